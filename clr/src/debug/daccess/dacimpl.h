@@ -1002,6 +1002,7 @@ public:
     DECLARE_DAC_REQUEST(RequestGCHeapSegment);
     DECLARE_DAC_REQUEST(RequestDACUnitTestData);
     DECLARE_DAC_REQUEST(RequestHandleTableTraverse);
+    DECLARE_DAC_REQUEST(RequestHandleCacheData);
     DECLARE_DAC_REQUEST(RequestLoaderHeapTraverse);
     DECLARE_DAC_REQUEST(RequestVirtCallStubHeapTraverse);
     DECLARE_DAC_REQUEST(RequestIsStub);
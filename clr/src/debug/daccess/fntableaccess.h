@@ -42,8 +42,6 @@ struct FakeHeapList
     LPVOID              pHeap;          // changed type from LoaderHeap*
     DWORD_PTR           startAddress;   // changed from PBYTE
     DWORD_PTR           endAddress;     // changed from PBYTE
-    volatile PBYTE      changeStart;
-    volatile PBYTE      changeEnd;
     DWORD_PTR           mapBase;        // changed from PBYTE
     DWORD_PTR           pHdrMap;        // changed from DWORD*
     size_t              maxCodeHeapSize;
@@ -35,6 +35,14 @@
 #define PTR_CDADDR(ptr)   TO_CDADDR(PTR_TO_TADDR(ptr))
 #define HOST_CDADDR(host) TO_CDADDR(PTR_HOST_TO_TADDR(host))
 
+// Size a Dacp structure had before the 4-byte fields starting at field were
+// appended to it. The old structure was padded up to the alignment of its
+// CLRDATA_ADDRESS members, which is not the same on every platform.
+struct DacpAddressAlignment { BYTE b; CLRDATA_ADDRESS addr; };
+#define DACP_ADDRESS_ALIGNMENT offsetof(DacpAddressAlignment, addr)
+#define DACP_SIZE_BEFORE(type, field) \
+    ((offsetof(type, field) + DACP_ADDRESS_ALIGNMENT - 1) & ~(DACP_ADDRESS_ALIGNMENT - 1))
+
 // Use this when you don't want to instantiate an Object * in the host.
 TADDR DACGetMethodTableFromObjectPointer(TADDR objAddr,ICLRDataTarget* target)
 {
@@ -292,9 +300,12 @@ ClrDataAccess::RequestThreadpoolData(IN ULONG32 inBufferSize,
                                      IN ULONG32 outBufferSize,
                                      OUT BYTE* outBuffer)
 {
+    // Callers built before the hill climbing fields were added pass the
+    // smaller size
     if ((inBufferSize != 0) ||
         (inBuffer != NULL) ||
-        (outBufferSize != sizeof(DacpThreadpoolData)))
+        ((outBufferSize != sizeof(DacpThreadpoolData)) &&
+         (outBufferSize != offsetof(DacpThreadpoolData, WorkerThreadTarget))))
     {
         return E_INVALIDARG;
     }
@@ -319,21 +330,18 @@ ClrDataAccess::RequestThreadpoolData(IN ULONG32 inBufferSize,
     threadpoolData->CurrentLimitTotalCPThreads = ThreadpoolMgr::CurrentLimitTotalCPThreads;
     threadpoolData->MinLimitTotalCPThreads = ThreadpoolMgr::MinLimitTotalCPThreads;
 
-    TADDR pEntry = DacGetTargetAddrForHostAddr(&ThreadpoolMgr::TimerQueue,true);
-    ThreadpoolMgr::LIST_ENTRY entry;
-    DacReadAll(pEntry,&entry,sizeof(ThreadpoolMgr::LIST_ENTRY),true);
-    TADDR node = (TADDR) entry.Flink;
-    threadpoolData->NumTimers = 0;
-    while (node && node != pEntry)
-    {
-        threadpoolData->NumTimers++;
-        DacReadAll(node,&entry,sizeof(ThreadpoolMgr::LIST_ENTRY),true);
-        node = (TADDR) entry.Flink;
-    }
+    threadpoolData->NumTimers = ThreadpoolMgr::NumTimers;
     
     threadpoolData->QueueUserWorkItemCallbackFPtr = (CLRDATA_ADDRESS) GFN_TADDR(QueueUserWorkItemCallback);
     threadpoolData->AsyncCallbackCompletionFPtr = (CLRDATA_ADDRESS) GFN_TADDR(ThreadpoolMgr__AsyncCallbackCompletion);
     threadpoolData->AsyncTimerCallbackCompletionFPtr = (CLRDATA_ADDRESS) GFN_TADDR(ThreadpoolMgr__AsyncTimerCallbackCompletion);
+
+    if (outBufferSize == sizeof(DacpThreadpoolData))
+    {
+        threadpoolData->WorkerThreadTarget = ThreadpoolMgr::WorkerThreadTarget;
+        threadpoolData->WorkerThroughput = ThreadpoolMgr::WorkerThroughput;
+        threadpoolData->WorkerThreadAdjustments = ThreadpoolMgr::WorkerThreadAdjustments;
+    }
     return S_OK;
 }
 
@@ -343,9 +351,12 @@ ClrDataAccess::RequestThreadStoreData(IN ULONG32 inBufferSize,
                                       IN ULONG32 outBufferSize,
                                       OUT BYTE* outBuffer)
 {
+    // Callers built before the suspension statistics were added pass the
+    // smaller size
     if ((inBufferSize != 0) ||
         (inBuffer != NULL) ||
-        (outBufferSize != sizeof(DacpThreadStoreData)))
+        ((outBufferSize != sizeof(DacpThreadStoreData)) &&
+         (outBufferSize != DACP_SIZE_BEFORE(DacpThreadStoreData, suspendCount))))
     {
         return E_INVALIDARG;
     }
@@ -370,6 +381,16 @@ ClrDataAccess::RequestThreadStoreData(IN ULONG32 inBufferSize,
 
     threadStoreData->fHostConfig = g_fHostConfig;
 
+    C_ASSERT(DACP_SUSPEND_HISTOGRAM_BUCKETS == SUSPEND_HISTOGRAM_BUCKETS);
+    if (outBufferSize == sizeof(DacpThreadStoreData))
+    {
+        threadStoreData->suspendCount = threadStore->m_SuspendCount;
+        for (int i = 0; i < SUSPEND_HISTOGRAM_BUCKETS; i++)
+        {
+            threadStoreData->suspendHistogram[i] = threadStore->m_SuspendHistogram[i];
+        }
+    }
+
     threadStoreData->firstThread =
         HOST_CDADDR(threadStore->m_ThreadList.GetHead());
 
@@ -1974,9 +1995,11 @@ ClrDataAccess::RequestAppDomainData(IN ULONG32 inBufferSize,
                                     IN ULONG32 outBufferSize,
                                     OUT BYTE* outBuffer)
 {
+    // Callers built before pPrecodeHeap was added pass the smaller size
     if ((inBufferSize != sizeof(CLRDATA_ADDRESS)) ||
         (inBuffer == NULL) ||
-        (outBufferSize != sizeof(DacpAppDomainData)))
+        ((outBufferSize != sizeof(DacpAppDomainData)) &&
+         (outBufferSize != offsetof(DacpAppDomainData, pPrecodeHeap))))
     {
         return E_INVALIDARG;
     }
@@ -1995,12 +2018,16 @@ ClrDataAccess::RequestAppDomainData(IN ULONG32 inBufferSize,
         return E_INVALIDARG;
     }
 
-    ZeroMemory(appdomainData,sizeof(DacpAppDomainData));
+    ZeroMemory(appdomainData,outBufferSize);
     appdomainData->AppDomainPtr = HOST_CDADDR(pAppDomain);
     appdomainData->AppSecDesc = HOST_CDADDR(pAppDomain->GetSecurityDescriptor());
     appdomainData->pHighFrequencyHeap = HOST_CDADDR(pAppDomain->GetHighFrequencyHeap());
     appdomainData->pLowFrequencyHeap = HOST_CDADDR(pAppDomain->GetLowFrequencyHeap());
     appdomainData->pStubHeap = HOST_CDADDR(pAppDomain->GetStubHeap());
+    if (outBufferSize == sizeof(DacpAppDomainData))
+    {
+        appdomainData->pPrecodeHeap = HOST_CDADDR(pAppDomain->GetPrecodeHeap());
+    }
     appdomainData->appDomainStage = STAGE_OPEN;
 
     if (PTR_BaseDomain(pAppDomain) == PTR_BaseDomain(SharedDomain::GetDomain()))
@@ -3145,6 +3172,59 @@ ClrDataAccess::RequestHandleTableTraverse(IN ULONG32 inBufferSize,
     }
 
 
+    return S_OK;
+}
+
+HRESULT
+ClrDataAccess::RequestHandleCacheData(IN ULONG32 inBufferSize,
+                             IN BYTE* inBuffer,
+                             IN ULONG32 outBufferSize,
+                             OUT BYTE* outBuffer)
+{
+    if ((inBufferSize != 0) ||
+        (inBuffer != NULL) ||
+        (outBufferSize != sizeof(DacpHandleCacheData)))
+    {
+        return E_INVALIDARG;
+    }
+
+    DacpHandleCacheData *cacheData = (DacpHandleCacheData *)outBuffer;
+    ZeroMemory(cacheData, sizeof(DacpHandleCacheData));
+
+    int NumSlots = 1;
+    if (GCHeap::IsServerHeap())
+    {
+#ifdef GC_SMP
+        _ASSERTE(0);
+#else // !GC_SMP
+        NumSlots = GCHeapCount();
+#endif // !GC_SMP
+    }
+
+    HandleTableMap *pWalk = (HandleTableMap *)&g_HandleTableMap;
+    while(pWalk)
+    {
+        for(int i=0;i<INITIAL_HANDLE_TABLE_ARRAY_SIZE;i++)
+        {
+            HandleTableBucket *pBucket = PTR_HandleTableBucket(pWalk->pBuckets[i]);
+            if (pBucket)
+            {
+                TADDR *pTables = (TADDR *)PTR_READ((TADDR)pBucket->pTable,
+                                                   sizeof(HandleTable *)*NumSlots);
+                for(int j=0;j<NumSlots;j++)
+                {
+                    HandleTable *pTable = PTR_HandleTable(pTables[j]);
+                    cacheData->allocMisses += pTable->dwAllocMisses;
+                    cacheData->freeMisses += pTable->dwFreeMisses;
+                    cacheData->magazineRefills += pTable->dwMagazineRefills;
+                    cacheData->magazineSpills += pTable->dwMagazineSpills;
+                }
+            }
+        }
+
+        pWalk = pWalk->pNext;
+    }
+
     return S_OK;
 
 }
@@ -3351,9 +3431,12 @@ ClrDataAccess::RequestSyncBlockData(IN ULONG32 inBufferSize,
                              IN ULONG32 outBufferSize,
                              OUT BYTE* outBuffer)
 {
+    // Callers built before the contention counts were added pass the smaller
+    // size
     if ((inBufferSize != sizeof(UINT)) ||
         (inBuffer == NULL) ||
-        (outBufferSize != sizeof(DacpSyncBlockData)))
+        ((outBufferSize != sizeof(DacpSyncBlockData)) &&
+         (outBufferSize != DACP_SIZE_BEFORE(DacpSyncBlockData, ContentionCount))))
     {
         return E_INVALIDARG;
     }
@@ -3361,7 +3444,7 @@ ClrDataAccess::RequestSyncBlockData(IN ULONG32 inBufferSize,
     DacpSyncBlockData* pSyncBlockData = reinterpret_cast<DacpSyncBlockData*> (outBuffer);
     UINT SBNumber = * reinterpret_cast<UINT *> (inBuffer);
 
-    ZeroMemory(pSyncBlockData,sizeof(DacpSyncBlockData));
+    ZeroMemory(pSyncBlockData,outBufferSize);
     pSyncBlockData->SyncBlockCount = (SyncBlockCache::s_pSyncBlockCache->m_FreeSyncTableIndex) - 1;
     PTR_SyncTableEntry ste = PTR_SyncTableEntry(PTR_HOST_TO_TADDR(g_pSyncTable)+(sizeof(SyncTableEntry) * SBNumber));
     pSyncBlockData->bFree = (((TADDR)ste->m_Object) & 1);
@@ -3379,6 +3462,13 @@ ClrDataAccess::RequestSyncBlockData(IN ULONG32 inBufferSize,
             pSyncBlockData->Recursion = pBlock->m_Monitor.m_Recursion;
             pSyncBlockData->HoldingThread = HOST_CDADDR(pBlock->m_Monitor.m_HoldingThread);
 
+            if (outBufferSize == sizeof(DacpSyncBlockData))
+            {
+                pSyncBlockData->ContentionCount = pBlock->m_Monitor.GetContentionCount();
+                pSyncBlockData->SpinAcquireCount = pBlock->m_Monitor.GetSpinAcquireCount();
+                pSyncBlockData->WaitCount = pBlock->m_Monitor.GetWaitCount();
+            }
+
             if (pBlock->GetAppDomainIndex().m_dwIndex)
             {
                 pSyncBlockData->appDomainPtr = PTR_HOST_TO_TADDR(
@@ -3851,6 +3941,10 @@ ClrDataAccess::Request(IN ULONG32 reqCode,
             status = RequestHandleTableTraverse(inBufferSize, inBuffer,
                             outBufferSize, outBuffer);
             break;
+        case DACPRIV_REQUEST_HANDLECACHE_DATA:
+            status = RequestHandleCacheData(inBufferSize, inBuffer,
+                            outBufferSize, outBuffer);
+            break;
 #ifdef STRESS_LOG
         case DACPRIV_REQUEST_STRESSLOG_DATA:
             status = RequestStressLogData(inBufferSize, inBuffer,
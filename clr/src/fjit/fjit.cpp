@@ -3226,6 +3226,10 @@ JitAgain:
     // note: entering of the critical section is not part of the prolog
     mapping->add(CURRENT_INDEX,(unsigned)(outPtr - outBuff));
 
+    if (FJit_fPollInProlog) {
+        emit_trap_gc();
+    }
+
     if (methodAttributes & CORINFO_FLG_SYNCH) {
         ENTER_CRIT;
     }
@@ -100,6 +100,8 @@ extern void* FJit_pHlpNewObj;                   // CORINFO_Object (jit_call*) (C
 extern void* FJit_pHlpThrow;                    // void (jit_call*) (CORINFO_Object obj)
 extern void* FJit_pHlpRethrow;                  // void (jit_call*) ()
 extern void* FJit_pHlpPoll_GC;                  // void (jit_call*) ()
+extern LONG* FJit_pTrapReturningThreads;        // nonzero while the runtime wants threads to stop
+extern BOOL  FJit_fPollInProlog;                // poll for GC on entry to every method as well
 extern void* FJit_pHlpMonEnter;                 // void (jit_call*) (CORINFO_Object obj)
 extern void* FJit_pHlpMonExit;                  // void (jit_call*) (CORINFO_Object obj)
 extern void* FJit_pHlpMonEnterStatic;           // void (jit_call*) (CORINFO_METHOD_HANDLE method)
@@ -30,6 +30,7 @@ XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX
 
 #include "new.h"                // for placement new
 #include "fjitcore.h"
+#include "jitperf.h"
 #include <stdio.h>
 
 
@@ -68,6 +69,8 @@ void* FJit_pHlpNewObj;
 void* FJit_pHlpThrow;
 void* FJit_pHlpRethrow;
 void* FJit_pHlpPoll_GC;
+LONG* FJit_pTrapReturningThreads;
+BOOL  FJit_fPollInProlog;
 void* FJit_pHlpMonEnter;
 void* FJit_pHlpMonExit;
 void* FJit_pHlpMonEnterStatic;
@@ -211,6 +214,7 @@ CorJitResult __stdcall FJitCompiler::compileMethod (
     unsigned savedCodeBufferCommittedSize = 0;
     unsigned int codeSize = 0;
     unsigned actualCodeSize;
+    JIT_PERF_PHASE_LOCALS();
 
 #if defined(_DEBUG) || defined(LOGGING)
     const char *szDebugMethodName = NULL;
@@ -248,6 +252,7 @@ CorJitResult __stdcall FJitCompiler::compileMethod (
             codeSize = ROUND_TO_PAGE(info->ILCodeSize * 64);  
     #endif
         BOOL jitRetry = FALSE;  // this is set to false unless we get an exception because of underestimation of code buffer size
+        START_JIT_PERF_PHASE();
         do {    // the following loop is expected to execute only once, except when we underestimate the size of the code buffer,
                 // in which case, we try again with a larger codeSize
             if (codeSize < MIN_CODE_BUFFER_RESERVED_SIZE)
@@ -383,6 +388,10 @@ CorJitResult __stdcall FJitCompiler::compileMethod (
 
         } while (jitRetry);
 
+        // FJIT verifies the IL in the same pass that generates code, so a
+        // compile that verifies is accounted to the verify phase as a whole
+        STOP_JIT_PERF_PHASE((flags & CORJIT_FLG_SKIP_VERIFICATION) ? JIT_PERF_CODEGEN : JIT_PERF_VERIFY);
+
         if (ret != CORJIT_OK)
         {
             goto Done;
@@ -394,6 +403,8 @@ CorJitResult __stdcall FJitCompiler::compileMethod (
             fjitData->displayGCMapInfo();
 #endif
 
+        START_JIT_PERF_PHASE();
+
         /* write the EH info */
         unsigned exceptionCount;
         FJit_Encode* mapping;
@@ -550,6 +561,8 @@ CorJitResult __stdcall FJitCompiler::compileMethod (
 #endif // _DEBUG
         _ASSERTE(!GCInfo_len); 
 
+        STOP_JIT_PERF_PHASE(JIT_PERF_GCINFO);
+
 
 #ifdef _DEBUG
         if (codeSize < MIN_CODE_BUFFER_RESERVED_SIZE)
@@ -620,10 +633,18 @@ BOOL FJitCompiler::Init()
     FJit_HelpersInstalled = false;
     if (!FJit::Init()) 
         return FALSE;
+#ifdef ENABLE_JIT_PERF
+    PerfLog::PerfLogInitialize();
+    JitPerf::Initialize();
+#endif //ENABLE_JIT_PERF
     return TRUE;
 }
 
 void FJitCompiler::Terminate() {
+#ifdef ENABLE_JIT_PERF
+    JitPerf::Done();
+    PerfLog::PerfLogDone();
+#endif //ENABLE_JIT_PERF
     FJit::Terminate();
     if (ILJitter) ILJitter->~FJitCompiler();
     ILJitter = NULL;
@@ -662,6 +683,16 @@ BOOL FJitCompiler::GetJitHelpers(ICorJitInfo* jitInfo) {
     FJit_pHlpPoll_GC = jitInfo->getHelperFtn(CORINFO_HELP_POLL_GC);
     if (!FJit_pHlpPoll_GC) return false;
 
+    void* pIndirection;
+    FJit_pTrapReturningThreads = jitInfo->getAddrOfCaptureThreadGlobal(&pIndirection);
+    if (!FJit_pTrapReturningThreads) return false;
+
+    // When the runtime suspends for GC by polling (COMPlus_GCPollSuspend) it
+    // waits for running threads to reach a poll, so methods without loops
+    // have to poll too
+    static ConfigDWORD fGCPollSuspend;
+    FJit_fPollInProlog = (fGCPollSuspend.val(L"GCPollSuspend") != 0);
+
     FJit_pHlpMonEnter = jitInfo->getHelperFtn(CORINFO_HELP_MON_ENTER);
     if (!FJit_pHlpMonEnter) return false;
 
@@ -250,6 +250,14 @@
         cmdByte(expOr2(expNum(0xC0 | (op << 3)), reg)), \
         if(ext == x86NoExtend && size == x86Big) { cmdDWord(imm); } else { cmdByte(imm); } )
 
+/* In using this instruction the destination register for addMode should be op.
+   The immediate is sign extended to the operand size */
+#define x86_barith_mem_imm8(op, size, addMode, imm8)    \
+    cmdBlock3(                                          \
+        /*_ASSERTE(size == x86Byte | size == x86Big),*/ \
+        cmdByte(expNum(0x80 | size | (size << 1))),     \
+        addMode,                                        \
+        cmdByte(imm8))
 
 /********************* Shift instructions ************************/
 
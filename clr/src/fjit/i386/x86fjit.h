@@ -70,6 +70,9 @@
 /* stack operations */
 #define emit_testTOS() x86_testTOS
 
+/* gc polls */
+#define emit_trap_gc() x86_emit_trap_gc()
+
 /* moves between memory */
 #define emit_LDIND_I8(unaligned)                  x86_load_indirect_qword()
 
@@ -451,6 +454,23 @@
     inRegTOS = false;   \
     x86_test(x86Big, x86_mod_reg(X86_EAX, X86_EAX))
 
+/* The runtime sets g_TrapReturningThreads whenever it wants threads to stop, so
+   test it in line and only call the helper when it is set. TOS is spilled on
+   both paths to keep inRegTOS the same after the poll. */
+#define x86_emit_trap_gc()                                              \
+{                                                                       \
+    LABELSTACK((outPtr-outBuff), 0);                                    \
+    deregisterTOS;                                                      \
+    x86_barith_mem_imm8(x86OpCmp, x86Big,                               \
+        x86_mod_disp32(x86OpCmp, (unsigned int) FJit_pTrapReturningThreads), 0); \
+    x86_jmp_cond_small(x86CondEq);                                      \
+    BYTE* emitter_scratch_1 = outPtr;                                   \
+    outPtr++;                                                           \
+    callInfo.reset();                                                   \
+    emit_callhelper_(FJit_pHlpPoll_GC);                                 \
+    *emitter_scratch_1 = (BYTE) (outPtr - emitter_scratch_1 - 1);       \
+}
+
 
 #define x86_LOCALLOC(initialized,EHcount)  \
     enregisterTOS;      \
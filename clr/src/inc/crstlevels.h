@@ -126,6 +126,7 @@ DEFINE_CRST_LEVEL(CrstStubInterceptor                )             // stub track
 DEFINE_CRST_LEVEL(CrstStubTracker                    )             // stub tracker (debug       )    
 DEFINE_CRST_LEVEL(CrstSyncBlockCache                 )             // allocate a SyncBlock to an object -- taken inside CrstHandleTable
 DEFINE_CRST_LEVEL(CrstHandleTable                    )             // allocate / release a handle (called inside CrstSingleUseLock       )    
+DEFINE_CRST_LEVEL(CrstHandleMagazines                )             // claim / return a per-thread handle cache -- takes CrstHandleTable
 DEFINE_CRST_LEVEL(CrstCompressedStackRef             )             // Reference counting lock for the compressed stack
 DEFINE_CRST_LEVEL(CrstExecuteManRangeLock            )    
 DEFINE_CRST_LEVEL(CrstSyncHashLock                   )             // used for synchronized access to a hash table
@@ -230,6 +231,7 @@ DEFINE_CRST_LEVEL(CrstDeadlockDetection              )
 DEFINE_CRST_LEVEL(CrstPublisherCertificate           )
 DEFINE_CRST_LEVEL(CrstModIntPairList                 )
 DEFINE_CRST_LEVEL(CrstRVAOverrides                   )
+DEFINE_CRST_LEVEL(CrstVerificationCache              )
 
 // These should not be used in any checked in sources. They exist simply
 // so that if you need to add a new crstlevel, you can use one of these temporarily
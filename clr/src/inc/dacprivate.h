@@ -207,7 +207,8 @@ enum
     DACPRIV_REQUEST_NESTEDEXCEPTION_DATA,
     DACPRIV_REQUEST_USEFULGLOBALS,
     DACPRIV_REQUEST_CLRTLSDATA_INDEX,
-    DACPRIV_REQUEST_MODULE_FINDIL
+    DACPRIV_REQUEST_MODULE_FINDIL,
+    DACPRIV_REQUEST_HANDLECACHE_DATA
 };
 
 // Private requests for tasks.
@@ -566,6 +567,8 @@ struct DacpMethodTableData
 #define CLRSECURITYHOSTED                           0x80
 #define CLRHOSTED           0x80000000
 
+#define DACP_SUSPEND_HISTOGRAM_BUCKETS 16
+
 struct DacpThreadStoreData
 {
     LONG threadCount;
@@ -577,6 +580,10 @@ struct DacpThreadStoreData
     CLRDATA_ADDRESS finalizerThread;
     CLRDATA_ADDRESS gcThread;
     DWORD fHostConfig;          // Uses hosting flags defined above
+    // Added last so that the debugger extensions built against the smaller
+    // structure keep working
+    DWORD suspendCount;         // successful runtime suspensions
+    DWORD suspendHistogram[DACP_SUSPEND_HISTOGRAM_BUCKETS];  // by time to suspend, in power of two microseconds
 	
     HRESULT Request(IXCLRDataProcess* dac)
     {
@@ -639,6 +646,9 @@ struct DacpAppDomainData
     LONG AssemblyCount;
     LONG FailedAssemblyCount;
     DacpAppDomainDataStage appDomainStage; 
+    // Added last so that the debugger extensions built against the smaller
+    // structure keep working
+    CLRDATA_ADDRESS pPrecodeHeap;
     
     HRESULT Request(IXCLRDataProcess* dac, CLRDATA_ADDRESS addr)
     {
@@ -989,6 +999,12 @@ struct DacpThreadpoolData
     CLRDATA_ADDRESS QueueUserWorkItemCallbackFPtr;
     CLRDATA_ADDRESS AsyncCallbackCompletionFPtr;
     CLRDATA_ADDRESS AsyncTimerCallbackCompletionFPtr;
+
+    // Added last so that the debugger extensions built against the smaller
+    // structure keep working
+    LONG WorkerThreadTarget;            // picked by the hill climbing
+    LONG WorkerThroughput;              // work requests completed per second
+    DWORD WorkerThreadAdjustments;
     
     HRESULT Request(IXCLRDataProcess* dac)
     {
@@ -1148,6 +1164,12 @@ struct DacpSyncBlockData
     // SyncBlocks may be requested from [1,SyncBlockCount]
     UINT            SyncBlockCount;
 
+    // Added last so that the debugger extensions built against the smaller
+    // structure keep working
+    UINT            ContentionCount;    // times a thread found the lock taken
+    UINT            SpinAcquireCount;   // of those, lock taken while spinning
+    UINT            WaitCount;          // times a thread blocked for the lock
+
     // SyncBlockNumber must be from [1,SyncBlockCount]    
     // If there are no SyncBlocks, a call to Request with SyncBlockCount = 1
     // will return E_FAIL.
@@ -1258,6 +1280,22 @@ struct DacpHandleTableTraverse
     }
 };
 
+// Handle cache statistics summed over all handle tables
+struct DacpHandleCacheData
+{
+    DWORD allocMisses;          // allocations that took a table lock
+    DWORD freeMisses;           // frees that took a table lock
+    DWORD magazineRefills;      // batches moved from a table cache to a thread
+    DWORD magazineSpills;       // batches moved from a thread to a table cache
+
+    HRESULT Request(IXCLRDataProcess* dac)
+    {
+        return dac->Request(DACPRIV_REQUEST_HANDLECACHE_DATA,
+                            0, NULL,
+                            sizeof(*this), (PBYTE)this);
+    }
+};
+
 typedef void (*VISITHEAP)(CLRDATA_ADDRESS blockData,size_t blockSize,BOOL blockIsCurrentBlock);
 struct DacpLoaderHeapTraverseArgs
 {
@@ -74,6 +74,9 @@ DEFINE_DACVAR(ULONG, int, ThreadpoolMgr__MinLimitTotalWorkerThreads)
 DEFINE_DACVAR(ULONG, DWORD, ThreadpoolMgr__MaxLimitTotalWorkerThreads)
 DEFINE_DACVAR(ULONG, int, ThreadpoolMgr__NumIdleWorkerThreads)
 DEFINE_DACVAR(ULONG, LONG, ThreadpoolMgr__NumQueuedWorkRequests)
+DEFINE_DACVAR(ULONG, LONG, ThreadpoolMgr__WorkerThreadTarget)
+DEFINE_DACVAR(ULONG, LONG, ThreadpoolMgr__WorkerThroughput)
+DEFINE_DACVAR(ULONG, DWORD, ThreadpoolMgr__WorkerThreadAdjustments)
 DEFINE_DACVAR(ULONG, ULONG*, ThreadpoolMgr__WorkRequestHead) // PTR_WorkRequest is not defined. So use a pointer type
 DEFINE_DACVAR(ULONG, ULONG*, ThreadpoolMgr__WorkRequestTail) // 
 DEFINE_DACVAR(ULONG, DWORD, ThreadpoolMgr__NumTimers)    
@@ -84,7 +87,6 @@ DEFINE_DACVAR(ULONG, LONG, ThreadpoolMgr__NumRetiredCPThreads)
 DEFINE_DACVAR(ULONG, LONG, ThreadpoolMgr__MaxLimitTotalCPThreads)
 DEFINE_DACVAR(ULONG, LONG, ThreadpoolMgr__CurrentLimitTotalCPThreads)
 DEFINE_DACVAR(ULONG, LONG, ThreadpoolMgr__MinLimitTotalCPThreads)        
-DEFINE_DACVAR(ULONG, LIST_ENTRY, ThreadpoolMgr__TimerQueue)        
 
 DEFINE_DACVAR(ULONG, ULONG, GCHeap__gcHeapType)
 DEFINE_DACVAR(ULONG, PTR_Thread, GCHeap__FinalizerThread)
@@ -27,12 +27,151 @@
 
 #include "mscoree.h"
 #include "clrinternal.h"
+#include "perflog.h"
 
+//-----------------------------------------------------------------------------
+// The jit stats piggy back on the perf log, so they are gathered whenever the
+// perf log is compiled in. Define DISABLE_JIT_PERF to leave them out.
+#if defined(ENABLE_PERF_LOG) && !defined(DISABLE_JIT_PERF)
+#define ENABLE_JIT_PERF
+#endif
+
+//=============================================================================
+// ALL THE JIT PERF STATS GATHERING CODE IS COMPILED ONLY IF THE ENABLE_JIT_PERF WAS DEFINED.
+#if defined(ENABLE_JIT_PERF)
+//=============================================================================
+
+//-----------------------------------------------------------------------------
+// Phases of a single compileMethod call that the jit times for itself.
+// **keep in sync *** with the array of names defined in JitPerf.cpp
+typedef enum
+{
+    JIT_PERF_VERIFY = 0,    // IL pass of compiles that verify (import only or not)
+    JIT_PERF_CODEGEN,       // IL pass of compiles that skip verification
+    JIT_PERF_GCINFO,        // EH clauses, GC info and IL to native map encoding
+    JIT_PERF_PHASE_COUNT
+} JitPerfPhase;
+
+//-----------------------------------------------------------------------------
+// Per method bookkeeping of the EE side of a compile. It lives in the frame
+// of the caller of START_JIT_PERF and is chained through TlsIdx_JitPerf, so
+// methods jitted while the EE services a callback of another compile are
+// accounted to themselves.
+struct JitPerfFrame
+{
+    JitPerfFrame*   m_pPrev;
+    LONGLONG        m_startTicks;
+    LONGLONG        m_nonJitStartTicks;
+    LONGLONG        m_nonJitTicks;      // time spent in EE callbacks
+    DWORD           m_nonJitDepth;
+    DWORD           m_cbIL;
+    BOOL            m_fLinked;
+
+    JitPerfFrame() { LEAF_CONTRACT; m_fLinked = FALSE; }
+
+    // Unlinks the frame if the compile was abandoned by an exception
+    ~JitPerfFrame();
+};
+
+//-----------------------------------------------------------------------------
+// Namespace for the jit stats. Each module that includes this file and calls
+// Initialize/Done gathers and logs its own stats: the EE logs the per method
+// totals and the jit logs the time spent in each of its phases.
+class JitPerf
+{
+public:
+    // Called during startup; jit stats are gathered only if PERF_OUTPUT is set.
+    static void Initialize();
+
+    // Called during shutdown, logs the stats gathered so far.
+    static void Done();
+
+    static BOOL Enabled() { LEAF_CONTRACT; return s_fEnabled; }
+
+    // Raw timestamp in performance counter ticks
+    static LONGLONG GetTicks()
+    {
+        LEAF_CONTRACT;
+        LARGE_INTEGER ticks;
+        QueryPerformanceCounter(&ticks);
+        return ticks.QuadPart;
+    }
+
+    static void StartJit(JitPerfFrame *pFrame);
+    static void StopJit(JitPerfFrame *pFrame);
+    static void StartNonJit();
+    static void StopNonJit();
+    static void UpdateILCodeSize(DWORD cbIL);
+    static void UpdateNativeCodeSize(size_t cbNative);
+    static void UpdatePhase(JitPerfPhase phase, LONGLONG startTicks);
+
+private:
+    JitPerf();
+    ~JitPerf();
+
+    static void AddTo(LONGLONG volatile *pTotal, LONGLONG val);
+
+    static BOOL         s_fEnabled;
+    static LONGLONG     s_frequency;
+
+    // EE side totals
+    static LONG         s_cMethodsJitted;
+    static LONGLONG     s_cbILJitted;
+    static LONGLONG     s_cbNativeJitted;
+    static LONGLONG     s_jitTicks;
+    static LONGLONG     s_nonJitTicks;
+
+    // jit side totals
+    static LONG         s_cPhase[JIT_PERF_PHASE_COUNT];
+    static LONGLONG     s_phaseTicks[JIT_PERF_PHASE_COUNT];
+};
+
+// Use the caller's stack frame, so START and STOP must be in the same scope.
+#define START_JIT_PERF()                                                \
+    JitPerfFrame __jitPerfFrame;                                        \
+    JitPerf::StartJit(&__jitPerfFrame)
+
+#define STOP_JIT_PERF()                                                 \
+    JitPerf::StopJit(&__jitPerfFrame)
+
+#define START_NON_JIT_PERF()                                            \
+    JitPerf::StartNonJit()
+
+#define STOP_NON_JIT_PERF()                                             \
+    JitPerf::StopNonJit()
+
+#define JIT_PERF_UPDATE_IL_CODE_SIZE(size)                              \
+    JitPerf::UpdateILCodeSize(size)
+
+#define JIT_PERF_UPDATE_X86_CODE_SIZE(size)                             \
+    JitPerf::UpdateNativeCodeSize(size)
+
+// Phase timing inside the jit. The phases of one method run one after the
+// other, so a single timestamp declared by JIT_PERF_PHASE_LOCALS is enough.
+#define JIT_PERF_PHASE_LOCALS()                                         \
+    LONGLONG __jitPerfPhaseStart = 0
+
+#define START_JIT_PERF_PHASE()                                          \
+    do { if (JitPerf::Enabled()) __jitPerfPhaseStart = JitPerf::GetTicks(); } while (0)
+
+#define STOP_JIT_PERF_PHASE(phase)                                      \
+    JitPerf::UpdatePhase(phase, __jitPerfPhaseStart)
+
+#else // ENABLE_JIT_PERF
 
 #define START_JIT_PERF()
 #define STOP_JIT_PERF()
 #define START_NON_JIT_PERF()
 #define STOP_NON_JIT_PERF()
+#define JIT_PERF_UPDATE_IL_CODE_SIZE(size)
 #define JIT_PERF_UPDATE_X86_CODE_SIZE(size)                 
+#define JIT_PERF_PHASE_LOCALS()
+#define START_JIT_PERF_PHASE()
+#define STOP_JIT_PERF_PHASE(phase)
+
+//=============================================================================
+// ALL THE JIT PERF STATS GATHERING CODE IS COMPILED ONLY IF THE ENABLE_JIT_PERF WAS DEFINED.
+#endif // ENABLE_JIT_PERF
+//=============================================================================
 
 #endif //__JITPERF_H__
@@ -287,6 +287,9 @@ struct Perf_LocksAndThreads
     DWORD cCurrentThreadsLogical;           // Number (created - destroyed) of logical threads 
     DWORD cCurrentThreadsPhysical;          // Number (created - destroyed) of OS threads 
     TRICOUNT cRecognizedThreads;            // # of Threads execute in runtime's control
+// Sync blocks
+    DUALCOUNT cSyncBlocksAllocated;         // # of sync blocks handed out by SyncBlockCache
+    DUALCOUNT cSyncBlocksReclaimed;         // # of sync blocks returned to SyncBlockCache
 };
 
 
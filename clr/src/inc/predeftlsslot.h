@@ -45,6 +45,8 @@ enum PredefinedTlsSlots
     TlsIdx_OwnedCrstsChain, // slot to store the Crsts owned by this thread
     TlsIdx_AppDomainAgilePendingTable,
     TlsIdx_CantAllocCount, //Can't allocate memory on heap in this thread
+    TlsIdx_ThreadpoolWorkQueue, // work stealing queue of a threadpool worker thread
+    TlsIdx_HandleMagazines, // per-thread handle table caches
 
     MAX_PREDEFINED_TLS_SLOT
 };
@@ -2580,6 +2580,12 @@ DECLARE_API(SyncBlk)
                     ExtOut ("  %p", (ULONG64)syncBlockData.Object);
                     NameForObject_s((DWORD_PTR)syncBlockData.Object, g_mdName, mdNameLen);
                     ExtOut (" %S", g_mdName);
+
+                    if (syncBlockData.ContentionCount != 0 || syncBlockData.WaitCount != 0)
+                    {
+                        ExtOut (" (contended %u, spun %u, waited %u)", syncBlockData.ContentionCount,
+                                syncBlockData.SpinAcquireCount, syncBlockData.WaitCount);
+                    }
                 }            
             }
         }
@@ -3060,6 +3066,25 @@ HRESULT PrintThreadsFromThreadStore (BOOL bMiniDump, BOOL bPrintLiveThreadsOnly)
     ExtOut ("PendingThread: %d\n", ThreadStore.pendingThreadCount);
     ExtOut ("DeadThread: %d\n", ThreadStore.deadThreadCount);
 
+    if (ThreadStore.suspendCount != 0)
+    {
+        // time from trapping returning threads to all of them stopped
+        ExtOut ("Suspensions: %u (", ThreadStore.suspendCount);
+        const char *separator = "";
+        for (int i = 0; i < DACP_SUSPEND_HISTOGRAM_BUCKETS; i++)
+        {
+            if (ThreadStore.suspendHistogram[i] == 0)
+                continue;
+
+            if (i == DACP_SUSPEND_HISTOGRAM_BUCKETS - 1)
+                ExtOut ("%s>=%uus: %u", separator, 1 << i, ThreadStore.suspendHistogram[i]);
+            else
+                ExtOut ("%s<%uus: %u", separator, 2 << i, ThreadStore.suspendHistogram[i]);
+            separator = ", ";
+        }
+        ExtOut (")\n");
+    }
+
     ExtOut ("Hosted Runtime: %s", (ThreadStore.fHostConfig & CLRHOSTED) ? "yes" : "no" );
     if (ThreadStore.fHostConfig & ~CLRHOSTED)
     {
@@ -4045,6 +4070,10 @@ DECLARE_API(ThreadPool)
     ExtOut (" MaxLimit: %d", threadpool.MaxLimitTotalWorkerThreads);        
     ExtOut (" MinLimit: %d", threadpool.MinLimitTotalWorkerThreads);        
     ExtOut ("\n");        
+    ExtOut ("Worker Thread Target: %d", threadpool.WorkerThreadTarget);
+    ExtOut (" Throughput: %d/sec", threadpool.WorkerThroughput);
+    ExtOut (" Adjustments: %u", threadpool.WorkerThreadAdjustments);
+    ExtOut ("\n");
 
     ExtOut ("Work Request in Queue: %d\n", threadpool.NumQueuedWorkRequests);    
 
@@ -5112,6 +5141,15 @@ DECLARE_API(GCHandles)
             PrintGCStat(&(pStats->hs));
         }
     }
+
+    // how often handle allocation and free had to go past the caches
+    DacpHandleCacheData cacheData;
+    if (cacheData.Request(g_clrData) == S_OK)
+    {
+        ExtOut("Handle cache: %u alloc misses, %u free misses, %u thread refills, %u thread spills\n",
+               cacheData.allocMisses, cacheData.freeMisses,
+               cacheData.magazineRefills, cacheData.magazineSpills);
+    }
     
     return Status;
 }
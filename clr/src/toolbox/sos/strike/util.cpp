@@ -1612,6 +1612,7 @@ void DomainInfo (DacpAppDomainData *pDomain)
     dprintf ("LowFrequencyHeap: %p\n", (ULONG64)pDomain->pLowFrequencyHeap);
     dprintf ("HighFrequencyHeap: %p\n", (ULONG64)pDomain->pHighFrequencyHeap);
     dprintf ("StubHeap: %p\n", (ULONG64)pDomain->pStubHeap);
+    dprintf ("PrecodeHeap: %p\n", (ULONG64)pDomain->pPrecodeHeap);
     dprintf ("Stage: %s\n", GetStageText(pDomain->appDomainStage));
     if ((ULONG64)pDomain->AppSecDesc != NULL)
         dprintf ("SecurityDescriptor: %p\n", (ULONG64)pDomain->AppSecDesc);
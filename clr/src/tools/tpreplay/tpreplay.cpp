@@ -0,0 +1,296 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+//*****************************************************************************
+// File: tpreplay.cpp
+//
+// Replays threadpool samples recorded with COMPlus_ThreadpoolHillClimbingTrace
+// through the hill climbing controller (vm\hillclimbing.h), so that changes
+// to the controller and its settings can be tried without the workload.
+//
+// By default every recorded sample is fed to the controller and its target is
+// printed next to the one the runtime picked. With /simulate the trace is
+// turned into a throughput-by-thread-count model instead and the controller
+// runs against that model, choosing the thread count itself.
+//*****************************************************************************
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <palstartup.h>
+
+#ifndef LEAF_CONTRACT
+#define LEAF_CONTRACT
+#endif
+
+#include "hillclimbing.h"
+
+#define SAMPLE_INTERVAL     500         // GATE_THREAD_DELAY in the runtime
+#define MAX_THREADS         1024
+
+struct TraceRecord
+{
+    HillClimbingSample  sample;
+    LONG                target;         // what the runtime picked at the time
+};
+
+void Usage()
+{
+    printf("Usage: tpreplay [options] <trace file>\n");
+    printf("\n");
+    printf("\t/samples:<n> : samples measured at a thread count before moving (default %d)\n", HILLCLIMBING_DEFAULT_SAMPLES_PER_MOVE);
+    printf("\t/noise:<n>   : throughput change in percent that counts as noise (default %d)\n", HILLCLIMBING_DEFAULT_NOISE_PERCENT);
+    printf("\t/hold:<n>    : most extra samples to wait after a reversal (default %d)\n", HILLCLIMBING_DEFAULT_MAX_HOLD_SAMPLES);
+    printf("\t/min:<n>     : minimum number of worker threads (default 1)\n");
+    printf("\t/max:<n>     : maximum number of worker threads (default 25, at most %d)\n", MAX_THREADS);
+    printf("\t/simulate    : run the controller against a model built from the trace\n");
+    printf("\t/quiet       : only print the summary\n");
+    printf("\n");
+}
+
+// Reads the "<elapsed> <completions> <queue length> <active threads> <target>"
+// lines written by ThreadpoolMgr::TraceHillClimbingSample
+TraceRecord* ReadTrace(const char* path, int* pCount)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+        return NULL;
+
+    int capacity = 256;
+    int count = 0;
+    TraceRecord* records = (TraceRecord*)malloc(capacity * sizeof(TraceRecord));
+
+    unsigned elapsed, completions;
+    int queueLength, activeThreads, target;
+    while (records != NULL &&
+           fscanf(file, "%u %u %d %d %d", &elapsed, &completions, &queueLength, &activeThreads, &target) == 5)
+    {
+        if (count == capacity)
+        {
+            capacity *= 2;
+            TraceRecord* newRecords = (TraceRecord*)realloc(records, capacity * sizeof(TraceRecord));
+            if (newRecords == NULL)
+            {
+                free(records);
+                records = NULL;
+                break;
+            }
+            records = newRecords;
+        }
+
+        records[count].sample.ElapsedTime = elapsed;
+        records[count].sample.Completions = completions;
+        records[count].sample.QueueLength = queueLength;
+        records[count].sample.ActiveThreads = activeThreads;
+        records[count].target = target;
+        count++;
+    }
+
+    fclose(file);
+    *pCount = count;
+    return records;
+}
+
+void Replay(TraceRecord* records, int count, const HillClimbingSettings& settings,
+            LONG minThreads, LONG maxThreads, BOOL fQuiet)
+{
+    HillClimbing controller;
+    controller.Initialize(settings, count ? records[0].target : minThreads);
+
+    int differences = 0;
+    LONG totalDistance = 0;
+
+    if (!fQuiet)
+        printf("%8s %10s %8s %8s %10s %10s\n", "sample", "completed", "queued", "threads", "recorded", "replayed");
+
+    for (int i = 0; i < count; i++)
+    {
+        LONG target = controller.Update(records[i].sample, minThreads, maxThreads);
+
+        // the recorded target is the one in effect during the sample, so compare
+        // with the one the runtime picked at the next sample
+        LONG recorded = (i + 1 < count) ? records[i + 1].target : target;
+        if (recorded != target)
+        {
+            differences++;
+            totalDistance += (recorded > target) ? (recorded - target) : (target - recorded);
+        }
+
+        if (!fQuiet)
+            printf("%8d %10u %8d %8d %10d %10d\n", i, records[i].sample.Completions, records[i].sample.QueueLength,
+                   records[i].sample.ActiveThreads, recorded, target);
+    }
+
+    printf("\n");
+    printf("Samples:            %d\n", count);
+    printf("Adjustments:        %u\n", controller.GetAdjustments());
+    printf("Reversals:          %u\n", controller.GetReversals());
+    printf("Differing targets:  %d\n", differences);
+    printf("Mean difference:    %.2f\n", differences ? (double)totalDistance / differences : 0.0);
+}
+
+// Builds throughput (completions per second) as a function of the thread count
+// from the samples taken while work was waiting, and lets the controller pick
+// the thread count against it. Counts that were never recorded use the nearest
+// recorded count below, or above if there is none.
+void Simulate(TraceRecord* records, int count, const HillClimbingSettings& settings,
+              LONG minThreads, LONG maxThreads, BOOL fQuiet)
+{
+    static double completions[MAX_THREADS + 1];
+    static double elapsed[MAX_THREADS + 1];
+    static double model[MAX_THREADS + 1];
+
+    for (int i = 0; i < count; i++)
+    {
+        LONG threads = records[i].sample.ActiveThreads;
+        if (records[i].sample.QueueLength > 0 && threads > 0 && threads <= MAX_THREADS)
+        {
+            completions[threads] += records[i].sample.Completions;
+            elapsed[threads] += records[i].sample.ElapsedTime;
+        }
+    }
+
+    double last = -1;
+    for (int n = 1; n <= MAX_THREADS; n++)
+    {
+        if (elapsed[n] > 0)
+            last = completions[n] * 1000.0 / elapsed[n];
+        model[n] = last;
+    }
+    for (int n = MAX_THREADS; n >= 1; n--)
+    {
+        if (model[n] >= 0)
+            last = model[n];
+        else
+            model[n] = last;
+    }
+
+    if (last < 0)
+    {
+        printf("No samples with queued work in the trace\n");
+        return;
+    }
+
+    LONG best = minThreads;
+    for (LONG n = minThreads; n <= maxThreads; n++)
+    {
+        if (model[n] > model[best])
+            best = n;
+    }
+
+    HillClimbing controller;
+    controller.Initialize(settings, minThreads);
+
+    LONG threads = minThreads;
+    int firstAtBest = -1;
+    double totalCompletions = 0;
+
+    if (!fQuiet)
+        printf("%8s %8s %12s\n", "sample", "threads", "throughput");
+
+    for (int i = 0; i < count; i++)
+    {
+        HillClimbingSample sample;
+        sample.ElapsedTime = SAMPLE_INTERVAL;
+        sample.Completions = (DWORD)(model[threads] * SAMPLE_INTERVAL / 1000.0);
+        sample.QueueLength = 1;
+        sample.ActiveThreads = threads;
+        totalCompletions += sample.Completions;
+
+        if (threads == best && firstAtBest < 0)
+            firstAtBest = i;
+
+        if (!fQuiet)
+            printf("%8d %8d %12.0f\n", i, threads, model[threads]);
+
+        threads = controller.Update(sample, minThreads, maxThreads);
+    }
+
+    double seconds = (double)count * SAMPLE_INTERVAL / 1000.0;
+
+    printf("\n");
+    printf("Samples:            %d\n", count);
+    printf("Best thread count:  %d (%.0f/sec)\n", best, model[best]);
+    printf("First reached at:   sample %d\n", firstAtBest);
+    printf("Final thread count: %d\n", threads);
+    printf("Adjustments:        %u\n", controller.GetAdjustments());
+    printf("Reversals:          %u\n", controller.GetReversals());
+    printf("Mean throughput:    %.0f/sec (%.1f%% of best)\n", totalCompletions / seconds,
+           model[best] > 0 ? 100.0 * totalCompletions / seconds / model[best] : 100.0);
+}
+
+int __cdecl main(int argc, char* argv[])
+{
+    HillClimbingSettings settings;
+    settings.SamplesPerMove = HILLCLIMBING_DEFAULT_SAMPLES_PER_MOVE;
+    settings.NoisePercent = HILLCLIMBING_DEFAULT_NOISE_PERCENT;
+    settings.MaxHoldSamples = HILLCLIMBING_DEFAULT_MAX_HOLD_SAMPLES;
+
+    LONG minThreads = 1;
+    LONG maxThreads = 25;
+    BOOL fSimulate = FALSE;
+    BOOL fQuiet = FALSE;
+    const char* path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+
+        if (arg[0] != '/' && arg[0] != '-')
+            path = arg;
+        else if (strncmp(arg + 1, "samples:", 8) == 0)
+            settings.SamplesPerMove = atoi(arg + 9);
+        else if (strncmp(arg + 1, "noise:", 6) == 0)
+            settings.NoisePercent = atoi(arg + 7);
+        else if (strncmp(arg + 1, "hold:", 5) == 0)
+            settings.MaxHoldSamples = atoi(arg + 6);
+        else if (strncmp(arg + 1, "min:", 4) == 0)
+            minThreads = atoi(arg + 5);
+        else if (strncmp(arg + 1, "max:", 4) == 0)
+            maxThreads = atoi(arg + 5);
+        else if (strcmp(arg + 1, "simulate") == 0)
+            fSimulate = TRUE;
+        else if (strcmp(arg + 1, "quiet") == 0)
+            fQuiet = TRUE;
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    // The simulation keeps its model in arrays of MAX_THREADS + 1 entries
+    if (path == NULL || minThreads < 1 || maxThreads < minThreads || maxThreads > MAX_THREADS)
+    {
+        Usage();
+        return 1;
+    }
+
+    int count = 0;
+    TraceRecord* records = ReadTrace(path, &count);
+    if (records == NULL)
+    {
+        printf("Cannot read %s\n", path);
+        return 1;
+    }
+
+    if (fSimulate)
+        Simulate(records, count, settings, minThreads, maxThreads, fQuiet);
+    else
+        Replay(records, count, settings, minThreads, maxThreads, fQuiet);
+
+    free(records);
+    return 0;
+}
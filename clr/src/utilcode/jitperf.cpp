@@ -20,5 +20,216 @@
 
 //=============================================================================
 // ALL THE JIT PERF STATS GATHERING CODE IS COMPILED ONLY IF THE ENABLE_JIT_PERF WAS DEFINED.
+#if defined(ENABLE_JIT_PERF)
+//=============================================================================
+
+//-----------------------------------------------------------------------------
+// Names of the phases in JitPerfPhase. *** Keep in sync *** with JitPerf.h
+static wchar_t *wszJitPerfPhaseName[JIT_PERF_PHASE_COUNT] =
+{
+    L"Jit Verify",
+    L"Jit Codegen",
+    L"Jit GCInfo"
+};
+
+//-----------------------------------------------------------------------------
+// Initialize static variables of the JitPerf class.
+BOOL     JitPerf::s_fEnabled = FALSE;
+LONGLONG JitPerf::s_frequency = 0;
+LONG     JitPerf::s_cMethodsJitted = 0;
+LONGLONG JitPerf::s_cbILJitted = 0;
+LONGLONG JitPerf::s_cbNativeJitted = 0;
+LONGLONG JitPerf::s_jitTicks = 0;
+LONGLONG JitPerf::s_nonJitTicks = 0;
+LONG     JitPerf::s_cPhase[];
+LONGLONG JitPerf::s_phaseTicks[];
+
+void JitPerf::Initialize()
+{
+    LEAF_CONTRACT;
+
+    // Same switch as the perf log
+    wchar_t lpszValue[2];
+    if (WszGetEnvironmentVariable (L"PERF_OUTPUT", lpszValue, sizeof(lpszValue)/sizeof(lpszValue[0])) == 0)
+        return;
+
+    LARGE_INTEGER frequency;
+    if (!QueryPerformanceFrequency(&frequency) || frequency.QuadPart == 0)
+        return;
+
+    s_frequency = frequency.QuadPart;
+    s_fEnabled = TRUE;
+}
+
+// The counters are updated concurrently by all the threads that jit, without
+// taking a lock
+void JitPerf::AddTo(LONGLONG volatile *pTotal, LONGLONG val)
+{
+    LEAF_CONTRACT;
+
+    LONGLONG Old;
+    do {
+        Old = *pTotal;
+    } while (InterlockedCompareExchange64(pTotal, Old + val, Old) != Old);
+}
+
+void JitPerf::StartJit(JitPerfFrame *pFrame)
+{
+    LEAF_CONTRACT;
+
+    if (!s_fEnabled)
+        return;
+
+    pFrame->m_nonJitTicks = 0;
+    pFrame->m_nonJitDepth = 0;
+    pFrame->m_cbIL = 0;
+    pFrame->m_pPrev = (JitPerfFrame*) ClrFlsGetValue(TlsIdx_JitPerf);
+    ClrFlsSetValue(TlsIdx_JitPerf, pFrame);
+    pFrame->m_fLinked = TRUE;
+
+    pFrame->m_startTicks = GetTicks();
+}
+
+void JitPerf::StopJit(JitPerfFrame *pFrame)
+{
+    LEAF_CONTRACT;
+
+    if (!pFrame->m_fLinked)
+        return;
+
+    LONGLONG ticks = GetTicks() - pFrame->m_startTicks;
+
+    _ASSERTE(ClrFlsGetValue(TlsIdx_JitPerf) == pFrame);
+    _ASSERTE(pFrame->m_nonJitDepth == 0);
+    ClrFlsSetValue(TlsIdx_JitPerf, pFrame->m_pPrev);
+    pFrame->m_fLinked = FALSE;
+
+    // A nested compile runs inside an EE callback of the outer one and has
+    // already been charged to the outer method's EE time.
+    InterlockedIncrement(&s_cMethodsJitted);
+    AddTo(&s_cbILJitted, pFrame->m_cbIL);
+    AddTo(&s_jitTicks, ticks - pFrame->m_nonJitTicks);
+    AddTo(&s_nonJitTicks, pFrame->m_nonJitTicks);
+}
+
+JitPerfFrame::~JitPerfFrame()
+{
+    LEAF_CONTRACT;
+
+    if (m_fLinked)
+        ClrFlsSetValue(TlsIdx_JitPerf, m_pPrev);
+}
+
+void JitPerf::StartNonJit()
+{
+    LEAF_CONTRACT;
+
+    if (!s_fEnabled)
+        return;
+
+    // Not all JIT-EE callbacks are made on behalf of a compile (e.g. the verifier
+    // and the inliner use them too)
+    JitPerfFrame *pFrame = (JitPerfFrame*) ClrFlsGetValue(TlsIdx_JitPerf);
+    if (pFrame == NULL)
+        return;
+
+    if (pFrame->m_nonJitDepth++ == 0)
+        pFrame->m_nonJitStartTicks = GetTicks();
+}
 
+void JitPerf::StopNonJit()
+{
+    LEAF_CONTRACT;
 
+    if (!s_fEnabled)
+        return;
+
+    JitPerfFrame *pFrame = (JitPerfFrame*) ClrFlsGetValue(TlsIdx_JitPerf);
+    if (pFrame == NULL || pFrame->m_nonJitDepth == 0)
+        return;
+
+    if (--pFrame->m_nonJitDepth == 0)
+        pFrame->m_nonJitTicks += GetTicks() - pFrame->m_nonJitStartTicks;
+}
+
+void JitPerf::UpdateILCodeSize(DWORD cbIL)
+{
+    LEAF_CONTRACT;
+
+    if (!s_fEnabled)
+        return;
+
+    JitPerfFrame *pFrame = (JitPerfFrame*) ClrFlsGetValue(TlsIdx_JitPerf);
+    if (pFrame != NULL)
+        pFrame->m_cbIL += cbIL;
+}
+
+void JitPerf::UpdateNativeCodeSize(size_t cbNative)
+{
+    LEAF_CONTRACT;
+
+    if (!s_fEnabled)
+        return;
+
+    AddTo(&s_cbNativeJitted, (LONGLONG)cbNative);
+}
+
+void JitPerf::UpdatePhase(JitPerfPhase phase, LONGLONG startTicks)
+{
+    LEAF_CONTRACT;
+
+    _ASSERTE(phase < JIT_PERF_PHASE_COUNT);
+
+    if (!s_fEnabled)
+        return;
+
+    InterlockedIncrement(&s_cPhase[phase]);
+    AddTo(&s_phaseTicks[phase], GetTicks() - startTicks);
+}
+
+// Output the stats gathered by this module
+void JitPerf::Done()
+{
+    LEAF_CONTRACT;
+
+    if (!s_fEnabled)
+        return;
+
+    double frequency = (double)s_frequency;
+
+    if (s_cMethodsJitted != 0)
+    {
+        double jitTime = (double)s_jitTicks / frequency;
+        double nonJitTime = (double)s_nonJitTicks / frequency;
+
+        PERFLOG((L"Jit Methods", (UINT)s_cMethodsJitted, COUNT));
+        PERFLOG((L"Jit IL Size", (UINT64)s_cbILJitted, BYTES));
+        PERFLOG((L"Jit Native Size", (UINT64)s_cbNativeJitted, BYTES, L"code, GC and EH info"));
+        PERFLOG((L"Jit Time", jitTime, SECONDS, L"excluding EE callbacks"));
+        PERFLOG((L"Jit EE Callback Time", nonJitTime, SECONDS));
+        if (jitTime > 0)
+        {
+            PERFLOG((L"Jit Methods/sec", (double)s_cMethodsJitted / jitTime, COUNT));
+            PERFLOG((L"Jit IL Throughput", (double)s_cbILJitted / 1024 / jitTime, KBYTES_PER_SEC));
+        }
+    }
+
+    wchar_t wszName[PRINT_STR_LEN];
+    for (int phase = 0; phase < JIT_PERF_PHASE_COUNT; phase++)
+    {
+        if (s_cPhase[phase] == 0)
+            continue;
+
+        _snwprintf_s(wszName, PRINT_STR_LEN, PRINT_STR_LEN - 1, L"%s Methods", wszJitPerfPhaseName[phase]);
+        PERFLOG((wszName, (UINT)s_cPhase[phase], COUNT));
+        _snwprintf_s(wszName, PRINT_STR_LEN, PRINT_STR_LEN - 1, L"%s Time", wszJitPerfPhaseName[phase]);
+        PERFLOG((wszName, (double)s_phaseTicks[phase] / frequency, SECONDS));
+    }
+
+    s_fEnabled = FALSE;
+}
+
+//=============================================================================
+// ALL THE JIT PERF STATS GATHERING CODE IS COMPILED ONLY IF THE ENABLE_JIT_PERF WAS DEFINED.
+#endif // ENABLE_JIT_PERF
+//=============================================================================
@@ -477,6 +477,7 @@ BaseDomain::BaseDomain()
     m_pLowFrequencyHeap = NULL;
     m_pHighFrequencyHeap = NULL;
     m_pStubHeap = NULL;
+    m_pPrecodeHeap = NULL;
     m_pFuncPtrStubs=NULL;
 
     m_pFusionContext = NULL;
@@ -525,7 +526,8 @@ void BaseDomain::Init()
 
     DWORD dwTotalReserveMemSize = LOW_FREQUENCY_HEAP_RESERVE_SIZE
                                 + HIGH_FREQUENCY_HEAP_RESERVE_SIZE
-                                + STUB_HEAP_RESERVE_SIZE;
+                                + STUB_HEAP_RESERVE_SIZE
+                                + PRECODE_HEAP_RESERVE_SIZE;
 
     dwTotalReserveMemSize = (DWORD) ALIGN_UP(dwTotalReserveMemSize, VIRTUAL_ALLOC_RESERVE_GRANULARITY);
 
@@ -546,22 +548,18 @@ void BaseDomain::Init()
     if (m_pLowFrequencyHeap == NULL)
         COMPlusThrowOM();
 
+    // Only data lives here now that the entry points have their own heap, so
+    // it is neither executable nor one of the prestub manager's ranges
     m_pHighFrequencyHeap = new (&m_HighFreqHeapInstance) LoaderHeap(HIGH_FREQUENCY_HEAP_RESERVE_SIZE,
                                                                     HIGH_FREQUENCY_HEAP_COMMIT_SIZE,
                                                                     initReservedMem,
                                                                     HIGH_FREQUENCY_HEAP_RESERVE_SIZE,
-                                                                    LOADERHEAP_PROFILE_COUNTER,
-                                                                    MethodDescPrestubManager::g_pManager->GetRangeList(),
-                                                                    TRUE);
+                                                                    LOADERHEAP_PROFILE_COUNTER);
     initReservedMem += HIGH_FREQUENCY_HEAP_RESERVE_SIZE;
 
     if (m_pHighFrequencyHeap == NULL)
         COMPlusThrowOM();
 
-#if defined(_DEBUG) && defined(STUBLINKER_GENERATES_UNWIND_INFO)
-    m_pHighFrequencyHeap->m_fPermitStubsWithUnwindInfo = TRUE;
-#endif
-
     m_pStubHeap = new (&m_StubHeapInstance) LoaderHeap(STUB_HEAP_RESERVE_SIZE,
                                                        STUB_HEAP_COMMIT_SIZE,
                                                        initReservedMem,
@@ -579,6 +577,19 @@ void BaseDomain::Init()
     m_pStubHeap->m_fPermitStubsWithUnwindInfo = TRUE;
 #endif
 
+    m_pPrecodeHeap = new (&m_PrecodeHeapInstance) LoaderHeap(PRECODE_HEAP_RESERVE_SIZE,
+                                                             PRECODE_HEAP_COMMIT_SIZE,
+                                                             initReservedMem,
+                                                             PRECODE_HEAP_RESERVE_SIZE,
+                                                             LOADERHEAP_PROFILE_COUNTER,
+                                                             MethodDescPrestubManager::g_pManager->GetRangeList(),
+                                                             TRUE);
+
+    initReservedMem += PRECODE_HEAP_RESERVE_SIZE;
+
+    if (m_pPrecodeHeap == NULL)
+        COMPlusThrowOM();
+
     // Used by GetMultiCallableAddrOfCode
     m_pFuncPtrStubs = new FuncPtrStubs();
 
@@ -702,6 +713,12 @@ void BaseDomain::Terminate()
         m_pStubHeap = NULL;
     }
 
+    if (m_pPrecodeHeap != NULL)
+    {
+        delete(m_pPrecodeHeap);
+        m_pPrecodeHeap = NULL;
+    }
+
     if (m_pFuncPtrStubs != NULL)
     {
         delete m_pFuncPtrStubs;
@@ -9688,6 +9705,8 @@ size_t AppDomain::EstimateSize()
         retval+=m_pLowFrequencyHeap->GetSize();  
      if(m_pStubHeap) 
         retval+=m_pStubHeap->GetSize();   
+    if(m_pPrecodeHeap) 
+        retval+=m_pPrecodeHeap->GetSize();
     if(m_pVirtualCallStubManager)
         retval+=m_pVirtualCallStubManager->GetSize();
     //very rough estimate
@@ -9771,6 +9790,10 @@ BaseDomain::EnumMemoryRegions(CLRDataEnumMemoryFlags flags,
     {
         m_pStubHeap->EnumMemoryRegions(flags);
     }
+    if (m_pPrecodeHeap.IsValid())
+    {
+        m_pPrecodeHeap->EnumMemoryRegions(flags);
+    }
 }
 
 void
@@ -714,6 +714,9 @@ FORCEINLINE  void LargeHeapHandleBlockHolder__StaticFree(LargeHeapHandleBlockHol
 #define STUB_HEAP_RESERVE_SIZE                 (2 * PAGE_SIZE)
 #define STUB_HEAP_COMMIT_SIZE                  (1 * PAGE_SIZE)
 
+#define PRECODE_HEAP_RESERVE_SIZE              (2 * PAGE_SIZE)
+#define PRECODE_HEAP_COMMIT_SIZE               (1 * PAGE_SIZE)
+
 
 // --------------------------------------------------------------------------------
 // PE File List lock - for creating list locks on PE files
@@ -997,6 +1000,15 @@ public:
         return m_pStubHeap;
     }
 
+    // Precodes and compact entry points only, so that the entry points of
+    // a type end up packed together instead of being spread between the
+    // MethodTables and MethodDescs of the high frequency heap
+    LoaderHeap* GetPrecodeHeap()
+    {
+        LEAF_CONTRACT;
+        return m_pPrecodeHeap;
+    }
+
     FuncPtrStubs * GetFuncPtrStubs()
     {
         LEAF_CONTRACT;
@@ -1169,9 +1181,11 @@ protected:
     BYTE                m_LowFreqHeapInstance[sizeof(LoaderHeap)];
     BYTE                m_HighFreqHeapInstance[sizeof(LoaderHeap)];
     BYTE                m_StubHeapInstance[sizeof(LoaderHeap)];
+    BYTE                m_PrecodeHeapInstance[sizeof(LoaderHeap)];
     PTR_LoaderHeap      m_pLowFrequencyHeap;
     PTR_LoaderHeap      m_pHighFrequencyHeap;
     PTR_LoaderHeap      m_pStubHeap; // stubs for PInvoke, remoting, etc
+    PTR_LoaderHeap      m_pPrecodeHeap; // method entry points
     FuncPtrStubs *      m_pFuncPtrStubs; // for GetMultiCallableAddrOfCode()
 
 
@@ -171,6 +171,11 @@ void AppDomainNative::CreateDomainHelper (STRINGREF* ppFriendlyName, OBJECTREF*
     }
     CONTRACTL_END;
     
+    // Domain neutral code jitted so far may have the default domain's statics
+    // baked in (see CEEInfo::getFieldAttribs)
+    if (g_pConfig->SingleAppDomain())
+        COMPlusThrow(kNotSupportedException, L"NotSupported_SingleAppDomain");
+
     if (g_fADUnloadWorkerOK<0)
     {
         GCX_PREEMP();
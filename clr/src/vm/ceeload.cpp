@@ -57,6 +57,7 @@
 #include "ecall.h"
 #include "objectclone.h"
 #include "constrainedexecutionregion.h"
+#include "verificationcache.h"
 #include "typekey.h"
 #include "peimagelayout.inl"
 
@@ -218,6 +219,11 @@ Module::Module(Assembly *pAssembly, mdFile moduleRef, PEFile *file)
     m_pRVAOverrides             = NULL;
     m_pRVAOverridesCrst         = NULL;
 
+    m_pVerificationCache        = NULL;
+
+    m_pMethodDefJitAttribs      = NULL;
+    m_cMethodDefJitAttribs      = 0;
+
     m_pRemotingInterfaceThunks  = NULL;
     m_pRemotingInterfaceThunksCrst = NULL;
     if (!m_file->HasNativeImage())
@@ -559,6 +565,12 @@ void Module::Destruct()
     if (m_pRVAOverridesCrst)
         delete m_pRVAOverridesCrst;
 
+    if (m_pVerificationCache)
+        VerificationCache::Release(m_pVerificationCache);
+
+    if (m_pMethodDefJitAttribs)
+        delete [] m_pMethodDefJitAttribs;
+
     if (m_pRemotingInterfaceThunksCrst)
         delete m_pRemotingInterfaceThunksCrst;
 
@@ -5016,6 +5028,80 @@ void  Module::SetRVAOverrideForMethod(MethodDesc* pMD, DWORD dwOverride)
     m_pRVAOverrides->InsertValue(pMD, (HashDatum)(SIZE_T)dwOverride);
 }
 
+VerificationCache *Module::GetVerificationCache()
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_TRIGGERS;
+        MODE_ANY;
+    }
+    CONTRACTL_END
+
+    if (m_pVerificationCache == NULL)
+    {
+        // Reading the cache hashes the image, so do it at most once per module.
+        VerificationCache *pCache = VerificationCache::Create(this);
+        if (InterlockedCompareExchangePointer((void**)&m_pVerificationCache, pCache, NULL) != NULL)
+            delete pCache;
+    }
+
+    return m_pVerificationCache;
+}
+
+DWORD Module::LookupMethodDefJitAttribs(mdMethodDef tk)
+{
+    LEAF_CONTRACT;
+
+    _ASSERTE(TypeFromToken(tk) == mdtMethodDef);
+
+    DWORD *pAttribs = *(DWORD * volatile *)&m_pMethodDefJitAttribs;
+    DWORD rid = RidFromToken(tk);
+
+    // Methods added by EnC are past the end and are simply never cached
+    if (pAttribs == NULL || rid >= m_cMethodDefJitAttribs)
+        return 0;
+
+    return *(volatile DWORD *)&pAttribs[rid];
+}
+
+void Module::StoreMethodDefJitAttribs(mdMethodDef tk, DWORD dwAttribs)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+        INJECT_FAULT(return;);
+    }
+    CONTRACTL_END
+
+    _ASSERTE(TypeFromToken(tk) == mdtMethodDef);
+    _ASSERTE(dwAttribs != 0);
+
+    // Reflection emit keeps adding methods to the module
+    if (IsReflection())
+        return;
+
+    if (m_pMethodDefJitAttribs == NULL)
+    {
+        DWORD cAttribs = GetMDImport()->GetCountWithTokenKind(mdtMethodDef) + 1;
+        DWORD *pAttribs = new (nothrow) DWORD[cAttribs];
+        if (pAttribs == NULL)
+            return;
+        ZeroMemory(pAttribs, cAttribs * sizeof(DWORD));
+
+        // The count is only read after the pointer, and it is the same for every thread that gets here
+        m_cMethodDefJitAttribs = cAttribs;
+        if (InterlockedCompareExchangePointer((void**)&m_pMethodDefJitAttribs, pAttribs, NULL) != NULL)
+            delete [] pAttribs;
+    }
+
+    DWORD rid = RidFromToken(tk);
+    if (rid < m_cMethodDefJitAttribs)
+        *(volatile DWORD *)&m_pMethodDefJitAttribs[rid] = dwAttribs;
+}
+
 #endif // !DACCESS_COMPILE
 
 
@@ -67,6 +67,7 @@ class AppDomain;
 class DynamicMethodTable;
 struct CerPrepInfo;
 class ModuleSecurityDescriptor;
+class VerificationCache;
 
 // Used to help clean up interfaces
 struct HelpForInterfaceCleanup
@@ -1574,6 +1575,16 @@ public:
 
     BOOL GetRVAOverrideForMethod(MethodDesc* pMD, DWORD* pdwOverride);
     void SetRVAOverrideForMethod(MethodDesc* pMD, DWORD dwOverride);
+
+    // The verification results persisted for this module by previous runs, created on first use.
+    VerificationCache *GetVerificationCache();
+
+    // Jit attributes of the method definitions of this module that do not depend on the
+    // caller or the instantiation, cached by CEEInfo::getMethodAttribs. The values are opaque
+    // here except that 0 means not cached. Lookups take no lock; a store that loses a race
+    // writes the same value as the winner.
+    DWORD LookupMethodDefJitAttribs(mdMethodDef tk);
+    void StoreMethodDefJitAttribs(mdMethodDef tk, DWORD dwAttribs);
 #endif // !DACCESS_COMPILE
 
 private:
@@ -1583,6 +1594,11 @@ private:
     EEPtrHashTable       *m_pRVAOverrides;      // Overriden 
     Crst                 *m_pRVAOverridesCrst;  // Mutex protecting update access to both of the above hashes
 
+    VerificationCache    *m_pVerificationCache; // Released on destruct, kept by the VerificationCache list until flushed
+
+    DWORD                *m_pMethodDefJitAttribs;   // Indexed by MethodDef RID, allocated on the first store
+    DWORD                 m_cMethodDefJitAttribs;
+
 public:
     // Support for per-module remoting thunks used to dispatch interface calls on transparent proxies in some edge cases.
 
@@ -70,6 +70,7 @@
 #include "apithreadstress.h"
 #include "ipcfunccall.h"
 #include "perflog.h"
+#include "jitperf.h"
 #include "../dlls/mscorrc/resource.h"
 #include "comnlsinfo.h"
 #include "util.hpp"
@@ -85,6 +86,7 @@
 #include "typeparse.h"
 #include "debuginfostore.h"
 #include "mdaassistants.h"
+#include "verificationcache.h"
 #include "eemessagebox.h"
 
 
@@ -428,6 +430,10 @@ void EEStartupHelper(COINITIEE fFlags)
     PerfLog::PerfLogInitialize();
 #endif //ENABLE_PERF_LOG
 
+#ifdef ENABLE_JIT_PERF
+    JitPerf::Initialize();
+#endif //ENABLE_JIT_PERF
+
     STRESS_LOG0(LF_STARTUP, LL_ALWAYS, "===================EEStartup Starting===================");
 
 
@@ -1147,6 +1153,9 @@ void STDMETHODCALLTYPE EEShutDownHelper(BOOL fIsDllUnloading)
         // Save the security policy cache as necessary.
         Security::SaveCache();
 
+        // Save the methods verified during this run.
+        VerificationCache::FlushAll();
+
 
 
         // This is the end of Part 1.
@@ -1203,6 +1212,10 @@ part2:
             // Terminate the InterProcess Communications with COM+
             TerminateIPCManager();
 
+#ifdef ENABLE_JIT_PERF
+            JitPerf::Done();
+#endif //ENABLE_JIT_PERF
+
 #ifdef ENABLE_PERF_LOG
             PerfLog::PerfLogDone();
 #endif //ENABLE_PERF_LOG
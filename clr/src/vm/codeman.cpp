@@ -55,6 +55,13 @@ SVAL_IMPL(LONG, ExecutionManager, m_dwWriterLock);
 CrstStatic ExecutionManager::m_ExecutionManagerCrst;
 CrstStatic ExecutionManager::m_JumpStubCrst;
 CrstStatic ExecutionManager::m_RangeCrst;
+RangeSectionIndex * volatile ExecutionManager::m_pCodeRangeIndex = NULL;
+RangeSectionIndex * volatile ExecutionManager::m_pDataRangeIndex = NULL;
+RangeSectionIndex * volatile ExecutionManager::m_pRetiredRangeIndexes = NULL;
+RangeSectionIndex * ExecutionManager::m_pExpiringRangeIndexes = NULL;
+RangeReaderSlot ExecutionManager::m_RangeReaders[2][RANGE_READER_SLOTS];
+volatile LONG ExecutionManager::m_dwRangeEpoch = 0;
+volatile LONG ExecutionManager::m_dwRangeReclaimLock = 0;
 BYTE ExecutionManager::m_fFailedToLoad = 0x00;
 volatile LONG ExecutionManager::m_dwReaderCount = 0;
 volatile LONG ExecutionManager::m_dwWriterLock = 0;
@@ -93,13 +100,9 @@ AddRangeToJitHeapCache
 DeleteJitHeapCache
 
 
-HeapList::changeStart/changeEnd
+Lock-free reader of the nibble map (HeapList::pHdrMap)
 -----------------------------------------------
-allocCode
-allocEntryChunk
-allocJumpStubBlock
-RemoveJitData
-JitCodeToMethodInfo (read-only)
+JitCodeToMethodInfo
 
 */
 
@@ -168,19 +171,33 @@ void EEJitManager::ReleaseWriter(EEJitManager *pMgr)
 //-----------------------------------------------------------------------------
 
 ==============================================================================
-ExecutionManger::ReaderLockHolder and ExecutionManger::WriterLockHolder
-Protects the callers of ExecutionManager::GetRangeSection from heap deletions
-while walking RangeSections.  You need to take a reader lock before reading the
-values: m_CodeRangeList or m_DataRangeList and hold it while walking the lists
-The two xxxWrapper functions allows us to avoid taking a ReaderLock in some cases
-
-Uses ReaderLockHolder (allows multiple reeaders with no writers)
+ExecutionManager::RangeReaderHolder
+Protects the lookups in m_CodeRangeList and m_DataRangeList, and in their
+RangeSectionIndex snapshots, from the RangeSections and snapshots being freed.
+Readers only count themselves in a slot of the current epoch and never wait,
+so lookups scale and can be done from any context. The RangeSection found
+may only be used while the holder is held.
+
+Uses RangeReaderHolder
 -----------------------------------------
-ExecutionManager::FindJitManNonZeroWrapper
-ExecutionManager::GetMethodHeaderForAddressWrapper
+ExecutionManager::FindJitManNonZero
 ExecutionManager::GetRangeSectionForAddress
 ExecutionManager::FindZapModule
 ExecutionManager::FindZapModuleForNativeCode
+
+The writers are serialized by m_RangeCrst. A replaced snapshot is retired and
+freed by ReclaimRangeIndexes (at the end of every GC, and when ranges are added
+or deleted) once the epoch has moved on and the readers of the old epoch are
+gone. DeleteRangeHelper waits for the readers to leave before it frees the
+RangeSection.
+
+==============================================================================
+ExecutionManger::ReaderLockHolder and ExecutionManger::WriterLockHolder
+Still serialize AddRangeHelper and DeleteRangeHelper with the DAC enumeration
+of the range lists; the DAC checks m_dwWriterLock before walking them.
+
+Uses ReaderLockHolder (allows multiple reeaders with no writers)
+-----------------------------------------
 ExecutionManager::AddRangeHelper
 ExecutionManager::EnumMemoryRegions
 
@@ -560,8 +577,6 @@ HeapList* LoaderCodeHeap::CreateCodeHeap(CodeHeapRequestInfo *pInfo, LoaderHeap
     // We do not need to memset this memory, since ClrVirtualAlloc() guarantees that the memory is zero.
     // Furthermore, if we avoid writing to it, these pages don't come into our working set
 
-    pHp->changeStart     = NULL;
-    pHp->changeEnd       = NULL;
     pHp->bFull           = FALSE;
     pHp->cBlocks         = 0;
 
@@ -795,13 +810,8 @@ CodeHeader* EEJitManager::allocCode(MethodDesc* pMD, size_t blockSize, CorJitAll
 
     // Scope the lock
     {
-        // This crst has the CRST_DEBUGGER_THREAD flag, which prevents
-        // debuggers from halting this thread after if has incremented changeStart,
-        // but before it has incremented changeEnd; otherwise it would loop forever
-        // when it does a stack walk and tries to access the nibble map.
-        // Hijacking profilers have a similar problem, which is fixed by the forbid
-        // suspend thread holder below.  Profilers will refuse a stackwalk in
-        // a forbid suspend thread region.
+        // Serializes the writers of the nibble map. Readers never take it, see
+        // JitCodeToMethodInfo.
         CrstHolder ch(&m_CodeHeapCritSec);
 
         HeapList *pCodeHeap = NULL;
@@ -847,27 +857,12 @@ CodeHeader* EEJitManager::allocCode(MethodDesc* pMD, size_t blockSize, CorJitAll
 
         JIT_PERF_UPDATE_X86_CODE_SIZE(blockSize);
 
-        BEGIN_HOST_NOCALL_CODE;
-        {
-            // Prevents a thread suspension AND prevents a hijacking profiler from doing
-            // a stackwalk.
-            ForbidSuspendThreadHolder suspend;
+        _ASSERTE(pCode >= pCodeHeap->mapBase);
 
-            CantAllocHolder caHolder;
-        
-
-            pCodeHeap->changeStart++;   // mark that we are about to make changes
-
-            _ASSERTE(pCode >= pCodeHeap->mapBase);
-
-            size_t delta = pCode - pCodeHeap->mapBase;
-            NibbleMapSet(pCodeHeap->pHdrMap, delta);
+        size_t delta = pCode - pCodeHeap->mapBase;
+        NibbleMapSet(pCodeHeap->pHdrMap, delta);
 
-            pCodeHeap->cBlocks++;
-            pCodeHeap->changeEnd++;
-
-        }
-        END_HOST_NOCALL_CODE;
+        pCodeHeap->cBlocks++;
 
         pCodeHdr = (CodeHeader *)(mem);    
 
@@ -1203,13 +1198,8 @@ JumpStubBlockHeader *  EEJitManager::allocJumpStubBlock(MethodDesc* pMD, DWORD n
 
     // Scope the lock
     {
-        // This crst has the CRST_DEBUGGER_THREAD flag, which prevents
-        // debuggers from halting this thread after if has incremented changeStart,
-        // but before it has incremented changeEnd; otherwise it would loop forever
-        // when it does a stack walk and tries to access the nibble map.
-        // Hijacking profilers have a similar problem, which is fixed by the forbid
-        // suspend thread holder below.  Profilers will refuse a stackwalk in
-        // a forbid suspend thread region.
+        // Serializes the writers of the nibble map. Readers never take it, see
+        // JitCodeToMethodInfo.
         CrstHolder ch(&m_CodeHeapCritSec);
 
         mem       = (BYTE *) allocCodeRaw(&requestInfo, blockSize, CODE_SIZE_ALIGN, &pCodeHeap);
@@ -1227,25 +1217,11 @@ JumpStubBlockHeader *  EEJitManager::allocJumpStubBlock(MethodDesc* pMD, DWORD n
     
         JIT_PERF_UPDATE_X86_CODE_SIZE(blockSize);
     
-        {
-            // Prevents a thread suspension AND prevents a hijacking profiler from doing
-            // a stackwalk.
-            ForbidSuspendThreadHolder suspend;
-            BEGIN_HOST_NOCALL_CODE;
-            {
-            CantAllocHolder caHolder;
+        _ASSERTE((TADDR)pCodeHdr >= pCodeHeap->mapBase);
+        size_t delta = (TADDR)pCodeHdr + sizeof(CodeHeader) - pCodeHeap->mapBase;
+        NibbleMapSet(pCodeHeap->pHdrMap, delta);
 
-            pCodeHeap->changeStart++;   // mark that we are about to make changes
-        
-            _ASSERTE((TADDR)pCodeHdr >= pCodeHeap->mapBase);
-            size_t delta = (TADDR)pCodeHdr + sizeof(CodeHeader) - pCodeHeap->mapBase;
-            NibbleMapSet(pCodeHeap->pHdrMap, delta);
-    
-            pCodeHeap->cBlocks++;
-            pCodeHeap->changeEnd++;
-            }
-            END_HOST_NOCALL_CODE;
-        }
+        pCodeHeap->cBlocks++;
     }
 
     pBlock->m_next      = NULL;
@@ -1416,13 +1392,8 @@ void EEJitManager::RemoveJitData (METHODTOKEN token, size_t GCinfo_len, size_t E
     HeapList *pHp = GetVolatile_pCodeHeap();
 
     {
-        // This crst has the CRST_DEBUGGER_THREAD flag, which prevents
-        // debuggers from halting this thread after if has incremented changeStart,
-        // but before it has incremented changeEnd; otherwise it would loop forever
-        // when it does a stack walk and tries to access the nibble map.
-        // Hijacking profilers have a similar problem, which is fixed by the forbid
-        // suspend thread holder below.  Profilers will refuse a stackwalk in
-        // a forbid suspend thread region.
+        // Serializes the writers of the nibble map. Readers never take it, see
+        // JitCodeToMethodInfo.
         CrstHolder ch(&m_CodeHeapCritSec);
 
         while (pHp && ((pHp->startAddress > (TADDR)pCHdr) ||
@@ -1438,25 +1409,10 @@ void EEJitManager::RemoveJitData (METHODTOKEN token, size_t GCinfo_len, size_t E
         if (pHp ==  NULL)
             return;
 
-        // After we suspend a thread for GC or abort, we may call EEJitManager::JitCodeToMethodInfo which
-        // will loop until changeStart == changeEnd.  If a thread is supended in between, we hang.
-        // Also prevents a stackwalk by a hijacking profiler which would see a similar hang when it
-        // accesses the EEJitManager.
-        ForbidSuspendThreadHolder suspend;
-        BEGIN_HOST_NOCALL_CODE;
-        {
-        CantAllocHolder caHolder;
-        
-        pHp->changeStart++;
-
         size_t delta = (TADDR)pCHdr + sizeof(CodeHeader) - pHp->mapBase;
         NibbleMapSet(pHp->pHdrMap, delta, FALSE);
 
         pHp->cBlocks--;
-
-        pHp->changeEnd++;
-        }
-        END_HOST_NOCALL_CODE;
         // leave lock
     }
 
@@ -2071,7 +2027,6 @@ void EEJitManager::JitCodeToMethodInfo(
 
     HeapList *pHp = NULL;
     CodeHeader *pCHdr;
-    PBYTE tick;
 
 #ifdef _DEBUG_IMPL
     HeapList *pDebugHp = GetVolatile_pCodeHeap();
@@ -2151,81 +2106,43 @@ foundHeader:
         RETURN;
     }
 
-    // we now access the nibble-map and are prone to race conditions.
-    // Since we are strictly a "reader", we just use a simple counter
-    // scheme to detect if something changed while we were accessing
-    // the map. In that case we simply try it again.
-    while (1)
+    // The nibble map is read without synchronizing with the writers. Writers
+    // are serialized by m_CodeHeapCritSec and publish every change with a single
+    // DWORD store (see NibbleMapSet), so we see each nibble either before or
+    // after a change. Only the nibbles of methods that are being added or removed
+    // change, and currentPC can't be in such a method, so either value gives
+    // the same answer.
+    size_t codeOffset = FindMethodCode(pHp->pHdrMap, (TADDR)currentPC - pHp->mapBase);
+    if (codeOffset == UINT_MAX)
     {
-
-        tick = pHp->changeEnd;
-
-        size_t codeOffset = FindMethodCode(pHp->pHdrMap, (TADDR)currentPC - pHp->mapBase);
-        if (codeOffset == UINT_MAX)
+        if (pMethodToken)
         {
-            if (pMethodToken)
-            {
-                *pMethodToken = NULL;
-            }
-            if (ppMethodDesc)
-            {
-                *ppMethodDesc = NULL;
-            }
-            RETURN;
+            *pMethodToken = NULL;
         }
-        pCHdr = PTR_CodeHeader(pHp->mapBase + (codeOffset - sizeof(CodeHeader)));
-
-        // now check if something has changed while we were accessing
-        // the map
-        if (tick == pHp->changeStart)
+        if (ppMethodDesc)
         {
-            // no changes, we are done
-            _ASSERTE((TADDR)currentPC > PTR_HOST_TO_TADDR(pCHdr));
-            if (pMethodToken)
-            {
-                *pMethodToken = (METHODTOKEN) pCHdr;
-            }
+            *ppMethodDesc = NULL;
+        }
+        RETURN;
+    }
+    pCHdr = PTR_CodeHeader(pHp->mapBase + (codeOffset - sizeof(CodeHeader)));
 
-            if (pPCOffset)
-            {
-                *pPCOffset = (DWORD)(currentPC - pCHdr->GetCodeStartAddress());
-            }
+    _ASSERTE((TADDR)currentPC > PTR_HOST_TO_TADDR(pCHdr));
+    if (pMethodToken)
+    {
+        *pMethodToken = (METHODTOKEN) pCHdr;
+    }
 
-            if (ppMethodDesc)
-            {
-                *ppMethodDesc = pCHdr->GetMethodDesc();
-            }
-            RETURN;
-        }
-        else
-        {
-            // A writer modified heap while we were reading it.
-            // Give the writer a chance to finish what it's doing and
-            // then retry. This is potentially bad as we could keep on
-            // looping if writers keep on making changes, but since we
-            // typically will not have many writers it should be fine.
-            //
-            // <WARNING!!!>
-            // DO NOT replace this __SwitchToThread() with grabbing
-            // the m_CodeHeapCritSec to get in sync with the writers.
-            // On 64bit platforms we can frequently end up in JitCodeToMethodInfo
-            // under the Loader lock and have numerous potential
-            // deadlocks with that implementation.
-            // </WARNING!!!>
-#ifndef DACCESS_COMPILE
-            {
-            // When hosted, call SwitchToThread through the OS instead of the host
-                __DangerousSwitchToThread(0, TRUE);
-            }
-#else
-            // Nothing should be updating the nibble map under DAC!
-            UNREACHABLE();
-#endif
-        }
+    if (pPCOffset)
+    {
+        *pPCOffset = (DWORD)(currentPC - pCHdr->GetCodeStartAddress());
     }
 
-    _ASSERTE(!"Unreachable");
-    RETURN ;
+    if (ppMethodDesc)
+    {
+        *ppMethodDesc = pCHdr->GetMethodDesc();
+    }
+    RETURN;
 }
 
 #if !defined(DACCESS_COMPILE)
@@ -2291,7 +2208,9 @@ void EEJitManager::NibbleMapSet(DWORD * pMap, size_t delta, BOOL bSet /* = TRUE
     // (it's a reset or it is empty)
     _ASSERTE(!value || !((*(pMap+index))& ~mask));
 
-    *(pMap+index) = ((*(pMap+index))&mask)|value;
+    // JitCodeToMethodInfo reads the map without a lock, so the whole DWORD
+    // must be published with one store
+    *((volatile DWORD *)(pMap+index)) = ((*(pMap+index))&mask)|value;
 }
 
 #endif // !DACCESS_COMPILE
@@ -2463,8 +2382,6 @@ IJitManager* ExecutionManager::FindJitManNonZeroWrapper(SLOT currentPC)
 {
     WRAPPER_CONTRACT;
 
-    ReaderLockHolder rlh;    
-
     return FindJitManNonZero(currentPC, IJitManager::ScanNoReaderLock);
 }
 
@@ -2481,10 +2398,11 @@ ExecutionManager::FindJitManNonZero(SLOT currentPC,
         SO_TOLERANT;
     } CONTRACTL_END;
 
-    if (scanFlag != IJitManager::ScanNoReaderLock && IJitManager::GetScanFlags() != IJitManager::ScanNoReaderLock)
-        return FindJitManNonZeroWrapper(currentPC);
+    // Entering the reader never blocks, so there is no need to tell apart the
+    // callers that can't take locks (scanFlag)
+    RangeReaderHolder rrh;
 
-    RangeSection *pRS = GetRangeSection(m_CodeRangeList, (TADDR) currentPC);
+    RangeSection *pRS = FindCodeRangeSection((TADDR) currentPC);
 
     if (pRS == NULL)
     {
@@ -2793,6 +2711,8 @@ void ExecutionManager::AddJitManager(IJitManager * newjitmgr)
 #endif // #ifndef DACCESS_COMPILE
 
 
+// Linear search of a RangeSection list. Used when the sorted index of the list
+// is not available (under DAC, or if we ran out of memory building it).
 RangeSection* ExecutionManager::GetRangeSection(RangeSection *pHead, TADDR addr)
 {
     WRAPPER_CONTRACT;
@@ -2800,17 +2720,6 @@ RangeSection* ExecutionManager::GetRangeSection(RangeSection *pHead, TADDR addr)
 
     RangeSection *pCurr = pHead;
 
-#ifndef DACCESS_COMPILE
-    RangeSection *pLastUsedRS = (pCurr != NULL) ? pCurr->pLastUsed : NULL;
-
-    if ((pLastUsedRS != NULL)              &&
-        (addr >= pLastUsedRS->LowAddress)  &&
-        (addr <  pLastUsedRS->HighAddress)   )
-    {
-        return pLastUsedRS;
-    }
-#endif
-
     while (pCurr != NULL)
     {
         // See if addr is in [pCurr->LowAddress .. pCurr->HighAddress)
@@ -2825,16 +2734,6 @@ RangeSection* ExecutionManager::GetRangeSection(RangeSection *pHead, TADDR addr)
             _ASSERTE((pCurr->LowAddress <= addr) && (addr < pCurr->HighAddress));
         
             // Found the matching RangeSection
-            
-#ifndef DACCESS_COMPILE
-            // Cache pCurr as pLastUsed in the head node
-            // Unless we are on an MP system with many cpus
-            // where this sort of caching actually diminishes scaling during server GC
-            // due to many processors writing to a common location
-            if (g_SystemInfo.dwNumberOfProcessors < 4 || !GCHeap::IsServerHeap() || !GCHeap::IsGCInProgress())
-                pHead->pLastUsed = pCurr;
-#endif
-            
             return pCurr;
         }
         pCurr = pCurr->pnext;
@@ -2843,6 +2742,71 @@ RangeSection* ExecutionManager::GetRangeSection(RangeSection *pHead, TADDR addr)
     return NULL;
 }
 
+// The callers must hold a RangeReaderHolder
+RangeSection* ExecutionManager::FindCodeRangeSection(TADDR addr)
+{
+    WRAPPER_CONTRACT;
+    STATIC_CONTRACT_SO_TOLERANT;
+
+#ifndef DACCESS_COMPILE
+    RangeSectionIndex *pIndex = m_pCodeRangeIndex;
+    if (pIndex != NULL)
+        return LookupRangeIndex(pIndex, addr);
+#endif
+
+    return GetRangeSection(m_CodeRangeList, addr);
+}
+
+// The callers must hold a RangeReaderHolder
+RangeSection* ExecutionManager::FindDataRangeSection(TADDR addr)
+{
+    WRAPPER_CONTRACT;
+    STATIC_CONTRACT_SO_TOLERANT;
+
+#ifndef DACCESS_COMPILE
+    RangeSectionIndex *pIndex = m_pDataRangeIndex;
+    if (pIndex != NULL)
+        return LookupRangeIndex(pIndex, addr);
+#endif
+
+    return GetRangeSection(m_DataRangeList, addr);
+}
+
+#ifndef DACCESS_COMPILE
+
+RangeSection* ExecutionManager::LookupRangeIndex(RangeSectionIndex *pIndex, TADDR addr)
+{
+    CONTRACTL {
+        NOTHROW;
+        GC_NOTRIGGER;
+        SO_TOLERANT;
+        PRECONDITION(CheckPointer(pIndex));
+    } CONTRACTL_END;
+
+    // Find the last section that starts at or below addr
+    DWORD lo = 0;
+    DWORD hi = pIndex->count;
+    while (lo < hi)
+    {
+        DWORD mid = lo + (hi - lo) / 2;
+        if (pIndex->sections[mid]->LowAddress <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == 0)
+        return NULL;
+
+    RangeSection *pRS = pIndex->sections[lo - 1];
+    if (addr >= pRS->HighAddress)
+        return NULL;
+
+    return pRS;
+}
+
+#endif // #ifndef DACCESS_COMPILE
+
 RangeSection* ExecutionManager::GetRangeSectionAndPrev(RangeSection *pHead, TADDR addr, RangeSection** ppPrev)
 {
     WRAPPER_CONTRACT;
@@ -2888,9 +2852,9 @@ RangeSection* ExecutionManager::GetRangeSectionForAddress(TADDR startAddress)
 {
     WRAPPER_CONTRACT;
 
-    ReaderLockHolder rlh;
+    RangeReaderHolder rrh;
 
-    return GetRangeSection(m_CodeRangeList, startAddress);
+    return FindCodeRangeSection(startAddress);
 }
 
 /* static */
@@ -2899,9 +2863,9 @@ Module* ExecutionManager::FindZapModule(TADDR currentData)
     WRAPPER_CONTRACT;
     STATIC_CONTRACT_SO_TOLERANT;
 
-    ReaderLockHolder rlh;
+    RangeReaderHolder rrh;
 
-    RangeSection *pRS = GetRangeSection(m_DataRangeList, currentData);
+    RangeSection *pRS = FindDataRangeSection(currentData);
     
     return (pRS == NULL) ? (Module*) NULL : pRS->pModule;
 }
@@ -2911,9 +2875,9 @@ Module* ExecutionManager::FindZapModuleForNativeCode(TADDR currentCode)
 {
     WRAPPER_CONTRACT;
 
-    ReaderLockHolder rlh;
+    RangeReaderHolder rrh;
 
-    RangeSection *pRS = GetRangeSection(m_CodeRangeList, currentCode);
+    RangeSection *pRS = FindCodeRangeSection(currentCode);
 
     return (pRS == NULL) ? (Module*) NULL : pRS->pModule;
 }
@@ -3011,7 +2975,6 @@ RangeSection * ExecutionManager::AddRangeHelper(RangeSection** ppRangeList,
     pnewrange->flags       = flags;
     pnewrange->pcold       = pColdRangeSection;
     pnewrange->pModule     = pModule;
-    pnewrange->pLastUsed   = NULL;
 
     {
         CrstHolder ch(&m_RangeCrst); // Acquire the Crst before linking in a new RangeList
@@ -3057,8 +3020,12 @@ RangeSection * ExecutionManager::AddRangeHelper(RangeSection** ppRangeList,
         {
             *ppRangeList = pnewrange;
         }
+
+        PublishRangeIndex(ppRangeList);
     }
 
+    ReclaimRangeIndexes();
+
     RETURN(pnewrange);
 }
 
@@ -3086,37 +3053,230 @@ void ExecutionManager::DeleteRangeHelper(RangeSection** ppRangeList,
         GC_NOTRIGGER;
     } CONTRACTL_END;
 
-    WriterLockHolder wlh;        // Acquire the WriteLock and prevent any readers from walking the RangeList
-    CrstHolder ch(&m_RangeCrst); // Acquire the Crst before unlinking a RangeList
-    
     RangeSection *pCurr = NULL;
     RangeSection *pPrev = NULL;
 
-    pCurr = GetRangeSectionAndPrev(*ppRangeList, pStartRange, &pPrev);
-    
-    // pCurr points at the Range that needs to be unlinked from the RangeList
-    if (pCurr != NULL)
     {
+        WriterLockHolder wlh;        // Acquire the WriteLock and prevent any readers from walking the RangeList
+        CrstHolder ch(&m_RangeCrst); // Acquire the Crst before unlinking a RangeList
 
-        // If pPrev is NULL the the head of this list is to be deleted
-        if (pPrev == NULL)
-        {
-            *ppRangeList = pCurr->pnext;          
-        }
-        else
+        pCurr = GetRangeSectionAndPrev(*ppRangeList, pStartRange, &pPrev);
+
+        // pCurr points at the Range that needs to be unlinked from the RangeList
+        if (pCurr != NULL)
         {
-            _ASSERT(pPrev->pnext == pCurr);
-        
-            pPrev->pnext = pCurr->pnext;
+
+            // If pPrev is NULL the the head of this list is to be deleted
+            if (pPrev == NULL)
+            {
+                *ppRangeList = pCurr->pnext;
+            }
+            else
+            {
+                _ASSERT(pPrev->pnext == pCurr);
+
+                pPrev->pnext = pCurr->pnext;
+            }
+
+            PublishRangeIndex(ppRangeList);
         }
+    }
 
-        // Clear the cache pLastUsed in the head node (if any)
-        if (*ppRangeList)
+    if (pCurr != NULL)
+    {
+        // Lookups don't take the WriterLock into account, so wait for the ones
+        // that may have found pCurr in the list or in the old snapshot. Nobody
+        // else can reach pCurr any more, so the locks aren't needed for this.
+        WaitForRangeReaders();
+
+        delete pCurr;
+    }
+}
+
+RangeSectionIndex * volatile * ExecutionManager::GetRangeIndex(RangeSection** ppRangeList)
+{
+    LEAF_CONTRACT;
+
+    _ASSERTE(ppRangeList == &m_CodeRangeList || ppRangeList == &m_DataRangeList);
+
+    return (ppRangeList == &m_CodeRangeList) ? &m_pCodeRangeIndex : &m_pDataRangeIndex;
+}
+
+// Rebuilds the sorted snapshot of *ppRangeList after a change to the list. If
+// we can't allocate the snapshot, the readers fall back to walking the list.
+void ExecutionManager::PublishRangeIndex(RangeSection** ppRangeList)
+{
+    CONTRACTL {
+        NOTHROW;
+        GC_NOTRIGGER;
+        PRECONDITION(m_RangeCrst.OwnedByCurrentThread());
+    } CONTRACTL_END;
+
+    DWORD count = 0;
+    for (RangeSection *pCurr = *ppRangeList; pCurr != NULL; pCurr = pCurr->pnext)
+        count++;
+
+    size_t cbIndex = offsetof(RangeSectionIndex, sections) + count * sizeof(RangeSection *);
+    RangeSectionIndex *pNewIndex = (RangeSectionIndex *) new (nothrow) BYTE[cbIndex];
+
+    if (pNewIndex != NULL)
+    {
+        pNewIndex->pRetiredNext = NULL;
+        pNewIndex->count = count;
+
+        // The list is sorted top down, the index bottom up
+        DWORD i = count;
+        for (RangeSection *pCurr = *ppRangeList; pCurr != NULL; pCurr = pCurr->pnext)
+            pNewIndex->sections[--i] = pCurr;
+    }
+
+    RangeSectionIndex * volatile * ppIndex = GetRangeIndex(ppRangeList);
+    RangeSectionIndex *pOldIndex = *ppIndex;
+
+    // The snapshot is fully built before it is published
+    FastInterlockExchangePointer((PVOID volatile *)ppIndex, pNewIndex);
+
+    // ReclaimRangeIndexes takes the retired list without m_RangeCrst
+    if (pOldIndex != NULL)
+    {
+        RangeSectionIndex *pRetired;
+        do
         {
-            (*ppRangeList)->pLastUsed = NULL;
+            pRetired = m_pRetiredRangeIndexes;
+            pOldIndex->pRetiredNext = pRetired;
         }
+        while (FastInterlockCompareExchangePointer((PVOID *)&m_pRetiredRangeIndexes, pOldIndex, pRetired) != pRetired);
+    }
+}
 
-        delete pCurr;
+volatile LONG * ExecutionManager::EnterRangeReader()
+{
+    CONTRACTL {
+        NOTHROW;
+        GC_NOTRIGGER;
+        SO_TOLERANT;
+    } CONTRACTL_END;
+
+    // Thread ids are often multiples of a page or of the slot count, so mix
+    // them before taking the low bits (see SimpleRWLock::GetReaderCount)
+    DWORD id = GetCurrentThreadId();
+    id ^= id >> 16;
+    id *= 0x45d9f3b;
+    id ^= id >> 16;
+    DWORD slot = id & (RANGE_READER_SLOTS - 1);
+
+    // As under the ReaderLockHolder, nothing may allocate (the stress log in
+    // particular) while DeleteRangeHelper may be waiting for this thread
+    IncCantAllocCount();
+
+    while (TRUE)
+    {
+        LONG epoch = m_dwRangeEpoch;
+        volatile LONG *pCount = &m_RangeReaders[epoch & 1][slot].m_cReaders;
+        FastInterlockIncrement(pCount);
+
+        // The reclaimer only waits for the readers of the epoch before the
+        // current one, so a reader that is counted in an older epoch must
+        // not look at anything (see AdvanceRangeEpoch)
+        if (m_dwRangeEpoch == epoch)
+            return pCount;
+
+        FastInterlockDecrement(pCount);
+    }
+}
+
+void ExecutionManager::LeaveRangeReader(volatile LONG *pCount)
+{
+    LEAF_CONTRACT;
+
+    FastInterlockDecrement(pCount);
+    DecCantAllocCount();
+}
+
+BOOL ExecutionManager::RangeReadersPresent(LONG epoch)
+{
+    LEAF_CONTRACT;
+
+    for (DWORD i = 0; i < RANGE_READER_SLOTS; i++)
+    {
+        if (m_RangeReaders[epoch & 1][i].m_cReaders != 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+// Frees the snapshots retired before the last epoch change and moves the
+// epoch on, once the readers of the epoch before the current one are gone.
+// The readers of any older epoch left before the current epoch started, so
+// then only the readers of the current epoch remain, and they have seen all
+// the snapshots retired until now replaced. Called with m_dwRangeReclaimLock
+// held; returns FALSE if there are readers left and fWait is FALSE.
+BOOL ExecutionManager::AdvanceRangeEpoch(BOOL fWait)
+{
+    CONTRACTL {
+        NOTHROW;
+        GC_NOTRIGGER;
+        PRECONDITION(m_dwRangeReclaimLock != 0);
+    } CONTRACTL_END;
+
+    while (RangeReadersPresent(m_dwRangeEpoch - 1))
+    {
+        if (!fWait)
+            return FALSE;
+        __SwitchToThread(0);
+    }
+
+    while (m_pExpiringRangeIndexes != NULL)
+    {
+        RangeSectionIndex *pExpired = m_pExpiringRangeIndexes;
+        m_pExpiringRangeIndexes = pExpired->pRetiredNext;
+        delete [] (BYTE*)pExpired;
+    }
+
+    m_pExpiringRangeIndexes = (RangeSectionIndex *) FastInterlockExchangePointer((PVOID volatile *)&m_pRetiredRangeIndexes, NULL);
+
+    if (m_pExpiringRangeIndexes != NULL || fWait)
+        FastInterlockIncrement(&m_dwRangeEpoch);
+
+    return TRUE;
+}
+
+void ExecutionManager::ReclaimRangeIndexes()
+{
+    CONTRACTL {
+        NOTHROW;
+        GC_NOTRIGGER;
+    } CONTRACTL_END;
+
+    // Never waits: whatever can't be freed now is freed next time
+    if (FastInterlockCompareExchange(&m_dwRangeReclaimLock, 1, 0) != 0)
+        return;
+
+    AdvanceRangeEpoch(FALSE);
+
+    m_dwRangeReclaimLock = 0;
+}
+
+// Waits until all the readers that might have seen the range lists or their
+// snapshots before the call are gone. Those readers are in the current epoch
+// or the one before, so two epoch changes are enough. Not called with
+// m_RangeCrst held, so that the other writers aren't held up meanwhile.
+void ExecutionManager::WaitForRangeReaders()
+{
+    CONTRACTL {
+        NOTHROW;
+        GC_NOTRIGGER;
+        PRECONDITION(!m_RangeCrst.OwnedByCurrentThread());
+    } CONTRACTL_END;
+
+    for (int i = 0; i < 2; i++)
+    {
+        while (FastInterlockCompareExchange(&m_dwRangeReclaimLock, 1, 0) != 0)
+            __SwitchToThread(0);
+
+        AdvanceRangeEpoch(TRUE);
+
+        m_dwRangeReclaimLock = 0;
     }
 }
 
@@ -437,13 +437,6 @@ typedef struct _HeapList
     TADDR               startAddress;
     TADDR               endAddress;     // the current end of the used portion of the Heap
 
-    // Counters which are incremented by writers.
-    // Readers can check that changeEnd before the read is the same as
-    // changeStart after the read to ensure that no writer was stomping
-    // on the heap while they were reading it
-    volatile PBYTE      changeStart;
-    volatile PBYTE      changeEnd;
-
     TADDR               mapBase;        // "startAddress" rounded down to PAGE_SIZE. pHdrMap is relative to this address
     PTR_DWORD           pHdrMap;        // bit array used to find the start of methods
 
@@ -572,7 +565,6 @@ typedef struct _rangesection
     TADDR               ptable;
 
     PTR_RangeSection    pnext;          // link rangesections in a sorted list
-    PTR_RangeSection    pLastUsed;      // for the head node only:  a link to rangesections that was used most recently
 
     DWORD               flags;
     PTR_RangeSection    pcold;          // pointer to cold range section (only present in hot range sections)
@@ -582,6 +574,29 @@ typedef struct _rangesection
 
 #define RANGE_SECTION_COLD  0x01
 
+#define RANGE_READER_SLOTS  16
+
+struct RangeReaderSlot
+{
+    volatile LONG       m_cReaders;
+    BYTE                m_Padding[64 - sizeof(LONG)];
+};
+
+//-----------------------------------------------------------------------------
+// An immutable snapshot of a RangeSection list, sorted by ascending LowAddress,
+// that lets GetRangeSection binary search for an address. Writers build a new
+// snapshot under m_RangeCrst and publish it with a single pointer store, so
+// readers never wait for the writers. A replaced snapshot can still be in use
+// by a reader, it is freed once all the readers that might have seen it are
+// gone (see ExecutionManager::ReclaimRangeIndexes).
+
+typedef struct _rangesectionindex
+{
+    struct _rangesectionindex * pRetiredNext;   // link of the replaced snapshots waiting to be freed
+    DWORD                       count;
+    RangeSection *              sections[1];    // actually "count" entries
+} RangeSectionIndex;
+
 /*****************************************************************************/
 
 #define FAILED_JIT      0x01
@@ -743,6 +758,13 @@ public:
         return (m_jit != NULL);
     }
 
+    HINSTANCE GetJitModule()
+    {
+        LEAF_CONTRACT;
+
+        return m_JITCompiler;
+    }
+
     VOID ClearCache()
     {
         if( m_jit != NULL )
@@ -1140,6 +1162,8 @@ public :
 
 
     static RangeSection*             GetRangeSection(RangeSection *pRS, TADDR addr);
+    static RangeSection*             FindCodeRangeSection(TADDR addr);
+    static RangeSection*             FindDataRangeSection(TADDR addr);
     static RangeSection*             GetRangeSectionAndPrev(RangeSection *pRS, TADDR addr, RangeSection **ppPrev);
 
     static RangeSection*             GetRangeSectionForAddress(TADDR startAddress);
@@ -1176,6 +1200,19 @@ private :
     static CrstStatic       m_ExecutionManagerCrst;
     static CrstStatic       m_JumpStubCrst;
     static CrstStatic       m_RangeCrst;        // Aquire before writing into m_CodeRangeList and m_DataRangeList
+#ifndef DACCESS_COMPILE
+    static RangeSectionIndex * volatile m_pCodeRangeIndex;  // snapshots of m_CodeRangeList and m_DataRangeList
+    static RangeSectionIndex * volatile m_pDataRangeIndex;
+    static RangeSectionIndex * volatile m_pRetiredRangeIndexes; // replaced since the last epoch change
+    static RangeSectionIndex *          m_pExpiringRangeIndexes;// replaced before the last epoch change
+
+    // Readers of the range lists and indexes count themselves in one of the
+    // slots of the current epoch; there are several slots per epoch so that
+    // lookups on different threads don't write to the same cache line
+    static RangeReaderSlot  m_RangeReaders[2][RANGE_READER_SLOTS];
+    static volatile LONG    m_dwRangeEpoch;
+    static volatile LONG    m_dwRangeReclaimLock;
+#endif
     static BYTE             m_fFailedToLoad;
 
     // infrastructure to manage readers so we can lock them out and delete domain data
@@ -1213,6 +1250,53 @@ private :
                                          Module* pModule=NULL);
     static void DeleteRangeHelper(RangeSection** ppRangeList,
                                   TADDR StartRange);
+#ifndef DACCESS_COMPILE
+    static RangeSectionIndex * volatile * GetRangeIndex(RangeSection** ppRangeList);
+    static void PublishRangeIndex(RangeSection** ppRangeList);
+    static RangeSection* LookupRangeIndex(RangeSectionIndex *pIndex, TADDR addr);
+
+    static volatile LONG * EnterRangeReader();
+    static void LeaveRangeReader(volatile LONG *pCount);
+    static BOOL RangeReadersPresent(LONG epoch);
+    static BOOL AdvanceRangeEpoch(BOOL fWait);
+    static void WaitForRangeReaders();
+#endif
+
+    // Must be held while looking up or walking the RangeSection lists and
+    // while using the RangeSection found. Never blocks.
+    class RangeReaderHolder
+    {
+    public:
+        RangeReaderHolder()
+        {
+            WRAPPER_CONTRACT;
+#ifndef DACCESS_COMPILE
+            m_pCount = EnterRangeReader();
+#endif
+        }
+
+        ~RangeReaderHolder()
+        {
+            WRAPPER_CONTRACT;
+#ifndef DACCESS_COMPILE
+            LeaveRangeReader(m_pCount);
+#endif
+        }
+
+    private:
+#ifndef DACCESS_COMPILE
+        volatile LONG *m_pCount;
+#endif
+    };
+
+#ifndef DACCESS_COMPILE
+public:
+    // Frees the replaced RangeSectionIndex snapshots nobody can be using any
+    // more. Called at the end of every GC; AddRangeHelper and DeleteRangeHelper
+    // also try.
+    static void ReclaimRangeIndexes();
+private:
+#endif
 
 #ifndef DACCESS_COMPILE
     static BYTE * getNextJumpStub(MethodDesc* pMD,
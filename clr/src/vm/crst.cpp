@@ -924,6 +924,7 @@ UINT CrstStubInterceptorRanking         = 1000;        // stub tracker (debug)
 UINT CrstStubTrackerRanking             = 1000;        // stub tracker (debug)
 UINT CrstSyncBlockCacheRanking          = 1300;        // allocate a SyncBlock to an object -- taken inside CrstHandleTable
 UINT CrstHandleTableRanking             = 1500;        // allocate / release a handle (called inside CrstSingleUseLock)
+UINT CrstHandleMagazinesRanking         = 1600;        // claim / return a per-thread handle cache -- takes CrstHandleTable
 UINT CrstCompressedStackRefRanking      = 1500;        // Reference counting lock for the compressed stack
 UINT CrstExecuteManRangeLockRanking     = 1900;
 UINT CrstSyncHashLockRanking            = 2000;        // used for synchronized access to a hash table
@@ -940,6 +941,7 @@ UINT CrstADCompressedStackRegistryRanking = 2000;     // lock for protecting acc
 UINT CrstCompressedStackTransitionRanking = 2000;      // State transition lock for the compressed stack
 UINT CrstSecurityPolicyCacheRanking     = 2000;        // For Security policy cache
 UINT CrstRVAOverridesRanking            = 2000;        // Overrides of method RVAs
+UINT CrstVerificationCacheRanking       = 2000;        // Methods verified during this run
 UINT CrstRCWCacheRanking                = 2200;        // For RCWCache
 UINT CrstSigConvertRanking              = 2500;        // convert a gsig_ from text to binary
 UINT CrstCompressedStackListCleanupRanking = 2500;     // List cleanup lock for the compressed stack
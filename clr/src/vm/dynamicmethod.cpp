@@ -791,8 +791,6 @@ HeapList* HostCodeHeap::CreateCodeHeap(CodeHeapRequestInfo *pInfo, EEJitManager
     // We do not need to memset this memory, since ClrVirtualAlloc() guarantees that the memory is zero.
     // Furthermore, if we avoid writing to it, these pages don't come into our working set
 
-    pHp->changeStart     = NULL;
-    pHp->changeEnd       = NULL;
     pHp->cBlocks         = 0;
 #ifndef DACCESS_COMPILE 
 #endif // !DACCESS_COMPILE
@@ -1286,29 +1284,12 @@ void HostCodeHeap::ReleaseReferenceToHeap(MethodDesc* pMD)
     // clean up the NibbleMap
     //
 
-    // Scope the CantStopHolder
-    {
-        // Prevents a thread suspension AND prevents a hijacking profiler from doing
-        // a stackwalk.
-        ForbidSuspendThreadHolder suspend;
-
-        // Currently all callers to this method ensure EEJitManager::m_CodeHeapCritSec
-        // is held.  This crst has the CRST_DEBUGGER_THREAD flag, which prevents
-        // debuggers from halting this thread after if has incremented changeStart, but
-        // before it has incremented changeEnd; otherwise it would loop forever when it
-        // does a stack walk and tries to access the nibble map.
-        //
-        // However, it is not easy in this function to verify or enforce that the crst
-        // was indeed taken before this has been called.  So we're forcing the
-        // cantstop counter to increment with this holder, which will also prevent
-        // the debugger from causing infinite loops.
-        CantStopHolder hCantStop;
-
-        m_pHeapList->changeStart++;
+    // Currently all callers to this method ensure EEJitManager::m_CodeHeapCritSec
+    // is held, which serializes the writers of the nibble map.
+    {
         size_t delta = (size_t)((BYTE*)(pPrivateData->m_recordCodePointer) - m_pHeapList->mapBase);
         m_pJitManager->NibbleMapSet(m_pHeapList->pHdrMap, delta, FALSE);
         m_pHeapList->cBlocks--;
-        m_pHeapList->changeEnd++;
     }
 
     CodeHeader* pCodeHdr = ((CodeHeader*)(pPrivateData->m_recordCodePointer)) - 1;
@@ -405,6 +405,9 @@ HRESULT EEConfig::Init()
 
     pZapSet = DEFAULT_ZAP_SET;
 
+    pVerificationCacheDir = NULL;
+    pVerificationCacheKeyFile = NULL;
+
     dwSharePolicy = AppDomain::SHARE_POLICY_UNSPECIFIED;
 
     dwMonitorZapStartup = 0;
@@ -427,6 +430,7 @@ HRESULT EEConfig::Init()
 
     fAppDomainUnload = true;
     dwADURetryCount=1000;
+    fSingleAppDomain = false;
 
 #ifdef _DEBUG
     fAppDomainLeaks = DEFAULT_APP_DOMAIN_LEAKS;
@@ -514,6 +518,8 @@ HRESULT EEConfig::Cleanup()
 
     if (m_fFreepZapSet)
         delete[] pZapSet;
+    delete[] pVerificationCacheDir;
+    delete[] pVerificationCacheKeyFile;
     delete[] szZapBBInstr;
     
     if (pRequireZapsList)
@@ -863,6 +869,9 @@ HRESULT EEConfig::sync()
             
     IfFailRet(GetConfigString(L"ZapSet", (LPWSTR*)&pZapSet));
 
+    IfFailRet(GetConfigString(L"VerificationCacheDir", &pVerificationCacheDir));
+    IfFailRet(GetConfigString(L"VerificationCacheKeyFile", &pVerificationCacheKeyFile));
+
     fLazyActivation = (GetConfigDWORD(L"LazyActivation", fLazyActivation) != 0);
     fSecurityNeutralCode = (GetConfigDWORD(L"SecurityNeutralCode", fSecurityNeutralCode) != 0);
 
@@ -1072,6 +1081,7 @@ HRESULT EEConfig::sync()
         _ASSERTE(!"Reserved value");
         dwADURetryCount=(DWORD)-2;
     }
+    fSingleAppDomain = (GetConfigDWORD(L"SingleAppDomain", fSingleAppDomain) != 0);
 #ifdef _DEBUG
     fAppDomainLeaks = GetConfigDWORD(L"AppDomainAgilityChecked", DEFAULT_APP_DOMAIN_LEAKS) == 1;
 #endif
@@ -496,6 +496,11 @@ public:
 
     inline DWORD AppDomainUnloadRetryCount() const
     {LEAF_CONTRACT;  return dwADURetryCount; }
+
+    // No AppDomain other than the default one may be created, so domain neutral
+    // code may hardcode the addresses of the default domain's statics
+    inline bool SingleAppDomain() const
+    {LEAF_CONTRACT;  return fSingleAppDomain; }
 	
 
 #ifdef _DEBUG
@@ -663,6 +668,11 @@ public:
     
     LPCWSTR ZapSet()                        const { LEAF_CONTRACT; return pZapSet; }
 
+    // Directory holding the persisted verification results (see verificationcache.h), NULL if disabled
+    LPCWSTR VerificationCacheDir()          const { LEAF_CONTRACT; return pVerificationCacheDir; }
+    // Key that authenticates the verification cache files, NULL for the default one
+    LPCWSTR VerificationCacheKeyFile()      const { LEAF_CONTRACT; return pVerificationCacheKeyFile; }
+
     // Temporary codegen feature flags
     bool    SecurityNeutralCode()           const { LEAF_CONTRACT; return fSecurityNeutralCode; }
     bool    LazyActivation()                const { LEAF_CONTRACT; return fLazyActivation; }
@@ -855,6 +865,7 @@ private:
     bool   m_fDeveloperInstallation;      // We are on a developers machine
     bool   fAppDomainUnload;            // Enable appdomain unloading
     DWORD  dwADURetryCount;
+    bool   fSingleAppDomain;            // Only the default domain may exist
 #ifdef _DEBUG
     bool fJitVerificationDisable;       // Turn off jit verification (for testing purposes only)
 
@@ -947,6 +958,9 @@ private:
 
     LPCWSTR pZapSet;
 
+    LPWSTR  pVerificationCacheDir;
+    LPWSTR  pVerificationCacheKeyFile;
+
     // Temporary codegen features
     bool fSecurityNeutralCode; // security neutral codegen
     bool fLazyActivation; // Lazy module activation
@@ -451,6 +451,11 @@ retry_for_debugger:
         // suspend for GC, set in progress after suspending
         // threads which have no must complete
         WaitForGCEvent->Reset();
+
+        LARGE_INTEGER startSuspend;
+        startSuspend.QuadPart = 0;
+        QueryPerformanceCounter(&startSuspend);
+
         // SetGCInProgress();
         {
             GcThread = pCurThread;
@@ -473,6 +478,9 @@ retry_for_debugger:
             if (hr == ERROR_TIMEOUT)
                 g_SuspendStatistics.cntCollideRetry++;
 #endif
+
+            if (hr == S_OK)
+                ThreadStore::s_pThreadStore->RecordSuspendTime(startSuspend);
         }
 
         // If the debugging services are attached, then its possible
@@ -199,6 +199,9 @@ void HndDestroyHandleTable(HHANDLETABLE hTable)
     // decrement handle count by number of handles in this table
     COUNTER_ONLY(GetPrivatePerfCounters().m_GC.cHandles -= pTable->dwCount);
 
+    // make sure no thread hands out or caches handles from this table any more
+    TableDiscardMagazines(pTable);
+
     // We are going to free the memory for this HandleTable.
     // Let us reset the copy in g_pHandleTableArray to NULL.
     // Otherwise, GC will think this HandleTable is still available.
@@ -729,6 +732,10 @@ void HndWriteBarrier(OBJECTHANDLE handle, OBJECTREF objref)
     if (barrier[offset] > (BYTE)generation)
     {
         barrier[offset] = (BYTE)0;
+
+        // the segment's minimum age for the block's type has to follow
+        TableSegment *pSegment = (TableSegment *)barrier;
+        pSegment->rgMinAge[pSegment->rgBlockType[offset / HANDLE_CLUMPS_PER_BLOCK]] = 0;
     }
 }
 
@@ -773,6 +780,8 @@ void HndEnumHandles(HHANDLETABLE hTable, const UINT *puType, UINT uTypeCount,
     info.uFlags          = (fAsync? HNDGCF_ASYNC : HNDGCF_NORMAL);
     info.fEnumUserData   = fEnumUserData;
     info.dwAgeMask       = 0;
+    info.uAgeLimit       = 0;
+    info.uAgeUpdate      = AGEUPDATE_NONE;
     info.pCurrentSegment = NULL;
     info.pfnScan         = CallHandleEnumProc;
     info.param1          = (LPARAM)pfnEnum;
@@ -880,12 +889,23 @@ void HndScanHandlesForGC(HHANDLETABLE hTable, HANDLESCANPROC scanProc, LPARAM pa
     info.uFlags          = flags;
     info.fEnumUserData   = enumUserData;
     info.dwAgeMask       = BuildAgeMask(condemned, maxgen);
+    info.uAgeLimit       = 0;
+    info.uAgeUpdate      = AGEUPDATE_NONE;
     info.pCurrentSegment = NULL;
     info.pfnScan         = scanProc;
     info.param1          = param1;
     info.param2          = param2;
 
+    // ephemeral scans only look at young clumps, so they can skip old segments
+    if (condemned < maxgen)
+    {
+        info.uAgeLimit   = BuildAgeLimit(condemned, maxgen);
+        if (flags & HNDGCF_AGE)
+            info.uAgeUpdate = AGEUPDATE_AGE;
+    }
+
 #ifdef _DEBUG
+    info.DEBUG_SegmentsSkipped              = 0;
     info.DEBUG_BlocksScanned                = 0;
     info.DEBUG_BlocksScannedNonTrivially    = 0;
     info.DEBUG_HandleSlotsScanned           = 0;
@@ -940,6 +960,8 @@ void HndResetAgeMap(HHANDLETABLE hTable, const UINT *types, UINT typeCount, UINT
     info.uFlags          = flags;
     info.fEnumUserData   = FALSE;
     info.dwAgeMask       = BuildAgeMask(condemned, maxgen);
+    info.uAgeLimit       = BuildAgeLimit(condemned, maxgen);
+    info.uAgeUpdate      = AGEUPDATE_RESET;
     info.pCurrentSegment = NULL;
     info.pfnScan         = NULL;
     info.param1          = 0;
@@ -980,6 +1002,8 @@ void HndVerifyTable(HHANDLETABLE hTable, const UINT *types, UINT typeCount, UINT
     info.uFlags          = flags;
     info.fEnumUserData   = FALSE;
     info.dwAgeMask       = BuildAgeMask(condemned, maxgen);
+    info.uAgeLimit       = 0;
+    info.uAgeUpdate      = AGEUPDATE_NONE;
     info.pCurrentSegment = NULL;
     info.pfnScan         = NULL;
     info.param1          = 0;
@@ -1106,6 +1130,7 @@ void DEBUG_PostGCScanHandler(HandleTable *pTable, const UINT *types, UINT typeCo
         pTable->_DEBUG_iMaxGen = (int)condemned;
 
     // update the statistics
+    pTable->_DEBUG_TotalSegmentsSkipped              [condemned] += info->DEBUG_SegmentsSkipped;
     pTable->_DEBUG_TotalBlocksScanned                [condemned] += info->DEBUG_BlocksScanned;
     pTable->_DEBUG_TotalBlocksScannedNonTrivially    [condemned] += info->DEBUG_BlocksScannedNonTrivially;
     pTable->_DEBUG_TotalHandleSlotsScanned           [condemned] += info->DEBUG_HandleSlotsScanned;
@@ -1125,6 +1150,9 @@ void DEBUG_PostGCScanHandler(HandleTable *pTable, const UINT *types, UINT typeCo
             LOG((LF_GC, LL_INFO1000, ",%u", types[u]));
         LOG((LF_GC, LL_INFO1000,  "\n"));
 
+        // dump the number of segments we could pass over entirely
+        LOG((LF_GC, LL_INFO1000, "    Segments Skipped      = %u\n", info->DEBUG_SegmentsSkipped));
+
         // dump the number of blocks and slots we scanned
         ULONG32 blockHandles = info->DEBUG_BlocksScanned * HANDLE_HANDLES_PER_BLOCK;
         LOG((LF_GC, LL_INFO1000, "    Blocks Scanned        = %u (%u slots)\n", info->DEBUG_BlocksScanned, blockHandles));
@@ -1167,6 +1195,7 @@ void DEBUG_LogScanningStatistics(HandleTable *pTable, DWORD level)
             // dump the generation number and the number of blocks scanned
             LOG((LF_GC, level,     "--------------------------------------------------------------\n"));
             LOG((LF_GC, level,     "    Condemned Generation      = %d\n", i));
+            LOG((LF_GC, level,     "    Segments Skipped          = %I64u\n", pTable->_DEBUG_TotalSegmentsSkipped[i]));
             LOG((LF_GC, level,     "    Blocks Scanned            = %I64u\n", totalBlocksScanned));
 
             // if we scanned any blocks in this generation then dump some interesting numbers
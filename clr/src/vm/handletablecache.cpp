@@ -633,6 +633,9 @@ OBJECTHANDLE TableCacheMissOnAlloc(HandleTable *pTable, HandleTypeCache *pCache,
     // acquire the handle manager lock
     CrstHolder ch(&pTable->Lock);
 
+    // remember that we had to
+    pTable->dwAllocMisses++;
+
     // try again to take a handle (somebody else may have rebalanced)
     LONG lReserveIndex = FastInterlockDecrement(&pCache->lReserveIndex);
 
@@ -683,6 +686,9 @@ void TableCacheMissOnFree(HandleTable *pTable, HandleTypeCache *pCache, UINT uTy
     // acquire the handle manager lock
     CrstHolder ch(&pTable->Lock);
 
+    // remember that we had to
+    pTable->dwFreeMisses++;
+
     // try again to take a slot (somebody else may have rebalanced)
     LONG lFreeIndex = FastInterlockDecrement(&pCache->lFreeIndex);
 
@@ -703,6 +709,358 @@ void TableCacheMissOnFree(HandleTable *pTable, HandleTypeCache *pCache, UINT uTy
 }
 
 
+/*
+ * Per-thread handle magazines
+ *
+ * Threads that allocate handles keep a few small magazines of them, each for
+ * one table and type.  A magazine is refilled from the main cache and spills
+ * back to it a batch at a time, so threads that allocate and free handles
+ * in a loop touch the shared cache once per batch instead of once per handle.
+ *
+ * Only the owning thread takes handles from or puts handles into its
+ * magazines.  The magazine lock is taken to point a magazine at a different
+ * table or type, to give back the handles of a thread that exits and to
+ * drop the handles of a table that is being destroyed.
+ */
+CrstStatic          g_HandleMagazineLock;
+HandleMagazineSet  *g_pHandleMagazineSets = NULL;
+BOOL                g_fUseHandleMagazines = FALSE;
+
+
+/*
+ * MagazineRefill
+ *
+ * Moves up to a batch of handles from the main cache into an empty
+ * magazine, taking all of their reserve slots with one interlocked
+ * operation.  Returns the number of handles obtained, which is zero if
+ * the reserve bank was empty.
+ *
+ */
+UINT MagazineRefill(HandleMagazine *pMagazine)
+{
+    WRAPPER_CONTRACT;
+
+    /*
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    */
+
+    // sanity
+    _ASSERTE(pMagazine->uCount == 0);
+
+    HandleTable *pTable = pMagazine->pTable;
+    HandleTypeCache *pCache = pTable->rgMainCache + pMagazine->uType;
+
+    // take a batch of handles from the reserve bank
+    LONG lReserveIndex = FastInterlockExchangeAdd(&pCache->lReserveIndex, -HANDLE_MAGAZINE_BATCH);
+
+    // was the bank already empty?
+    if (lReserveIndex <= 0)
+        return 0;
+
+    // we own the slots from the new index up to the old one - the new index
+    // may have underflowed, which the next miss will clean up as usual
+    LONG lMinReserveIndex = lReserveIndex - HANDLE_MAGAZINE_BATCH;
+    if (lMinReserveIndex < 0)
+        lMinReserveIndex = 0;
+
+    UINT uCount = (UINT)(lReserveIndex - lMinReserveIndex);
+
+    // copy the handles into the magazine and zero their slots
+    ReadAndZeroCacheHandles(pMagazine->rgHandles, pCache->rgReserveBank + lMinReserveIndex, uCount);
+    pMagazine->uCount = uCount;
+
+    pTable->dwMagazineRefills++;
+
+    return uCount;
+}
+
+
+/*
+ * MagazineSpill
+ *
+ * Moves the top uCount handles of a magazine to the main cache, taking a
+ * batch of free slots at a time with one interlocked operation.  Handles
+ * that do not fit in the free bank go through TableCacheMissOnFree.
+ *
+ */
+void MagazineSpill(HandleMagazine *pMagazine, UINT uCount)
+{
+    WRAPPER_CONTRACT;
+
+    /*
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    */
+
+    // sanity
+    _ASSERTE(uCount <= pMagazine->uCount);
+
+    HandleTable *pTable = pMagazine->pTable;
+    UINT uType = pMagazine->uType;
+    HandleTypeCache *pCache = pTable->rgMainCache + uType;
+
+    // the handles we give back are the ones on top
+    pMagazine->uCount -= uCount;
+    OBJECTHANDLE *pHandleBase = pMagazine->rgHandles + pMagazine->uCount;
+
+    while (uCount)
+    {
+        UINT uBatch = (uCount < HANDLE_MAGAZINE_BATCH) ? uCount : HANDLE_MAGAZINE_BATCH;
+
+        // take a batch of free slots
+        LONG lFreeIndex = FastInterlockExchangeAdd(&pCache->lFreeIndex, -(LONG)uBatch);
+
+        // store as many handles as we got slots for
+        UINT uStored = 0;
+        if (lFreeIndex > 0)
+        {
+            LONG lMinFreeIndex = lFreeIndex - (LONG)uBatch;
+            if (lMinFreeIndex < 0)
+                lMinFreeIndex = 0;
+
+            uStored = (UINT)(lFreeIndex - lMinFreeIndex);
+            WriteCacheHandles(pCache->rgFreeBank + lMinFreeIndex, pHandleBase, uStored);
+        }
+
+        // the free bank is full - the rest go through the miss path, which rebalances
+        for (UINT u = uStored; u < uBatch; u++)
+            TableCacheMissOnFree(pTable, pCache, uType, pHandleBase[u]);
+
+        pTable->dwMagazineSpills++;
+
+        pHandleBase += uBatch;
+        uCount -= uBatch;
+    }
+}
+
+
+/*
+ * MagazineGetSet
+ *
+ * Returns the magazines of the current thread.  If the thread has none
+ * and fCreate is set, it gets a set of an exited thread or a new one.
+ * Returns NULL if the thread has none and cannot get one.
+ *
+ */
+HandleMagazineSet *MagazineGetSet(BOOL fCreate)
+{
+    WRAPPER_CONTRACT;
+
+    /*
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    */
+
+    HandleMagazineSet *pSet = (HandleMagazineSet *)ClrFlsGetValue(TlsIdx_HandleMagazines);
+    if (pSet || !fCreate)
+        return pSet;
+
+    CrstHolder ch(&g_HandleMagazineLock);
+
+    // look for a set nobody owns
+    for (pSet = g_pHandleMagazineSets; pSet; pSet = pSet->pNext)
+    {
+        if (!pSet->fInUse)
+            break;
+    }
+
+    // none free - make a new one
+    if (!pSet)
+    {
+        pSet = new (nothrow) HandleMagazineSet;
+        if (!pSet)
+            return NULL;
+
+        memset(pSet, 0, sizeof(HandleMagazineSet));
+        pSet->pNext = g_pHandleMagazineSets;
+        g_pHandleMagazineSets = pSet;
+    }
+
+    pSet->fInUse = TRUE;
+    ClrFlsSetValue(TlsIdx_HandleMagazines, pSet);
+
+    return pSet;
+}
+
+
+/*
+ * MagazineFind
+ *
+ * Returns the magazine in a set that holds handles of the specified
+ * table and type, or NULL if there is none.
+ *
+ */
+__inline HandleMagazine *MagazineFind(HandleMagazineSet *pSet, HandleTable *pTable, UINT uType)
+{
+    LEAF_CONTRACT;
+
+    HandleMagazine *pMagazine = pSet->rgMagazines;
+    HandleMagazine *pLast = pMagazine + HANDLE_MAGAZINES_PER_THREAD;
+
+    for (; pMagazine < pLast; pMagazine++)
+    {
+        if ((pMagazine->pTable == pTable) && (pMagazine->uType == uType))
+            return pMagazine;
+    }
+
+    return NULL;
+}
+
+
+/*
+ * MagazineClaim
+ *
+ * Points a magazine of the set at the specified table and type.  An empty
+ * magazine is used if there is one; otherwise the magazines are taken in
+ * turn and the handles of the one taken are given back to their table.
+ *
+ */
+HandleMagazine *MagazineClaim(HandleMagazineSet *pSet, HandleTable *pTable, UINT uType)
+{
+    WRAPPER_CONTRACT;
+
+    /*
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    */
+
+    CrstHolder ch(&g_HandleMagazineLock);
+
+    HandleMagazine *pMagazine = NULL;
+    for (UINT u = 0; u < HANDLE_MAGAZINES_PER_THREAD; u++)
+    {
+        if (!pSet->rgMagazines[u].uCount)
+        {
+            pMagazine = pSet->rgMagazines + u;
+            break;
+        }
+    }
+
+    if (!pMagazine)
+    {
+        pMagazine = pSet->rgMagazines + (pSet->uNextVictim++ % HANDLE_MAGAZINES_PER_THREAD);
+        MagazineSpill(pMagazine, pMagazine->uCount);
+    }
+
+    pMagazine->pTable = pTable;
+    pMagazine->uType = uType;
+
+    return pMagazine;
+}
+
+
+/*
+ * MagazineReturnAll
+ *
+ * Gives back the handles of all magazines in a set to their tables and
+ * releases the set for another thread.  Called when the owning thread exits.
+ *
+ */
+VOID WINAPI MagazineReturnAll(PVOID pData)
+{
+    STATIC_CONTRACT_NOTHROW;
+    STATIC_CONTRACT_GC_NOTRIGGER;
+    STATIC_CONTRACT_MODE_ANY;
+    STATIC_CONTRACT_SO_TOLERANT;
+
+    HandleMagazineSet *pSet = (HandleMagazineSet *)pData;
+
+    CrstHolder ch(&g_HandleMagazineLock);
+
+    for (UINT u = 0; u < HANDLE_MAGAZINES_PER_THREAD; u++)
+    {
+        HandleMagazine *pMagazine = pSet->rgMagazines + u;
+
+        if (pMagazine->uCount)
+            MagazineSpill(pMagazine, pMagazine->uCount);
+
+        pMagazine->pTable = NULL;
+        pMagazine->uType = 0;
+    }
+
+    pSet->uNextVictim = 0;
+    pSet->fInUse = FALSE;
+}
+
+
+/*
+ * TableAllocHandleFromMagazine
+ *
+ * Gets a single handle of the specified type from the current thread's
+ * magazine for the table, refilling the magazine if it is empty.  Returns
+ * NULL if the thread has no magazines or no handle could be allocated.
+ *
+ */
+OBJECTHANDLE TableAllocHandleFromMagazine(HandleTable *pTable, UINT uType)
+{
+    WRAPPER_CONTRACT;
+
+    /*
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    */
+
+    HandleMagazineSet *pSet = MagazineGetSet(TRUE);
+    if (!pSet)
+        return NULL;
+
+    HandleMagazine *pMagazine = MagazineFind(pSet, pTable, uType);
+    if (!pMagazine)
+        pMagazine = MagazineClaim(pSet, pTable, uType);
+
+    if (!pMagazine->uCount && !MagazineRefill(pMagazine))
+    {
+        // the reserve bank is empty - take a handle the way everybody else does
+        // so that the cache gets rebalanced, and refill on the next allocation
+        return TableCacheMissOnAlloc(pTable, pTable->rgMainCache + uType, uType);
+    }
+
+    return pMagazine->rgHandles[--pMagazine->uCount];
+}
+
+
+/*
+ * TableFreeHandleToMagazine
+ *
+ * Puts a single zeroed handle of the specified type in the current
+ * thread's magazine for the table, spilling a batch to the main cache if
+ * the magazine is full.  Returns FALSE if the thread has no magazine for
+ * the table and type; frees never take a magazine from another table.
+ *
+ */
+BOOL TableFreeHandleToMagazine(HandleTable *pTable, UINT uType, OBJECTHANDLE handle)
+{
+    WRAPPER_CONTRACT;
+
+    /*
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    */
+
+    HandleMagazineSet *pSet = MagazineGetSet(FALSE);
+    if (!pSet)
+        return FALSE;
+
+    HandleMagazine *pMagazine = MagazineFind(pSet, pTable, uType);
+    if (!pMagazine)
+        return FALSE;
+
+    if (pMagazine->uCount == HANDLE_MAGAZINE_SIZE)
+        MagazineSpill(pMagazine, HANDLE_MAGAZINE_BATCH);
+
+    pMagazine->rgHandles[pMagazine->uCount++] = handle;
+
+    return TRUE;
+}
+
+
 /*
  * TableAllocSingleHandleFromCache
  *
@@ -718,7 +1076,17 @@ OBJECTHANDLE TableAllocSingleHandleFromCache(HandleTable *pTable, UINT uType)
     // we use this in two places
     OBJECTHANDLE handle;
 
-    // first try to get a handle from the quick cache
+    // first try the calling thread's magazine
+    if (g_fUseHandleMagazines)
+    {
+        handle = TableAllocHandleFromMagazine(pTable, uType);
+
+        // if it worked then we're done
+        if (handle)
+            return handle;
+    }
+
+    // next try to get a handle from the quick cache
     if (pTable->rgQuickCache[uType])
     {
         // try to grab the handle we saw
@@ -786,6 +1154,10 @@ void TableFreeSingleHandleToCache(HandleTable *pTable, UINT uType, OBJECTHANDLE
     if (TypeHasUserData(pTable, uType))
         HandleQuickSetUserData(handle, 0L);
 
+    // keep the handle in the calling thread's magazine if it has one for this type
+    if (g_fUseHandleMagazines && TableFreeHandleToMagazine(pTable, uType, handle))
+        return;
+
     // is there room in the quick cache?
     if (!pTable->rgQuickCache[uType])
     {
@@ -880,6 +1252,75 @@ void TableFreeHandlesToCache(HandleTable *pTable, UINT uType, const OBJECTHANDLE
     }
 }
 
+
+/*
+ * TableInitializeMagazines
+ *
+ * Sets up the per-thread handle magazines unless they are turned off
+ * with COMPlus_HandleTableMagazines=0.
+ *
+ */
+void TableInitializeMagazines()
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    if (EEConfig::GetConfigDWORD(L"HandleTableMagazines", 1) == 0)
+        return;
+
+    g_HandleMagazineLock.Init("Handle Magazine Lock", CrstHandleMagazines, CrstFlags(CRST_UNSAFE_ANYMODE | CRST_DEBUGGER_THREAD));
+
+    // give the handles back when a thread exits
+    ClrFlsAssociateCallback(TlsIdx_HandleMagazines, MagazineReturnAll);
+
+    g_fUseHandleMagazines = TRUE;
+}
+
+
+/*
+ * TableDiscardMagazines
+ *
+ * Empties every thread's magazines for the specified table, which is
+ * about to be destroyed.  The handles are dropped rather than freed since
+ * their segments are freed along with the table.
+ *
+ */
+void TableDiscardMagazines(HandleTable *pTable)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    if (!g_fUseHandleMagazines)
+        return;
+
+    CrstHolder ch(&g_HandleMagazineLock);
+
+    for (HandleMagazineSet *pSet = g_pHandleMagazineSets; pSet; pSet = pSet->pNext)
+    {
+        for (UINT u = 0; u < HANDLE_MAGAZINES_PER_THREAD; u++)
+        {
+            HandleMagazine *pMagazine = pSet->rgMagazines + u;
+
+            if (pMagazine->pTable == pTable)
+            {
+                pMagazine->uCount = 0;
+                pMagazine->pTable = NULL;
+                pMagazine->uType = 0;
+            }
+        }
+    }
+}
+
 /*--------------------------------------------------------------------------*/
 
 
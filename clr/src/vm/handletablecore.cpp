@@ -516,6 +516,7 @@ BOOL SegmentInitialize(TableSegment *pSegment, HandleTable *pTable)
     FillMemory(pSegment->rgGeneration, sizeof(pSegment->rgGeneration), 0xFF);
     FillMemory(pSegment->rgTail,       sizeof(pSegment->rgTail),       BLOCK_INVALID);
     FillMemory(pSegment->rgHint,       sizeof(pSegment->rgHint),       BLOCK_INVALID);
+    FillMemory(pSegment->rgMinAge,     sizeof(pSegment->rgMinAge),     0xFF);
     FillMemory(pSegment->rgFreeMask,   sizeof(pSegment->rgFreeMask),   0xFF);
     FillMemory(pSegment->rgBlockType,  sizeof(pSegment->rgBlockType),  TYPE_INVALID);
     FillMemory(pSegment->rgUserData,   sizeof(pSegment->rgUserData),   BLOCK_INVALID);
@@ -634,6 +635,24 @@ __inline void SegmentUnMarkFreeMask(TableSegment *pSegment, _UNCHECKED_OBJECTREF
     pSegment->rgFreeMask[uMask] &= ~(1<<uBit);
 }
 
+// Make a type's minimum age cover the clumps of a block joining its chain.
+__inline void SegmentNoteBlockAges(TableSegment *pSegment, UINT uBlock, UINT uType)
+{
+    LEAF_CONTRACT;
+
+    BYTE *pbGen = pSegment->rgGeneration + (uBlock * HANDLE_CLUMPS_PER_BLOCK);
+    for (UINT u = 0; u < HANDLE_CLUMPS_PER_BLOCK; u++)
+    {
+        // the handle write barrier can lower the minimum while we hold the table
+        // lock, so only ever store zero here or we might undo its update
+        if (pbGen[u] < pSegment->rgMinAge[uType])
+        {
+            pSegment->rgMinAge[uType] = 0;
+            break;
+        }
+    }
+}
+
 // Prepare a segment to be moved to default domain.
 // Remove all non-async pin handles.
 void SegmentPreCompactAsyncPinHandles(TableSegment *pSegment)
@@ -774,6 +793,7 @@ BOOL SegmentCopyAsyncPinHandle(TableSegment *pSegment, _UNCHECKED_OBJECTREF *h)
         }
         pSegment->bFreeList = pSegment->rgAllocation[uBlock];
         pSegment->rgBlockType[uBlock] = HNDTYPE_ASYNCPINNED;
+        SegmentNoteBlockAges(pSegment, uBlock, HNDTYPE_ASYNCPINNED);
         pSegment->rgAllocation[uBlock] = pSegment->rgHint[HNDTYPE_ASYNCPINNED];
         pSegment->rgHint[HNDTYPE_ASYNCPINNED] = uBlock;
         pSegment->rgFreeCount[HNDTYPE_ASYNCPINNED] += HANDLE_HANDLES_PER_BLOCK;
@@ -1401,6 +1421,7 @@ UINT SegmentInsertBlockFromFreeListWorker(TableSegment *pSegment, UINT uType, BO
 
         // mark this block with the type we're using it for
         pSegment->rgBlockType[uBlock] = (BYTE)uType;
+        SegmentNoteBlockAges(pSegment, uBlock, uType);
 
         // update the chain tail
         pSegment->rgTail[uType] = (BYTE)uBlock;
@@ -122,6 +122,11 @@ C_ASSERT (HANDLE_HANDLES_PER_MASK * 2 == HANDLE_HANDLES_PER_BLOCK);
 // bulk alloc policy defines
 #define SMALL_ALLOC_COUNT               (HANDLES_PER_CACHE_BANK / 10)
 
+// per-thread cache (magazine) metrics
+#define HANDLE_MAGAZINE_SIZE            16
+#define HANDLE_MAGAZINE_BATCH           (HANDLE_MAGAZINE_SIZE / 2)
+#define HANDLE_MAGAZINES_PER_THREAD     4
+
 // misc constants
 #define MASK_FULL                       (0)
 #define MASK_EMPTY                      (0xFFFFFFFF)
@@ -215,6 +220,15 @@ struct _TableSegmentHeader
      */
     BYTE rgHint[HANDLE_MAX_INTERNAL_TYPES];
 
+    /*
+     * Allocation Chain Minimum Ages
+     *
+     * Each slot holds a lower bound on the clump ages in an allocation chain.
+     * Ephemeral scans pass over a segment whose scanned chains are all older
+     * than the condemned generation without looking at its blocks.
+     */
+    BYTE rgMinAge[HANDLE_MAX_INTERNAL_TYPES];
+
     /*
      * Free Count
      *
@@ -346,6 +360,64 @@ struct HandleTypeCache
 };
 
 
+/*
+ * Handle Magazine
+ *
+ * Defines the layout of a small per-thread cache of handles of one type
+ * from one table.  Only the owning thread touches the handles.  The table
+ * and type are only changed while holding the magazine lock.
+ */
+struct HandleMagazine
+{
+    /*
+     * table and type the handles belong to (NULL table if unused)
+     */
+    struct HandleTable *pTable;
+    UINT uType;
+
+    /*
+     * number of handles in the magazine
+     */
+    UINT uCount;
+
+    /*
+     * the handles - already zeroed, ready to be handed out
+     */
+    OBJECTHANDLE rgHandles[HANDLE_MAGAZINE_SIZE];
+};
+
+
+/*
+ * Handle Magazine Set
+ *
+ * Defines the layout of the magazines of one thread.  Sets are never
+ * freed; the set of a thread that exited is handed to the next thread
+ * that needs one.
+ */
+struct HandleMagazineSet
+{
+    /*
+     * next set in the list of all sets
+     */
+    HandleMagazineSet *pNext;
+
+    /*
+     * whether a thread owns this set
+     */
+    BOOL fInUse;
+
+    /*
+     * next magazine to take for a different table or type
+     */
+    UINT uNextVictim;
+
+    /*
+     * the magazines
+     */
+    HandleMagazine rgMagazines[HANDLE_MAGAZINES_PER_THREAD];
+};
+
+
 /*---------------------------------------------------------------------------*/
 
 
@@ -371,8 +443,11 @@ struct ScanCallbackInfo
     LPARAM         param1;          // callback param 1
     LPARAM         param2;          // callback param 2
     ULONG32        dwAgeMask;       // generation mask for ephemeral GCs
+    UINT           uAgeLimit;       // segments with no clumps younger than this are skipped (0 skips none)
+    UINT           uAgeUpdate;      // AGEUPDATE_* - what the scan does to clumps younger than uAgeLimit
 
 #ifdef _DEBUG
+    UINT DEBUG_SegmentsSkipped;
     UINT DEBUG_BlocksScanned;
     UINT DEBUG_BlocksScannedNonTrivially;
     UINT DEBUG_HandleSlotsScanned;
@@ -381,6 +456,17 @@ struct ScanCallbackInfo
 };
 
 
+/*
+ * Age Updates
+ *
+ * How a scan changes the ages of the clumps it looks at, so that the segment
+ * minimum ages can be kept up to date.
+ */
+#define AGEUPDATE_NONE          (0)     // ages are only read
+#define AGEUPDATE_AGE           (1)     // ages below the limit go up by one
+#define AGEUPDATE_RESET         (2)     // ages below the limit are recomputed and may go down
+
+
 /*
  * BLOCKSCANPROC
  *
@@ -525,11 +611,22 @@ struct HandleTable
      */
     OBJECTHANDLE rgQuickCache[HANDLE_MAX_INTERNAL_TYPES];   // interlocked ops used here
 
+    /*
+     * cache statistics
+     *
+     * N.B. the magazine counts are updated without synchronization, so they are approximate
+     */
+    DWORD dwAllocMisses;                                    // allocations that took the table lock
+    DWORD dwFreeMisses;                                     // frees that took the table lock
+    DWORD dwMagazineRefills;                                // batches moved from the main cache to a thread
+    DWORD dwMagazineSpills;                                 // batches moved from a thread to the main cache
+
     /*
      * debug-only statistics
      */
 #ifdef _DEBUG
     int     _DEBUG_iMaxGen;
+    __int64 _DEBUG_TotalSegmentsSkipped          [MAXSTATGEN];
     __int64 _DEBUG_TotalBlocksScanned            [MAXSTATGEN];
     __int64 _DEBUG_TotalBlocksScannedNonTrivially[MAXSTATGEN];
     __int64 _DEBUG_TotalHandleSlotsScanned       [MAXSTATGEN];
@@ -887,6 +984,26 @@ UINT TableAllocHandlesFromCache(HandleTable *pTable, UINT uType, OBJECTHANDLE *p
  */
 void TableFreeHandlesToCache(HandleTable *pTable, UINT uType, const OBJECTHANDLE *pHandleBase, UINT uCount);
 
+
+/*
+ * TableInitializeMagazines
+ *
+ * Sets up the per-thread handle magazines unless they are turned off
+ * with COMPlus_HandleTableMagazines=0.
+ *
+ */
+void TableInitializeMagazines();
+
+
+/*
+ * TableDiscardMagazines
+ *
+ * Empties every thread's magazines for the specified table, which is
+ * about to be destroyed.
+ *
+ */
+void TableDiscardMagazines(HandleTable *pTable);
+
 /*--------------------------------------------------------------------------*/
 
 
@@ -941,6 +1058,15 @@ void CALLBACK xxxTableScanHandlesAsync(HandleTable *pTable,
 BOOL TypesRequireUserDataScanning(HandleTable *pTable, const UINT *types, UINT typeCount);
 
 
+/*
+ * BuildAgeLimit
+ *
+ * Computes the age below which clumps are examined/updated for a generation.
+ *
+ */
+UINT BuildAgeLimit(UINT uGen, UINT uMaxGen);
+
+
 /*
  * BuildAgeMask
  *
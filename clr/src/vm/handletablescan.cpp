@@ -365,16 +365,16 @@ BOOL TypesRequireUserDataScanning(HandleTable *pTable, const UINT *types, UINT t
 
 
 /*
- * BuildAgeMask
+ * BuildAgeLimit
  *
- * Builds an age mask to be used when examining/updating the write barrier.
+ * Computes the age below which clumps are examined/updated for a generation.
  *
  */
-ULONG32 BuildAgeMask(UINT uGen, UINT uMaxGen)
+UINT BuildAgeLimit(UINT uGen, UINT uMaxGen)
 {
     LEAF_CONTRACT;
 
-    // an age mask is composed of repeated bytes containing the next older generation
+    // the limit is the next older generation
 
     if (uGen == uMaxGen)
         uGen = GEN_MAX_AGE;
@@ -385,6 +385,23 @@ ULONG32 BuildAgeMask(UINT uGen, UINT uMaxGen)
     if (uGen > GEN_MAX_AGE)
         uGen = GEN_MAX_AGE;
 
+    return uGen;
+}
+
+
+/*
+ * BuildAgeMask
+ *
+ * Builds an age mask to be used when examining/updating the write barrier.
+ *
+ */
+ULONG32 BuildAgeMask(UINT uGen, UINT uMaxGen)
+{
+    LEAF_CONTRACT;
+
+    // an age mask is composed of repeated bytes containing the age limit
+    uGen = BuildAgeLimit(uGen, uMaxGen);
+
     // pack up a word with age bytes and fill bytes pre-folded as well
     return PREFOLD_FILL_INTO_AGEMASK(uGen | (uGen << 8) | (uGen << 16) | (uGen << 24));
 }
@@ -939,6 +956,9 @@ void BlockVerifyAgeMapForBlocksWorker(ULONG32 *pdwGen, ULONG32 dwClumpMask, Scan
         {
             // for each clump, check whether any object is younger than the age indicated by the clump
             BYTE minAge = ((BYTE *)pSegment->rgGeneration)[uClump];
+
+            // the segment's minimum age for the block's type must not be above the clump's
+            _ASSERTE(minAge >= pSegment->rgMinAge[pSegment->rgBlockType[uClump / HANDLE_CLUMPS_PER_BLOCK]]);
             for ( ; pValue < pLast; pValue++)
             {
                 if (!HndIsNullOrDestroyedHandle(*pValue))
@@ -1622,6 +1642,75 @@ void SegmentScanByTypeMap(TableSegment *pSegment, const BOOL *rgTypeInclusion,
 }
 
 
+/*
+ * SegmentIsTooOldToScan
+ *
+ * Checks whether a segment holds no clumps of the specified type(s) young enough
+ * for a scan with the specified age limit.
+ *
+ */
+BOOL SegmentIsTooOldToScan(TableSegment *pSegment, const UINT *puType, UINT uTypeCount, UINT uAgeLimit)
+{
+    LEAF_CONTRACT;
+
+    // scans without an age limit look at every clump
+    if (!uAgeLimit)
+        return FALSE;
+
+    // the segment can be passed over if every chain we scan is old enough
+    for (UINT u = 0; u < uTypeCount; u++)
+    {
+        if (pSegment->rgMinAge[puType[u]] < uAgeLimit)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/*
+ * SegmentUpdateMinAges
+ *
+ * Brings the minimum ages of the scanned chains in a segment up to date with
+ * what the scan did to their clumps.
+ *
+ */
+void SegmentUpdateMinAges(TableSegment *pSegment, const UINT *puType, UINT uTypeCount, ScanCallbackInfo *pInfo)
+{
+    LEAF_CONTRACT;
+
+    // get frequently used params into locals
+    UINT uAgeLimit  = pInfo->uAgeLimit;
+    UINT uAgeUpdate = pInfo->uAgeUpdate;
+
+    // the handle write barrier runs alongside async scans, so we can't raise the
+    // minimums then without risking overwriting one the barrier just lowered
+    if ((uAgeUpdate == AGEUPDATE_AGE) && (pInfo->uFlags & HNDGCF_ASYNC))
+        return;
+
+    for (UINT u = 0; u < uTypeCount; u++)
+    {
+        BYTE *pbMinAge = pSegment->rgMinAge + puType[u];
+
+        // only clumps below the limit were touched by the scan
+        if (*pbMinAge < uAgeLimit)
+        {
+            if (uAgeUpdate == AGEUPDATE_AGE)
+            {
+                // all the clumps below the limit went up by one, and the rest
+                // were at least as old as the limit already
+                (*pbMinAge)++;
+            }
+            else if (uAgeUpdate == AGEUPDATE_RESET)
+            {
+                // the clumps got the age of their youngest object, which can be anything
+                *pbMinAge = 0;
+            }
+        }
+    }
+}
+
+
 /*
  * TableScanHandles
  *
@@ -1660,6 +1749,16 @@ void CALLBACK TableScanHandles(HandleTable *pTable,
         // (we do this test inside the loop since the iterators should still run...)
         if (uTypeCount >= 1)
         {
+            // ephemeral scans can pass over segments holding only older handles
+            if (SegmentIsTooOldToScan(pSegment, puType, uTypeCount, pInfo->uAgeLimit))
+            {
+#ifdef _DEBUG
+                // update our scanning statistics
+                pInfo->DEBUG_SegmentsSkipped++;
+#endif
+                continue;
+            }
+
             // make sure the "current segment" pointer in the scan info is up to date
             pInfo->pCurrentSegment = pSegment;
 
@@ -1675,6 +1774,10 @@ void CALLBACK TableScanHandles(HandleTable *pTable,
                 SegmentScanByTypeMap(pSegment, rgTypeInclusion, pfnBlockHandler, pInfo);
             }
 
+            // keep the segment's minimum ages in step with the clumps
+            if (pInfo->uAgeUpdate != AGEUPDATE_NONE)
+                SegmentUpdateMinAges(pSegment, puType, uTypeCount, pInfo);
+
             // make sure the "current segment" pointer in the scan info is up to date
             pInfo->pCurrentSegment = NULL;
         }
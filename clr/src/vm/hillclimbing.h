@@ -0,0 +1,225 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+/*++
+
+Module Name:
+
+    HillClimbing.h
+
+Abstract:
+
+    Feedback controller that picks the number of threadpool worker threads.
+
+    The gate thread feeds it a sample every GATE_THREAD_DELAY: how many work
+    requests completed, how many are waiting, and how many workers there are.
+    After a few samples at one thread count it compares the throughput with
+    the one measured at the previous count and moves one thread in whichever
+    direction helped. A change within the noise band counts as no gain, and
+    then it moves towards fewer threads. Each time the direction reverses, it
+    stays at a count for longer before the next move, which keeps the count
+    from flapping around the optimum.
+
+    Work that blocks (e.g. synchronous I/O) shows up as samples with waiting
+    work and no completions, and those add a thread right away.
+
+    The controller has no dependency on the rest of the runtime, so the
+    threadpool replay tool (tools\tpreplay) can drive it with recorded traces.
+
+--*/
+
+#ifndef _HILLCLIMBING_H
+#define _HILLCLIMBING_H
+
+struct HillClimbingSample
+{
+    DWORD   ElapsedTime;        // milliseconds since the previous sample
+    DWORD   Completions;        // work requests completed during that time
+    LONG    QueueLength;        // work requests waiting at the end of it
+    LONG    ActiveThreads;      // worker threads that are not retired
+};
+
+struct HillClimbingSettings
+{
+    DWORD   SamplesPerMove;     // samples measured at a thread count before moving
+    DWORD   NoisePercent;       // throughput changes smaller than this are noise
+    DWORD   MaxHoldSamples;     // upper bound on the extra samples after a reversal
+};
+
+#define HILLCLIMBING_DEFAULT_SAMPLES_PER_MOVE   2
+#define HILLCLIMBING_DEFAULT_NOISE_PERCENT      5
+#define HILLCLIMBING_DEFAULT_MAX_HOLD_SAMPLES   16
+
+class HillClimbing
+{
+public:
+    void Initialize(const HillClimbingSettings& settings, LONG initialTarget)
+    {
+        LEAF_CONTRACT;
+
+        m_settings = settings;
+        if (m_settings.SamplesPerMove == 0)
+            m_settings.SamplesPerMove = 1;
+
+        m_target = initialTarget;
+        m_direction = 1;
+        m_holdSamples = 0;
+        m_mismatchedSamples = 0;
+        m_fHaveLast = FALSE;
+        m_lastTarget = initialTarget;
+        m_lastThroughput = 0;
+        m_throughput = 0;
+        m_adjustments = 0;
+        m_reversals = 0;
+
+        ResetMeasurement();
+    }
+
+    // Returns the number of worker threads the pool should run with
+    LONG Update(const HillClimbingSample& sample, LONG minThreads, LONG maxThreads)
+    {
+        LEAF_CONTRACT;
+
+        if (m_target < minThreads)
+            m_target = minThreads;
+        if (m_target > maxThreads)
+            m_target = maxThreads;
+
+        // Nothing is waiting, so the pool keeps up with the demand and the
+        // throughput tells nothing about the thread count
+        if (sample.QueueLength <= 0)
+            return m_target;
+
+        // Work is waiting and none completed: the workers are blocked. Their
+        // throughput means nothing, so add a thread and start over.
+        if (sample.Completions == 0)
+        {
+            m_direction = 1;
+            m_fHaveLast = FALSE;
+            ResetMeasurement();
+            return SetTarget(m_target + 1, minThreads, maxThreads);
+        }
+
+        // The pool has not caught up with the last move yet (thread creation
+        // is throttled and threads retire lazily). If it never does, take the
+        // pool as it is as the new starting point.
+        if (sample.ActiveThreads != m_target)
+        {
+            if (++m_mismatchedSamples <= 2 * m_settings.SamplesPerMove)
+                return m_target;
+
+            m_fHaveLast = FALSE;
+            ResetMeasurement();
+            return SetTarget(sample.ActiveThreads, minThreads, maxThreads);
+        }
+        m_mismatchedSamples = 0;
+
+        m_completions += sample.Completions;
+        m_elapsedTime += sample.ElapsedTime;
+        m_samples++;
+
+        if (m_samples < m_settings.SamplesPerMove + m_holdSamples)
+            return m_target;
+
+        m_throughput = (LONG)(((ULONGLONG)m_completions * 1000) / (m_elapsedTime ? m_elapsedTime : 1));
+        ResetMeasurement();
+
+        LONG move = m_direction;
+        if (m_fHaveLast && m_lastTarget != m_target)
+        {
+            LONG lastMove = (m_target > m_lastTarget) ? 1 : -1;
+            LONG noise = (LONG)(((ULONGLONG)m_lastThroughput * m_settings.NoisePercent) / 100);
+            LONG gain = m_throughput - m_lastThroughput;
+
+            if (gain > noise)
+                move = lastMove;                // that helped, keep going
+            else if (gain < -noise)
+                move = -lastMove;               // that hurt, go back
+            else
+                move = -1;                      // no gain, so the extra threads only cost memory
+        }
+
+        if (move != m_direction)
+        {
+            m_reversals++;
+            m_holdSamples = m_holdSamples ? 2 * m_holdSamples : m_settings.SamplesPerMove;
+            if (m_holdSamples > m_settings.MaxHoldSamples)
+                m_holdSamples = m_settings.MaxHoldSamples;
+        }
+        else
+        {
+            m_holdSamples /= 2;
+        }
+
+        m_direction = move;
+        m_fHaveLast = TRUE;
+        m_lastTarget = m_target;
+        m_lastThroughput = m_throughput;
+
+        return SetTarget(m_target + move, minThreads, maxThreads);
+    }
+
+    LONG GetTarget()        { LEAF_CONTRACT; return m_target; }
+    LONG GetThroughput()    { LEAF_CONTRACT; return m_throughput; }     // completions per second
+    DWORD GetAdjustments()  { LEAF_CONTRACT; return m_adjustments; }
+    DWORD GetReversals()    { LEAF_CONTRACT; return m_reversals; }
+
+private:
+    LONG SetTarget(LONG target, LONG minThreads, LONG maxThreads)
+    {
+        LEAF_CONTRACT;
+
+        if (target < minThreads)
+            target = minThreads;
+        if (target > maxThreads)
+            target = maxThreads;
+
+        if (target != m_target)
+        {
+            m_target = target;
+            m_adjustments++;
+        }
+        return m_target;
+    }
+
+    void ResetMeasurement()
+    {
+        LEAF_CONTRACT;
+
+        m_completions = 0;
+        m_elapsedTime = 0;
+        m_samples = 0;
+    }
+
+    HillClimbingSettings m_settings;
+
+    LONG    m_target;                   // current thread count goal
+    LONG    m_direction;                // +1 or -1, the last move
+    DWORD   m_holdSamples;              // extra samples before the next move
+    DWORD   m_mismatchedSamples;        // samples taken while the pool was off target
+
+    BOOL    m_fHaveLast;                // m_lastTarget and m_lastThroughput are valid
+    LONG    m_lastTarget;
+    LONG    m_lastThroughput;
+
+    DWORD   m_completions;              // measurement at m_target so far
+    DWORD   m_elapsedTime;
+    DWORD   m_samples;
+
+    LONG    m_throughput;               // last measured, completions per second
+    DWORD   m_adjustments;              // number of times the target changed
+    DWORD   m_reversals;                // number of times the direction changed
+};
+
+#endif // _HILLCLIMBING_H
@@ -954,15 +954,19 @@ extern "C" {
 BitFieldOps FastInterlockOr = OrMaskUP;
 BitFieldOps FastInterlockAnd = AndMaskUP;
 
-XchgOps         FastInterlockExchange = ExchangeUP;
 XchgLongOps         FastInterlockExchangeLong = (XchgLongOps)ExchangeLongMP8b;
-CmpXchgOps      FastInterlockCompareExchange = (CmpXchgOps)CompareExchangeUP;
 CmpXchgLongOps      FastInterlockCompareExchangeLong = (CmpXchgLongOps)CompareExchangeLongMP8b;
 XchngAddOps     FastInterlockExchangeAdd = ExchangeAddUP;
 XchgAddLongOps     FastInterlockExchangeAddLong = (XchgAddLongOps)ExchangeAddLongMP8b;
 
+// with PAL_INLINE_INTERLOCKED these are the PAL's inline functions (util.hpp)
+#ifndef PAL_INLINE_INTERLOCKED
+XchgOps         FastInterlockExchange = ExchangeUP;
+CmpXchgOps      FastInterlockCompareExchange = (CmpXchgOps)CompareExchangeUP;
 IncDecOps       FastInterlockIncrement = IncrementUP;
 IncDecOps       FastInterlockDecrement = DecrementUP;
+#endif // !PAL_INLINE_INTERLOCKED
+
 IncDecLongOps   FastInterlockIncrementLong = IncrementLongMP8b;
 IncDecLongOps   FastInterlockDecrementLong = DecrementLongMP8b;
 
@@ -990,11 +994,13 @@ void InitFastInterlockOps()
         FastInterlockOr  = OrMaskMP;
         FastInterlockAnd = AndMaskMP;
 
+        FastInterlockExchangeAdd = ExchangeAddMP;
+#ifndef PAL_INLINE_INTERLOCKED
         FastInterlockExchange = ExchangeMP;
         FastInterlockCompareExchange = (CmpXchgOps)CompareExchangeMP;
-        FastInterlockExchangeAdd = ExchangeAddMP;
         FastInterlockIncrement = IncrementMP;
         FastInterlockDecrement = DecrementMP;
+#endif // !PAL_INLINE_INTERLOCKED
 
     }
     //RETURN;
@@ -789,7 +789,7 @@ void *JIT_TrialAlloc::GenAllocSFast(Flags flags)
         sl.X86EmitNearJump(sl.NewExternalCodeLabel((LPVOID) JIT_New));
     }
 
-    Stub *pStub = sl.Link(SystemDomain::System()->GetHighFrequencyHeap());
+    Stub *pStub = sl.Link(SystemDomain::System()->GetStubHeap());
 
     return (void *)pStub->GetEntryPoint();
 }
@@ -924,7 +924,7 @@ void *JIT_TrialAlloc::GenBox(Flags flags)
     // Jump to the slow version of JIT_Box
     sl.X86EmitNearJump(sl.NewExternalCodeLabel((LPVOID) JIT_Box));
 
-    Stub *pStub = sl.Link(SystemDomain::System()->GetHighFrequencyHeap());
+    Stub *pStub = sl.Link(SystemDomain::System()->GetStubHeap());
 
     return (void *)pStub->GetEntryPoint();
 }
@@ -1149,7 +1149,7 @@ void *JIT_TrialAlloc::GenAllocArray(Flags flags)
         sl.X86EmitNearJump(sl.NewExternalCodeLabel((LPVOID) JIT_NewArr1));
     }
 
-    Stub *pStub = sl.Link(SystemDomain::System()->GetHighFrequencyHeap());
+    Stub *pStub = sl.Link(SystemDomain::System()->GetStubHeap());
 
     return (void *)pStub->GetEntryPoint();
 }
@@ -1258,7 +1258,7 @@ void *JIT_TrialAlloc::GenAllocString(Flags flags)
         sl.X86EmitNearJump(sl.NewExternalCodeLabel((LPVOID) FramedAllocateString));
     }
 
-    Stub *pStub = sl.Link(SystemDomain::System()->GetHighFrequencyHeap());
+    Stub *pStub = sl.Link(SystemDomain::System()->GetStubHeap());
 
     return (void *)pStub->GetEntryPoint();
 }
@@ -1388,7 +1388,7 @@ void *GenFastGetSharedStaticBase(bool bCheckCCtor, bool bGCStatic)
 
     EmitFastGetSharedStaticBase(&sl, init, bCheckCCtor, bGCStatic);
 
-    Stub *pStub = sl.Link(SystemDomain::System()->GetHighFrequencyHeap());
+    Stub *pStub = sl.Link(SystemDomain::System()->GetStubHeap());
 
     return (void*) pStub->GetEntryPoint();
 }
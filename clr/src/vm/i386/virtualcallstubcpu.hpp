@@ -298,10 +298,11 @@ private:
                                     // 03 c2        add     eax,edx
                                     // 35           xor     eax,
     UINT32  _hashedToken;           // xx xx xx xx              hashedToken ;along with pre-hashed token
-    BYTE    part2 [1];              // 25           and     eax,
-    size_t mask;                    // xx xx xx xx              cache_mask
-    BYTE part3 [2];                 // 8b 80        mov     eax, [eax+
-    size_t  _cacheAddress;          // xx xx xx xx                lookupCache]
+    BYTE    part2 [2];              // 23 05        and     eax,[
+    size_t  _cacheMaskAddress;      // xx xx xx xx               cache_mask] ;the cache can grow, so both the mask
+    BYTE part3 [2];                 // 03 05        add     eax,[            ;    and the table are loaded, mask first
+    size_t  _cacheAddress;          // xx xx xx xx               lookupCache]
+    BYTE part3a [2];                // 8b 00        mov     eax,[eax]
 #ifdef STUB_LOGGING
     BYTE cntr1[2];                  // ff 05        inc
     size_t* c_call;                 // xx xx xx xx          [call_cache_counter]
@@ -351,7 +352,7 @@ struct ResolveHolder
 
     void  Initialize(const BYTE *resolveWorkerTarget, const BYTE* patcherTarget, 
                      size_t dispatchToken, UINT32 hashedToken,
-                     void * cacheAddr, INT32 * counterAddr,
+                     void * cacheAddr, size_t * cacheMaskAddr, INT32 * counterAddr,
                      VirtualCallStubManager::ThisCallingConvention passThis);
 
     ResolveStub* stub()      { LEAF_CONTRACT;  return &_stub; }
@@ -1295,15 +1296,19 @@ void ResolveHolder::InitializeStatic()
     C_ASSERT(sizeof(resolveInit.part1) == 6);
 
     resolveInit._hashedToken           = 0xcccccccc;
-    resolveInit.part2 [0]              = 0x25;
-    C_ASSERT(sizeof(resolveInit.part2) == 1);
+    resolveInit.part2 [0]              = 0x23;
+    resolveInit.part2 [1]              = 0x05;
+    C_ASSERT(sizeof(resolveInit.part2) == 2);
 
-    resolveInit.mask                   = (CALL_STUB_CACHE_MASK << LOG2_PTRSIZE);
-    resolveInit.part3 [0]              = 0x8b;
-    resolveInit.part3 [1]              = 0x80;;
+    resolveInit._cacheMaskAddress      = 0xcccccccc;
+    resolveInit.part3 [0]              = 0x03;
+    resolveInit.part3 [1]              = 0x05;
     C_ASSERT(sizeof(resolveInit.part3) == 2);
 
     resolveInit._cacheAddress          = 0xcccccccc;
+    resolveInit.part3a [0]             = 0x8b;
+    resolveInit.part3a [1]             = 0x00;
+    C_ASSERT(sizeof(resolveInit.part3a) == 2);
 #ifdef STUB_LOGGING
     resolveInit.cntr1 [0]              = 0xff;
     resolveInit.cntr1 [1]              = 0x05;
@@ -1371,7 +1376,7 @@ void ResolveHolder::InitializeStatic()
 
 void  ResolveHolder::Initialize(const BYTE *resolveWorkerTarget, const BYTE* patcherTarget, 
                                 size_t dispatchToken, UINT32 hashedToken,
-                                void * cacheAddr, INT32 * counterAddr,
+                                void * cacheAddr, size_t * cacheMaskAddr, INT32 * counterAddr,
                                 VirtualCallStubManager::ThisCallingConvention passThis)
 {
     _stub = resolveInit;
@@ -1379,6 +1384,7 @@ void  ResolveHolder::Initialize(const BYTE *resolveWorkerTarget, const BYTE* pat
     //fill in the stub specific fields
     _stub._pCounter           = counterAddr;
     _stub._hashedToken        = hashedToken << LOG2_PTRSIZE;
+    _stub._cacheMaskAddress   = (size_t) cacheMaskAddr;
     _stub._cacheAddress       = (size_t) cacheAddr;
     _stub._token              = dispatchToken;
 //    _stub._hashedTokenMov     = hashedToken;
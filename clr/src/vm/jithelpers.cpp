@@ -1444,7 +1444,8 @@ HCIMPLEND
 //========================================================================
 
 /*********************************************************************/
-HCIMPL1(void*, JIT_GetStaticFieldAddr, FieldDesc *pFD)
+// Slow helper to tailcall from the fast one
+HCIMPL1(void*, JIT_GetStaticFieldAddr_Framed, FieldDesc *pFD)
 {
     CONTRACTL {
         SO_TOLERANT;
@@ -1492,6 +1493,92 @@ HCIMPL1(void*, JIT_GetStaticFieldAddr, FieldDesc *pFD)
 }
 HCIMPLEND
 
+/*********************************************************************/
+// Finds the thread static storage of a class on the current thread without
+// a frame. Returns NULL when the class is not initialized yet or the storage
+// is not allocated on this thread in the current domain, both of which the
+// framed helper takes care of.
+static FORCEINLINE BYTE *GetThreadStaticsBaseNoFrame(Thread *pThread, MethodTable *pMT)
+{
+    LEAF_CONTRACT;
+
+    if (!pMT->IsRestored() || !pMT->IsClassInited())
+        return NULL;
+
+    // Note: GetThreadStaticsOffset returns -1 if the offset is not allocated yet
+    return pThread->GetThreadStaticsBaseNoCreate(pMT->IsDomainNeutral(), pMT->GetThreadStaticsOffset());
+}
+
+/*********************************************************************/
+// The jit uses this helper for the statics of domain neutral classes. Once
+// the class is initialized in the current domain the address is computed
+// without setting up a frame, which is what hot reads of static tables in
+// shared code mostly hit. Thread statics of value types come here too, and
+// take the same kind of shortcut once their box is allocated.
+#ifdef _MSC_VER
+#pragma optimize("t", on)
+#endif
+HCIMPL1(void*, JIT_GetStaticFieldAddr, FieldDesc *pFD)
+{
+    CONTRACTL {
+        SO_TOLERANT;
+        THROWS;
+        DISABLED(GC_TRIGGERS);      // currently disabled because of FORBIDGC in HCIMPL
+        PRECONDITION(CheckPointer(pFD));
+        PRECONDITION(pFD->IsStatic());
+    } CONTRACTL_END;
+
+    MethodTable *pMT = pFD->GetEnclosingMethodTable();
+    DomainLocalModule *pLocalModule = NULL;
+
+    if (pFD->IsThreadStatic())
+    {
+        if (!pFD->IsByValue())
+            goto SLOW;
+
+        Thread *pThread = GetThread();
+        BYTE *dataBits = GetThreadStaticsBaseNoFrame(pThread, pMT);
+        if (dataBits == NULL)
+            goto SLOW;
+
+        // The field holds the slot of the box in the thread's managed storage
+        int slot = *((int*) &dataBits[pFD->GetOffset()]);
+        if (slot == 0)
+            goto SLOW;
+
+        OBJECTREF *pBox = (OBJECTREF *)pThread->CalculateAddressForManagedStatic(slot);
+        if (*pBox == NULL)
+            goto SLOW;
+
+        return (*pBox)->GetData();
+    }
+
+    if (pFD->IsContextStatic() || pFD->IsRVA())
+        goto SLOW;
+
+    // Dynamic statics may not be allocated yet
+    if (!pMT->IsRestored() || !pMT->IsDomainNeutral() || pMT->IsDynamicStatics())
+        goto SLOW;
+
+    pLocalModule = pMT->GetDomainLocalModule();
+    if (pLocalModule == NULL)
+        goto SLOW;
+
+    if (!pMT->IsClassPreInited() && !pLocalModule->IsClassInitialized(pMT))
+        goto SLOW;
+
+    return pFD->GetStaticAddress((void*)pFD->GetBaseInDomainLocalModule(pLocalModule));
+
+SLOW:
+    // Tailcall to the slow helper
+    ENDFORBIDGC();
+    return HCCALL1(JIT_GetStaticFieldAddr_Framed, pFD);
+}
+HCIMPLEND
+#ifdef _MSC_VER
+#pragma optimize("",on)
+#endif
+
 // Slow helper to tailcall from the fast one
 HCIMPL1(void, JIT_InitClass_Framed, MethodTable* pMT)
 {
@@ -1592,27 +1679,7 @@ HCIMPL1(void *, JIT_GetThreadFieldAddr_Primitive, FieldDesc *pFD)
     } CONTRACTL_END;
 
     // for static field the MethodTable is exact even for generic classes
-    MethodTable* pMT = pFD->GetEnclosingMethodTable();
-
-    Thread *pThread = NULL;
-    STATIC_DATA *pData = NULL;
-    DWORD dwClassOffset = 0;
-    BYTE *dataBits = NULL;
-
-    if (!pMT->IsRestored() || !pMT->IsClassInited())
-        goto SLOW;
-
-    pThread = GetThread();
-    pData = pMT->IsDomainNeutral() ? pThread->GetSharedStaticData() : pThread->GetUnsharedStaticData();
-    if (pData == 0)
-        goto SLOW;
-
-    // Note: returns -1 if the offset is not allocated yet
-    dwClassOffset = pMT->GetThreadStaticsOffset();
-    if (dwClassOffset >= pData->cElem)
-        goto SLOW;
-
-    dataBits = (BYTE*) pData->dataPtr[dwClassOffset];
+    BYTE *dataBits = GetThreadStaticsBaseNoFrame(GetThread(), pFD->GetEnclosingMethodTable());
     if (dataBits == 0)
         goto SLOW;
 
@@ -1621,7 +1688,7 @@ HCIMPL1(void *, JIT_GetThreadFieldAddr_Primitive, FieldDesc *pFD)
 SLOW:
     // Tailcall to the slow helper
     ENDFORBIDGC();
-    return HCCALL1(JIT_GetStaticFieldAddr, pFD);
+    return HCCALL1(JIT_GetStaticFieldAddr_Framed, pFD);
 }
 HCIMPLEND
 #ifdef _MSC_VER
@@ -1648,28 +1715,11 @@ HCIMPL1(void *, JIT_GetThreadFieldAddr_Objref, FieldDesc *pFD)
     } CONTRACTL_END;
 
     // for static field the MethodTable is exact even for generic classes
-    MethodTable* pMT = pFD->GetEnclosingMethodTable();
-
-    Thread *pThread = NULL;
-    STATIC_DATA *pData = NULL;
-    DWORD dwClassOffset = 0;
+    Thread *pThread = GetThread();
     BYTE *dataBits = NULL;
     int slot = 0;
 
-    if (!pMT->IsRestored() || !pMT->IsClassInited())
-        goto SLOW;
-
-    pThread = GetThread();
-    pData = pMT->IsDomainNeutral() ? pThread->GetSharedStaticData() : pThread->GetUnsharedStaticData();
-    if (pData == 0)
-        goto SLOW;
-
-    // Note: returns -1 if the offset is not allocated yet
-    dwClassOffset = pMT->GetThreadStaticsOffset();
-    if (dwClassOffset >= pData->cElem)
-        goto SLOW;
-
-    dataBits = (BYTE*) pData->dataPtr[dwClassOffset];
+    dataBits = GetThreadStaticsBaseNoFrame(pThread, pFD->GetEnclosingMethodTable());
     if (dataBits == 0)
         goto SLOW;
 
@@ -1682,7 +1732,7 @@ HCIMPL1(void *, JIT_GetThreadFieldAddr_Objref, FieldDesc *pFD)
 SLOW:
     // Tailcall to the slow helper
     ENDFORBIDGC();
-    return HCCALL1(JIT_GetStaticFieldAddr, pFD);
+    return HCCALL1(JIT_GetStaticFieldAddr_Framed, pFD);
 }
 HCIMPLEND
 #ifdef _MSC_VER
@@ -66,6 +66,7 @@
 #include "security.inl"
 #include "tokeniter.hpp"
 #include "safemath.h"
+#include "verificationcache.h"
 
 
 #include "mdaassistantsptr.h"
@@ -5225,6 +5226,62 @@ const char* __stdcall CEEInfo::getMethodName (CORINFO_METHOD_HANDLE ftnHnd, cons
     return result;
 }
 
+/*********************************************************************/
+// getMethodAttribs caches the part of its result that only depends on the method
+// definition in Module::LookupMethodDefJitAttribs. These bits are jitter-reserved
+// (CORINFO_FLG_JITTERFLAGSMASK) and are never returned to the jit.
+#define METHODDEF_JIT_ATTRIBS_CACHED            0x80000000  // makes every cached value non-zero
+#define METHODDEF_JIT_ATTRIBS_CCTOR_CANDIDATE   0x40000000  // static or instance initializer, but not the .cctor
+#define METHODDEF_JIT_ATTRIBS_INTERNAL          (METHODDEF_JIT_ATTRIBS_CACHED | METHODDEF_JIT_ATTRIBS_CCTOR_CANDIDATE)
+
+static DWORD GetMethodDefJitAttribs(MethodDesc *pMD)
+{
+    CONTRACTL {
+        THROWS;
+        GC_NOTRIGGER;
+    } CONTRACTL_END;
+
+    DWORD result = METHODDEF_JIT_ATTRIBS_CACHED;
+
+    DWORD attribs = pMD->GetAttrs();
+
+    if (IsMdPublic(attribs))
+        result |= CORINFO_FLG_PUBLIC;
+    if (IsMdPrivate(attribs))
+        result |= CORINFO_FLG_PRIVATE;
+    if (IsMdFamily(attribs))
+        result |= CORINFO_FLG_PROTECTED;
+    if (IsMdStatic(attribs))
+        result |= CORINFO_FLG_STATIC;
+    if (IsMdFinal(attribs))
+        result |= CORINFO_FLG_FINAL;
+    if (IsMdVirtual(attribs))
+        result |= CORINFO_FLG_VIRTUAL;
+    if (IsMdAbstract(attribs))
+        result |= CORINFO_FLG_ABSTRACT;
+
+    LPCUTF8 szName = pMD->GetName();
+    BOOL fInstanceInitializer = IsMdInstanceInitializer(attribs, szName);
+    BOOL fClassConstructor    = IsMdClassConstructor(attribs, szName);
+
+    if (fInstanceInitializer || fClassConstructor)
+        result |= CORINFO_FLG_CONSTRUCTOR;
+
+    // Run .cctor on statics & constructors, except on the .cctor itself
+    if ((fInstanceInitializer || IsMdStatic(attribs)) && !fClassConstructor)
+        result |= METHODDEF_JIT_ATTRIBS_CCTOR_CANDIDATE;
+
+    if (!pMD->IsRuntimeSupplied())
+    {
+        if (Security::HasREQ_SOAttribute(pMD) == S_OK)
+        {
+            result |= CORINFO_FLG_SECURITYCHECK;
+        }
+    }
+
+    return result;
+}
+
 /*********************************************************************/
 //
 // The callerHnd can be either the methodBeingCompiled or the immediate
@@ -5259,29 +5316,26 @@ DWORD __stdcall CEEInfo::getMethodAttribs (CORINFO_METHOD_HANDLE calleeHnd, CORI
     }
 
 
-    DWORD attribs = callee->GetAttrs();
+    // The jit asks about the same callees over and over, so the flags that come from
+    // the metadata of the method definition are looked up once per module. Everything
+    // that depends on the caller, the instantiation or the class init state is not cached.
+    BOOL fCacheable = !callee->IsArray() && !callee->IsNoMetadata();
+    DWORD defAttribs = 0;
+    if (fCacheable)
+        defAttribs = callee->GetModule()->LookupMethodDefJitAttribs(callee->GetMemberDef());
+    if (defAttribs == 0)
+    {
+        defAttribs = GetMethodDefJitAttribs(callee);
+        if (fCacheable)
+            callee->GetModule()->StoreMethodDefJitAttribs(callee->GetMemberDef(), defAttribs);
+    }
+
+    result |= (defAttribs & ~METHODDEF_JIT_ATTRIBS_INTERNAL);
 
-    if (IsMdPublic(attribs))
-        result |= CORINFO_FLG_PUBLIC;
-    if (IsMdPrivate(attribs))
-        result |= CORINFO_FLG_PRIVATE;
-    if (IsMdFamily(attribs))
-        result |= CORINFO_FLG_PROTECTED;
-    if (IsMdStatic(attribs))
-        result |= CORINFO_FLG_STATIC;
-    if (IsMdFinal(attribs))
-        result |= CORINFO_FLG_FINAL;
     if (callee->IsSynchronized())
         result |= CORINFO_FLG_SYNCH;
     if (callee->IsFCallOrIntrinsic())
         result |= CORINFO_FLG_NOGCCHECK | CORINFO_FLG_INTRINSIC;
-    if (IsMdVirtual(attribs))
-        result |= CORINFO_FLG_VIRTUAL;
-    if (IsMdAbstract(attribs))
-        result |= CORINFO_FLG_ABSTRACT;
-    if (IsMdInstanceInitializer(attribs, callee->GetName()) ||
-        IsMdClassConstructor(   attribs, callee->GetName()))
-        result |= CORINFO_FLG_CONSTRUCTOR;
 
     //
     // See if we need to embed a .cctor call at the head of the
@@ -5329,10 +5383,8 @@ DWORD __stdcall CEEInfo::getMethodAttribs (CORINFO_METHOD_HANDLE calleeHnd, CORI
         && !pCalleeMT->GetClass()->IsBeforeFieldInit()
 
         // Run .cctor on statics & constructors
-        && (IsMdInstanceInitializer(attribs, callee->GetName()) || IsMdStatic(attribs))
-
         // Except don't class construct on .cctor - it would be circular
-        && !IsMdClassConstructor(attribs, callee->GetName())
+        && (defAttribs & METHODDEF_JIT_ATTRIBS_CCTOR_CANDIDATE)
 
         && (
             // Note that jit has both methods the same if asking whether to emit cctor
@@ -5359,7 +5411,7 @@ DWORD __stdcall CEEInfo::getMethodAttribs (CORINFO_METHOD_HANDLE calleeHnd, CORI
     }
 
     // method may not have the final bit, but the class might
-    if (IsMdFinal(attribs) == 0)
+    if ((result & CORINFO_FLG_FINAL) == 0)
     {
         if (pCalleeMT->IsSealed())
             result |= CORINFO_FLG_FINAL;
@@ -5391,14 +5443,6 @@ DWORD __stdcall CEEInfo::getMethodAttribs (CORINFO_METHOD_HANDLE calleeHnd, CORI
         result |= CORINFO_FLG_DONT_INLINE;
     }
 
-    if (!callee->IsRuntimeSupplied())
-    {
-        if (Security::HasREQ_SOAttribute(callee) == S_OK)
-        {
-            result |= CORINFO_FLG_SECURITYCHECK;
-        }
-    }
-
     if (pCalleeMT->IsAnyDelegateClass() && ((DelegateEEClass*)(pCalleeMT->GetClass()))->m_pInvokeMethod == callee)
     {
         // This is now used to emit efficient invoke code for any delegate invoke,
@@ -5485,7 +5529,10 @@ void __stdcall CEEInfo::setMethodAttribs (
              !(attribs & CORINFO_FLG_VERIFIABLE  ));
 
     if (attribs & CORINFO_FLG_VERIFIABLE)
+    {
         ftn->SetIsVerified(TRUE);
+        VerificationCache::RecordVerified(ftn);
+    }
     else if (attribs & CORINFO_FLG_UNVERIFIABLE)
         ftn->SetIsVerified(FALSE);
 
@@ -6838,7 +6885,13 @@ DWORD __stdcall CEEInfo::getFieldAttribs (CORINFO_FIELD_HANDLE  fieldHnd,
                 {
                     _ASSERTE(!pFieldMT->HasGenericsStaticsInfo());
                     _ASSERTE(pFieldMT->IsDomainNeutral());
-                    result |= CORINFO_FLG_SHARED_HELPER;
+
+                    // When no other AppDomain can ever run this code, the statics of
+                    // the current domain are the only ones it will see. Once the class
+                    // is initialized their address can be embedded just like for
+                    // unshared code; until then the helper does the init check.
+                    if (!g_pConfig->SingleAppDomain() || !pFieldMT->IsClassInited())
+                        result |= CORINFO_FLG_SHARED_HELPER;
                 }
             }
         }
@@ -9217,6 +9270,13 @@ CorJitFlag GetCompileFlags(MethodDesc * ftn, DWORD flags, CORINFO_METHOD_INFO *
     if ((flags & CORJIT_FLG_IMPORT_ONLY) == 0 && 
         Security::CanSkipVerification(ftn, FALSE)) // don't commit
         flags |= CORJIT_FLG_SKIP_VERIFICATION;
+    else if ((flags & CORJIT_FLG_IMPORT_ONLY) == 0 &&
+             VerificationCache::IsMethodVerified(ftn))
+    {
+        // A previous run verified this method against the same image
+        ftn->SetIsVerified(TRUE);
+        flags |= CORJIT_FLG_SKIP_VERIFICATION;
+    }
 
 
     return (CorJitFlag)flags;
@@ -9419,9 +9479,8 @@ TADDR UnsafeJitFunction(MethodDesc* ftn, COR_ILMETHOD_DECODER* ILHeader,
         /* There is a double indirection to call compileMethod  - can we
            improve this with the new structure? */
 
-#if defined(ENABLE_PERF_COUNTERS)
         START_JIT_PERF();
-#endif
+        JIT_PERF_UPDATE_IL_CODE_SIZE(methodInfo.ILCodeSize);
 
 #if defined(ENABLE_PERF_COUNTERS)
         LARGE_INTEGER CycleStart;
@@ -9452,9 +9511,7 @@ TADDR UnsafeJitFunction(MethodDesc* ftn, COR_ILMETHOD_DECODER* ILHeader,
         GetPrivatePerfCounters().m_Jit.cbILJitted+=methodInfo.ILCodeSize;
 #endif // defined(ENABLE_PERF_COUNTERS)
 
-#if defined(ENABLE_PERF_COUNTERS)
         STOP_JIT_PERF();
-#endif
 
     }
 
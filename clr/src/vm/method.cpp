@@ -2413,7 +2413,7 @@ TADDR MethodDescChunk::AllocateCompactEntryPoints(BaseDomain* pDomain, AllocMemT
 
     SIZE_T size = SizeOfCompactEntryPoints(count);
 
-    TADDR temporaryEntryPoints = (TADDR)pamTracker->Track(pDomain->GetHighFrequencyHeap()->AllocMem(size));
+    TADDR temporaryEntryPoints = (TADDR)pamTracker->Track(pDomain->GetPrecodeHeap()->AllocMem(size));
 
     // make the temporary entrypoints unaligned, so they are easy to identify
     BYTE* p = (BYTE*)temporaryEntryPoints + 1;
@@ -373,6 +373,9 @@ void Ref_Initialize()
     g_HandleTableMap.pBuckets = pBuckets;
     g_HandleTableMap.dwMaxIndex = INITIAL_HANDLE_TABLE_ARRAY_SIZE;
     g_HandleTableMap.pNext = NULL;
+
+    // let threads cache handles
+    TableInitializeMagazines();
 }
 
 
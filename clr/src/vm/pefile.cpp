@@ -60,7 +60,7 @@ PEFile::PEFile(PEImage *identity, BOOL fCheckSecurity/*=TRUE*/) :
     m_pAssemblyImporter(NULL),
     m_pEmitter(NULL),
     m_pAssemblyEmitter(NULL),
-    m_pMetadataLock(::new SimpleRWLock(PREEMPTIVE, LOCK_TYPE_DEFAULT)),
+    m_pMetadataLock(::new SimpleRWLock(PREEMPTIVE, LOCK_TYPE_DEFAULT, TRUE)),
     m_refCount(1),
     m_hash(NULL),
     m_flags(0),
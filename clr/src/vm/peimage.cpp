@@ -1044,7 +1044,7 @@ PEImage::PEImage():
     WRAPPER_CONTRACT;
     for (DWORD i=0;i<COUNTOF(m_pLayouts);i++)
         m_pLayouts[i]=NULL ;
-    m_pLayoutLock=new SimpleRWLock(PREEMPTIVE,LOCK_TYPE_DEFAULT);
+    m_pLayoutLock=new SimpleRWLock(PREEMPTIVE,LOCK_TYPE_DEFAULT,TRUE);
 }
 
 PTR_PEImageLayout PEImage::GetLayout(DWORD imageLayoutMask,DWORD flags)
@@ -1769,15 +1769,18 @@ extern "C" {
 BitFieldOps FastInterlockOr = OrMaskGN;
 BitFieldOps FastInterlockAnd = AndMaskGN;
 
-XchgOps         FastInterlockExchange = ExchangeGN;
 XchgLongOps     FastInterlockExchangeLong = (XchgLongOps)ExchangeLongGN;
-CmpXchgOps      FastInterlockCompareExchange = (CmpXchgOps)CompareExchangeGN;
 CmpXchgLongOps  FastInterlockCompareExchangeLong = (CmpXchgLongOps)CompareExchangeLongGN;
 XchngAddOps     FastInterlockExchangeAdd = ExchangeAddGN;
 XchgAddLongOps  FastInterlockExchangeAddLong = (XchgAddLongOps)ExchangeAddLongGN;
 
+// with PAL_INLINE_INTERLOCKED these are the PAL's inline functions (util.hpp)
+#ifndef PAL_INLINE_INTERLOCKED
+XchgOps         FastInterlockExchange = ExchangeGN;
+CmpXchgOps      FastInterlockCompareExchange = (CmpXchgOps)CompareExchangeGN;
 IncDecOps   FastInterlockIncrement = IncrementGN;
 IncDecOps   FastInterlockDecrement = DecrementGN;
+#endif // !PAL_INLINE_INTERLOCKED
 IncDecLongOps    FastInterlockIncrementLong = IncrementLongGN;
 IncDecLongOps    FastInterlockDecrementLong = DecrementLongGN;
 
@@ -373,7 +373,7 @@ const BYTE* CTPMethodTable::CreateNonVirtualThunkForVirtualMethod(MethodDesc* pM
 
     // Link and produce the stub
     // FUTURE: Do we have to provide the loader heap ?
-    pStub = psl->Link(SystemDomain::System()->GetHighFrequencyHeap());
+    pStub = psl->Link(SystemDomain::System()->GetStubHeap());
 
     // Grab the offset of the RemotingLabel and RecheckLabel
     // for use in CNonVirtualThunkMgr::DoTraceStub and
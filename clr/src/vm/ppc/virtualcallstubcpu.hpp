@@ -331,7 +331,7 @@ struct ResolveHolder
 
     void  Initialize(const BYTE *resolveWorkerTarget, const BYTE* patcherTarget, 
                      size_t dispatchToken, UINT32 hashedToken,
-                     void * cacheAddr, INT32 * counterAddr,
+                     void * cacheAddr, size_t * cacheMaskAddr, INT32 * counterAddr,
                      VirtualCallStubManager::ThisCallingConvention passThis);
 
     ResolveStub* stub()      { LEAF_CONTRACT;  return &_stub; }
@@ -571,7 +571,7 @@ void ResolveHolder::InitializeStatic()
 
 void  ResolveHolder::Initialize(const BYTE *resolveWorkerTarget, const BYTE* patcherTarget, 
                                 size_t dispatchToken, UINT32 hashedToken,
-                                void * cacheAddr, INT32 * counterAddr,
+                                void * cacheAddr, size_t * cacheMaskAddr, INT32 * counterAddr,
                                 VirtualCallStubManager::ThisCallingConvention passThis)
 {
     _stub = resolveInit;
@@ -190,7 +190,7 @@ Precode* Precode::Allocate(PrecodeType t, MethodDesc* pMD, BOOL fMayHaveNativeCo
     } CONTRACTL_END;
 
     SIZE_T size = SizeOf(t) + (fMayHaveNativeCode ? sizeof(TADDR) : 0);
-    Precode* pPrecode = (Precode*)pamTracker->Track(pDomain->GetHighFrequencyHeap()->AllocAlignedMem(size, AlignOf(t), NULL));
+    Precode* pPrecode = (Precode*)pamTracker->Track(pDomain->GetPrecodeHeap()->AllocAlignedMem(size, AlignOf(t), NULL));
     pPrecode->Init(t, pMD, pDomain);
     return pPrecode;
 }
@@ -327,7 +327,9 @@ void Precode::Reset()
         return NULL;
 #endif
 
-    TADDR temporaryEntryPoints = (TADDR)pamTracker->Track(pDomain->GetHighFrequencyHeap()->AllocAlignedMem(allSize, AlignOf(t), NULL));
+    // All the entry points of the chunk are allocated in one block, so calls
+    // between methods of the same type stay within a few cache lines
+    TADDR temporaryEntryPoints = (TADDR)pamTracker->Track(pDomain->GetPrecodeHeap()->AllocAlignedMem(allSize, AlignOf(t), NULL));
 
     TADDR entryPoint = temporaryEntryPoints;
     for (int i = 0; i < count; i++)
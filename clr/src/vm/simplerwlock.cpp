@@ -27,6 +27,27 @@ BOOL SimpleRWLock::TryEnterRead()
         _ASSERTE(!GetThread() || GetThread()->PreemptiveGCDisabled());
 #endif
 
+    if (m_pReaderSlots != NULL)
+    {
+        if (m_RWLock == -1)
+            return FALSE;
+
+        volatile LONG *pcReaders = GetReaderCount();
+        InterlockedIncrement(pcReaders);
+
+        // The increment is a full barrier, so either we see the writer here,
+        // or the writer sees us when it checks for readers after setting m_RWLock.
+        if (m_RWLock == -1)
+        {
+            InterlockedDecrement(pcReaders);
+            return FALSE;
+        }
+
+        INCTHREADLOCKCOUNT();
+
+        return TRUE;
+    }
+
     LONG RWLock;
 
     do {
@@ -106,6 +127,21 @@ void SimpleRWLock::EnterRead()
     }
 }
 
+//=====================================================================        
+BOOL SimpleRWLock::ReadersPresent()
+{
+    LEAF_CONTRACT;
+
+    _ASSERTE(m_pReaderSlots != NULL);
+
+    for (DWORD i = 0; i <= m_ReaderSlotMask; i++)
+    {
+        if (m_pReaderSlots[i].m_cReaders != 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
 //=====================================================================        
 BOOL SimpleRWLock::TryEnterWrite()
 {
@@ -125,6 +161,14 @@ BOOL SimpleRWLock::TryEnterWrite()
     if( RWLock ) {
         return FALSE;
     }
+
+    // A reader biased lock keeps its readers out of m_RWLock. New readers back
+    // off now that it is set; give it up again if any are still inside.
+    if (m_pReaderSlots != NULL && ReadersPresent())
+    {
+        InterlockedExchange (&m_RWLock, 0);
+        return FALSE;
+    }
     
     INCTHREADLOCKCOUNT();
     
@@ -30,6 +30,19 @@ template BOOL CompareDefault(SimpleRWLock*,SimpleRWLock*);
 typedef Holder<SimpleRWLock*, DoNothing, DoNothing> HACKSimpleRWLockHolder;
 #endif
 
+// A reader biased lock counts its readers in one of several counters, each on
+// its own cache line, instead of in m_RWLock. Readers on different processors
+// then don't contend for the same line. Writers still own m_RWLock, and wait
+// for all the counters to drain once they have set it.
+#define SIMPLERWLOCK_MAX_READER_SLOTS   64
+#define SIMPLERWLOCK_READER_SLOT_SIZE   64
+
+struct SimpleRWLockReaderSlot
+{
+    volatile LONG       m_cReaders;
+    BYTE                m_Padding[SIMPLERWLOCK_READER_SLOT_SIZE - sizeof(LONG)];
+};
+
 class SimpleRWLock
 {
 private:
@@ -65,7 +78,31 @@ private:
     // are supposed to be rare.
     BOOL                m_WriterWaiting;
 
+    // per processor reader counts for reader biased locks, NULL otherwise
+    SimpleRWLockReaderSlot *m_pReaderSlots;
+
+    // the allocation m_pReaderSlots was aligned within
+    BYTE               *m_pReaderSlotMemory;
+
+    // number of reader counts - 1
+    DWORD               m_ReaderSlotMask;
+
 #ifndef DACCESS_COMPILE
+    // The PAL doesn't tell us which processor we're running on, so a hash of
+    // the thread id stands in for it. It must not change between entering and
+    // leaving the lock.
+    volatile LONG *GetReaderCount()
+    {
+        LEAF_CONTRACT;
+        DWORD id = GetCurrentThreadId();
+        id ^= id >> 16;
+        id *= 0x45d9f3b;
+        id ^= id >> 16;
+        return &m_pReaderSlots[id & m_ReaderSlotMask].m_cReaders;
+    }
+
+    BOOL ReadersPresent();
+
     static void AcquireReadLock(SimpleRWLock *s) { LEAF_CONTRACT; s->EnterRead(); }
     static void ReleaseReadLock(SimpleRWLock *s) { LEAF_CONTRACT; s->LeaveRead(); }
 
@@ -80,7 +117,9 @@ private:
 #endif // DACCESS_COMPILE
 
 public:
-    SimpleRWLock (GC_MODE gcMode, LOCK_TYPE locktype)
+    // fReaderBiased makes readers cheaper and writers more expensive. Use it for
+    // locks that are read on hot paths and rarely written.
+    SimpleRWLock (GC_MODE gcMode, LOCK_TYPE locktype, BOOL fReaderBiased = FALSE)
         : m_gcMode (gcMode)
     {
         CONTRACTL {
@@ -91,6 +130,30 @@ public:
         m_RWLock = 0;
         m_spinCount = (GetCurrentProcessCpuCount() == 1) ? 0 : 4000;
         m_WriterWaiting = FALSE;
+        m_pReaderSlots = NULL;
+        m_pReaderSlotMemory = NULL;
+        m_ReaderSlotMask = 0;
+
+#ifndef DACCESS_COMPILE
+        // Readers can't contend with each other on a single processor. If we can't
+        // get the memory, the lock just isn't reader biased.
+        if (fReaderBiased && GetCurrentProcessCpuCount() > 1)
+        {
+            DWORD cSlots = 1;
+            while (cSlots < (DWORD)GetCurrentProcessCpuCount() && cSlots < SIMPLERWLOCK_MAX_READER_SLOTS)
+                cSlots *= 2;
+
+            // new only guarantees pointer alignment, so allocate an extra line
+            // and start the slots on a line boundary
+            m_pReaderSlotMemory = new (nothrow) BYTE[cSlots * sizeof(SimpleRWLockReaderSlot) + SIMPLERWLOCK_READER_SLOT_SIZE - 1];
+            if (m_pReaderSlotMemory != NULL)
+            {
+                m_pReaderSlots = (SimpleRWLockReaderSlot *)ALIGN_UP(m_pReaderSlotMemory, SIMPLERWLOCK_READER_SLOT_SIZE);
+                memset(m_pReaderSlots, 0, cSlots * sizeof(SimpleRWLockReaderSlot));
+                m_ReaderSlotMask = cSlots - 1;
+            }
+        }
+#endif // DACCESS_COMPILE
     }
 #ifdef DACCESS_COMPILE
     // Special empty CTOR for DAC. We still need to assign to const fields, but they won't actually be used.
@@ -99,7 +162,14 @@ public:
     {
         LEAF_CONTRACT;
     }
-#endif
+#else // DACCESS_COMPILE
+    ~SimpleRWLock()
+    {
+        LEAF_CONTRACT;
+        if (m_pReaderSlotMemory != NULL)
+            delete [] m_pReaderSlotMemory;
+    }
+#endif // DACCESS_COMPILE
     
 #ifndef DACCESS_COMPILE
     // Acquire the reader lock.
@@ -114,8 +184,16 @@ public:
     void LeaveRead()
     {
         LEAF_CONTRACT;
-        LONG RWLock = InterlockedDecrement(&m_RWLock);
-        _ASSERTE (RWLock >= 0);
+        if (m_pReaderSlots != NULL)
+        {
+            LONG cReaders = InterlockedDecrement(GetReaderCount());
+            _ASSERTE (cReaders >= 0);
+        }
+        else
+        {
+            LONG RWLock = InterlockedDecrement(&m_RWLock);
+            _ASSERTE (RWLock >= 0);
+        }
         DECTHREADLOCKCOUNT();
     }
 
@@ -136,12 +214,16 @@ public:
     BOOL LockTaken ()
     {
         LEAF_CONTRACT;
-        return m_RWLock != 0;
+        return m_RWLock != 0 || IsReaderLock();
     }
 
     BOOL IsReaderLock ()
     {
         LEAF_CONTRACT;
+#ifndef DACCESS_COMPILE
+        if (m_pReaderSlots != NULL)
+            return ReadersPresent();
+#endif // DACCESS_COMPILE
         return m_RWLock > 0;
     }
 
@@ -43,6 +43,8 @@
 // Allocate 1 page worth. Typically enough
 #define MAXSYNCBLOCK (PAGE_SIZE-sizeof(void*))/sizeof(SyncBlock)
 #define SYNC_TABLE_INITIAL_SIZE 250
+// Upper bound on the number of per processor free lists
+#define SYNCBLOCK_MAX_FREELISTS 64
 
 //#define DUMP_SB
 
@@ -312,6 +314,8 @@ SyncBlockCache::SyncBlockCache()
       m_CacheLock("SyncBlockCache", CrstSyncBlockCache, (CrstFlags) (CRST_UNSAFE_ANYMODE | CRST_DEBUGGER_THREAD)),
       m_FreeCount(0),
       m_ActiveCount(0),
+      m_pFreeLists(0),
+      m_FreeListMask(0),
       m_SyncBlocks(0),
       m_FreeSyncBlock(0),
       m_FreeSyncTableIndex(1),
@@ -348,6 +352,10 @@ SyncBlockCache::~SyncBlockCache()
     m_FreeBlockList = NULL;
     m_pCleanupBlockList = NULL;
 
+    // The blocks on the per processor lists live in the arrays below
+    delete [] m_pFreeLists;
+    m_pFreeLists = NULL;
+
     // destruct all arrays
     while (m_SyncBlocks)
     {
@@ -584,10 +592,22 @@ void SyncBlockCache::Start()
 
     SyncTableEntry::GetSyncTableEntry() = new SyncTableEntry[SYNC_TABLE_INITIAL_SIZE+1];
 
+    // One free list per processor, rounded up to a power of 2 so that the
+    // list can be picked with a mask
+    DWORD cFreeLists = 1;
+    while (cFreeLists < g_SystemInfo.dwNumberOfProcessors && cFreeLists < SYNCBLOCK_MAX_FREELISTS)
+        cFreeLists *= 2;
+
+    SyncBlockFreeList* pFreeLists = new SyncBlockFreeList[cFreeLists];
+
+    memset (pFreeLists, 0, cFreeLists*sizeof(SyncBlockFreeList));
+
     SyncTableEntry::GetSyncTableEntry()[0].m_SyncBlock = 0;
     SyncBlockCache::GetSyncBlockCache() = new (&g_SyncBlockCacheInstance) SyncBlockCache;
 
     SyncBlockCache::GetSyncBlockCache()->m_EphemeralBitmap = bm;
+    SyncBlockCache::GetSyncBlockCache()->m_pFreeLists = pFreeLists;
+    SyncBlockCache::GetSyncBlockCache()->m_FreeListMask = cFreeLists - 1;
 }
 
 
@@ -668,8 +688,52 @@ SyncBlock* SyncBlockCache::GetNextCleanupSyncBlock()
 }
 
 
+// The per processor free lists are protected by spin locks, which are only
+// ever held for a few instructions. The cache lock must never be taken while
+// holding one.
+static FORCEINLINE void AcquireFreeListLock(SyncBlockFreeList *pList)
+{
+    LEAF_CONTRACT;
+
+    unsigned int rounds = 0;
+
+    while (pList->m_Lock != 0 || FastInterlockExchange(&pList->m_Lock, 1) != 0)
+    {
+        YieldProcessor();           // indicate to the processor that we are spinning
+
+        rounds++;
+
+        if ((rounds % 32) == 0)
+        {
+            __SwitchToThread(0);
+        }
+    }
+}
+
+static FORCEINLINE void ReleaseFreeListLock(SyncBlockFreeList *pList)
+{
+    LEAF_CONTRACT;
+
+    pList->m_Lock = 0;
+}
+
+
+// returns the free list the current thread should use. The PAL doesn't tell
+// us which processor we're running on, so the thin lock thread id stands in
+// for it; threads the runtime doesn't know about share the first list.
+SyncBlockFreeList* SyncBlockCache::GetFreeList()
+{
+    LEAF_CONTRACT;
+
+    Thread *pThread = GetThread();
+    DWORD   index = (pThread != NULL) ? (pThread->GetThreadId() & m_FreeListMask) : 0;
+
+    return &m_pFreeLists[index];
+}
+
+
 // returns and removes the next free syncblock from the list
-// the cache lock must be entered to call this
+// of the current processor, refilling it from the cache if it's empty
 SyncBlock *SyncBlockCache::GetNextFreeSyncBlock()
 {
     CONTRACTL
@@ -685,43 +749,316 @@ SyncBlock *SyncBlockCache::GetNextFreeSyncBlock()
     delete new char;
 #endif
 
-    SyncBlock       *psb;
-    SLink           *plst = m_FreeBlockList;
+    SyncBlockFreeList *pList = GetFreeList();
+    SLink             *plst = NULL;
+
+    // No need for acquiring the lock if there's nothing to remove.
+    if (pList->m_pHead != NULL)
+    {
+        AcquireFreeListLock(pList);
+
+        plst = pList->m_pHead;
+        if (plst)
+        {
+            pList->m_pHead = plst->m_pNext;
+            pList->m_Count--;
+        }
+
+        ReleaseFreeListLock(pList);
+    }
 
     COUNTER_ONLY(GetPrivatePerfCounters().m_GC.cSinkBlocks ++);
-    m_ActiveCount++;
+    COUNTER_ONLY(GetPrivatePerfCounters().m_LocksAndThreads.cSyncBlocksAllocated.Total ++);
 
-    if (plst)
-    {
-        m_FreeBlockList = m_FreeBlockList->m_pNext;
+    if (plst == NULL)
+        return RefillFreeList(pList);
 
-        // shouldn't be 0
-        m_FreeCount--;
+    // get the actual sync block pointer
+    return (SyncBlock *) (((BYTE *) plst) - offsetof(SyncBlock, m_Link));
+}
 
-        // get the actual sync block pointer
-        psb = (SyncBlock *) (((BYTE *) plst) - offsetof(SyncBlock, m_Link));
 
-        return psb;
+// takes a batch of blocks from the cache, returns one and puts the rest
+// on the given list
+SyncBlock *SyncBlockCache::RefillFreeList(SyncBlockFreeList *pList)
+{
+    CONTRACTL
+    {
+        INSTANCE_CHECK;
+        INJECT_FAULT(COMPlusThrowOM());
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_ANY;
     }
-    else
+    CONTRACTL_END;
+
+    SyncBlockArray  *newsyncblocks = NULL;
+
+    // If the cache looks like it's running out, allocate the next array
+    // before taking the lock. We check again under the lock.
+    if ((m_FreeBlockList == NULL) &&
+        ((m_SyncBlocks == NULL) || (m_FreeSyncBlock + SYNCBLOCK_FREELIST_BATCH > MAXSYNCBLOCK)))
     {
-        if ((m_SyncBlocks == NULL) || (m_FreeSyncBlock >= MAXSYNCBLOCK))
+        newsyncblocks = new(SyncBlockArray);
+        if (!newsyncblocks)
+            COMPlusThrowOM ();
+    }
+
+    SLink           *pBatch = NULL;
+    SLink           *pTail = NULL;
+    DWORD            cBatch = 0;
+
+    {
+        SyncBlockCache::LockHolder lh(this);
+
+        while (cBatch < SYNCBLOCK_FREELIST_BATCH)
         {
+            SLink   *plst = m_FreeBlockList;
+
+            if (plst)
+            {
+                m_FreeBlockList = m_FreeBlockList->m_pNext;
+
+                // shouldn't be 0
+                m_FreeCount--;
+            }
+            else
+            {
+                if ((m_SyncBlocks == NULL) || (m_FreeSyncBlock >= MAXSYNCBLOCK))
+                {
+                    // Only add an array we didn't allocate up front if
+                    // the caller would otherwise get nothing
+                    if (cBatch != 0 && newsyncblocks == NULL)
+                        break;
+
 #ifdef DUMP_SB
-//            LogSpewAlways("Allocating new syncblock array\n");
-//            DumpSyncBlockCache();
+//                    LogSpewAlways("Allocating new syncblock array\n");
+//                    DumpSyncBlockCache();
 #endif
-            SyncBlockArray* newsyncblocks = new(SyncBlockArray);
-            if (!newsyncblocks)
-                COMPlusThrowOM ();
+                    if (newsyncblocks == NULL)
+                    {
+                        newsyncblocks = new(SyncBlockArray);
+                        if (!newsyncblocks)
+                            COMPlusThrowOM ();
+                    }
 
-            newsyncblocks->m_Next = m_SyncBlocks;
-            m_SyncBlocks = newsyncblocks;
-            m_FreeSyncBlock = 0;
+                    newsyncblocks->m_Next = m_SyncBlocks;
+                    m_SyncBlocks = newsyncblocks;
+                    m_FreeSyncBlock = 0;
+                    newsyncblocks = NULL;
+                }
+                plst = &(((SyncBlock*)m_SyncBlocks->m_Blocks)[m_FreeSyncBlock++].m_Link);
+            }
+
+            m_ActiveCount++;
+
+            if (pTail == NULL)
+                pTail = plst;
+            plst->m_pNext = pBatch;
+            pBatch = plst;
+            cBatch++;
         }
-        return &(((SyncBlock*)m_SyncBlocks->m_Blocks)[m_FreeSyncBlock++]);
     }
 
+    // Somebody else refilled the cache while we were allocating
+    if (newsyncblocks)
+        delete newsyncblocks;
+
+    _ASSERTE(cBatch != 0);
+
+    SLink   *plst = pBatch;
+    pBatch = pBatch->m_pNext;
+    cBatch--;
+
+    if (pBatch != NULL)
+    {
+        AcquireFreeListLock(pList);
+
+        pTail->m_pNext = pList->m_pHead;
+        pList->m_pHead = pBatch;
+        pList->m_Count += cBatch;
+
+        ReleaseFreeListLock(pList);
+    }
+
+    // get the actual sync block pointer
+    return (SyncBlock *) (((BYTE *) plst) - offsetof(SyncBlock, m_Link));
+}
+
+
+// moves a batch of blocks from a list that grew too long back to the cache
+void SyncBlockCache::SpillFreeList(SyncBlockFreeList *pList)
+{
+    CONTRACTL
+    {
+        INSTANCE_CHECK;
+        NOTHROW;
+        GC_NOTRIGGER;
+        FORBID_FAULT;
+    }
+    CONTRACTL_END;
+
+    SLink   *pBatch;
+    SLink   *pTail = NULL;
+    DWORD    cBatch = 0;
+
+    AcquireFreeListLock(pList);
+
+    pBatch = pList->m_pHead;
+    while (cBatch < SYNCBLOCK_FREELIST_BATCH && pList->m_pHead != NULL)
+    {
+        pTail = pList->m_pHead;
+        pList->m_pHead = pTail->m_pNext;
+        cBatch++;
+    }
+    pList->m_Count -= cBatch;
+
+    ReleaseFreeListLock(pList);
+
+    if (cBatch == 0)
+        return;
+
+    {
+        SyncBlockCache::LockHolder lh(this);
+
+        pTail->m_pNext = m_FreeBlockList;
+        m_FreeBlockList = pBatch;
+
+        m_ActiveCount -= cBatch;
+        m_FreeCount += cBatch;
+    }
+}
+
+
+// Computes the size of the next synctable. Normally, we double it - unless
+// doing so would create slots with indices too high to fit within the
+// mask. If so, we create a synctable up to the mask limit. If we're
+// already at the mask limit, then caller is out of luck.
+DWORD SyncBlockCache::GetGrownSyncTableSize()
+{
+    CONTRACTL
+    {
+        INSTANCE_CHECK;
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_ANY;
+        INJECT_FAULT(COMPlusThrowOM(););
+    }
+    CONTRACTL_END;
+
+    DWORD newSyncTableSize;
+    if (m_SyncTableSize <= (MASK_SYNCBLOCKINDEX >> 1))
+    {
+        newSyncTableSize = m_SyncTableSize * 2;
+    }
+    else
+    {
+        newSyncTableSize = MASK_SYNCBLOCKINDEX;
+    }
+
+    if (!(newSyncTableSize > m_SyncTableSize)) // Make sure we actually found room to grow!
+    {
+        COMPlusThrowOM();
+    }
+
+    return newSyncTableSize;
+}
+
+
+// Replaces the synctable and the ephemeral bitmap with the given zeroed ones.
+// The entries are copied under the cache lock, since that's where they are set.
+void SyncBlockCache::InstallSyncTable(DWORD newSyncTableSize, SyncTableEntry *newSyncTable, DWORD *newBitMap)
+{
+    CONTRACTL
+    {
+        INSTANCE_CHECK;
+        NOTHROW;
+        GC_NOTRIGGER;
+        FORBID_FAULT;
+        PRECONDITION(newSyncTableSize > m_SyncTableSize);
+    }
+    CONTRACTL_END;
+
+    DWORD*         oldBitMap;
+
+    // We chain old table because we can't delete
+    // them before all the threads are stoppped
+    // (next GC)
+    SyncTableEntry::GetSyncTableEntry() [0].m_Object = (Object *)m_OldSyncTables;
+    m_OldSyncTables = SyncTableEntry::GetSyncTableEntry();
+
+    CopyMemory (newSyncTable, SyncTableEntry::GetSyncTableEntry(),
+                m_SyncTableSize*sizeof (SyncTableEntry));
+
+    CopyMemory (newBitMap, m_EphemeralBitmap,
+                BitMapSize (m_SyncTableSize)*sizeof (DWORD));
+
+    oldBitMap = m_EphemeralBitmap;
+    m_EphemeralBitmap = newBitMap;
+    delete[] oldBitMap;
+
+    _ASSERTE((m_SyncTableSize & MASK_SYNCBLOCKINDEX) == m_SyncTableSize);
+    FastInterlockExchangePointer((void**)&SyncTableEntry::GetSyncTableEntry(),newSyncTable);
+
+    m_SyncTableSize = newSyncTableSize;
+
+#ifdef _DEBUG
+    static int dumpSBOnResize = -1;
+
+    if (dumpSBOnResize == -1)
+        dumpSBOnResize = g_pConfig->GetConfigDWORD(L"SBDumpOnResize", 0);
+
+    if (dumpSBOnResize)
+    {
+        LogSpewAlways("SyncBlockCache resized\n");
+        DumpSyncBlockCache();
+    }
+#endif
+}
+
+
+// Grows the synctable if the next NewSyncBlockSlot would have to. Allocating
+// and clearing the new table is done before taking the cache lock, so that
+// other threads inflating sync blocks don't wait on it. If somebody else
+// grew the table in the meantime, ours is thrown away.
+void SyncBlockCache::GrowSyncTableIfFull()
+{
+    CONTRACTL
+    {
+        INSTANCE_CHECK;
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_ANY;
+        INJECT_FAULT(COMPlusThrowOM(););
+    }
+    CONTRACTL_END;
+
+    DWORD oldSyncTableSize = m_SyncTableSize;
+
+    if (m_FreeSyncTableList || (m_FreeSyncTableIndex < oldSyncTableSize))
+        return;
+
+    DWORD newSyncTableSize = GetGrownSyncTableSize();
+
+    NewArrayHolder<SyncTableEntry> newSyncTable (new(SyncTableEntry[newSyncTableSize]));
+    NewArrayHolder<DWORD>          newBitMap    (new(DWORD[BitMapSize (newSyncTableSize)]));
+
+    memset (newSyncTable, 0, newSyncTableSize*sizeof (SyncTableEntry));
+    memset (newBitMap, 0, BitMapSize (newSyncTableSize)*sizeof (DWORD));
+
+    SyncBlockCache::LockHolder lh(this);
+
+    if ((m_SyncTableSize == oldSyncTableSize) &&
+        (m_FreeSyncTableList == 0) &&
+        (m_FreeSyncTableIndex >= m_SyncTableSize))
+    {
+        STRESS_LOG0(LF_SYNC, LL_INFO10000, "SyncBlockCache::GrowSyncTableIfFull growing SyncBlockCache \n");
+
+        newSyncTable.SuppressRelease();
+        newBitMap.SuppressRelease();
+
+        InstallSyncTable(newSyncTableSize, newSyncTable, newBitMap);
+    }
 }
 
 
@@ -747,33 +1084,13 @@ DWORD SyncBlockCache::NewSyncBlockSlot(Object *obj)
     else if ((indexNewEntry = (DWORD)(m_FreeSyncTableIndex)) >= m_SyncTableSize)
     {
         STRESS_LOG0(LF_SYNC, LL_INFO10000, "SyncBlockCache::NewSyncBlockSlot growing SyncBlockCache \n");
-        
-        NewArrayHolder<SyncTableEntry> newSyncTable (NULL);
-        NewArrayHolder<DWORD>          newBitMap    (NULL);
-        DWORD*         oldBitMap;
-
-        // Compute the size of the new synctable. Normally, we double it - unless
-        // doing so would create slots with indices too high to fit within the
-        // mask. If so, we create a synctable up to the mask limit. If we're
-        // already at the mask limit, then caller is out of luck.
-        DWORD newSyncTableSize;
-        if (m_SyncTableSize <= (MASK_SYNCBLOCKINDEX >> 1))
-        {
-            newSyncTableSize = m_SyncTableSize * 2;
-        }
-        else
-        {
-            newSyncTableSize = MASK_SYNCBLOCKINDEX;
-        }
 
-        if (!(newSyncTableSize > m_SyncTableSize)) // Make sure we actually found room to grow!
-        {
-            COMPlusThrowOM();
-        }
-
-        newSyncTable = new(SyncTableEntry[newSyncTableSize]);
-        newBitMap = new(DWORD[BitMapSize (newSyncTableSize)]);
+        // Callers normally grow the table with GrowSyncTableIfFull before
+        // taking the cache lock; we only get here if they lost a race.
+        DWORD newSyncTableSize = GetGrownSyncTableSize();
 
+        NewArrayHolder<SyncTableEntry> newSyncTable (new(SyncTableEntry[newSyncTableSize]));
+        NewArrayHolder<DWORD>          newBitMap    (new(DWORD[BitMapSize (newSyncTableSize)]));
 
         {
             //! From here on, we assume that we will succeed and start doing global side-effects.
@@ -784,44 +1101,12 @@ DWORD SyncBlockCache::NewSyncBlockSlot(Object *obj)
             newSyncTable.SuppressRelease();
             newBitMap.SuppressRelease();
 
-
-            // We chain old table because we can't delete
-            // them before all the threads are stoppped
-            // (next GC)
-            SyncTableEntry::GetSyncTableEntry() [0].m_Object = (Object *)m_OldSyncTables;
-            m_OldSyncTables = SyncTableEntry::GetSyncTableEntry();
-
             memset (newSyncTable, 0, newSyncTableSize*sizeof (SyncTableEntry));
             memset (newBitMap, 0, BitMapSize (newSyncTableSize)*sizeof (DWORD));
-            CopyMemory (newSyncTable, SyncTableEntry::GetSyncTableEntry(),
-                        m_SyncTableSize*sizeof (SyncTableEntry));
 
-            CopyMemory (newBitMap, m_EphemeralBitmap,
-                        BitMapSize (m_SyncTableSize)*sizeof (DWORD));
-
-            oldBitMap = m_EphemeralBitmap;
-            m_EphemeralBitmap = newBitMap;
-            delete[] oldBitMap;
-
-            _ASSERTE((m_SyncTableSize & MASK_SYNCBLOCKINDEX) == m_SyncTableSize);
-            FastInterlockExchangePointer((void**)&SyncTableEntry::GetSyncTableEntry(),newSyncTable);
+            InstallSyncTable(newSyncTableSize, newSyncTable, newBitMap);
 
             m_FreeSyncTableIndex++;
-
-            m_SyncTableSize = newSyncTableSize;
-
-#ifdef _DEBUG
-            static int dumpSBOnResize = -1;
-
-            if (dumpSBOnResize == -1)
-                dumpSBOnResize = g_pConfig->GetConfigDWORD(L"SBDumpOnResize", 0);
-
-            if (dumpSBOnResize)
-            {
-                LogSpewAlways("SyncBlockCache resized\n");
-                DumpSyncBlockCache();
-            }
-#endif
         }
     }
     else
@@ -872,16 +1157,13 @@ void SyncBlockCache::DeleteSyncBlock(SyncBlock *psb)
     // operator delete).
     delete psb;
 
-    //synchronizer with the consumers,
-    {
-        SyncBlockCache::LockHolder lh(this);
-
-        DeleteSyncBlockMemory(psb);
-    }
+    // The memory goes to the list of the current processor, which only
+    // takes the cache lock once per batch
+    DeleteSyncBlockMemory(psb);
 }
 
 
-// returns the sync block memory to the free pool but does not destruct sync block (must own cache lock already)
+// returns the sync block memory to the free pool but does not destruct sync block (must not own cache lock)
 void    SyncBlockCache::DeleteSyncBlockMemory(SyncBlock *psb)
 {
     CONTRACTL
@@ -894,13 +1176,20 @@ void    SyncBlockCache::DeleteSyncBlockMemory(SyncBlock *psb)
     CONTRACTL_END
 
     COUNTER_ONLY(GetPrivatePerfCounters().m_GC.cSinkBlocks --);
+    COUNTER_ONLY(GetPrivatePerfCounters().m_LocksAndThreads.cSyncBlocksReclaimed.Total ++);
 
-    m_ActiveCount--;
-    m_FreeCount++;
+    SyncBlockFreeList *pList = GetFreeList();
 
-    psb->m_Link.m_pNext = m_FreeBlockList;
-    m_FreeBlockList = &psb->m_Link;
+    AcquireFreeListLock(pList);
+
+    psb->m_Link.m_pNext = pList->m_pHead;
+    pList->m_pHead = &psb->m_Link;
+    DWORD count = ++pList->m_Count;
+
+    ReleaseFreeListLock(pList);
 
+    if (count > SYNCBLOCK_FREELIST_MAX)
+        SpillFreeList(pList);
 }
 
 // free a used sync block
@@ -920,6 +1209,7 @@ void SyncBlockCache::GCDeleteSyncBlock(SyncBlock *psb)
     delete psb;
 
     COUNTER_ONLY(GetPrivatePerfCounters().m_GC.cSinkBlocks --);
+    COUNTER_ONLY(GetPrivatePerfCounters().m_LocksAndThreads.cSyncBlocksReclaimed.Total ++);
 
 
     m_ActiveCount--;
@@ -1813,6 +2103,9 @@ DWORD ObjHeader::GetSyncBlockIndex()
         }
         else
         {
+            // Make sure there's a free slot before taking the lock
+            SyncBlockCache::GetSyncBlockCache()->GrowSyncTableIfFull();
+
             //Need to get it from the cache
             SyncBlockCache::LockHolder lh(SyncBlockCache::GetSyncBlockCache());
 
@@ -1971,7 +2264,7 @@ BOOL ObjHeader::Validate (BOOL bVerifySyncBlkIndex)
 
 // This holder takes care of the SyncBlock memory cleanup if an OOM occurs inside a call to NewSyncBlockSlot.
 //
-// Warning: Assumes you already own the cache lock.
+// Warning: Assumes you don't own the cache lock when it releases.
 //          Assumes nothing allocated inside the SyncBlock (only releases the memory, does not destruct.)
 //
 // This holder really just meets GetSyncBlock()'s special needs. It's not a general purpose holder.
@@ -2012,16 +2305,21 @@ SyncBlock *ObjHeader::GetSyncBlock()
 
     //Need to get it from the cache
     {
-        SyncBlockCache::LockHolder lh(SyncBlockCache::GetSyncBlockCache());
+        // Get the memory and a free slot before taking the lock. The holder
+        // is declared first so that it gives the memory back after the lock
+        // is released.
+        SyncBlockMemoryHolder syncBlockMemoryHolder(SyncBlockCache::GetSyncBlockCache()->GetNextFreeSyncBlock());
+        syncBlock = syncBlockMemoryHolder;
 
-        //Try one more time
-        syncBlock = GetBaseObject()->PassiveGetSyncBlock();
-        if (syncBlock)
-            RETURN syncBlock;
+        if (GetHeaderSyncBlockIndex() == 0)
+            SyncBlockCache::GetSyncBlockCache()->GrowSyncTableIfFull();
 
+        SyncBlockCache::LockHolder lh(SyncBlockCache::GetSyncBlockCache());
 
-        SyncBlockMemoryHolder syncBlockMemoryHolder(SyncBlockCache::GetSyncBlockCache()->GetNextFreeSyncBlock());
-        syncBlock = syncBlockMemoryHolder;
+        //Try one more time
+        SyncBlock *psbExisting = GetBaseObject()->PassiveGetSyncBlock();
+        if (psbExisting)
+            RETURN psbExisting;
 
         if ((indx = GetHeaderSyncBlockIndex()) == 0)
         {
@@ -2472,6 +2770,8 @@ BOOL AwareLock::EnterEpilog(Thread* pCurThread, INT32 timeOut)
     DWORD ret = 0;
     BOOL finished = false;
     ULONGLONG start, end, duration;
+    DWORD wakeups = 0;
+    BOOL fStarving = FALSE;
 
     // Require all callers to be in cooperative mode.  If they have switched to preemptive
     // mode temporarily before calling here, then they are responsible for protecting
@@ -2483,6 +2783,8 @@ BOOL AwareLock::EnterEpilog(Thread* pCurThread, INT32 timeOut)
     // We cannot allow the AwareLock to be cleaned up underneath us by the GC.
     IncrementTransientPrecious();
 
+    m_dwWaitCount++;
+
     GCPROTECT_BEGIN(obj);
     {
         if (!m_SemEvent.IsMonitorEventAllocated())
@@ -2536,11 +2838,21 @@ BOOL AwareLock::EnterEpilog(Thread* pCurThread, INT32 timeOut)
                     }
                     // And signal the next waiter, else they'll wait forever.
                     m_SemEvent.Set();
+
+                    if (fStarving)
+                    {
+                        m_WaiterStarving = 0;
+                    }
                 }
             } EE_END_FINALLY;
 
             if (ret == WAIT_OBJECT_0)
             {
+                // Let the next release wake another waiter. This has to happen
+                // before we look at the lock: if we lose it to a spinning thread,
+                // its release must wake us again.
+                FastInterlockExchange((LONG*)&m_WaiterWoken, 0);
+
                 // Attempt to acquire lock (this also involves decrementing the waiter count).
                 for (;;) 
                 {
@@ -2556,6 +2868,13 @@ BOOL AwareLock::EnterEpilog(Thread* pCurThread, INT32 timeOut)
                         break;
                     }
                 }
+
+                // Spinning threads keep taking the lock before we get to run.
+                // Make them queue up behind us.
+                if (!finished && ++wakeups >= AWARELOCK_STARVATION_WAKEUPS && !fStarving)
+                {
+                    fStarving = (FastInterlockCompareExchange((LONG*)&m_WaiterStarving, 1, 0) == 0);
+                }
             }
             else
             {
@@ -2578,6 +2897,11 @@ BOOL AwareLock::EnterEpilog(Thread* pCurThread, INT32 timeOut)
             }
         }
 
+        if (fStarving)
+        {
+            m_WaiterStarving = 0;
+        }
+
         pCurThread->DisablePreemptiveGC();
     }
     GCPROTECT_END();
@@ -2673,6 +2997,7 @@ bool AwareLock::Contention(INT32 timeOut)
         startTime = GetTickCount();
 
     COUNTER_ONLY(GetPrivatePerfCounters().m_LocksAndThreads.cContention++);
+    m_dwContentionCount++;
 
     if ( ETW_IS_TRACE_ON(TRACE_LEVEL_INFORMATION) ) 
     {
@@ -2691,7 +3016,23 @@ bool AwareLock::Contention(INT32 timeOut)
     {
         GCX_PREEMP();
 
-        // Try spinning and yielding before eventually blocking.
+        if (TryEnter())
+        {
+            pCurThread->DisablePreemptiveGC();
+            bEntered = true;
+            goto entered;
+        }
+
+        // Try spinning and yielding before eventually blocking. How long we spin
+        // depends on how long spinning took when it last got this lock, see
+        // GetSpinLimit. We stop early when a waiter is starving.
+        DWORD spinLimit = GetSpinLimit();
+        DWORD spun = 0;
+
+        // Snapshot of the owner, only ever compared. The owner may release the
+        // lock and exit at any time, so its Thread must not be dereferenced here.
+        Thread *pSpinOwner = m_HoldingThread;
+
         // The limit of 10 is largely arbitrary - feel free to tune if you have evidence
         // you're making things better                        
         for (int iter = 0; iter < 10; iter++)
@@ -2699,8 +3040,12 @@ bool AwareLock::Contention(INT32 timeOut)
             DWORD i = 50;
             do
             {
-                if (TryEnter())
+                if (SpinTryEnter(pCurThread))
                 {
+                    // Move the average a quarter of the way towards this spin
+                    m_dwSpinAverage = (3 * m_dwSpinAverage + spun) / 4;
+                    m_dwSpinAcquireCount++;
+
                     pCurThread->DisablePreemptiveGC();
                     bEntered = true;
                     goto entered;
@@ -2714,6 +3059,11 @@ bool AwareLock::Contention(INT32 timeOut)
                 if (timeOut != (INT32)INFINITE && GetTickCount() - startTime >= (DWORD)timeOut)
                     break;
 
+                if (spun >= spinLimit || m_WaiterStarving)
+                {
+                    goto doneSpinning;
+                }
+
                 // Delay by approximately 2*i clock cycles (Pentium III).
                 // This is brittle code - future processors may of course execute this
                 // faster or slower, and future code generators may eliminate the loop altogether.
@@ -2732,6 +3082,7 @@ bool AwareLock::Contention(INT32 timeOut)
                     static char dummy;
                     dummy++;
                 }
+                spun += i;
 
                 // exponential backoff: wait 3 times as long in the next iteration
                 i = i*3;
@@ -2745,6 +3096,16 @@ bool AwareLock::Contention(INT32 timeOut)
 
             __SwitchToThread(0);
         }
+
+doneSpinning:
+        // The thread that held the lock when we started still holds it, so the
+        // lock is held for longer than we spin and spinning does not pay off for
+        // it right now. Spin less next time. If the lock changed hands and we
+        // just lost the race for it, the spin length was about right.
+        if (spun >= spinLimit && pSpinOwner != NULL && m_HoldingThread == pSpinOwner)
+        {
+            m_dwSpinAverage /= 2;
+        }
     }
 entered: ;
     GCPROTECT_END();
@@ -2761,6 +3122,50 @@ entered: ;
     return bEntered;
 }
 
+// Returns how long Contention spins for this lock, in YieldProcessor calls
+DWORD AwareLock::GetSpinLimit()
+{
+    LEAF_CONTRACT;
+
+    DWORD limit = AWARELOCK_SPIN_MIN + 2 * m_dwSpinAverage;
+    return min(limit, AWARELOCK_SPIN_MAX);
+}
+
+// Takes the lock for a thread spinning in Contention. Unlike TryEnter this
+// takes it past waiters whenever it is free, so the lock does not sit idle
+// while a woken waiter is being scheduled, unless a waiter is starving.
+BOOL AwareLock::SpinTryEnter(Thread *pCurThread)
+{
+    LEAF_CONTRACT;
+
+    for (;;)
+    {
+        LONG state = m_MonitorHeld;
+
+        if ((state & 1) || (state != 0 && m_WaiterStarving))
+        {
+            return FALSE;
+        }
+
+        if (FastInterlockCompareExchange((LONG*)&m_MonitorHeld, (state | 1), state) == state)
+        {
+            break;
+        }
+    }
+
+    m_HoldingThread = pCurThread;
+    m_Recursion = 1;
+    pCurThread->IncLockCount();
+
+#if defined(_DEBUG) && defined(TRACK_SYNC)
+    // The best place to grab this is from the ECall frame
+    Frame   *pFrame = pCurThread->GetFrame();
+    int      caller = (pFrame && pFrame != FRAME_TOP ? (int) pFrame->GetReturnAddress() : -1);
+    pCurThread->m_pTrackSync->EnterSync(caller, this);
+#endif
+
+    return TRUE;
+}
 
 LONG AwareLock::LeaveCompletely()
 {
@@ -163,6 +163,17 @@ class AppDomain;
 // Spin for about 1000 cycles before waiting longer.
 #define     BIT_SBLK_SPIN_COUNT         1000
 
+// Bounds on how long AwareLock::Contention spins, in YieldProcessor calls.
+// Within them each lock spins about twice as long as spinning took when it
+// last paid off, see AwareLock::GetSpinLimit.
+#define     AWARELOCK_SPIN_MIN          1000
+#define     AWARELOCK_SPIN_MAX          500000
+#define     AWARELOCK_SPIN_INITIAL      10000
+
+// A waiter that was woken this many times and found the lock taken each time
+// stops threads from spinning for the lock until it gets it.
+#define     AWARELOCK_STARVATION_WAKEUPS    2
+
 // The GC is highly dependent on SIZE_OF_OBJHEADER being exactly the sizeof(ObjHeader)
 // We define this macro so that the preprocessor can calculate padding structures.
 #define SIZEOF_OBJHEADER    4
@@ -198,6 +209,25 @@ public:
 
     CLREvent        m_SemEvent;
 
+    // Set while a waiter has been woken and has not tried for the lock yet.
+    // Signal does not wake another waiter in the meantime.
+    volatile LONG   m_WaiterWoken;
+
+    // Set by a waiter that keeps losing the lock to spinning threads, see
+    // AWARELOCK_STARVATION_WAKEUPS. Spinners only take the lock past waiters
+    // while this is clear.
+    volatile LONG   m_WaiterStarving;
+
+    // Moving average of how long spinning took when it got the lock, in
+    // YieldProcessor calls. It stands in for how long the lock is held.
+    DWORD           m_dwSpinAverage;
+
+    // Contention statistics for SOS !syncblk. They are updated without
+    // interlocked operations, so they can be a little off.
+    DWORD           m_dwContentionCount;    // entries into Contention
+    DWORD           m_dwSpinAcquireCount;   // of those, lock taken while spinning
+    DWORD           m_dwWaitCount;          // waits on m_SemEvent
+
     // Only SyncBlocks can create AwareLocks.  Hence this private constructor.
     AwareLock(DWORD indx)
         : m_MonitorHeld(0),
@@ -207,7 +237,13 @@ public:
           m_HoldingThread(NULL),
 #endif // DACCESS_COMPILE          
           m_TransientPrecious(0),
-          m_dwSyncIndex(indx)
+          m_dwSyncIndex(indx),
+          m_WaiterWoken(0),
+          m_WaiterStarving(0),
+          m_dwSpinAverage(AWARELOCK_SPIN_INITIAL),
+          m_dwContentionCount(0),
+          m_dwSpinAcquireCount(0),
+          m_dwWaitCount(0)
     {
         LEAF_CONTRACT;
     }
@@ -246,7 +282,12 @@ public:
     void    Signal()
     {
         WRAPPER_CONTRACT;
-        
+
+        // Wake one waiter at a time. Until the woken one has tried for the lock,
+        // waking more only adds threads that fight over it.
+        if (FastInterlockCompareExchange((LONG*)&m_WaiterWoken, 1, 0) != 0)
+            return;
+
         // CLREvent::SetMonitorEvent works even if the event has not been intialized yet
         m_SemEvent.SetMonitorEvent();
     }
@@ -283,6 +324,14 @@ public:
         LEAF_CONTRACT;
         return m_HoldingThread;
     }
+
+    DWORD   GetContentionCount()    { LEAF_CONTRACT; return m_dwContentionCount; }
+    DWORD   GetSpinAcquireCount()   { LEAF_CONTRACT; return m_dwSpinAcquireCount; }
+    DWORD   GetWaitCount()          { LEAF_CONTRACT; return m_dwWaitCount; }
+
+  private:
+    DWORD   GetSpinLimit();
+    BOOL    SpinTryEnter(Thread *pCurThread);
 };
 
 
@@ -663,6 +712,23 @@ class SyncTableEntry
 };
 
 
+// Besides the global free list, free sync blocks are kept in a few small
+// lists, one per processor, each with its own spin lock. Inflating a monitor
+// takes a block from the list of the current thread and only needs the cache
+// lock to hand out a table slot. The lists trade blocks with the global list
+// in batches, so freeing many blocks (e.g. on the finalizer thread) takes the
+// cache lock once per batch.
+#define SYNCBLOCK_FREELIST_MAX      32      // most blocks a list keeps
+#define SYNCBLOCK_FREELIST_BATCH    16      // blocks moved to or from the global list at a time
+
+struct SyncBlockFreeList
+{
+    volatile LONG   m_Lock;                 // spin lock
+    DWORD           m_Count;                // number of blocks in the list
+    SLink*          m_pHead;                // first free block
+    BYTE            m_Padding[64 - sizeof(LONG) - sizeof(DWORD) - sizeof(SLink*)];
+};
+
 // this class stores free sync blocks after they're allocated and
 // unused
 
@@ -681,8 +747,10 @@ class SyncBlockCache
     PTR_SLink   m_pCleanupBlockList;    // list of sync blocks that need cleanup
     SLink*      m_FreeBlockList;        // list of free sync blocks
     Crst        m_CacheLock;            // cache lock
-    DWORD       m_FreeCount;            // count of active sync blocks
-    DWORD       m_ActiveCount;          // number active
+    DWORD       m_FreeCount;            // count of sync blocks on the global free list
+    DWORD       m_ActiveCount;          // number given out to objects or to the per processor lists
+    SyncBlockFreeList *m_pFreeLists;    // per processor lists of free sync blocks
+    DWORD       m_FreeListMask;         // number of per processor lists - 1
     SyncBlockArray *m_SyncBlocks;       // Array of new SyncBlocks.
     DWORD       m_FreeSyncBlock;        // Next Free Syncblock in the array
     DWORD       m_FreeSyncTableIndex;   // free index in the SyncBlocktable
@@ -695,6 +763,14 @@ class SyncBlockCache
 
     BOOL        GCWeakPtrScanElement(int elindex, HANDLESCANPROC scanProc, LPARAM lp1, LPARAM lp2, BOOL& cleanup);
 
+    SyncBlockFreeList* GetFreeList();
+    SyncBlock* RefillFreeList(SyncBlockFreeList *pList);
+    void    SpillFreeList(SyncBlockFreeList *pList);
+
+    DWORD   GetGrownSyncTableSize();
+    // replaces the sync table with a bigger, zeroed one (must own cache lock)
+    void    InstallSyncTable(DWORD newSyncTableSize, SyncTableEntry *newSyncTable, DWORD *newBitMap);
+
     void SetCard (size_t card);
     void ClearCard (size_t card);
     BOOL CardSetP (size_t card);
@@ -726,7 +802,7 @@ class SyncBlockCache
     static void Start();
     static void Stop();
 
-    // returns and removes next from free list
+    // returns and removes next from free list, no need to own the cache lock
     SyncBlock* GetNextFreeSyncBlock();
     // returns and removes the next from cleanup list
     SyncBlock* GetNextCleanupSyncBlock();
@@ -736,10 +812,14 @@ class SyncBlockCache
     // Obtain a new syncblock slot in the SyncBlock table. Used as a hash code
     DWORD   NewSyncBlockSlot(Object *obj);
 
+    // Grows the SyncBlock table if it's full, so that NewSyncBlockSlot doesn't
+    // have to allocate the new table while holding the cache lock
+    void    GrowSyncTableIfFull();
+
     // return sync block to cache or delete
     void    DeleteSyncBlock(SyncBlock *sb);
 
-    // returns the sync block memory to the free pool but does not destruct sync block (must own cache lock already)
+    // returns the sync block memory to the free pool but does not destruct sync block (must not own cache lock)
     void    DeleteSyncBlockMemory(SyncBlock *sb);
 
     // return sync block to cache or delete, called from GC
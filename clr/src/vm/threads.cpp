@@ -87,6 +87,7 @@ CLREvent *ThreadStore::s_pWaitForStackCrawlEvent;
 
 CLREvent* ThreadStore::s_hAbortEvt = NULL;
 CLREvent* ThreadStore::s_hAbortEvtCache = NULL;
+BOOL ThreadStore::s_fPollForGCSuspend = FALSE;
 
 BOOL Thread::s_fCleanFinalizedThread = FALSE;
 
@@ -6413,7 +6414,8 @@ ThreadStore::ThreadStore()
              m_PendingThreadCount(0),
              m_DeadThreadCount(0),
              m_GuidCreated(FALSE),
-             m_HoldingThread(0)
+             m_HoldingThread(0),
+             m_SuspendCount(0)
 {
     CONTRACTL {
         THROWS;
@@ -6421,6 +6423,8 @@ ThreadStore::ThreadStore()
     }
     CONTRACTL_END;
 
+    ZeroMemory(m_SuspendHistogram, sizeof(m_SuspendHistogram));
+
     m_TerminationEvent.CreateManualEvent(FALSE);
     _ASSERTE(m_TerminationEvent.IsValid());
 }
@@ -6451,6 +6455,43 @@ void ThreadStore::InitThreadStore()
 
     s_pWaitForStackCrawlEvent = new CLREvent();
     s_pWaitForStackCrawlEvent->CreateManualEvent(FALSE);
+
+    s_fPollForGCSuspend = (EEConfig::GetConfigDWORD(L"GCPollSuspend", 0) != 0);
+}
+
+void ThreadStore::RecordSuspendTime(LARGE_INTEGER start)
+{
+    CONTRACTL {
+        NOTHROW;
+        GC_NOTRIGGER;
+    }
+    CONTRACTL_END;
+
+    _ASSERTE(HoldingThreadStore() || g_fProcessDetach);
+
+    static LONGLONG s_TicksPerMicrosecond = 0;
+
+    if (s_TicksPerMicrosecond == 0)
+    {
+        LARGE_INTEGER frequency;
+        if (QueryPerformanceFrequency(&frequency) && frequency.QuadPart >= 1000 * 1000)
+            s_TicksPerMicrosecond = frequency.QuadPart / (1000 * 1000);
+        else
+            s_TicksPerMicrosecond = 1;
+    }
+
+    LARGE_INTEGER now;
+    if (!QueryPerformanceCounter(&now) || now.QuadPart < start.QuadPart)
+        return;
+
+    ULONGLONG microseconds = (now.QuadPart - start.QuadPart) / s_TicksPerMicrosecond;
+
+    int bucket = 0;
+    while (bucket < SUSPEND_HISTOGRAM_BUCKETS - 1 && (microseconds >> (bucket + 1)) != 0)
+        bucket++;
+
+    m_SuspendHistogram[bucket]++;
+    m_SuspendCount++;
 }
 
 extern void WaitForEndOfShutdown();
@@ -8105,6 +8146,17 @@ HRESULT Thread::SysSuspendForGC(GCHeap::SUSPEND_REASON reason)
 
         // Threads can be in Preemptive or Cooperative GC mode.  Threads cannot switch
         // to Cooperative mode without special treatment when a GC is happening.
+        if (thread->m_fPreemptiveGCDisabled && ThreadStore::s_fPollForGCSuspend)
+        {
+            // The thread stops by itself at its next poll.  If it is leaving
+            // cooperative mode instead, pass 2 sees that.
+            FastInterlockOr((ULONG *) &thread->m_State, TS_GCSuspendPending);
+
+            countThreads++;
+
+            STRESS_LOG1(LF_SYNC, LL_INFO1000, "    Thread 0x%x is in cooperative and will poll\n", thread);
+        }
+        else
         if (thread->m_fPreemptiveGCDisabled)
         {
             // Check a little more carefully.  Threads might sneak out without telling
@@ -8357,6 +8409,12 @@ HRESULT Thread::SysSuspendForGC(GCHeap::SUSPEND_REASON reason)
                     continue;
                 }
 
+                // Polling threads are not nudged, they only have to get to a poll
+                if (ThreadStore::s_fPollForGCSuspend)
+                {
+                    continue;
+                }
+
                 // We can not allocate memory after we suspend a thread.
                 // Otherwise, we may deadlock the process when CLR is hosted.
                 ThreadStore::AllocateOSContext();
@@ -3159,6 +3159,25 @@ public:
         return m_pUnsharedStaticData;
     }
 
+#ifndef DACCESS_COMPILE
+    // Returns the thread static storage of a class in the current domain, or
+    // NULL if the thread has not used the class's thread statics since it
+    // entered the domain. Only the tables cached for the current domain are
+    // looked at, so this is a few loads off the Thread with no hash lookup.
+    // The jit helpers use it and fall back to GetStaticFieldAddress, which
+    // fills in the cached tables. dwClassOffset is -1 while unassigned.
+    inline BYTE *GetThreadStaticsBaseNoCreate(BOOL fIsShared, DWORD dwClassOffset)
+    {
+        LEAF_CONTRACT;
+
+        STATIC_DATA *pData = fIsShared ? m_pSharedStaticData : m_pUnsharedStaticData;
+        if (pData == NULL || dwClassOffset >= pData->cElem)
+            return NULL;
+
+        return (BYTE *)pData->dataPtr[dwClassOffset];
+    }
+#endif // !DACCESS_COMPILE
+
     void SetName(__in_ecount(length) WCHAR* name, DWORD length);
 
 protected:
@@ -3801,6 +3820,9 @@ typedef SList<Thread, offsetof(Thread, m_LinkStore), false, PTR_Thread> ThreadLi
 #define CHECK_ONE_STORE()       _ASSERTE(this == ThreadStore::s_pThreadStore);
 
 typedef DPTR(class ThreadStore) PTR_ThreadStore;
+
+#define SUSPEND_HISTOGRAM_BUCKETS   16
+
 typedef DPTR(class ExceptionTracker) PTR_ExceptionTracker;
 
 class ThreadStore
@@ -3888,6 +3910,15 @@ public:
     static CLREvent *s_hAbortEvt;
     static CLREvent *s_hAbortEvtCache;
 
+    // With COMPlus_GCPollSuspend set, SysSuspendForGC does not OS suspend threads
+    // running managed code.  It marks them and waits for them to reach one of the
+    // polls the jit emits at loop back edges and method entries.
+    static BOOL s_fPollForGCSuspend;
+
+    // Adds the time since start (a QueryPerformanceCounter value) to the
+    // time-to-suspend histogram.  Called with the thread store lock held.
+    void RecordSuspendTime(LARGE_INTEGER start);
+
     Crst *GetDLSHashCrst()
     {
         LEAF_CONTRACT;
@@ -3988,6 +4019,13 @@ private:
     Thread     *m_HoldingThread;
     EEThreadId  m_holderthreadid;   // current holder (or NULL)
 
+    // Successful SuspendEE calls, by the time from trapping returning threads
+    // to having all of them stopped.  Bucket 0 counts the ones under 2
+    // microseconds, bucket i those from 2^i up to 2^(i+1) microseconds, and
+    // the last bucket everything longer.
+    DWORD       m_SuspendCount;
+    DWORD       m_SuspendHistogram[SUSPEND_HISTOGRAM_BUCKETS];
+
 public:
 
     static BOOL HoldingThreadStore()
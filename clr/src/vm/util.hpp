@@ -94,13 +94,27 @@ extern IncDecLongOps FastInterlockDecrementLong;
 // these DO have corresponding compiler intrinsics
 //
 #if !defined(_WIN64) && !defined(DACCESS_COMPILE)
-extern XchgOps     FastInterlockExchange;
 extern XchgLongOps     FastInterlockExchangeLong;
-extern CmpXchgOps  FastInterlockCompareExchange;
 extern CmpXchgLongOps  FastInterlockCompareExchangeLong;
 extern XchngAddOps FastInterlockExchangeAdd;
 extern XchgAddLongOps FastInterlockExchangeAddLong;
 
+#ifdef PAL_INLINE_INTERLOCKED
+
+// The PAL compiles these inline (see rotor_pal.h), which is cheaper than the
+// indirect call to the helpers.
+#define FastInterlockExchange               InterlockedExchange
+#define FastInterlockExchangePointer        InterlockedExchangePointer
+#define FastInterlockCompareExchange        InterlockedCompareExchange
+#define FastInterlockCompareExchangePointer InterlockedCompareExchangePointer
+#define FastInterlockIncrement              InterlockedIncrement
+#define FastInterlockDecrement              InterlockedDecrement
+
+#else // PAL_INLINE_INTERLOCKED
+
+extern XchgOps     FastInterlockExchange;
+extern CmpXchgOps  FastInterlockCompareExchange;
+
 inline PVOID FastInterlockExchangePointer(PVOID volatile *Target, PVOID Value)
 {
     LEAF_CONTRACT;
@@ -120,6 +134,8 @@ inline PVOID FastInterlockCompareExchangePointer(PVOID volatile *Destination, PV
 // values -- only on the sign of the return.
 extern IncDecOps   FastInterlockIncrement;
 extern IncDecOps   FastInterlockDecrement;
+
+#endif // PAL_INLINE_INTERLOCKED
 #else
 
 #define FastInterlockExchange               InterlockedExchange
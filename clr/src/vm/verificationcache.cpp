@@ -0,0 +1,956 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+#include "common.h"
+#include "verificationcache.h"
+#include "eeconfig.h"
+#include "product_version.h"
+
+VerificationCache *VerificationCache::s_pFirst = NULL;
+Volatile<BOOL>     VerificationCache::s_fShutdown = FALSE;
+
+BYTE           VerificationCache::s_key[VERIFICATION_CACHE_KEY_SIZE];
+Volatile<BOOL> VerificationCache::s_fKeyInitialized = FALSE;
+BYTE           VerificationCache::s_buildHash[SHA1_HASH_SIZE];
+Volatile<BOOL> VerificationCache::s_fBuildHashInitialized = FALSE;
+
+// Sanity limit on the number of tokens in a cache file; a module can't have more
+// method definitions than fit in the RID part of a token
+#define MAX_CACHED_TOKENS   0x00FFFFFF
+
+// Sanity limit on the number of assembly references recorded in a cache file
+#define MAX_CACHED_DEPENDENCIES 0x0000FFFF
+
+#define SHA1_BLOCK_SIZE     64
+#define HMAC_IPAD           0x36
+#define HMAC_OPAD           0x5C
+
+static int __cdecl CompareTokens(const void *p1, const void *p2)
+{
+    LEAF_CONTRACT;
+
+    mdMethodDef tk1 = *(const mdMethodDef *)p1;
+    mdMethodDef tk2 = *(const mdMethodDef *)p2;
+    return (tk1 < tk2) ? -1 : ((tk1 > tk2) ? 1 : 0);
+}
+
+// Creates a file to be moved over path once it is filled in. Its name can't
+// be guessed, so nobody can plant a file or a link there beforehand, and only
+// the current user can access it.
+static HANDLE CreatePrivateTempFile(const SString &path, SString &tempPath)
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_PREEMPTIVE;
+    }
+    CONTRACTL_END;
+
+    DWORD suffix[2];
+    if (!PAL_Random(FALSE, suffix, sizeof(suffix)))
+        return INVALID_HANDLE_VALUE;
+
+    tempPath.Set(path);
+    tempPath.AppendPrintf(L".%08x%08x.new", suffix[0], suffix[1]);
+
+    HANDLE hFile = WszCreateFile(tempPath, GENERIC_WRITE | WRITE_DAC, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return INVALID_HANDLE_VALUE;
+
+    if (!PAL_SetFileOwnerOnly(hFile))
+    {
+        CloseHandle(hFile);
+        WszDeleteFile(tempPath);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return hFile;
+}
+
+// Opens a file for reading if nobody but the current user can have written it
+static HANDLE OpenPrivateFile(LPCWSTR wszPath)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_PREEMPTIVE;
+    }
+    CONTRACTL_END;
+
+    HANDLE hFile = WszCreateFile(wszPath, GENERIC_READ | READ_CONTROL, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return INVALID_HANDLE_VALUE;
+
+    if (!PAL_IsFileOwnerOnly(hFile))
+    {
+        LOG((LF_VERIFIER, LL_INFO10, "VerificationCache: ignoring %S, other users can write it\n", wszPath));
+        CloseHandle(hFile);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return hFile;
+}
+
+VerificationCache::VerificationCache()
+{
+    WRAPPER_CONTRACT;
+
+    m_pNext = NULL;
+    m_fDirty = FALSE;
+    m_fReleased = FALSE;
+    m_fDisabled = FALSE;
+    ZeroMemory(m_hash, sizeof(m_hash));
+    ZeroMemory(&m_mvid, sizeof(m_mvid));
+    m_pTokens = NULL;
+    m_cTokens = 0;
+    m_pDependencies = NULL;
+    m_cDependencies = 0;
+    m_state = DEPENDENCIES_STALE;
+    m_cNewBound = 0;
+    m_fNewCoversOld = FALSE;
+    m_crst.Init("Verification Cache", CrstVerificationCache, CRST_UNSAFE_ANYMODE);
+}
+
+VerificationCache::~VerificationCache()
+{
+    WRAPPER_CONTRACT;
+
+    delete [] m_pTokens;
+    delete [] m_pDependencies;
+    m_crst.Destroy();
+}
+
+VerificationCache *VerificationCache::Create(Module *pModule)
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_TRIGGERS;
+        MODE_ANY;
+        PRECONDITION(CheckPointer(pModule));
+        PRECONDITION(g_pConfig->VerificationCacheDir() != NULL);
+    }
+    CONTRACTL_END;
+
+    NewHolder<VerificationCache> pCache(new VerificationCache());
+
+    PEFile *pFile = pModule->GetFile();
+
+    StackSBuffer hash;
+    pFile->GetSHA1Hash(hash);
+    if (hash.GetSize() != SHA1_HASH_SIZE)
+        ThrowHR(COR_E_BADIMAGEFORMAT);
+    memcpy(pCache->m_hash, (const BYTE *)hash, SHA1_HASH_SIZE);
+
+    pFile->GetMVID(&pCache->m_mvid);
+
+    // The file is named after the image hash, so a changed image never
+    // picks up the results of the old one
+    LPCWSTR wszDir = g_pConfig->VerificationCacheDir();
+    pCache->m_path.Set(wszDir);
+    size_t cchDir = wcslen(wszDir);
+    if (cchDir > 0 && wszDir[cchDir - 1] != L'\\' && wszDir[cchDir - 1] != L'/')
+        pCache->m_path.Append(L'\\');
+    for (int i = 0; i < SHA1_HASH_SIZE; i++)
+        pCache->m_path.AppendPrintf(L"%02x", pCache->m_hash[i]);
+    pCache->m_path.Append(L".ver");
+
+    // The other modules of a multi-module assembly aren't tracked
+    if (pModule->GetAssembly()->GetManifestImport()->GetCountWithTokenKind(mdtFile) != 0)
+        pCache->m_fDisabled = TRUE;
+
+    if (!pCache->m_fDisabled)
+    {
+        EX_TRY
+        {
+            InitializeKey();
+            InitializeBuildHash();
+        }
+        EX_CATCH
+        {
+            LOG((LF_VERIFIER, LL_INFO10, "VerificationCache: not caching %S\n", pCache->m_path.GetUnicode()));
+            pCache->m_fDisabled = TRUE;
+        }
+        EX_END_CATCH(RethrowTerminalExceptions);
+    }
+
+    if (!pCache->m_fDisabled)
+        pCache->Load();
+
+    return pCache.Extract();
+}
+
+// Reads the MAC key, creating it the first time the cache is used by this user.
+void VerificationCache::InitializeKey()
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_TRIGGERS;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    if (s_fKeyInitialized)
+        return;
+
+    GCX_PREEMP();
+
+    // The user configuration directory is only accessible to its owner, unlike
+    // the cache directory which may well be shared
+    SString path;
+    LPCWSTR wszKeyFile = g_pConfig->VerificationCacheKeyFile();
+    if (wszKeyFile != NULL)
+    {
+        path.Set(wszKeyFile);
+    }
+    else
+    {
+        WCHAR wszDir[MAX_PATH];
+        if (!PAL_GetUserConfigurationDirectoryW(wszDir, MAX_PATH))
+            ThrowLastError();
+        path.Set(wszDir);
+        path.Append(L"\\vercache.key");
+    }
+
+    BYTE key[VERIFICATION_CACHE_KEY_SIZE];
+    if (!ReadKey(path, key))
+    {
+        // Another process may be creating the key at the same time, so the new
+        // key only goes in if there is none yet, and whichever key won is read
+        // back. At worst the caches written with a losing key get rebuilt.
+        if (!PAL_Random(TRUE, key, sizeof(key)))
+            ThrowLastError();
+
+        SString tempPath;
+        BOOL fWritten = FALSE;
+        {
+            HandleHolder hFile(CreatePrivateTempFile(path, tempPath));
+            if (hFile == INVALID_HANDLE_VALUE)
+                ThrowLastError();
+
+            DWORD cbWritten = 0;
+            fWritten = WriteFile(hFile, key, sizeof(key), &cbWritten, NULL) && cbWritten == sizeof(key);
+        }
+
+        if (!fWritten || !WszMoveFileEx(tempPath, path, 0))
+            WszDeleteFile(tempPath);
+
+        if (!ReadKey(path, key))
+            ThrowHR(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+    }
+
+    // Racing threads all copy the same bytes
+    memcpy(s_key, key, sizeof(key));
+    s_fKeyInitialized = TRUE;
+}
+
+BOOL VerificationCache::ReadKey(LPCWSTR wszPath, BYTE *pKey)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_PREEMPTIVE;
+    }
+    CONTRACTL_END;
+
+    // A key that somebody else could have written or read is no key at all
+    HandleHolder hFile(OpenPrivateFile(wszPath));
+    if (hFile == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    DWORD cbRead = 0;
+    return ReadFile(hFile, pKey, VERIFICATION_CACHE_KEY_SIZE, &cbRead, NULL) &&
+           cbRead == VERIFICATION_CACHE_KEY_SIZE &&
+           GetFileSize(hFile, NULL) == VERIFICATION_CACHE_KEY_SIZE;
+}
+
+// Hashes the path, size and time stamp of a loaded module. Unlike the version
+// number, these change with every build.
+void VerificationCache::HashModuleIdentity(HCRYPTHASH hHash, HMODULE hMod)
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_PREEMPTIVE;
+    }
+    CONTRACTL_END;
+
+    WCHAR wszPath[MAX_PATH];
+    DWORD cchPath = WszGetModuleFileName(hMod, wszPath, MAX_PATH);
+    if (cchPath == 0 || cchPath >= MAX_PATH)
+        ThrowHR(HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE));
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!WszGetFileAttributesEx(wszPath, GetFileExInfoStandard, &data))
+        ThrowLastError();
+
+    if (!CryptHashData(hHash, (const BYTE *)wszPath, cchPath * sizeof(WCHAR), 0)
+        || !CryptHashData(hHash, (const BYTE *)&data.nFileSizeHigh, sizeof(data.nFileSizeHigh), 0)
+        || !CryptHashData(hHash, (const BYTE *)&data.nFileSizeLow, sizeof(data.nFileSizeLow), 0)
+        || !CryptHashData(hHash, (const BYTE *)&data.ftLastWriteTime, sizeof(data.ftLastWriteTime), 0))
+        ThrowLastError();
+}
+
+// Computes the hash that identifies the runtime, which contains the verifier,
+// and the jit, which drives it. A file written by any other build is ignored.
+void VerificationCache::InitializeBuildHash()
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_TRIGGERS;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    if (s_fBuildHashInitialized)
+        return;
+
+    IJitManager *pJitMgr;
+#if !defined(FJITONLY)
+    pJitMgr = ExecutionManager::GetJitForType(miManaged|miIL);
+#else // !!defined(FJITONLY)
+    pJitMgr = ExecutionManager::GetJitForType(miManaged_IL_EJIT);
+#endif // !!defined(FJITONLY)
+    if (pJitMgr == NULL || pJitMgr->GetJitModule() == NULL)
+        ThrowHR(E_FAIL);
+
+    GCX_PREEMP();
+
+    HandleCSPHolder hProv;
+    HandleHashHolder hHash;
+    if (!WszCryptAcquireContext(&hProv, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT)
+        || !CryptCreateHash(hProv, CALG_SHA1, 0, 0, &hHash))
+        ThrowLastError();
+
+    static const WCHAR wszVersion[] = VER_PRODUCTVERSION_STR_L;
+    if (!CryptHashData(hHash, (const BYTE *)wszVersion, sizeof(wszVersion), 0))
+        ThrowLastError();
+
+    HashModuleIdentity(hHash, GetModuleInst());
+    HashModuleIdentity(hHash, pJitMgr->GetJitModule());
+
+    BYTE buildHash[SHA1_HASH_SIZE];
+    DWORD cbHash = SHA1_HASH_SIZE;
+    if (!CryptGetHashParam(hHash, HP_HASHVAL, buildHash, &cbHash, 0))
+        ThrowLastError();
+
+    // Racing threads all copy the same bytes
+    memcpy(s_buildHash, buildHash, sizeof(buildHash));
+    s_fBuildHashInitialized = TRUE;
+}
+
+// Lists the MVIDs of the assemblies the module references, followed by those
+// of the assemblies they reference and so on, breadth first and in metadata
+// order, so that the same bindings always give the same list: a method may use
+// a type whose base type lives in an assembly the module never mentions. Type
+// forwarders are covered since the forwarding assembly references the
+// destination.
+// Nothing is loaded. A reference that isn't bound yet is listed as GUID_NULL
+// and not followed; no method verified so far can depend on it.
+// Returns FALSE if a multi-module assembly is bound, whose other modules
+// aren't tracked.
+BOOL VerificationCache::RecordDependencies(Module *pModule, SArray<GUID> *pDependencies)
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    SArray<Module *> modules;
+    modules.Append(pModule);
+
+    for (COUNT_T i = 0; i < modules.GetCount(); i++)
+    {
+        Module *pCurrent = modules[i];
+
+        IMDInternalImport *pImport = pCurrent->GetMDImport();
+        HENUMInternalHolder hEnum(pImport);
+        hEnum.EnumInit(mdtAssemblyRef, mdTokenNil);
+
+        mdAssemblyRef tkRef;
+        while (pImport->EnumNext(&hEnum, &tkRef))
+        {
+            Assembly *pAssembly = pCurrent->LookupAssemblyRef(tkRef);
+            if (pAssembly == NULL)
+            {
+                pDependencies->Append(GUID_NULL);
+                continue;
+            }
+
+            if (pAssembly->GetManifestImport()->GetCountWithTokenKind(mdtFile) != 0)
+                return FALSE;
+
+            Module *pRef = pAssembly->GetManifestModule();
+
+            GUID mvid;
+            pRef->GetFile()->GetMVID(&mvid);
+            pDependencies->Append(mvid);
+
+            COUNT_T j;
+            for (j = 0; j < modules.GetCount(); j++)
+            {
+                if (modules[j] == pRef)
+                    break;
+            }
+            if (j == modules.GetCount())
+                modules.Append(pRef);
+        }
+    }
+
+    return TRUE;
+}
+
+// Walks the references the way RecordDependencies does and compares the bound
+// assemblies with the recorded list
+VerificationCache::DependencyState VerificationCache::CheckDependencies(Module *pModule,
+                                                                        const GUID *pDependencies,
+                                                                        COUNT_T cDependencies)
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    SArray<Module *> modules;
+    modules.Append(pModule);
+
+    COUNT_T iDependency = 0;
+
+    for (COUNT_T i = 0; i < modules.GetCount(); i++)
+    {
+        Module *pCurrent = modules[i];
+
+        IMDInternalImport *pImport = pCurrent->GetMDImport();
+        HENUMInternalHolder hEnum(pImport);
+        hEnum.EnumInit(mdtAssemblyRef, mdTokenNil);
+
+        mdAssemblyRef tkRef;
+        while (pImport->EnumNext(&hEnum, &tkRef))
+        {
+            if (iDependency == cDependencies)
+                return DEPENDENCIES_STALE;
+
+            const GUID &expected = pDependencies[iDependency++];
+
+            // The methods in the file didn't need this reference
+            if (IsEqualGUID(expected, GUID_NULL))
+                continue;
+
+            Assembly *pAssembly = pCurrent->LookupAssemblyRef(tkRef);
+            if (pAssembly == NULL)
+                return DEPENDENCIES_PENDING;
+
+            if (pAssembly->GetManifestImport()->GetCountWithTokenKind(mdtFile) != 0)
+                return DEPENDENCIES_STALE;
+
+            Module *pRef = pAssembly->GetManifestModule();
+
+            GUID mvid;
+            pRef->GetFile()->GetMVID(&mvid);
+            if (!IsEqualGUID(mvid, expected))
+                return DEPENDENCIES_STALE;
+
+            COUNT_T j;
+            for (j = 0; j < modules.GetCount(); j++)
+            {
+                if (modules[j] == pRef)
+                    break;
+            }
+            if (j == modules.GetCount())
+                modules.Append(pRef);
+        }
+    }
+
+    return (iDependency == cDependencies) ? DEPENDENCIES_MATCH : DEPENDENCIES_STALE;
+}
+
+// Computes SHA1((key ^ pad) || buffers), one half of the HMAC
+static void HashWithKey(HCRYPTPROV hProv, const BYTE *pKey, BYTE bPad,
+                        const BYTE **ppData, const DWORD *pcbData, int cBuffers, BYTE *pHash)
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    BYTE pad[SHA1_BLOCK_SIZE];
+    memset(pad, bPad, sizeof(pad));
+    for (int i = 0; i < VERIFICATION_CACHE_KEY_SIZE; i++)
+        pad[i] ^= pKey[i];
+
+    HandleHashHolder hHash;
+    if (!CryptCreateHash(hProv, CALG_SHA1, 0, 0, &hHash)
+        || !CryptHashData(hHash, pad, sizeof(pad), 0))
+        ThrowLastError();
+
+    for (int i = 0; i < cBuffers; i++)
+    {
+        if (pcbData[i] != 0 && !CryptHashData(hHash, ppData[i], pcbData[i], 0))
+            ThrowLastError();
+    }
+
+    DWORD cbHash = SHA1_HASH_SIZE;
+    if (!CryptGetHashParam(hHash, HP_HASHVAL, pHash, &cbHash, 0))
+        ThrowLastError();
+}
+
+// HMAC-SHA1 (RFC 2104) of the header, the dependencies and the tokens
+void VerificationCache::ComputeMac(const FileHeader *pHeader, const GUID *pDependencies,
+                                   const mdMethodDef *pTokens, BYTE *pMac)
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_ANY;
+        PRECONDITION(s_fKeyInitialized);
+    }
+    CONTRACTL_END;
+
+    HandleCSPHolder hProv;
+    if (!WszCryptAcquireContext(&hProv, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT))
+        ThrowLastError();
+
+    const BYTE *rgpData[] = { (const BYTE *)pHeader, (const BYTE *)pDependencies, (const BYTE *)pTokens };
+    DWORD rgcbData[] = { sizeof(FileHeader),
+                         pHeader->m_cDependencies * sizeof(GUID),
+                         pHeader->m_cTokens * sizeof(mdMethodDef) };
+
+    BYTE inner[SHA1_HASH_SIZE];
+    HashWithKey(hProv, s_key, HMAC_IPAD, rgpData, rgcbData, 3, inner);
+
+    const BYTE *pInner = inner;
+    DWORD cbInner = sizeof(inner);
+    HashWithKey(hProv, s_key, HMAC_OPAD, &pInner, &cbInner, 1, pMac);
+}
+
+void VerificationCache::Release(VerificationCache *pCache)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+        PRECONDITION(CheckPointer(pCache));
+    }
+    CONTRACTL_END;
+
+    // The module is dead, so nothing can record new entries any more. A dirty
+    // cache is deleted by FlushAll once it has been written.
+    BOOL fDelete;
+    {
+        CrstHolder ch(&pCache->m_crst);
+        pCache->m_fReleased = TRUE;
+        fDelete = !pCache->m_fDirty;
+    }
+
+    if (fDelete)
+        delete pCache;
+}
+
+// Reads the tokens verified by previous runs. Any mismatch or malformed data
+// leaves the cache empty, i.e. everything is verified again.
+void VerificationCache::Load()
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_TRIGGERS;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    GCX_PREEMP();
+
+    HandleHolder hFile(OpenPrivateFile(m_path));
+    if (hFile == INVALID_HANDLE_VALUE)
+        return;
+
+    FileHeader header;
+    DWORD cbRead = 0;
+    if (!ReadFile(hFile, &header, sizeof(header), &cbRead, NULL) || cbRead != sizeof(header))
+        return;
+
+    if (header.m_dwMagic != VERIFICATION_CACHE_MAGIC ||
+        header.m_dwVersion != VERIFICATION_CACHE_VERSION ||
+        memcmp(header.m_buildHash, s_buildHash, SHA1_HASH_SIZE) != 0 ||
+        memcmp(header.m_hash, m_hash, SHA1_HASH_SIZE) != 0 ||
+        memcmp(&header.m_mvid, &m_mvid, sizeof(GUID)) != 0 ||
+        header.m_cDependencies > MAX_CACHED_DEPENDENCIES ||
+        header.m_cTokens == 0 ||
+        header.m_cTokens > MAX_CACHED_TOKENS)
+    {
+        LOG((LF_VERIFIER, LL_INFO10, "VerificationCache: ignoring stale cache %S\n", m_path.GetUnicode()));
+        return;
+    }
+
+    NewArrayHolder<GUID> pDependencies(new GUID[header.m_cDependencies]);
+    DWORD cbDependencies = header.m_cDependencies * sizeof(GUID);
+    if (cbDependencies != 0 &&
+        (!ReadFile(hFile, pDependencies, cbDependencies, &cbRead, NULL) || cbRead != cbDependencies))
+        return;
+
+    NewArrayHolder<mdMethodDef> pTokens(new mdMethodDef[header.m_cTokens]);
+    DWORD cbTokens = header.m_cTokens * sizeof(mdMethodDef);
+    if (!ReadFile(hFile, pTokens, cbTokens, &cbRead, NULL) || cbRead != cbTokens)
+        return;
+
+    BYTE mac[SHA1_HASH_SIZE];
+    if (!ReadFile(hFile, mac, sizeof(mac), &cbRead, NULL) || cbRead != sizeof(mac) ||
+        GetFileSize(hFile, NULL) != sizeof(header) + cbDependencies + cbTokens + sizeof(mac))
+        return;
+
+    BYTE expectedMac[SHA1_HASH_SIZE];
+    ComputeMac(&header, pDependencies, pTokens, expectedMac);
+    if (memcmp(mac, expectedMac, sizeof(mac)) != 0)
+    {
+        LOG((LF_VERIFIER, LL_INFO10, "VerificationCache: ignoring cache with a bad MAC %S\n", m_path.GetUnicode()));
+        return;
+    }
+
+    // Contains does a binary search, so insist on strictly ascending method tokens
+    for (DWORD i = 0; i < header.m_cTokens; i++)
+    {
+        if (TypeFromToken(pTokens[i]) != mdtMethodDef ||
+            (i > 0 && pTokens[i] <= pTokens[i - 1]))
+            return;
+    }
+
+    m_cTokens = header.m_cTokens;
+    m_pTokens = pTokens.Extract();
+    m_cDependencies = header.m_cDependencies;
+    m_pDependencies = pDependencies.Extract();
+
+    // The referenced assemblies are checked as they get bound, see IsVerified
+    m_state = DEPENDENCIES_PENDING;
+
+    LOG((LF_VERIFIER, LL_INFO10, "VerificationCache: %d verified methods in %S\n", m_cTokens, m_path.GetUnicode()));
+}
+
+BOOL VerificationCache::Contains(mdMethodDef tk)
+{
+    LEAF_CONTRACT;
+
+    COUNT_T lo = 0;
+    COUNT_T hi = m_cTokens;
+    while (lo < hi)
+    {
+        COUNT_T mid = lo + (hi - lo) / 2;
+        if (m_pTokens[mid] == tk)
+            return TRUE;
+        if (m_pTokens[mid] < tk)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return FALSE;
+}
+
+// Looks tk up once the assemblies the file depends on are known to be the
+// same. Until they are all bound the dependencies are checked again on every
+// call, which only reads the binding maps.
+BOOL VerificationCache::IsVerified(Module *pModule, mdMethodDef tk)
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    if (m_state == DEPENDENCIES_PENDING)
+    {
+        // The result doesn't change once it's MATCH or STALE, so racing
+        // threads store the same value
+        DependencyState state = CheckDependencies(pModule, m_pDependencies, m_cDependencies);
+        if (state != DEPENDENCIES_PENDING)
+        {
+            LOG((LF_VERIFIER, LL_INFO10, "VerificationCache: %S is %s\n", m_path.GetUnicode(),
+                 state == DEPENDENCIES_MATCH ? "current" : "stale"));
+            m_state = state;
+        }
+    }
+
+    return m_state == DEPENDENCIES_MATCH && Contains(tk);
+}
+
+BOOL VerificationCache::IsCacheable(MethodDesc *pMD)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    if (g_pConfig->VerificationCacheDir() == NULL)
+        return FALSE;
+
+    // Generic code is verified once through its typical instantiation
+    // (see GetCompileFlagsIfGenericInstantiation) and dynamic code has no
+    // stable image to key on.
+    return pMD->IsIL() &&
+           !pMD->IsNoMetadata() &&
+           !pMD->HasClassOrMethodInstantiation() &&
+           !pMD->GetModule()->IsReflection();
+}
+
+BOOL VerificationCache::IsMethodVerified(MethodDesc *pMD)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_TRIGGERS;
+        MODE_ANY;
+        PRECONDITION(CheckPointer(pMD));
+    }
+    CONTRACTL_END;
+
+    if (!IsCacheable(pMD))
+        return FALSE;
+
+    BOOL fVerified = FALSE;
+
+    // A cache that can't be read just means the method gets verified
+    EX_TRY
+    {
+        Module *pModule = pMD->GetModule();
+        VerificationCache *pCache = pModule->GetVerificationCache();
+        fVerified = pCache->IsVerified(pModule, pMD->GetMemberDef());
+    }
+    EX_CATCH
+    {
+    }
+    EX_END_CATCH(SwallowAllExceptions);
+
+    return fVerified;
+}
+
+void VerificationCache::RecordVerified(MethodDesc *pMD)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_TRIGGERS;
+        MODE_ANY;
+        PRECONDITION(CheckPointer(pMD));
+    }
+    CONTRACTL_END;
+
+    if (!IsCacheable(pMD) || s_fShutdown)
+        return;
+
+    EX_TRY
+    {
+        Module *pModule = pMD->GetModule();
+        VerificationCache *pCache = pModule->GetVerificationCache();
+        mdMethodDef tk = pMD->GetMemberDef();
+
+        if (!pCache->m_fDisabled && !pCache->IsVerified(pModule, tk))
+        {
+            // Everything the method needed is bound by now. The walk only
+            // reads the binding maps, but it is done outside the lock.
+            BOOL fCoversOld = (pCache->m_state == DEPENDENCIES_MATCH);
+            SArray<GUID> dependencies;
+            if (!RecordDependencies(pModule, &dependencies))
+                pCache->m_fDisabled = TRUE;
+
+            COUNT_T cBound = 0;
+            for (COUNT_T i = 0; i < dependencies.GetCount(); i++)
+            {
+                if (!IsEqualGUID(dependencies[i], GUID_NULL))
+                    cBound++;
+            }
+
+            CrstHolder ch(&pCache->m_crst);
+
+            // FlushAll may have taken the list already
+            if (!pCache->m_fDisabled && !s_fShutdown)
+            {
+                pCache->m_newTokens.Append(tk);
+
+                // Bindings are only ever added, so the list with the most bound
+                // assemblies is the latest one and covers every new token
+                if (pCache->m_newTokens.GetCount() == 1 || cBound > pCache->m_cNewBound)
+                {
+                    pCache->m_newDependencies.Set(dependencies);
+                    pCache->m_cNewBound = cBound;
+                    pCache->m_fNewCoversOld = fCoversOld;
+                }
+                else if (cBound == pCache->m_cNewBound)
+                {
+                    pCache->m_fNewCoversOld |= fCoversOld;
+                }
+
+                if (!pCache->m_fDirty)
+                {
+                    pCache->m_fDirty = TRUE;
+
+                    VerificationCache *pFirst;
+                    do {
+                        pFirst = s_pFirst;
+                        pCache->m_pNext = pFirst;
+                    } while (InterlockedCompareExchangePointer((void**)&s_pFirst, pCache, pFirst) != pFirst);
+                }
+            }
+        }
+    }
+    EX_CATCH
+    {
+    }
+    EX_END_CATCH(SwallowAllExceptions);
+}
+
+// Merges the methods verified during this run with the ones read at startup and
+// replaces the cache file. The new file is written next to the old one and
+// renamed over it, so a concurrent reader sees either version but never a mix.
+// The caller holds m_crst.
+void VerificationCache::Flush()
+{
+    CONTRACTL
+    {
+        THROWS;
+        GC_NOTRIGGER;
+        MODE_PREEMPTIVE;
+    }
+    CONTRACTL_END;
+
+    COUNT_T cNew = m_newTokens.GetCount();
+    if (cNew == 0)
+        return;
+
+    // The old entries can only be kept if the new list of dependencies was
+    // recorded while all of theirs were bound with the same MVIDs
+    COUNT_T cOld = m_fNewCoversOld ? m_cTokens : 0;
+
+    COUNT_T cTokens = cOld + cNew;
+    NewArrayHolder<mdMethodDef> pTokens(new mdMethodDef[cTokens]);
+    if (cOld > 0)
+        memcpy(pTokens, m_pTokens, cOld * sizeof(mdMethodDef));
+    for (COUNT_T i = 0; i < cNew; i++)
+        pTokens[cOld + i] = m_newTokens[i];
+
+    qsort(pTokens, cTokens, sizeof(mdMethodDef), CompareTokens);
+
+    COUNT_T cUnique = 0;
+    for (COUNT_T i = 0; i < cTokens; i++)
+    {
+        if (cUnique == 0 || pTokens[cUnique - 1] != pTokens[i])
+            pTokens[cUnique++] = pTokens[i];
+    }
+
+    const GUID *pDependencies = m_newDependencies.GetElements();
+
+    FileHeader header;
+    header.m_dwMagic = VERIFICATION_CACHE_MAGIC;
+    header.m_dwVersion = VERIFICATION_CACHE_VERSION;
+    memcpy(header.m_buildHash, s_buildHash, SHA1_HASH_SIZE);
+    memcpy(header.m_hash, m_hash, SHA1_HASH_SIZE);
+    header.m_mvid = m_mvid;
+    header.m_cDependencies = m_newDependencies.GetCount();
+    header.m_cTokens = cUnique;
+
+    BYTE mac[SHA1_HASH_SIZE];
+    ComputeMac(&header, pDependencies, pTokens, mac);
+
+    SString tempPath;
+    BOOL fWritten = FALSE;
+    {
+        HandleHolder hFile(CreatePrivateTempFile(m_path, tempPath));
+        if (hFile == INVALID_HANDLE_VALUE)
+        {
+            LOG((LF_VERIFIER, LL_INFO10, "VerificationCache: cannot create a file next to %S\n", m_path.GetUnicode()));
+            return;
+        }
+
+        DWORD cbWritten = 0;
+        DWORD cbDependencies = header.m_cDependencies * sizeof(GUID);
+        DWORD cbTokens = cUnique * sizeof(mdMethodDef);
+        fWritten = WriteFile(hFile, &header, sizeof(header), &cbWritten, NULL) && cbWritten == sizeof(header) &&
+                   (cbDependencies == 0 ||
+                    (WriteFile(hFile, pDependencies, cbDependencies, &cbWritten, NULL) && cbWritten == cbDependencies)) &&
+                   WriteFile(hFile, pTokens, cbTokens, &cbWritten, NULL) && cbWritten == cbTokens &&
+                   WriteFile(hFile, mac, sizeof(mac), &cbWritten, NULL) && cbWritten == sizeof(mac);
+    }
+
+    if (!fWritten || !WszMoveFileEx(tempPath, m_path, MOVEFILE_REPLACE_EXISTING))
+        WszDeleteFile(tempPath);
+}
+
+void VerificationCache::FlushAll()
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_TRIGGERS;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    GCX_PREEMP();
+
+    // Only called at EE shutdown. Methods verified from now on aren't
+    // recorded, so the detached list is complete.
+    s_fShutdown = TRUE;
+    VerificationCache *pCache = (VerificationCache *)InterlockedExchangePointer((void**)&s_pFirst, NULL);
+
+    while (pCache != NULL)
+    {
+        VerificationCache *pNext = pCache->m_pNext;
+        BOOL fDelete;
+
+        {
+            CrstHolder ch(&pCache->m_crst);
+
+            EX_TRY
+            {
+                pCache->Flush();
+            }
+            EX_CATCH
+            {
+            }
+            EX_END_CATCH(SwallowAllExceptions);
+
+            pCache->m_newTokens.Clear();
+            pCache->m_newDependencies.Clear();
+            pCache->m_pNext = NULL;
+            pCache->m_fDirty = FALSE;
+            fDelete = pCache->m_fReleased;
+        }
+
+        // The module is gone and left the cache to us
+        if (fDelete)
+            delete pCache;
+
+        pCache = pNext;
+    }
+}
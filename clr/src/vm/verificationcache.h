@@ -0,0 +1,155 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+//
+// VerificationCache remembers, across processes, which methods of a module
+// the jit has already found to be verifiable, so that modules that are loaded
+// again and again (e.g. partially trusted plug-ins) do not pay for verification
+// in every process.
+//
+// The cache of a module is a file in the directory named by the
+// VerificationCacheDir config setting (the cache is off when it is not set).
+// The file name is the SHA1 hash of the module image, so any change to the
+// image invalidates the cache. The file also records the MVID, the cache
+// format version and a hash identifying the build of the runtime and of the
+// jit, which must all match before any entry is trusted.
+//
+// Whether a method verifies also depends on the types it uses from other
+// assemblies, so the file records the MVIDs of the assemblies the module
+// references, directly or indirectly, that were bound when the methods were
+// verified. Looking them up never loads anything: the entries are trusted
+// once every recorded assembly is bound with the same MVID, and a different
+// version of any of them invalidates the cache.
+// Only successful verifications are recorded: a method that fails to verify
+// is always re-verified so that the jit can insert the verification throw.
+//
+// Partially trusted code runs unverified on a hit, so the file is authenticated
+// with an HMAC-SHA1 whose key is created on first use in the user's private
+// configuration directory (or the file named by VerificationCacheKeyFile).
+// Files that don't carry a valid MAC are ignored, so write access to the cache
+// directory alone isn't enough to get unverifiable code past the verifier.
+// The key and the cache files are only accessible to their owner, and files
+// that other users could have written are ignored.
+//
+// The entries read from the file are immutable for the life of the process and
+// are looked up without a lock. Methods verified during this run are appended
+// to a side list and merged into the file when the EE shuts down.
+//
+
+#ifndef _VERIFICATIONCACHE_H_
+#define _VERIFICATIONCACHE_H_
+
+#include "crst.h"
+#include "sarray.h"
+
+#ifndef SHA1_HASH_SIZE
+#define SHA1_HASH_SIZE 20
+#endif
+
+#define VERIFICATION_CACHE_MAGIC    0x43524556  // 'VERC'
+// The file format. Changes to the verifier are caught by the build hash.
+#define VERIFICATION_CACHE_VERSION  3
+
+#define VERIFICATION_CACHE_KEY_SIZE 20
+
+class VerificationCache
+{
+public:
+    // Returns TRUE if pMD was verified by a previous run against the same image.
+    static BOOL IsMethodVerified(MethodDesc *pMD);
+
+    // Records that the jit verified pMD successfully.
+    static void RecordVerified(MethodDesc *pMD);
+
+    // Writes back the caches of all the modules that verified new methods.
+    static void FlushAll();
+
+    // Called by Module::GetVerificationCache the first time the cache is needed.
+    static VerificationCache *Create(Module *pModule);
+
+    // Called when the module goes away. A cache with unsaved entries stays
+    // alive until FlushAll.
+    static void Release(VerificationCache *pCache);
+
+    ~VerificationCache();
+
+private:
+    VerificationCache();
+
+    static BOOL IsCacheable(MethodDesc *pMD);
+
+    static void InitializeKey();
+    static BOOL ReadKey(LPCWSTR wszPath, BYTE *pKey);
+    static void InitializeBuildHash();
+    static void HashModuleIdentity(HCRYPTHASH hHash, HMODULE hMod);
+
+    enum DependencyState
+    {
+        DEPENDENCIES_PENDING,   // some recorded assemblies aren't bound yet
+        DEPENDENCIES_MATCH,     // every recorded assembly is bound with the same MVID
+        DEPENDENCIES_STALE,     // some recorded assembly changed
+    };
+
+    static BOOL RecordDependencies(Module *pModule, SArray<GUID> *pDependencies);
+    static DependencyState CheckDependencies(Module *pModule, const GUID *pDependencies, COUNT_T cDependencies);
+
+    void Load();
+    void Flush();
+    BOOL IsVerified(Module *pModule, mdMethodDef tk);
+    BOOL Contains(mdMethodDef tk);
+
+    struct FileHeader
+    {
+        DWORD       m_dwMagic;
+        DWORD       m_dwVersion;
+        BYTE        m_buildHash[SHA1_HASH_SIZE];    // identifies the runtime and the jit
+        BYTE        m_hash[SHA1_HASH_SIZE];     // SHA1 of the image, same as the file name
+        GUID        m_mvid;
+        DWORD       m_cDependencies;            // followed by the MVIDs of the referenced assemblies,
+        DWORD       m_cTokens;                  // the sorted method tokens and the MAC
+    };
+
+    static void ComputeMac(const FileHeader *pHeader, const GUID *pDependencies,
+                           const mdMethodDef *pTokens, BYTE *pMac);
+
+    VerificationCache   *m_pNext;               // the caches with new entries, for FlushAll
+    BOOL                 m_fDirty;              // linked on s_pFirst
+    BOOL                 m_fReleased;           // the module is gone, FlushAll deletes the cache
+    BOOL                 m_fDisabled;           // the key or the build hash is unavailable
+    SString              m_path;
+    BYTE                 m_hash[SHA1_HASH_SIZE];
+    GUID                 m_mvid;
+
+    mdMethodDef         *m_pTokens;             // sorted, read from the file
+    COUNT_T              m_cTokens;
+    GUID                *m_pDependencies;       // read from the file, GUID_NULL for assemblies that weren't bound
+    COUNT_T              m_cDependencies;
+    Volatile<DependencyState> m_state;          // of m_pDependencies, only moves on from PENDING
+
+    SArray<mdMethodDef>  m_newTokens;           // verified during this run
+    SArray<GUID>         m_newDependencies;     // bound when the latest of m_newTokens was verified
+    COUNT_T              m_cNewBound;           // the non null entries of m_newDependencies
+    BOOL                 m_fNewCoversOld;       // m_newDependencies was recorded after m_state became MATCH
+    CrstStatic           m_crst;                // protects the new entries and m_fReleased
+
+    static VerificationCache *s_pFirst;
+    static Volatile<BOOL>     s_fShutdown;      // FlushAll has run
+
+    static BYTE           s_key[VERIFICATION_CACHE_KEY_SIZE];
+    static Volatile<BOOL> s_fKeyInitialized;
+    static BYTE           s_buildHash[SHA1_HASH_SIZE];
+    static Volatile<BOOL> s_fBuildHashInitialized;
+};
+
+#endif // _VERIFICATIONCACHE_H_
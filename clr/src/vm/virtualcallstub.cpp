@@ -53,6 +53,10 @@ UINT32 g_insert_cache_miss = 0;         //# of times Insert already had a matchi
 UINT32 g_insert_cache_collide = 0;      //# of times Insert found a used cache entry
 UINT32 g_insert_cache_write = 0;        //# of times Insert wrote a cache entry
 
+UINT32 g_cache_grow = 0;                //# of times the resolve cache doubled in size
+UINT32 g_cache_space = 0;               //# of bytes of the resolve cache table
+UINT32 g_cache_space_dead = 0;          //# of bytes of grown out resolve cache tables not yet recycled
+
 UINT32 g_cache_entry_counter = 0;       //# of cache structs
 UINT32 g_cache_entry_space = 0;         //# of bytes used by cache lookup structs
 
@@ -99,6 +103,7 @@ UINT32 STUB_COLLIDE_MONO_PCT  =   0;
 #endif // STUB_LOGGING
 
 FastTable* BucketTable::dead = NULL;    //linked list of the abandoned buckets
+ResolveCacheElem** DispatchCache::dead = NULL; //linked list of the grown out cache tables
 MethodTable *VirtualCallStubManager::s_pTPMT = NULL;
 
 DispatchCache *g_resolveCache = NULL;    //cache of dispatch stubs for in line lookup by resolve stubs.
@@ -363,6 +368,12 @@ void VirtualCallStubManager::LoggingDump()
         WriteFile (g_hStubLogFile, szPrintStr, (DWORD) strlen(szPrintStr), &dwWriteByte, NULL);
         sprintf_s(szPrintStr, COUNTOF(szPrintStr), OUTPUT_FORMAT_INT, "cache_entry_space", g_cache_entry_space);
         WriteFile (g_hStubLogFile, szPrintStr, (DWORD) strlen(szPrintStr), &dwWriteByte, NULL);
+        sprintf_s(szPrintStr, COUNTOF(szPrintStr), OUTPUT_FORMAT_INT, "cache_grow", g_cache_grow);
+        WriteFile (g_hStubLogFile, szPrintStr, (DWORD) strlen(szPrintStr), &dwWriteByte, NULL);
+        sprintf_s(szPrintStr, COUNTOF(szPrintStr), OUTPUT_FORMAT_INT, "cache_space", g_cache_space);
+        WriteFile (g_hStubLogFile, szPrintStr, (DWORD) strlen(szPrintStr), &dwWriteByte, NULL);
+        sprintf_s(szPrintStr, COUNTOF(szPrintStr), OUTPUT_FORMAT_INT, "cache_space_dead", g_cache_space_dead);
+        WriteFile (g_hStubLogFile, szPrintStr, (DWORD) strlen(szPrintStr), &dwWriteByte, NULL);
 
         sprintf_s(szPrintStr, COUNTOF(szPrintStr), "\r\nstub hash table data\r\n");
         WriteFile (g_hStubLogFile, szPrintStr, (DWORD) strlen(szPrintStr), &dwWriteByte, NULL);
@@ -380,7 +391,7 @@ void VirtualCallStubManager::LoggingDump()
         sprintf_s(szPrintStr, COUNTOF(szPrintStr), "\r\ncache entry write counts\r\n");
         WriteFile (g_hStubLogFile, szPrintStr, (DWORD) strlen(szPrintStr), &dwWriteByte, NULL);
         DispatchCache::CacheEntryData *rgCacheData = g_resolveCache->cacheData;
-        for (UINT16 i = 0; i < CALL_STUB_CACHE_SIZE; i++)
+        for (size_t i = 0; i < g_resolveCache->GetCacheCount(); i++)
         {
             sprintf_s(szPrintStr, COUNTOF(szPrintStr), " %4d", rgCacheData[i]);
             WriteFile (g_hStubLogFile, szPrintStr, (DWORD) strlen(szPrintStr), &dwWriteByte, NULL);
@@ -846,6 +857,9 @@ void VirtualCallStubManager::ReclaimAll()
     //reclaim space of abandoned buckets
     BucketTable::Reclaim();
 
+    //and of the tables the resolve cache grew out of
+    DispatchCache::Reclaim();
+
     VirtualCallStubManagerIterator it =
         VirtualCallStubManagerManager::GlobalManager()->IterateVirtualCallStubManagers();
     while (it.Next())
@@ -2535,7 +2549,7 @@ ResolveHolder *VirtualCallStubManager::GenerateResolveStub(StubCallSite *   pCal
 
     holder->Initialize(addrOfResolver, addrOfPatcher,
                        dispatchToken, DispatchCache::HashToken(dispatchToken),
-                       g_resolveCache->GetCacheBaseAddr(), counterAddr,
+                       g_resolveCache->GetCacheTableAddr(), g_resolveCache->GetCacheMaskAddr(), counterAddr,
                        getThisCallingConvention((TADDR)pCallSite->GetSiteTarget()));
     ClrFlushInstructionCache(holder->stub(), holder->stub()->size());
 
@@ -3170,22 +3184,54 @@ DispatchCache::DispatchCache()
     e->pMT = (void *) (-1); //force all method tables to be misses
     e->pNext = NULL; // null terminate the chain for the empty entry
     empty = e;
+
+    cache = AllocTable(CALL_STUB_CACHE_SIZE);
+    if (cache == NULL)
+        COMPlusThrowOM();
+    stubMask = CALL_STUB_CACHE_MASK << LOG2_PTRSIZE;
+    collisions = 0;
     for (int i = 0;i<CALL_STUB_CACHE_SIZE;i++)
         ClearCacheEntry(i);
 
     // Initialize statistics
     memset(&stats, 0, sizeof(stats));
+    stats.cache_space = CALL_STUB_CACHE_SIZE * sizeof(ResolveCacheElem*);
 #ifdef STUB_LOGGING 
     memset(&cacheData, 0, sizeof(cacheData));
 #endif
 }
 
+// Tables carry one extra slot in front of the entries for the dead link, since the entries
+// of a grown out table may still be read until the next gc sync point.
+/*static*/ ResolveCacheElem** DispatchCache::AllocTable(size_t count)
+{
+    CONTRACTL {
+        NOTHROW;
+        GC_NOTRIGGER;
+        INJECT_FAULT(return NULL;);
+    } CONTRACTL_END;
+
+    ResolveCacheElem** table = new (nothrow) ResolveCacheElem*[count + 1];
+    if (table == NULL)
+        return NULL;
+    table[0] = NULL;
+    return table + 1;
+}
+
+/*static*/ void DispatchCache::FreeTable(ResolveCacheElem** table)
+{
+    LEAF_CONTRACT;
+
+    delete [] (table + CALL_STUB_CACHE_DEAD_LINK);
+}
+
 ResolveCacheElem* DispatchCache::Lookup(size_t token, UINT16 tokenHash, void* mt)
 {
     WRAPPER_CONTRACT;
     if (tokenHash == INVALID_HASH)
         tokenHash = HashToken(token);
-    UINT16 idx = HashMT(tokenHash, mt);
+    // The mask must be read before the table, see Grow
+    UINT16 idx = HashMT(tokenHash, mt, GetCacheMask());
     ResolveCacheElem *pCurElem = GetCacheEntry(idx);
 
 #if defined(STUB_LOGGING) && defined(CHAIN_LOOKUP) 
@@ -3233,7 +3279,7 @@ BOOL DispatchCache::Insert(ResolveCacheElem* elem, InsertKind insertKind)
 
     // Figure out what bucket this element belongs in
     UINT16 tokHash = HashToken(elem->token);
-    UINT16 hash    = HashMT(tokHash, elem->pMT);
+    UINT16 hash    = HashMT(tokHash, elem->pMT, GetCacheMask());
     UINT16 idx     = hash;
     BOOL   write   = FALSE;
     BOOL   miss    = FALSE;
@@ -3333,9 +3379,116 @@ BOOL DispatchCache::Insert(ResolveCacheElem* elem, InsertKind insertKind)
     else if (collide)
         stats.insert_cache_collide++;
 
+#ifdef CHAIN_LOOKUP 
+    // Long chains cost every resolve stub call that lands on them, so grow the
+    // cache once a good part of it has seen collisions.
+    if (collide && (++collisions * 100 > GetCacheCount() * CALL_STUB_CACHE_GROW_PCT))
+        Grow();
+#endif // CHAIN_LOOKUP
+
     return write || miss;
 }
 
+#ifdef CHAIN_LOOKUP 
+// Doubles the number of buckets and rehashes all the entries into the new table.
+// Readers are never blocked: they either use the old table, which keeps valid (if
+// shuffled) chains until it is reclaimed at the next gc sync point, or the new one.
+void DispatchCache::Grow()
+{
+    CONTRACTL {
+        NOTHROW;
+        GC_NOTRIGGER;
+        FORBID_FAULT;
+    } CONTRACTL_END;
+
+    CONSISTENCY_CHECK(m_writeLock.OwnedByCurrentThread());
+
+    collisions = 0;
+
+    size_t oldCount = GetCacheCount();
+    if (oldCount >= CALL_STUB_CACHE_MAX_SIZE)
+        return;
+
+    size_t newCount = oldCount * 2;
+    size_t newMask  = newCount - 1;
+
+    ResolveCacheElem** oldTable = cache;
+    ResolveCacheElem** newTable;
+    {
+        FAULT_NOT_FATAL();
+        newTable = AllocTable(newCount);
+    }
+    // Failing to grow only costs longer chains
+    if (newTable == NULL)
+        return;
+
+    for (size_t i = 0; i < newCount; i++)
+        newTable[i] = empty;
+
+    // Moving an element to the front of its new chain can send a reader walking
+    // an old chain into a new one, but every chain still ends at empty, so the
+    // worst a reader sees is a miss that the resolve worker then handles.
+    for (size_t i = 0; i < oldCount; i++)
+    {
+        ResolveCacheElem* pElem = oldTable[i];
+        while (pElem != empty)
+        {
+            ResolveCacheElem* pNext = pElem->pNext;
+            UINT16 idx = HashMT(HashToken(pElem->token), pElem->pMT, newMask);
+#ifdef _DEBUG 
+            pElem->debug_index = idx;
+#endif // _DEBUG
+            pElem->pNext = newTable[idx];
+            newTable[idx] = pElem;
+            pElem = pNext;
+        }
+    }
+
+    // Publish the table before the mask, readers load them in the opposite order
+    FastInterlockExchangePointer((PVOID volatile *) &cache, newTable);
+    stubMask = newMask << LOG2_PTRSIZE;
+
+    // Link the old table onto the "to be reclaimed" list
+    ResolveCacheElem** list;
+    do {
+        list = *((ResolveCacheElem** volatile *) &dead);
+        oldTable[CALL_STUB_CACHE_DEAD_LINK] = (ResolveCacheElem*) list;
+    } while (FastInterlockCompareExchangePointer((PVOID volatile *) &dead, oldTable, list) != list);
+
+    LOG((LF_STUBS, LL_INFO100, "DispatchCache grew to %d entries\n", newCount));
+
+    stats.cache_grow++;
+    stats.cache_space_dead += UINT32(oldCount * sizeof(ResolveCacheElem*));
+    stats.cache_space      += UINT32((newCount - oldCount) * sizeof(ResolveCacheElem*));
+}
+#endif // CHAIN_LOOKUP
+
+/*static*/ void DispatchCache::Reclaim()
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        FORBID_FAULT;
+    }
+    CONTRACTL_END
+
+    ResolveCacheElem** list = dead;
+
+    //see BucketTable::Reclaim for why the races here are benign
+    if (list == NULL) return;
+
+    if (FastInterlockCompareExchangePointer((PVOID volatile *) &dead, NULL, list) != list)
+        return;
+
+    while (list)
+    {
+        ResolveCacheElem** next = (ResolveCacheElem**) list[CALL_STUB_CACHE_DEAD_LINK];
+        FreeTable(list);
+        list = next;
+    }
+}
+
 #ifdef CHAIN_LOOKUP 
 void DispatchCache::PromoteChainEntry(ResolveCacheElem* elem)
 {
@@ -3350,7 +3503,7 @@ void DispatchCache::PromoteChainEntry(ResolveCacheElem* elem)
 
     // Figure out what bucket this element belongs in
     UINT16 tokHash = HashToken(elem->token);
-    UINT16 hash    = HashMT(tokHash, elem->pMT);
+    UINT16 hash    = HashMT(tokHash, elem->pMT, GetCacheMask());
     UINT16 idx     = hash;
 
     ResolveCacheElem *curElem = GetCacheEntry(idx);
@@ -3395,6 +3548,9 @@ void DispatchCache::LogStats()
     g_insert_cache_miss     += stats.insert_cache_miss;
     g_insert_cache_collide  += stats.insert_cache_collide;
     g_insert_cache_write    += stats.insert_cache_write;
+    g_cache_grow            += stats.cache_grow;
+    g_cache_space           += stats.cache_space;
+    g_cache_space_dead      += stats.cache_space_dead;
 
     stats.insert_cache_external = 0;
     stats.insert_cache_shared = 0;
@@ -3404,6 +3560,9 @@ void DispatchCache::LogStats()
     stats.insert_cache_miss = 0;
     stats.insert_cache_collide = 0;
     stats.insert_cache_write = 0;
+    stats.cache_grow = 0;
+    stats.cache_space = 0;
+    stats.cache_space_dead = 0;
 }
 
 /* The following tablse have bits that have the following properties:
@@ -3436,6 +3595,9 @@ static UINT16 tokenHashBits[32] =
     // then we have to recompute the hash function
     // Though making the number of bits smaller should still be OK
     C_ASSERT(CALL_STUB_CACHE_NUM_BITS <= 12);
+    // A grown cache takes the index bits above these from the method table alone,
+    // and the index still has to fit the UINT16 that HashMT returns
+    C_ASSERT(CALL_STUB_CACHE_MAX_NUM_BITS <= 16);
 
     while (token)
     {
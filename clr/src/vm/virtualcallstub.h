@@ -962,6 +962,13 @@ extern UINT32 STUB_COLLIDE_MONO_PCT;
 #define CALL_STUB_CACHE_SIZE 4096 //1024
 #define CALL_STUB_CACHE_MASK (CALL_STUB_CACHE_SIZE-1)
 #define CALL_STUB_CACHE_PROBES 5
+//the cache above is only the initial size, it doubles whenever more than CALL_STUB_CACHE_GROW_PCT
+//percent of its buckets took a collision since the last growth, up to 2^CALL_STUB_CACHE_MAX_NUM_BITS entries
+#define CALL_STUB_CACHE_MAX_NUM_BITS 16
+#define CALL_STUB_CACHE_MAX_SIZE (1 << CALL_STUB_CACHE_MAX_NUM_BITS)
+#define CALL_STUB_CACHE_GROW_PCT 25
+//the slot in front of a cache table links the retired tables
+#define CALL_STUB_CACHE_DEAD_LINK -1
 //min sizes for BucketTable and buckets and the growth and hashing constants
 #define CALL_STUB_MIN_BUCKETS 32
 #define CALL_STUB_MIN_ENTRIES 4
@@ -1218,18 +1225,24 @@ public:
     {
         LEAF_CONTRACT;
 
-        *total = CALL_STUB_CACHE_SIZE;
+        *total = GetCacheCount();
         size_t count = 0;
-        for (size_t i = 0; i < CALL_STUB_CACHE_SIZE; i++)
+        for (size_t i = 0; i < *total; i++)
             if (cache[i] != empty)
                 count++;
         *used = count;
     }
 
-    inline void *GetCacheBaseAddr()
-        { LEAF_CONTRACT; return &cache[0]; }
+    // The resolve stubs load the table and the mask through these addresses on every call
+    // since both change when the cache grows.
+    inline void *GetCacheTableAddr()
+        { LEAF_CONTRACT; return (void *) &cache; }
+    inline size_t *GetCacheMaskAddr()
+        { LEAF_CONTRACT; return (size_t *) &stubMask; }
+    inline size_t GetCacheMask()
+        { LEAF_CONTRACT; return stubMask >> LOG2_PTRSIZE; }
     inline size_t GetCacheCount()
-        { LEAF_CONTRACT; return CALL_STUB_CACHE_SIZE; }
+        { LEAF_CONTRACT; return GetCacheMask() + 1; }
     inline ResolveCacheElem *GetCacheEntry(size_t idx)
         { LEAF_CONTRACT; return *((ResolveCacheElem * volatile *)&cache[idx]); }
     inline BOOL IsCacheEntryEmpty(size_t idx)
@@ -1266,10 +1279,16 @@ public:
         UINT32 insert_cache_miss;         //# of times Insert already had a matching cache entry
         UINT32 insert_cache_collide;      //# of times Insert found a used cache entry
         UINT32 insert_cache_write;        //# of times Insert wrote a cache entry
+        UINT32 cache_grow;                //# of times the cache doubled in size
+        UINT32 cache_space;               //# of bytes of the cache table
+        UINT32 cache_space_dead;          //# of bytes of grown out tables not yet recycled
     } stats;
 
     void LogStats();
 
+    // Frees the tables the cache grew out of; called at a gc sync point, see VirtualCallStubManager::ReclaimAll
+    static void Reclaim();
+
     // Unlocked iterator of entries. Use only when read/write access to the cache
     // is safe. This would typically be at GC sync points, currently needed during
     // appdomain unloading.
@@ -1301,33 +1320,44 @@ public:
 private:
 #ifdef CHAIN_LOOKUP 
     Crst m_writeLock;
+
+    void Grow();
 #endif
 
+    static ResolveCacheElem** AllocTable(size_t count);
+    static void FreeTable(ResolveCacheElem** table);
+
     //the following hash computation is also inlined in the resolve stub in asm (SO NO TOUCHIE)
-    inline static UINT16 HashMT(UINT16 tokenHash, void* mt)
+    inline static UINT16 HashMT(UINT16 tokenHash, void* mt, size_t mask)
     {
         LEAF_CONTRACT;
 
         UINT16 hash;
 
         size_t mtHash = (size_t) mt;
-        mtHash = (((mtHash >> CALL_STUB_CACHE_NUM_BITS) + mtHash) >> LOG2_PTRSIZE) & CALL_STUB_CACHE_MASK;
+        mtHash = (((mtHash >> CALL_STUB_CACHE_NUM_BITS) + mtHash) >> LOG2_PTRSIZE) & mask;
         hash  = (UINT16) mtHash;
 
-        hash ^= (tokenHash & CALL_STUB_CACHE_MASK);
+        hash ^= (tokenHash & mask);
 
         return hash;
     }
 
-    ResolveCacheElem* cache[CALL_STUB_CACHE_SIZE]; //must be first
+    // Readers load stubMask before cache, and Grow stores the new table before the new mask,
+    // so an index is always within the table it is applied to.
+    ResolveCacheElem** volatile cache;
+    size_t volatile stubMask;                   //(number of entries - 1) << LOG2_PTRSIZE, as used by the resolve stubs
+    UINT32 collisions;                          //# of collisions since the last growth
     ResolveCacheElem* empty;                    //empty entry, initialized to fail all comparisons
+
+    static ResolveCacheElem** dead;             //linked list of the tables the cache grew out of
 #ifdef STUB_LOGGING 
 public:
     struct CacheEntryData {
         UINT32 numWrites;
         UINT16 numClears;
     };
-    CacheEntryData cacheData[CALL_STUB_CACHE_SIZE];
+    CacheEntryData cacheData[CALL_STUB_CACHE_MAX_SIZE];
 #endif // STUB_LOGGING
 };
 
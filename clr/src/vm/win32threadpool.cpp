@@ -146,9 +146,11 @@ SVAL_IMPL(DWORD,ThreadpoolMgr,NumTimers);
 
 SVAL_IMPL(long,ThreadpoolMgr,cpuUtilization);
 long    ThreadpoolMgr::cpuUtilizationAverage = 0;
-DWORD    ThreadpoolMgr::CompletedWorkRequests = 0;
-DWORD    ThreadpoolMgr::PriorCompletedWorkRequests = 0;
-float   ThreadpoolMgr::PriorWorkRequestRate = 0;
+LONG    ThreadpoolMgr::CompletedWorkRequests = 0;
+
+SVAL_IMPL(LONG,ThreadpoolMgr,WorkerThreadTarget);           // number of worker threads picked by the hill climbing
+SVAL_IMPL(LONG,ThreadpoolMgr,WorkerThroughput);             // work requests completed per second
+SVAL_IMPL(DWORD,ThreadpoolMgr,WorkerThreadAdjustments);     // number of times WorkerThreadTarget changed
 
 #ifndef DACCESS_COMPILE
 
@@ -161,23 +163,17 @@ float   ThreadpoolMgr::PriorWorkRequestRate = 0;
 
 LONG ThreadpoolMgr::Initialization=0;           // indicator of whether the threadpool is initialized.
 LONG ThreadpoolMgr::ThreadInSuspend=0;          // indicates if a thread has suspended processing
-int ThreadpoolMgr::LastRecordedQueueLength;     // captured by GateThread, used on Win9x to detect thread starvation
 unsigned int ThreadpoolMgr::LastDequeueTime;    // used to determine if work items are getting thread starved
 unsigned int ThreadpoolMgr::LastCompletionTime; // used to determine if io completions are getting thread starved
 unsigned int ThreadpoolMgr::LastSuspendTime;    // to prevent multiple threads from suspending in a short time period
 BOOL ThreadpoolMgr::MonitorWorkRequestsQueue=0; // if 1, the gate thread monitors progress of WorkRequestQueue to prevent starvation due to blocked worker threads
 int ThreadpoolMgr::offset_counter = 0;
 
-unsigned int ThreadpoolMgr::LastWorkerStateTime;    // time of last decision
-ThreadpoolMgr::WorkerCreationState ThreadpoolMgr::LastWorkerCreationState = ThreadpoolMgr::WORKER_None;
-unsigned int ThreadpoolMgr::SequentialRateDecreaseCount = 0;  // used to backoff on thread injection if no progress
-
 #endif //!DACCESS_COMPILE
 
 SPTR_IMPL(WorkRequest,ThreadpoolMgr,WorkRequestHead);        // Head of work request queue
 SPTR_IMPL(WorkRequest,ThreadpoolMgr,WorkRequestTail);        // Head of work request queue
 
-SVAL_IMPL(ThreadpoolMgr::LIST_ENTRY,ThreadpoolMgr,TimerQueue);  // queue of timers
 
 #ifndef DACCESS_COMPILE
 
@@ -200,7 +196,7 @@ DWORD ThreadpoolMgr::NumUnusedEvents=0;                                    // nu
 CrstStatic ThreadpoolMgr::TimerQueueCriticalSection;
 HANDLE ThreadpoolMgr::TimerThread=NULL;
 Thread *ThreadpoolMgr::pTimerThread=NULL;
-DWORD ThreadpoolMgr::LastTickCount;
+ThreadpoolMgr::TimerWheel ThreadpoolMgr::TimerQueue;
 #ifdef _DEBUG
 DWORD ThreadpoolMgr::TickCountAdjustment=0;
 #endif
@@ -209,6 +205,13 @@ LONG  ThreadpoolMgr::GateThreadCreated=GATE_THREAD_STATUS_NOTCREATED;
 
 ThreadpoolMgr::RecycledListsWrapper ThreadpoolMgr::RecycledLists;
 
+BOOL ThreadpoolMgr::UseWorkStealing = TRUE;
+ThreadpoolMgr::WorkStealingQueue* ThreadpoolMgr::WorkStealingQueues = NULL;
+
+HillClimbing ThreadpoolMgr::WorkerHillClimbing;
+unsigned int ThreadpoolMgr::LastHillClimbingSample;
+LPWSTR ThreadpoolMgr::HillClimbingTraceFile = NULL;
+
 ThreadpoolMgr::TimerInfo *ThreadpoolMgr::TimerInfosToBeRecycled = NULL;
 
 
@@ -363,7 +366,7 @@ BOOL ThreadpoolMgr::Initialize()
         InitializeListHead(&EventCache);
 
         // initialize TimerQueue
-        InitializeListHead(&TimerQueue);
+        TimerQueue.Initialize(GetTickCount());
 
         WorkRequestNotification = new CLREvent();
         WorkRequestNotification->CreateManualEvent(FALSE);
@@ -430,6 +433,39 @@ BOOL ThreadpoolMgr::Initialize()
     TickCountAdjustment = EEConfig::GetConfigDWORD(L"ThreadpoolTickCountAdjustment",0);
 #endif
 
+    UseWorkStealing = (EEConfig::GetConfigDWORD(L"ThreadpoolWorkStealing",1) != 0);
+
+    {
+        HillClimbingSettings settings;
+        settings.SamplesPerMove = EEConfig::GetConfigDWORD(L"ThreadpoolHillClimbingSamplesPerMove", HILLCLIMBING_DEFAULT_SAMPLES_PER_MOVE);
+        settings.NoisePercent = EEConfig::GetConfigDWORD(L"ThreadpoolHillClimbingNoisePercent", HILLCLIMBING_DEFAULT_NOISE_PERCENT);
+        settings.MaxHoldSamples = EEConfig::GetConfigDWORD(L"ThreadpoolHillClimbingMaxHoldSamples", HILLCLIMBING_DEFAULT_MAX_HOLD_SAMPLES);
+
+        WorkerHillClimbing.Initialize(settings, MinLimitTotalWorkerThreads);
+        WorkerThreadTarget = MinLimitTotalWorkerThreads;
+        WorkerThroughput = 0;
+        WorkerThreadAdjustments = 0;
+        LastHillClimbingSample = GetTickCount();
+
+        // Record the samples for replaying them offline with tools\tpreplay.
+        // The threadpool is never shut down, so the file is only opened to
+        // append a sample; here it is just emptied.
+        LPWSTR pwzTraceFile = NULL;
+        if (SUCCEEDED(EEConfig::GetConfigString(L"ThreadpoolHillClimbingTrace", &pwzTraceFile)) && pwzTraceFile != NULL)
+        {
+            HANDLE hFile = WszCreateFile(pwzTraceFile, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (hFile != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(hFile);
+                HillClimbingTraceFile = pwzTraceFile;
+            }
+            else
+            {
+                delete [] pwzTraceFile;
+            }
+        }
+    }
+
 #ifdef _LOGTOFILE
     logfile = fopen("c:\\tpool.log","w");
 #endif
@@ -914,6 +950,22 @@ BOOL ThreadpoolMgr::QueueUserWorkItem(LPTHREAD_START_ROUTINE Function,
 
     if (workRequest)
     {
+        // Work queued by a worker thread goes to its own queue, where the same
+        // thread is likely to pick it up again while its data is still in cache.
+        // Count it first, so that an idle worker that sees the count drop to
+        // zero never misses an item that is already in a local queue.
+        WorkStealingQueue* pLocalQueue = GetLocalWorkStealingQueue();
+        BOOL fQueuedLocally = FALSE;
+
+        if (pLocalQueue)
+        {
+            lRequestsQueued = (IncNumQueuedWorkRequests() == 1);
+            fQueuedLocally = pLocalQueue->LocalPush(workRequest);
+            if (!fQueuedLocally)
+                DecNumQueuedWorkRequests();
+        }
+
+        if (!fQueuedLocally)
         {
             CrstHolder csh(&WorkerCriticalSection);
             lRequestsQueued = EnqueueWorkRequest(workRequest);
@@ -1113,8 +1165,10 @@ LONG ThreadpoolMgr::EnqueueWorkRequest(WorkRequest* workRequest)
     CONTRACTL_END;
 
     THREADPOOL_LOG2(TPL_PRIV | TPL_LOG, LL_INFO1000, "Enqueue work request (Function= %x, Context = %x)\n", workRequest->Function, workRequest->Context);
-    AppendWorkRequest(workRequest);
-    if (NumQueuedWorkRequests == 1)
+    // Items pushed to the workers' own queues are counted without taking
+    // WorkerCriticalSection, so only the value returned by the increment
+    // tells whether this request is the one that made the queue non-empty
+    if (AppendWorkRequest(workRequest) == 1)
         return TRUE;
     else
         return FALSE;
@@ -1134,7 +1188,14 @@ WorkRequest* ThreadpoolMgr::DequeueWorkRequest()
 
     entry = RemoveWorkRequest();
     if (NumQueuedWorkRequests == 0)
+    {
         WorkRequestNotification->Reset();
+
+        // Worker threads add to their own queues without taking the lock, so
+        // make sure an item counted since the check above is not left sleeping
+        if (NumQueuedWorkRequests != 0)
+            WorkRequestNotification->Set();
+    }
     if (entry)
     {
         LastDequeueTime = GetTickCount();
@@ -1143,6 +1204,185 @@ WorkRequest* ThreadpoolMgr::DequeueWorkRequest()
     RETURN entry;
 }
 
+// Finds the next work request for a worker thread: first the most recent
+// item of its own queue, then the global queue, and last of all an item
+// stolen from another worker. fIdle says whether the thread is counted in
+// NumIdleWorkerThreads, in which case it stops being idle when it finds work;
+// a busy thread that finds nothing becomes idle.
+WorkRequest* ThreadpoolMgr::DequeueWorkRequestForWorker(WorkStealingQueue* pLocalQueue, BOOL fIdle)
+{
+    WorkRequest* entry = NULL;
+    CONTRACT(WorkRequest*)
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_PREEMPTIVE;
+
+        POSTCONDITION(CheckPointer(entry, NULL_OK));
+    } CONTRACT_END;
+
+    if (pLocalQueue)
+        entry = pLocalQueue->LocalPop();
+
+    // Requests from outside the pool are served in order before anything is
+    // taken from another worker. A worker that couldn't get a queue of its own
+    // still steals, or the items of a blocked worker would only be run by it.
+    if (entry == NULL && UseWorkStealing && WorkRequestHead == NULL)
+        entry = StealWorkRequest(pLocalQueue);
+
+    if (entry)
+    {
+        DecNumQueuedWorkRequests();
+        LastDequeueTime = GetTickCount();
+        THREADPOOL_LOG2(TPL_PRIV | TPL_LOG, LL_INFO1000, "Dequeue local work request (Function= %x, Context = %x)\n", entry->Function, entry->Context);
+
+        if (fIdle)
+        {
+            CrstHolder csh(&WorkerCriticalSection);
+            _ASSERTE(NumIdleWorkerThreads > 0);
+            DecNumIdleWorkerThreads();
+        }
+
+        RETURN entry;
+    }
+
+    CrstHolder csh(&WorkerCriticalSection);
+
+    entry = DequeueWorkRequest();
+
+    if (fIdle && entry != NULL)
+    {
+        _ASSERTE(NumIdleWorkerThreads > 0);
+        DecNumIdleWorkerThreads();
+    }
+    else if (!fIdle && entry == NULL)
+        IncNumIdleWorkerThreads();
+
+    RETURN entry;
+}
+
+// Takes the oldest item from the queue of some other worker, starting with the
+// one after our own so that the thieves do not all go for the same queue. A
+// worker without a queue (pLocalQueue is NULL) walks the list once from the start.
+WorkRequest* ThreadpoolMgr::StealWorkRequest(WorkStealingQueue* pLocalQueue)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    WorkStealingQueue* pQueue = pLocalQueue ? pLocalQueue->m_pNext : WorkStealingQueues;
+
+    for (;;)
+    {
+        if (pQueue == NULL)
+        {
+            if (pLocalQueue == NULL)
+                break;
+            pQueue = WorkStealingQueues;
+        }
+
+        if (pQueue == pLocalQueue)
+            break;
+
+        WorkRequest* entry = pQueue->TrySteal();
+        if (entry)
+            return entry;
+
+        pQueue = pQueue->m_pNext;
+    }
+
+    return NULL;
+}
+
+// Moves the items of a worker that is going away to the global queue, oldest
+// first so that they keep their order. They are already counted in
+// NumQueuedWorkRequests.
+void ThreadpoolMgr::FlushLocalWorkRequests(WorkStealingQueue* pLocalQueue)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    if (pLocalQueue->IsEmpty())
+        return;
+
+    {
+        CrstHolder csh(&WorkerCriticalSection);
+
+        WorkRequest* entry;
+        while ((entry = pLocalQueue->LocalPopOldest()) != NULL)
+        {
+            DecNumQueuedWorkRequests();
+            AppendWorkRequest(entry);
+        }
+    }
+
+    WorkRequestNotification->Set();
+}
+
+ThreadpoolMgr::WorkStealingQueue* ThreadpoolMgr::AcquireWorkStealingQueue()
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    if (!UseWorkStealing)
+        return NULL;
+
+    // Reuse the queue of a worker that has exited
+    for (WorkStealingQueue* pQueue = WorkStealingQueues; pQueue != NULL; pQueue = pQueue->m_pNext)
+    {
+        if (pQueue->m_fInUse == 0 && FastInterlockCompareExchange((LONG*)&pQueue->m_fInUse, 1, 0) == 0)
+            return pQueue;
+    }
+
+    // Without a queue of its own the worker simply uses the global queue
+    WorkStealingQueue* pQueue = new (nothrow) WorkStealingQueue();
+    if (pQueue == NULL)
+        return NULL;
+
+    pQueue->m_fInUse = 1;
+
+    WorkStealingQueue* pHead;
+    do
+    {
+        pHead = WorkStealingQueues;
+        pQueue->m_pNext = pHead;
+    } while (FastInterlockCompareExchangePointer((void**)&WorkStealingQueues, pQueue, pHead) != pHead);
+
+    return pQueue;
+}
+
+void ThreadpoolMgr::ReleaseWorkStealingQueue(WorkStealingQueue* pQueue)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    if (pQueue == NULL)
+        return;
+
+    FlushLocalWorkRequests(pQueue);
+    _ASSERTE(pQueue->IsEmpty());
+
+    FastInterlockExchange((LONG*)&pQueue->m_fInUse, 0);
+}
 
 void ThreadpoolMgr::ExecuteWorkRequest(WorkRequest* workRequest)
 {
@@ -1165,7 +1405,7 @@ void ThreadpoolMgr::ExecuteWorkRequest(WorkRequest* workRequest)
     RecycleMemory( workRequest, MEMTYPE_WorkRequest ); //delete workRequest;
     (wrFunction)(wrContext);
 
-    CompletedWorkRequests++;
+    FastInterlockIncrement(&CompletedWorkRequests);
 
     THREADPOOL_LOG2(TPL_PRIV | TPL_STRESS, LL_INFO1000, "ExecuteWorkRequest: Finished work request (Function= %x, Context = %x)\n", wrFunction, wrContext);
 }
@@ -1269,12 +1509,11 @@ BOOL ThreadpoolMgr::ShouldGrowWorkerThreadPool()
 
 }
 
-#define THROTTLE_RATE  0.10 /* rate by which we increase the delay as number of threads increase */
-
-
-// On Win9x, there are no apis to get cpu utilization, so we fall back on
-// other heuristics
-void ThreadpoolMgr::GrowWorkerThreadPoolIfStarvationSimple()
+// Called by the gate thread every GATE_THREAD_DELAY while work requests are
+// queued. Feeds the hill climbing the throughput since the last call and adds
+// a thread if the pool is below the resulting target. Threads above the target
+// retire in WorkerThreadStart, after finishing their current work request.
+void ThreadpoolMgr::AdjustWorkerThreadPool()
 {
 
     CONTRACTL
@@ -1285,27 +1524,42 @@ void ThreadpoolMgr::GrowWorkerThreadPoolIfStarvationSimple()
     }
     CONTRACTL_END;
 
-    if (NumQueuedWorkRequests == 0 ||
-        (DWORD)NumWorkerThreads >= MaxLimitTotalWorkerThreads)
-        return;
+    unsigned int now = GetTickCount();
+
+    HillClimbingSample sample;
+    sample.ElapsedTime = now - LastHillClimbingSample;
+    sample.Completions = (DWORD) FastInterlockExchange(&CompletedWorkRequests, 0);
+    sample.QueueLength = NumQueuedWorkRequests;
+    sample.ActiveThreads = NumWorkerThreads - NumRetiredWorkerThreads;
+    LastHillClimbingSample = now;
 
-    int  lastQueueLength = LastRecordedQueueLength;
-    LastRecordedQueueLength = NumQueuedWorkRequests;
+    if (HillClimbingTraceFile != NULL)
+        TraceHillClimbingSample(sample);
 
-    // else, we have queued work items, and we haven't
-    // hit the upper limit on the number of worker threads
+    LONG oldTarget = WorkerThreadTarget;
+    LONG newTarget = WorkerHillClimbing.Update(sample, MinLimitTotalWorkerThreads, (LONG)MaxLimitTotalWorkerThreads);
 
-    // if the queue length has decreased since our last time
-    // or not enough delay since we last created a worker thread
-    if ((NumQueuedWorkRequests < lastQueueLength) ||
-    !SufficientDelaySinceLastSample(LastWorkerThreadCreation,NumWorkerThreads, THROTTLE_RATE))
+    WorkerThreadTarget = newTarget;
+    WorkerThroughput = WorkerHillClimbing.GetThroughput();
+    WorkerThreadAdjustments = WorkerHillClimbing.GetAdjustments();
+
+    if (newTarget != oldTarget)
+    {
+        THREADPOOL_LOG3(TPL_PRIV, LL_INFO100, "AdjustWorkerThreadPool: target %d -> %d, throughput %d/sec\n", oldTarget, newTarget, WorkerThroughput);
+    }
+
+    if (NumQueuedWorkRequests == 0 ||
+        sample.ActiveThreads >= newTarget)
         return;
 
     BOOL shouldWakeupWorkerThread = FALSE;
     {
         CrstHolder csh(&WorkerCriticalSection);
-        if ((NumQueuedWorkRequests >= lastQueueLength) && ((DWORD)NumWorkerThreads < MaxLimitTotalWorkerThreads) &&
-            (NumIdleWorkerThreads == NumRetiredWorkerThreads))
+
+        // the idle threads will pick up the work without help
+        if ((NumWorkerThreads - NumRetiredWorkerThreads) < WorkerThreadTarget &&
+            (DWORD)NumWorkerThreads < MaxLimitTotalWorkerThreads &&
+            NumIdleWorkerThreads == NumRetiredWorkerThreads)
         {
             if (NumRetiredWorkerThreads > 0)
             {
@@ -1323,6 +1577,46 @@ void ThreadpoolMgr::GrowWorkerThreadPoolIfStarvationSimple()
 
 }
 
+// Whether a worker thread that just finished a work request is one too many
+// for the target picked by the hill climbing
+BOOL ThreadpoolMgr::ShouldRetireWorkerThread()
+{
+    LEAF_CONTRACT;
+
+    return (NumWorkerThreads - NumRetiredWorkerThreads) > WorkerThreadTarget &&
+           NumWorkerThreads > MinLimitTotalWorkerThreads;
+}
+
+// Appends a sample to the file named by ThreadpoolHillClimbingTrace, one line
+// per sample:  <elapsed ms> <completions> <queue length> <active threads> <target>
+void ThreadpoolMgr::TraceHillClimbingSample(const HillClimbingSample& sample)
+{
+    CONTRACTL
+    {
+        NOTHROW;
+        GC_NOTRIGGER;
+        MODE_ANY;
+    }
+    CONTRACTL_END;
+
+    char line[80];
+    int cch = sprintf_s(line, sizeof(line), "%u %u %d %d %d\n",
+                        sample.ElapsedTime, sample.Completions, sample.QueueLength,
+                        sample.ActiveThreads, WorkerThreadTarget);
+    if (cch <= 0)
+        return;
+
+    HANDLE hFile = WszCreateFile(HillClimbingTraceFile, GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return;
+
+    DWORD cbWritten;
+    if (SetFilePointer(hFile, 0, NULL, FILE_END) != INVALID_SET_FILE_POINTER)
+        WriteFile(hFile, line, cch, &cbWritten, NULL);
+
+    CloseHandle(hFile);
+}
+
 // This is to avoid the 64KB/1MB aliasing problem present on Pentium 4 processors,
 // which can significantly impact performance with HyperThreading enabled
 DWORD __stdcall ThreadpoolMgr::intermediateThreadProc(PVOID arg)
@@ -1572,6 +1866,10 @@ DWORD __stdcall ThreadpoolMgr::WorkerThreadStart(LPVOID lpArgs)
 
     THREADPOOL_LOG1(TPL_PRIV | TPL_STRESS, LL_INFO100, "Worker Thread %x started\n", GetCurrentThreadId());
 
+    // NULL if work stealing is off or the queue could not be allocated
+    WorkStealingQueue* pLocalQueue = AcquireWorkStealingQueue();
+    ClrFlsSetValue(TlsIdx_ThreadpoolWorkQueue, pLocalQueue);
+
 /*
 #ifndef FEATURE_PAL
     HANDLE hThread = NULL;
@@ -1662,17 +1960,9 @@ DWORD __stdcall ThreadpoolMgr::WorkerThreadStart(LPVOID lpArgs)
 
             if (NumQueuedWorkRequests != 0)
             {
-                {
-                    CrstHolder csh(&WorkerCriticalSection);
-
-                    if ( ( workRequest = DequeueWorkRequest() ) != NULL)
-                    {
-                        _ASSERTE(NumIdleWorkerThreads > 0);
-                        DecNumIdleWorkerThreads(); // we found work, decrease the number of idle threads
-                    }
-
-                    // the dequeue operation also resets the WorkRequestNotification event
-                }
+                // if we find work, this decreases the number of idle threads; the
+                // dequeue operation also resets the WorkRequestNotification event
+                workRequest = DequeueWorkRequestForWorker(pLocalQueue, TRUE);
             }
 
             if (!workRequest)
@@ -1708,14 +1998,12 @@ DWORD __stdcall ThreadpoolMgr::WorkerThreadStart(LPVOID lpArgs)
                 if (RunningOnWinNT() &&     // win9x can't obtain cpu utilization
                     ThreadInSuspend == 0)
                 {
-                    // last thread to be injected didn't increase throughput, so terminate
-                    if (LastWorkerCreationState == WORKER_RateDecrease)
+                    // the hill climbing wants fewer threads, so terminate
+                    if (ShouldRetireWorkerThread())
                     {
                         if (InterlockedCompareExchange(&ThreadInSuspend, 1, 0) == 0)
                         {
-                            THREADPOOL_LOG0(TPL_PRIV, LL_INFO100, "WorkerThreadStart: state WORKER_RateDecrease, setting WORKER_PauseInjection and terminating thread\n");
-                            LastWorkerCreationState = WORKER_PauseInjection;
-                            LastWorkerStateTime = GetTickCount();
+                            THREADPOOL_LOG2(TPL_PRIV, LL_INFO100, "WorkerThreadStart: above target (%d threads, target %d), terminating thread\n", NumWorkerThreads, WorkerThreadTarget);
                             shouldTerminate = TRUE;
                             ThreadInSuspend = 0;
                         }
@@ -1739,6 +2027,10 @@ DWORD __stdcall ThreadpoolMgr::WorkerThreadStart(LPVOID lpArgs)
 
                 if (shouldTerminate)
                 {
+                    // hand the work this thread queued for itself to the others
+                    if (pLocalQueue)
+                        FlushLocalWorkRequests(pLocalQueue);
+
                     CrstHolder csh(&WorkerCriticalSection);
                     IncNumIdleWorkerThreads();
                     workRequest = NULL;
@@ -1746,17 +2038,10 @@ DWORD __stdcall ThreadpoolMgr::WorkerThreadStart(LPVOID lpArgs)
                 else
                 {
                     LastThreadDequeueTime = GetTickCount();
-                    {
-                        CrstHolder csh(&WorkerCriticalSection);
-
-                        workRequest = DequeueWorkRequest();
-                        // the dequeue operation resets the WorkRequestNotification event
 
-                        if (workRequest == NULL)
-                        {
-                            IncNumIdleWorkerThreads(); // no more work, increase the number of idle threads
-                        }
-                    }
+                    // if there is no more work, this increases the number of idle threads;
+                    // the dequeue operation resets the WorkRequestNotification event
+                    workRequest = DequeueWorkRequestForWorker(pLocalQueue, FALSE);
                 }
 
                 // Reset TLS etc. for next WorkRequest.
@@ -1824,6 +2109,9 @@ DWORD __stdcall ThreadpoolMgr::WorkerThreadStart(LPVOID lpArgs)
 
     } // for(;;)
 
+    ClrFlsSetValue(TlsIdx_ThreadpoolWorkQueue, NULL);
+    ReleaseWorkStealingQueue(pLocalQueue);
+
     if ( ETW_IS_TRACE_ON(TRACE_LEVEL_INFORMATION) ) {
         ETW_THREADPOOL_INFO Info;
         Info.WorkerThread.Count = NumWorkerThreads;
@@ -2153,7 +2441,8 @@ void ThreadpoolMgr::InsertNewWaitForSelf(WaitInfo* pArgs)
     int index = FindWaitIndex(threadCB, waitInfo->waitHandle);
     _ASSERTE(index >= 0 && index <= threadCB->NumActiveWaits);
 
-    if (index == threadCB->NumActiveWaits)
+    BOOL fNewHandle = (index == threadCB->NumActiveWaits);
+    if (fNewHandle)
     {
         threadCB->waitHandle[threadCB->NumActiveWaits] = waitInfo->waitHandle;
         threadCB->NumActiveWaits++;
@@ -2168,6 +2457,15 @@ void ThreadpoolMgr::InsertNewWaitForSelf(WaitInfo* pArgs)
     _ASSERTE(offsetof(WaitInfo, link) == 0);
     InsertTailList(&(threadCB->waitPointer[index]), (&waitInfo->link));
 
+#ifdef PLATFORM_UNIX
+    if (fNewHandle &&
+        !PAL_WaitSetAdd(threadCB->waitSet, waitInfo->waitHandle, waitInfo->waitHandle))
+    {
+        // bad handle: application error, treated like a failed wait
+        DeactivateNthWait(waitInfo, index);
+    }
+#endif // PLATFORM_UNIX
+
     return;
 }
 
@@ -2259,6 +2557,18 @@ DWORD __stdcall ThreadpoolMgr::WaitThreadStart(LPVOID lpArgs)
         threadCB->threadHandle = NULL;
     }
 
+#ifdef PLATFORM_UNIX
+    if (pThread != NULL)
+    {
+        threadCB->waitSet = PAL_CreateWaitSet();
+        if (threadCB->waitSet == NULL)
+        {
+            threadCB->threadHandle = NULL;
+            pThread = NULL;
+        }
+    }
+#endif // PLATFORM_UNIX
+
     threadCB->startEvent.Set();
 
     if (pThread == NULL)
@@ -2271,6 +2581,10 @@ DWORD __stdcall ThreadpoolMgr::WaitThreadStart(LPVOID lpArgs)
     {
         DWORD status;
         DWORD timeout = 0;
+#ifdef PLATFORM_UNIX
+        PVOID signaledHandles[MAX_SIGNALED_WAITS];
+        DWORD numSignaled = 0;
+#endif // PLATFORM_UNIX
 
         if (threadCB->NumActiveWaits == 0)
         {
@@ -2286,6 +2600,19 @@ DWORD __stdcall ThreadpoolMgr::WaitThreadStart(LPVOID lpArgs)
             // compute minimum timeout. this call also updates the remainingTime field for each wait
             timeout = MinimumRemainingWait(threadCB->waitPointer,threadCB->NumActiveWaits);
 
+#ifdef PLATFORM_UNIX
+            status = PAL_WaitSetWait(threadCB->waitSet,
+                                     timeout,
+                                     TRUE,                          // alertable
+                                     signaledHandles,
+                                     MAX_SIGNALED_WAITS,
+                                     &numSignaled);
+
+            _ASSERTE( (status == WAIT_TIMEOUT) ||
+                      (status == WAIT_IO_COMPLETION) ||
+                      (status == WAIT_OBJECT_0 && numSignaled > 0) ||
+                      (status == WAIT_FAILED));
+#else
             status = WaitForMultipleObjectsEx(  threadCB->NumActiveWaits,
                                                 threadCB->waitHandle,
                                                 FALSE,                      // waitall
@@ -2296,6 +2623,7 @@ DWORD __stdcall ThreadpoolMgr::WaitThreadStart(LPVOID lpArgs)
                       (status == WAIT_IO_COMPLETION) ||
                       (status >= WAIT_OBJECT_0 && status < (DWORD)(WAIT_OBJECT_0 + threadCB->NumActiveWaits))  ||
                       (status == WAIT_FAILED));
+#endif // PLATFORM_UNIX
         }
 
         if (status == WAIT_IO_COMPLETION)
@@ -2324,6 +2652,45 @@ DWORD __stdcall ThreadpoolMgr::WaitThreadStart(LPVOID lpArgs)
                 } while ((PVOID) waitInfo != waitInfoHead);
             }
         }
+#ifdef PLATFORM_UNIX
+        else if (status == WAIT_OBJECT_0)
+        {
+            // The wait set has dropped the registrations of the handles it
+            // returned (and acquired the objects), so put back the handles
+            // that still have active waits once their completion is queued.
+            for (DWORD i = 0; i < numSignaled; i++)
+            {
+                HANDLE waitHandle = (HANDLE) signaledHandles[i];
+                int index = FindWaitIndex(threadCB, waitHandle);
+
+                if (index == threadCB->NumActiveWaits)
+                    continue;
+
+                // as with WaitForMultipleObjects, only the first wait on an
+                // (auto reset) handle is satisfied
+                ProcessWaitCompletion((WaitInfo*) (threadCB->waitPointer[index]).Flink, index, FALSE);
+
+                index = FindWaitIndex(threadCB, waitHandle);
+                if (index == threadCB->NumActiveWaits ||
+                    PAL_WaitSetAdd(threadCB->waitSet, waitHandle, waitHandle))
+                    continue;
+
+                // the handle went bad: remove all the waits on it
+                WaitInfo* waitInfo = (WaitInfo*) (threadCB->waitPointer[index]).Flink;
+                PVOID waitInfoHead = &(threadCB->waitPointer[index]);
+
+                do
+                {
+                    WaitInfo* temp  = (WaitInfo*) waitInfo->link.Flink;
+
+                    DeactivateNthWait(waitInfo,index);
+
+                    waitInfo = temp;
+
+                } while ((PVOID) waitInfo != waitInfoHead);
+            }
+        }
+#else
         else if (status >= WAIT_OBJECT_0 && status < (DWORD)(WAIT_OBJECT_0 + threadCB->NumActiveWaits))
         {
             unsigned index = status - WAIT_OBJECT_0;
@@ -2355,9 +2722,16 @@ DWORD __stdcall ThreadpoolMgr::WaitThreadStart(LPVOID lpArgs)
 
 
         }
+#endif // PLATFORM_UNIX
         else
         {
             _ASSERTE(status == WAIT_FAILED);
+#ifdef PLATFORM_UNIX
+            // PAL_WaitSetAdd checks the handles, so a failed wait set wait is
+            // not caused by one of them. Probing them with WaitForSingleObject
+            // would acquire the ones that are signaled and lose their signals.
+            THREADPOOL_LOG1(TPL_PRIV | TPL_LOG, LL_INFO100, "Wait set wait failed (error %d)\n", GetLastError());
+#else // !PLATFORM_UNIX
             // wait failed: application error
             // find out which wait handle caused the wait to fail
             for (int i = 0; i < threadCB->NumActiveWaits; i++)
@@ -2391,6 +2765,7 @@ DWORD __stdcall ThreadpoolMgr::WaitThreadStart(LPVOID lpArgs)
 
                 break;
             }
+#endif // !PLATFORM_UNIX
         }
     }
     END_SO_INTOLERANT_CODE;
@@ -2567,6 +2942,11 @@ void ThreadpoolMgr::DeactivateNthWait(WaitInfo* waitInfo, DWORD index)
         // initialize the entry just freed
         InitializeListHead(&(threadCB->waitPointer[EndIndex]));
 
+#ifdef PLATFORM_UNIX
+        // fails harmlessly if the wait set already returned the handle
+        PAL_WaitSetRemove(threadCB->waitSet, waitInfo->waitHandle);
+#endif // PLATFORM_UNIX
+
         threadCB->NumActiveWaits-- ;
         InterlockedDecrement(&threadCB->NumWaitHandles);
     }
@@ -3531,7 +3911,7 @@ DWORD __stdcall ThreadpoolMgr::GateThreadStart(LPVOID lpArgs)
 
         if (MonitorWorkRequestsQueue)
         {
-            GrowWorkerThreadPoolIfStarvationSimple();
+            AdjustWorkerThreadPool();
         }
 
         // check to see if gate thread needs to exit
@@ -3756,8 +4136,6 @@ DWORD __stdcall ThreadpoolMgr::TimerThreadStart(LPVOID p)
     pTimerThread = pThread;
     // Timer threads never die
 
-    LastTickCount = GetTickCount();
-
 
     for (;;)
     {
@@ -3849,7 +4227,7 @@ void ThreadpoolMgr::InsertNewTimer(TimerInfo* pArg)
         timerInfo->refCount = 1;
 
         // insert the timer in the queue
-        InsertTailList(&TimerQueue,(&timerInfo->link));
+        TimerQueue.Insert(timerInfo, currentTime);
     }
 
     THREADPOOL_LOG2(TPL_PRIV | TPL_LOG, LL_INFO1000, "Timer created, period= %x, Function = %x\n", timerInfo->Period, timerInfo->Function);
@@ -3859,8 +4237,8 @@ void ThreadpoolMgr::InsertNewTimer(TimerInfo* pArg)
 
 
 // executed by the Timer thread
-// sweeps through the list of timers, readjusting the firing times, queueing APCs for
-// those that have expired, and returns the next firing time interval
+// takes the expired timers off the timer queue, rearming the periodic ones, queues
+// their callbacks, and returns the next firing time interval
 DWORD ThreadpoolMgr::FireTimers()
 {
     CONTRACTL
@@ -3873,45 +4251,28 @@ DWORD ThreadpoolMgr::FireTimers()
 
     DWORD currentTime = GetTickCount();
 
-    DWORD nextFiringInterval = (DWORD) -1;
-
-    for (LIST_ENTRY* node = (LIST_ENTRY*) TimerQueue.Flink;
-         node != &TimerQueue;
-        )
+    TimerInfo* timerInfo;
+    while ((timerInfo = TimerQueue.RemoveExpired(currentTime)) != NULL)
     {
-        TimerInfo* timerInfo = (TimerInfo*) node;
-        node = (LIST_ENTRY*) node->Flink;
-
-        if (TimeExpired(LastTickCount, currentTime, timerInfo->FiringTime))
+        if (timerInfo->Period == 0 || timerInfo->Period == (ULONG) -1)
         {
-            if (timerInfo->Period == 0 || timerInfo->Period == (ULONG) -1)
-            {
-                DeactivateTimer(timerInfo);
-            }
-
-            InterlockedIncrement(&timerInfo->refCount);
-
-            QueueUserWorkItem(AsyncTimerCallbackCompletion,
-                              timerInfo,
-                              QUEUE_ONLY /* TimerInfo take care of deleting*/);
-
-            timerInfo->FiringTime = currentTime+timerInfo->Period;
-
-            if ((timerInfo->Period != 0) && (timerInfo->Period != (ULONG) -1) && (nextFiringInterval > timerInfo->Period))
-                nextFiringInterval = timerInfo->Period;
+            // one shot timer, it is off the queue already
+            timerInfo->state = timerInfo->state & ~TIMER_ACTIVE;
         }
-
         else
         {
-            DWORD firingInterval = TimeInterval(timerInfo->FiringTime,currentTime);
-            if (firingInterval < nextFiringInterval)
-                nextFiringInterval = firingInterval;
+            timerInfo->FiringTime = currentTime+timerInfo->Period;
+            TimerQueue.Insert(timerInfo, currentTime);
         }
-    }
 
-    LastTickCount = currentTime;
+        InterlockedIncrement(&timerInfo->refCount);
+
+        QueueUserWorkItem(AsyncTimerCallbackCompletion,
+                          timerInfo,
+                          QUEUE_ONLY /* TimerInfo take care of deleting*/);
+    }
 
-    return nextFiringInterval;
+    return TimerQueue.GetNextInterval(currentTime);
 }
 
 DWORD __stdcall ThreadpoolMgr::AsyncTimerCallbackCompletion(PVOID pArgs)
@@ -3954,11 +4315,9 @@ void ThreadpoolMgr::DeactivateTimer(TimerInfo* timerInfo)
 {
     LEAF_CONTRACT;
 
-    RemoveEntryList((LIST_ENTRY*) timerInfo);
-
     // This timer info could go into another linked list of timer infos
-    // waiting to be released. Reinitialize the list pointers
-    InitializeListHead(&timerInfo->link);
+    // waiting to be released. Remove reinitializes the list pointers
+    TimerQueue.Remove(timerInfo);
     timerInfo->state = timerInfo->state & ~TIMER_ACTIVE;
 }
 
@@ -4172,16 +4531,21 @@ void ThreadpoolMgr::UpdateTimer(TimerUpdateInfo* pArgs)
 
     delete updateInfo;
 
-    if (! (timerInfo->state & TIMER_ACTIVE))
+    if (timerInfo->state & TIMER_ACTIVE)
+    {
+        // the timer moves to the slot of its new firing time
+        TimerQueue.Remove(timerInfo);
+    }
+    else
     {
         // timer not active (probably a one shot timer that has expired), so activate it
         timerInfo->state |= TIMER_ACTIVE;
         _ASSERTE(timerInfo->refCount >= 1);
-        // insert the timer in the queue
-        InsertTailList(&TimerQueue,(&timerInfo->link));
-
     }
 
+    // insert the timer in the queue
+    TimerQueue.Insert(timerInfo, currentTime);
+
     THREADPOOL_LOG2(TPL_PRIV | TPL_LOG, LL_INFO1000, "Timer changed, period= %x, Function = %x\n", timerInfo->Period, timerInfo->Function);
 
     return;
@@ -4303,5 +4667,292 @@ void ThreadpoolMgr::DeregisterTimer(TimerInfo* pArgs)
     return;
 }
 
+/************************************************************************/
+void ThreadpoolMgr::TimerWheel::Initialize(DWORD currentTime)
+{
+    LEAF_CONTRACT;
+
+    for (DWORD i = 0; i <= NumSlots; i++)
+        InitializeListHead(&m_slots[i]);
+
+    memset(m_bitmap, 0, sizeof(m_bitmap));
+    m_currentTick = currentTime;
+}
+
+void ThreadpoolMgr::TimerWheel::Insert(TimerInfo* timerInfo, DWORD currentTime)
+{
+    LEAF_CONTRACT;
+
+    // The timer thread sleeps without a timeout while there are no timers, and
+    // up to a whole turn of the top level when there are, so m_currentTick can
+    // be days behind currentTime, too far for the difference to fit in a LONG.
+    // With no timers there is nothing to process in between, so start over at
+    // currentTime; otherwise catch up first, which leaves m_currentTick at
+    // currentTime + 1.
+    if (NumTimers == 0)
+        m_currentTick = currentTime;
+    else
+        Advance(currentTime);
+
+    // m_currentTick is now currentTime, or one ahead of it once every tick up
+    // to currentTime has been processed
+    __int64 delay = (__int64)(LONG)(currentTime - m_currentTick) + (DWORD)(timerInfo->FiringTime - currentTime);
+
+    NumTimers++;
+
+    // the tick it is due at has been processed already
+    if (delay < 0)
+    {
+        LinkInto(timerInfo, DueSlot);
+        return;
+    }
+
+    // Longer delays cascade down from the top level early, and are placed
+    // again from their real firing time then
+    if (delay >= MaxDelay)
+        delay = MaxDelay - 1;
+
+    InsertAt(timerInfo, (DWORD)delay);
+}
+
+void ThreadpoolMgr::TimerWheel::Remove(TimerInfo* timerInfo)
+{
+    LEAF_CONTRACT;
+
+    DWORD slot = timerInfo->WheelSlot;
+
+    RemoveEntryList(&timerInfo->link);
+    InitializeListHead(&timerInfo->link);
+
+    if (slot != DueSlot && IsListEmpty(&m_slots[slot]))
+        m_bitmap[slot / 32] &= ~(1 << (slot % 32));
+
+    _ASSERTE(NumTimers > 0);
+    NumTimers--;
+}
+
+ThreadpoolMgr::TimerInfo* ThreadpoolMgr::TimerWheel::RemoveExpired(DWORD currentTime)
+{
+    LEAF_CONTRACT;
+
+    if (IsListEmpty(&m_slots[DueSlot]))
+    {
+        Advance(currentTime);
+
+        if (IsListEmpty(&m_slots[DueSlot]))
+            return NULL;
+    }
+
+    LIST_ENTRY* entry;
+    RemoveHeadList(&m_slots[DueSlot], entry);
+
+    TimerInfo* timerInfo = (TimerInfo*) entry;
+    InitializeListHead(&timerInfo->link);
+
+    _ASSERTE(NumTimers > 0);
+    NumTimers--;
+
+    return timerInfo;
+}
+
+DWORD ThreadpoolMgr::TimerWheel::GetNextInterval(DWORD currentTime)
+{
+    LEAF_CONTRACT;
+
+    if (!IsListEmpty(&m_slots[DueSlot]))
+        return 0;
+
+    if (NumTimers == 0)
+        return INFINITE;
+
+    DWORD base = m_currentTick;
+    DWORD delay = MAXDWORD;             // ticks from m_currentTick
+
+    // a used slot later in this turn of level 0, else the start of the next turn
+    DWORD index = base & (Level0Slots - 1);
+    DWORD next = FindSlot(0, Level0Slots, index);
+    if (next < Level0Slots)
+        delay = next - index;
+    else if (FindSlot(0, Level0Slots, 0) < index)
+        delay = Level0Slots - index;
+
+    // the higher levels only matter when their next used slot is cascaded,
+    // which for the current slot is still to come if m_currentTick starts it
+    for (DWORD level = 1; level < NumLevels; level++)
+    {
+        DWORD shift = LevelShift(level);
+        DWORD first = LevelFirstSlot(level);
+        DWORD pending = ((base & ((1 << shift) - 1)) == 0) ? 0 : 1;
+
+        index = (base >> shift) & (LevelSlots - 1);
+        next = FindSlot(first, LevelSlots, index + pending);
+        if (next == LevelSlots)
+        {
+            next = FindSlot(first, LevelSlots, 0);
+            if (next >= index + pending)
+                continue;               // the level is empty
+            next += LevelSlots;
+        }
+
+        DWORD cascade = (((base >> shift) + (next - index)) << shift) - base;
+        if (cascade < delay)
+            delay = cascade;
+    }
+
+    __int64 interval = (__int64)delay + (LONG)(base - currentTime);
+    if (interval <= 0)
+        return 0;
+    if (interval >= INFINITE)
+        return INFINITE - 1;
+    return (DWORD)interval;
+}
+
+void ThreadpoolMgr::TimerWheel::InsertAt(TimerInfo* timerInfo, DWORD delay)
+{
+    LEAF_CONTRACT;
+
+    _ASSERTE(delay < MaxDelay);
+
+    DWORD tick = m_currentTick + delay;
+    DWORD slot;
+
+    if (delay < Level0Slots)
+    {
+        slot = tick & (Level0Slots - 1);
+    }
+    else
+    {
+        DWORD level = 1;
+        while (level < NumLevels - 1 && delay >= ((DWORD)1 << (LevelShift(level) + LevelBits)))
+            level++;
+
+        slot = LevelFirstSlot(level) + ((tick >> LevelShift(level)) & (LevelSlots - 1));
+    }
+
+    LinkInto(timerInfo, slot);
+}
+
+void ThreadpoolMgr::TimerWheel::LinkInto(TimerInfo* timerInfo, DWORD slot)
+{
+    LEAF_CONTRACT;
+
+    InsertTailList(&m_slots[slot], &timerInfo->link);
+    timerInfo->WheelSlot = slot;
+
+    if (slot != DueSlot)
+        m_bitmap[slot / 32] |= (1 << (slot % 32));
+}
+
+// Moves the timers of every tick up to currentTime to the due list, jumping
+// over the empty slots of level 0
+void ThreadpoolMgr::TimerWheel::Advance(DWORD currentTime)
+{
+    LEAF_CONTRACT;
+
+    if (NumTimers == 0)
+    {
+        // nothing to catch up with, however long the thread slept
+        m_currentTick = currentTime + 1;
+        return;
+    }
+
+    while ((LONG)(currentTime - m_currentTick) >= 0)
+    {
+        DWORD tick = m_currentTick;
+        DWORD index = tick & (Level0Slots - 1);
+
+        if (index == 0)
+            Cascade(tick);
+
+        if (IsSlotUsed(index))
+        {
+            while (!IsListEmpty(&m_slots[index]))
+            {
+                LIST_ENTRY* entry;
+                RemoveHeadList(&m_slots[index], entry);
+                LinkInto((TimerInfo*) entry, DueSlot);
+            }
+            m_bitmap[index / 32] &= ~(1 << (index % 32));
+        }
+
+        // Never past currentTime + 1, so that Insert can place timers relative to it
+        DWORD next = (tick - index) + FindSlot(0, Level0Slots, index + 1);
+        if ((LONG)(next - currentTime) > 1)
+            next = currentTime + 1;
+
+        m_currentTick = next;
+    }
+}
+
+// Places the timers of the slots that come up at tick again, one level lower
+void ThreadpoolMgr::TimerWheel::Cascade(DWORD tick)
+{
+    LEAF_CONTRACT;
+
+    _ASSERTE(tick == m_currentTick);
+
+    for (DWORD level = 1; level < NumLevels; level++)
+    {
+        DWORD index = (tick >> LevelShift(level)) & (LevelSlots - 1);
+        DWORD slot = LevelFirstSlot(level) + index;
+
+        if (IsSlotUsed(slot))
+        {
+            m_bitmap[slot / 32] &= ~(1 << (slot % 32));
+
+            // detach the slot first, InsertAt links into the lower levels
+            LIST_ENTRY pending;
+            pending.Flink = m_slots[slot].Flink;
+            pending.Blink = m_slots[slot].Blink;
+            pending.Flink->Blink = &pending;
+            pending.Blink->Flink = &pending;
+            InitializeListHead(&m_slots[slot]);
+
+            while (!IsListEmpty(&pending))
+            {
+                LIST_ENTRY* entry;
+                RemoveHeadList(&pending, entry);
+
+                TimerInfo* timerInfo = (TimerInfo*) entry;
+                DWORD delay = timerInfo->FiringTime - tick;
+                InsertAt(timerInfo, ((LONG)delay < 0) ? 0 : delay);
+            }
+        }
+
+        // the next level only turns when this one wraps
+        if (index != 0)
+            break;
+    }
+}
+
+// Returns the first used slot in [start, count) of the slots at first, or count
+DWORD ThreadpoolMgr::TimerWheel::FindSlot(DWORD first, DWORD count, DWORD start)
+{
+    LEAF_CONTRACT;
+
+    DWORD i = start;
+    while (i < count)
+    {
+        DWORD bit = first + i;
+        DWORD word = m_bitmap[bit / 32] >> (bit % 32);
+
+        if (word == 0)
+        {
+            i += 32 - (bit % 32);
+            continue;
+        }
+
+        while ((word & 1) == 0)
+        {
+            word >>= 1;
+            i++;
+        }
+
+        return (i < count) ? i : count;
+    }
+
+    return count;
+}
+
 
 #endif // !DACCESS_COMPILE
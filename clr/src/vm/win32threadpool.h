@@ -31,11 +31,20 @@ Revision History:
 
 #include "delegateinfo.h"
 #include "util.hpp"
+#include "hillclimbing.h"
 
 typedef VOID (__stdcall *WAITORTIMERCALLBACK)(PVOID, BOOL);
 
 
+#ifdef PLATFORM_UNIX
+// Wait threads wait on a PAL wait set rather than WaitForMultipleObjects, so
+// the number of waits a thread serves isn't capped at MAXIMUM_WAIT_OBJECTS.
+// The limit bounds the linear scans of the wait arrays.
+#define MAX_WAITHANDLES 4096
+#define MAX_SIGNALED_WAITS 64       // handles taken from the wait set at a time
+#else
 #define MAX_WAITHANDLES 64
+#endif // PLATFORM_UNIX
 
 #define MAX_CACHED_EVENTS 40        // upper limit on number of wait events cached 
 
@@ -56,14 +65,6 @@ const int CpuUtilizationLow =80;                    // inject more threads if be
 const int CpuUtilizationVeryLow =20;                // start shrinking threadpool below this
 
 #define CPU_UTILIZATION_SAMPLES 10                  // number of samples to average
-#define LOW_RATE                    0.02            // 20/sec -- if rate lower than this, don't use injection logic
-#define MEDIUM_RATE                 0.10            // 100/sec -- if rate lower, use low threshold
-#define HIGH_RATE                   0.75            // 750/sec -- if rate lower, use medium threshold, if higher, use high
-#define KEEP_THREAD_THRESHOLD_HIGH_RATE  1.02f     // if rate is greater than this factor, keep thread
-#define KEEP_THREAD_THRESHOLD_MEDIUM_RATE  1.04f   // if rate is greater than this factor, keep thread
-#define KEEP_THREAD_THRESHOLD_LOW_RATE  1.08f      // if rate is greater than this factor, keep thread
-#define THREAD_BACKOFF_THRESHOLD    0.94            // if rate drops more than this, backoff on injection
-#define INJECTION_SKIP_COUNT    2                   // how many samples to skip
 
 
 #define FILETIME_TO_INT64(t) (*(__int64*)&(t))
@@ -261,12 +262,16 @@ private:
         HANDLE          threadHandle;
         DWORD           threadId;
         CLREvent        startEvent;
-        LONG            NumWaitHandles;                 // number of wait objects registered to the thread <=64
+        LONG            NumWaitHandles;                 // number of wait objects registered to the thread <=MAX_WAITHANDLES
         LONG            NumActiveWaits;                 // number of objects, thread is actually waiting on (this may be less than
                                                            // NumWaitHandles since the thread may not have activated some waits
         HANDLE          waitHandle[MAX_WAITHANDLES];    // array of wait handles (copied from waitInfo since 
                                                            // we need them to be contiguous)
         LIST_ENTRY      waitPointer[MAX_WAITHANDLES];   // array of doubly linked list of corresponding waitinfo 
+#ifdef PLATFORM_UNIX
+        PAL_WAIT_SET    waitSet;                        // the handles of waitHandle[], registered with themselves as
+                                                           // context; owned by the wait thread
+#endif // PLATFORM_UNIX
     } ThreadCB;
 
 
@@ -442,6 +447,7 @@ private:
     typedef struct {
         LIST_ENTRY  link;           // doubly linked list of timers
         ULONG FiringTime;           // TickCount of when to fire next
+        DWORD WheelSlot;            // slot of TimerQueue the timer is linked into
         PVOID Function;             // Function to call when timer fires
         PVOID Context;              // Context to pass to function when timer fires
         ULONG Period;
@@ -491,6 +497,75 @@ private:
         ULONG Period ;              // new period
     } TimerUpdateInfo;
 
+#ifndef DACCESS_COMPILE
+
+    // Hierarchical timing wheel holding the active timers. A timer is linked
+    // into the slot for its firing time, so inserting and cancelling it take
+    // constant time. Level 0 has one slot per millisecond for the next 256ms;
+    // each of the four levels above has 64 slots, each slot covering a whole
+    // turn of the level below it. When level 0 wraps, the next slot of level 1
+    // is cascaded into level 0, and so on up. Expired timers are moved to the
+    // due list in batches and handed out one by one. Only the timer thread
+    // touches the wheel (timers are added and changed by APCs), so there is
+    // no lock.
+    class TimerWheel
+    {
+        static const DWORD Level0Bits = 8;
+        static const DWORD LevelBits = 6;
+        static const DWORD NumLevels = 5;
+        static const DWORD Level0Slots = 1 << Level0Bits;
+        static const DWORD LevelSlots = 1 << LevelBits;
+        static const DWORD NumSlots = Level0Slots + (NumLevels - 1) * LevelSlots;
+        static const DWORD DueSlot = NumSlots;      // not part of the wheel, no bitmap bit
+
+        // The top level must not wrap around onto its current slot
+        static const DWORD MaxDelay = (LevelSlots - 1) << (Level0Bits + (NumLevels - 2) * LevelBits);
+
+        LIST_ENTRY  m_slots[NumSlots + 1];          // the wheel, then the due list
+        DWORD       m_bitmap[NumSlots / 32];        // non-empty slots
+        DWORD       m_currentTick;                  // next tick to process
+
+    public:
+        void Initialize(DWORD currentTime);
+
+        // Links the timer in for timerInfo->FiringTime, which was computed from currentTime
+        void Insert(TimerInfo* timerInfo, DWORD currentTime);
+        void Remove(TimerInfo* timerInfo);
+
+        // Unlinks and returns a timer that is due at currentTime, or NULL
+        TimerInfo* RemoveExpired(DWORD currentTime);
+
+        // Milliseconds from currentTime until a timer may be due, INFINITE if none
+        DWORD GetNextInterval(DWORD currentTime);
+
+    private:
+        void InsertAt(TimerInfo* timerInfo, DWORD delay);
+        void LinkInto(TimerInfo* timerInfo, DWORD slot);
+        void Advance(DWORD currentTime);
+        void Cascade(DWORD tick);
+        DWORD FindSlot(DWORD first, DWORD count, DWORD start);
+
+        static DWORD LevelShift(DWORD level)
+        {
+            LEAF_CONTRACT;
+            return Level0Bits + (level - 1) * LevelBits;
+        }
+
+        static DWORD LevelFirstSlot(DWORD level)
+        {
+            LEAF_CONTRACT;
+            return Level0Slots + (level - 1) * LevelSlots;
+        }
+
+        BOOL IsSlotUsed(DWORD slot)
+        {
+            LEAF_CONTRACT;
+            return (m_bitmap[slot / 32] & (1 << (slot % 32))) != 0;
+        }
+    };
+
+#endif // #ifndef DACCESS_COMPILE
+
     // Definitions and data structures to support recycling of high-frequency 
     // memory blocks. We use a spin-lock to access the list
 
@@ -634,6 +709,180 @@ public:
         static ULONG WINAPI FallbackGetCurrentProcessorNumber();
     };
 
+    // Work requests queued by a worker thread go to the worker's own queue
+    // instead of the global one. The owner pushes and pops at the tail (LIFO)
+    // without any lock; idle workers steal from the head (FIFO). The spin lock
+    // is only taken by thieves, and by the owner when it races a thief for
+    // the last item. The queues are never freed, so a thief can walk the list
+    // of queues without synchronizing with worker threads going away.
+    class WorkStealingQueue
+    {
+        static const LONG QueueSize = 256;           // must be a power of 2
+        static const LONG QueueMask = QueueSize - 1;
+
+        WorkRequest* volatile  m_array[QueueSize];
+        volatile LONG          m_head;               // next item to steal
+        volatile LONG          m_tail;               // next free slot for the owner
+        volatile LONG          m_lock;
+
+    public:
+        WorkStealingQueue*     m_pNext;              // all the queues ever created
+        volatile LONG          m_fInUse;             // owned by a worker thread
+
+        WorkStealingQueue()
+        {
+            LEAF_CONTRACT;
+
+            m_head   = 0;
+            m_tail   = 0;
+            m_lock   = 0;
+            m_pNext  = NULL;
+            m_fInUse = 0;
+        }
+
+        FORCEINLINE bool IsEmpty()
+        {
+            LEAF_CONTRACT;
+
+            return m_head >= m_tail;
+        }
+
+        // Owner only. Returns false if the queue is full.
+        FORCEINLINE bool LocalPush(WorkRequest* entry)
+        {
+            LEAF_CONTRACT;
+
+            LONG tail = m_tail;
+
+            // Renormalize the indices before they overflow. Both move down by
+            // the same multiple of the queue size, so the number of items and
+            // the slot each index maps to stay the same.
+            if (tail == MAXLONG)
+            {
+                AcquireLock();
+                LONG delta = m_head & ~QueueMask;
+                m_head = m_head - delta;
+                m_tail = tail = tail - delta;
+                ReleaseLock();
+            }
+
+            // A stale head only makes the queue look fuller than it is
+            if (tail - m_head >= QueueSize)
+                return false;
+
+            m_array[tail & QueueMask] = entry;
+
+            // Publish the item before the new tail
+            FastInterlockExchange((LONG*)&m_tail, tail + 1);
+            return true;
+        }
+
+        // Owner only
+        FORCEINLINE WorkRequest* LocalPop()
+        {
+            LEAF_CONTRACT;
+
+            LONG tail = m_tail;
+            if (m_head >= tail)
+                return NULL;
+
+            // Claim the last item, with a full fence so that a thief sees the
+            // new tail before we look at the head
+            tail -= 1;
+            FastInterlockExchange((LONG*)&m_tail, tail);
+
+            if (m_head <= tail)
+                return m_array[tail & QueueMask];
+
+            // A thief may be taking the same item, settle it under the lock
+            WorkRequest* entry = NULL;
+
+            AcquireLock();
+            if (m_head <= tail)
+                entry = m_array[tail & QueueMask];
+            else
+                m_tail = tail + 1;
+            ReleaseLock();
+
+            return entry;
+        }
+
+        // Any thread but the owner. Gives up rather than wait for the lock.
+        FORCEINLINE WorkRequest* TrySteal()
+        {
+            LEAF_CONTRACT;
+
+            if (IsEmpty())
+                return NULL;
+
+            if (m_lock != 0 || FastInterlockExchange((LONG*)&m_lock, 1) != 0)
+                return NULL;
+
+            return PopHeadLocked();
+        }
+
+        // Owner only, when it hands its items back. Takes the oldest item like
+        // a thief, but waits for the lock instead of giving up.
+        FORCEINLINE WorkRequest* LocalPopOldest()
+        {
+            LEAF_CONTRACT;
+
+            if (IsEmpty())
+                return NULL;
+
+            AcquireLock();
+
+            return PopHeadLocked();
+        }
+
+    private:
+        // Called with the lock held; releases it
+        FORCEINLINE WorkRequest* PopHeadLocked()
+        {
+            LEAF_CONTRACT;
+
+            WorkRequest* entry = NULL;
+
+            LONG head = m_head;
+            FastInterlockExchange((LONG*)&m_head, head + 1);
+
+            if (head < m_tail)
+                entry = m_array[head & QueueMask];
+            else
+                m_head = head;
+
+            ReleaseLock();
+
+            return entry;
+        }
+
+        FORCEINLINE void AcquireLock()
+        {
+            LEAF_CONTRACT;
+
+            unsigned int rounds = 0;
+
+            while (m_lock != 0 || FastInterlockExchange((LONG*)&m_lock, 1) != 0)
+            {
+                YieldProcessor();           // indicate to the processor that we are spinning
+
+                rounds++;
+
+                if ((rounds % 32) == 0)
+                {
+                    __SwitchToThread(0);
+                }
+            }
+        }
+
+        FORCEINLINE void ReleaseLock()
+        {
+            LEAF_CONTRACT;
+
+            m_lock = 0;
+        }
+    };
+
 #endif
 
 // The state transitions are: 000->001  when a work item is queued or a io thread begins executing a callback 
@@ -666,41 +915,62 @@ public:
 
     static void ExecuteWorkRequest(WorkRequest* workRequest);
 
+#ifndef DACCESS_COMPILE
+    static WorkRequest* DequeueWorkRequestForWorker(WorkStealingQueue* pLocalQueue, BOOL fIdle);
+
+    static WorkRequest* StealWorkRequest(WorkStealingQueue* pLocalQueue);
+
+    static void FlushLocalWorkRequests(WorkStealingQueue* pLocalQueue);
+
+    static WorkStealingQueue* AcquireWorkStealingQueue();
+
+    static void ReleaseWorkStealingQueue(WorkStealingQueue* pQueue);
+
+    inline static WorkStealingQueue* GetLocalWorkStealingQueue()
+    {
+        LEAF_CONTRACT;
+        return (WorkStealingQueue*) ClrFlsGetValue(TlsIdx_ThreadpoolWorkQueue);
+    }
+#endif
+
 #ifndef DACCESS_COMPILE
 
-    static inline void IncNumQueuedWorkRequests()
+    // The count covers the global queue and the workers' own queues, so it
+    // is also updated outside of WorkerCriticalSection
+    static inline LONG IncNumQueuedWorkRequests()
 	{
 	    LEAF_CONTRACT;
 	    
-		NumQueuedWorkRequests++;
+		return FastInterlockIncrement(&NumQueuedWorkRequests);
 	}
 
-	static inline void DecNumQueuedWorkRequests()
+	static inline LONG DecNumQueuedWorkRequests()
 	{
 	   LEAF_CONTRACT;
 	   
-		NumQueuedWorkRequests--;
+		return FastInterlockDecrement(&NumQueuedWorkRequests);
 	}
 
  
-    inline static void AppendWorkRequest(WorkRequest* entry)
+    // Returns the new count, so that the caller that made it 1 wakes a worker
+    inline static LONG AppendWorkRequest(WorkRequest* entry)
     {
         LEAF_CONTRACT;
         if (WorkRequestTail)
         {
-            _ASSERTE(WorkRequestHead != NULL && NumQueuedWorkRequests >= 0);
+            _ASSERTE(WorkRequestHead != NULL && NumQueuedWorkRequests > 0);
             WorkRequestTail->next = entry;
         }
         else
         {
-            _ASSERTE(WorkRequestHead == NULL && NumQueuedWorkRequests == 0);
+            _ASSERTE(WorkRequestHead == NULL && NumQueuedWorkRequests >= 0);
             WorkRequestHead = entry;
         }
 
         WorkRequestTail = entry;
         _ASSERTE(WorkRequestTail->next == NULL);
 
-        IncNumQueuedWorkRequests();
+        return IncNumQueuedWorkRequests();
     }
 
     inline static WorkRequest* RemoveWorkRequest()
@@ -729,7 +999,11 @@ public:
     }
 
     static BOOL EnterRetirement();
-    static void GrowWorkerThreadPoolIfStarvationSimple();
+    static void AdjustWorkerThreadPool();
+
+    static BOOL ShouldRetireWorkerThread();
+
+    static void TraceHillClimbingSample(const HillClimbingSample& sample);
 
     static BOOL SuspendProcessing();
 
@@ -851,26 +1125,14 @@ public:
 
     SVAL_DECL(LONG,NumQueuedWorkRequests);               // number of queued work requests
 
-    static int LastRecordedQueueLength;				// captured by GateThread, used on Win9x to detect thread starvation 
     static unsigned int LastDequeueTime;			// used to determine if work items are getting thread starved 
     static unsigned int LastCompletionTime;			// used to determine if last thread can be terminated 
     static unsigned int LastSuspendTime;            // used to determine if it's time for a thread to suspend
-    static unsigned int LastWorkerStateTime;        // used to determine whether to create a thread or not
-    static DWORD CompletedWorkRequests;
-    static DWORD PriorCompletedWorkRequests;
-    static float PriorWorkRequestRate;
-    static unsigned int SequentialRateDecreaseCount;
+    static LONG CompletedWorkRequests;              // sampled and reset by the gate thread
 
-    enum WorkerCreationState
-    {
-        WORKER_None = 0,                            // no activity during last state check
-        WORKER_RateIncrease = 1,                    // thread added during last check
-        WORKER_RateDecrease = 2,                    // marks worker thread for deletion
-        WORKER_Starvation = 3,                      // starvation occurred during last state check
-        WORKER_LowCPU = 4,                          // low cpu detected during last state check
-        WORKER_PauseInjection = 5,                  // backoff on injection logic
-    };
-    static WorkerCreationState LastWorkerCreationState;
+    SVAL_DECL(LONG,WorkerThreadTarget);             // number of worker threads picked by the hill climbing
+    SVAL_DECL(LONG,WorkerThroughput);               // work requests completed per second, as last measured
+    SVAL_DECL(DWORD,WorkerThreadAdjustments);       // number of times WorkerThreadTarget changed
 
     SPTR_DECL(WorkRequest,WorkRequestHead);            // Head of work request queue
     SPTR_DECL(WorkRequest,WorkRequestTail);            // Head of work request queue
@@ -896,12 +1158,13 @@ public:
 
 
     static TimerInfo *TimerInfosToBeRecycled;    // list of delegate infos associated with deleted timers
-    static CrstStatic TimerQueueCriticalSection;  // critical section to synchronize timer queue access
-    SVAL_DECL(LIST_ENTRY,TimerQueue);                       // queue of timers
+    static CrstStatic TimerQueueCriticalSection;  // critical section to synchronize timer thread creation
+#ifndef DACCESS_COMPILE
+    static TimerWheel TimerQueue;                       // active timers, owned by the timer thread
+#endif
     SVAL_DECL(DWORD,NumTimers);                             // number of timers in queue
     static HANDLE TimerThread;                          // Currently we only have one timer thread
     static Thread*  pTimerThread;
-    static DWORD LastTickCount;                         // the count just before timer thread goes to sleep
 
     static BOOL InitCompletionPortThreadpool;           // flag indicating whether completion port threadpool has been initialized
     static HANDLE GlobalCompletionPort;                 // used for binding io completions on file handles
@@ -922,6 +1185,12 @@ public:
 
 #ifndef DACCESS_COMPILE
     static RecycledListsWrapper RecycledLists;
+
+    static BOOL UseWorkStealing;                        // worker threads queue work to their own queue first
+    static HillClimbing WorkerHillClimbing;             // picks WorkerThreadTarget
+    static unsigned int LastHillClimbingSample;         // time of the last sample fed to WorkerHillClimbing
+    static LPWSTR HillClimbingTraceFile;                // samples are appended here for tools\tpreplay
+    static WorkStealingQueue* WorkStealingQueues;       // all the worker queues, never freed
 #endif
 
 #ifdef _DEBUG
@@ -449,6 +449,18 @@ PAL_Random(
         IN OUT LPVOID lpBuffer,
         IN DWORD dwLength);
 
+PALIMPORT
+BOOL
+PALAPI
+PAL_SetFileOwnerOnly(
+        IN HANDLE hFile);
+
+PALIMPORT
+BOOL
+PALAPI
+PAL_IsFileOwnerOnly(
+        IN HANDLE hFile);
+
 typedef LPVOID (__stdcall *PAL_POPTIMIZEDTLSGETTER)();
 
 PALIMPORT
@@ -630,6 +642,8 @@ typedef struct _SECURITY_ATTRIBUTES {
 
 #define GENERIC_READ               (0x80000000L)
 #define GENERIC_WRITE              (0x40000000L)
+#define READ_CONTROL               (0x00020000L)
+#define WRITE_DAC                  (0x00040000L)
 
 #define FILE_SHARE_READ            0x00000001
 #define FILE_SHARE_WRITE           0x00000002
@@ -649,6 +663,7 @@ typedef struct _SECURITY_ATTRIBUTES {
 #define FILE_ATTRIBUTE_NORMAL                   0x00000080
 
 #define FILE_FLAG_WRITE_THROUGH    0x80000000
+#define FILE_FLAG_OVERLAPPED       0x40000000
 #define FILE_FLAG_NO_BUFFERING     0x20000000
 #define FILE_FLAG_RANDOM_ACCESS    0x10000000
 #define FILE_FLAG_SEQUENTIAL_SCAN  0x08000000
@@ -1048,6 +1063,15 @@ ReadFile(
      OUT LPDWORD lpNumberOfBytesRead,
      IN LPOVERLAPPED lpOverlapped);
 
+PALIMPORT
+BOOL
+PALAPI
+GetOverlappedResult(
+     IN HANDLE hFile,
+     IN LPOVERLAPPED lpOverlapped,
+     OUT LPDWORD lpNumberOfBytesTransferred,
+     IN BOOL bWait);
+
 #define STD_INPUT_HANDLE         ((DWORD)-10)
 #define STD_OUTPUT_HANDLE        ((DWORD)-11)
 #define STD_ERROR_HANDLE         ((DWORD)-12)
@@ -1663,6 +1687,56 @@ WaitForMultipleObjectsEx(
              IN DWORD dwMilliseconds,
              IN BOOL bAlertable);
 
+#ifdef PLATFORM_UNIX
+
+/* A wait set lets one thread wait on any number of objects at once. Each
+   object is registered once with a context value; PAL_WaitSetWait returns the
+   contexts of the objects that got signaled and drops their registrations.
+   Removing a registration whose object was signaled but not returned yet 
+   hands the signal back to the object. A wait set belongs to the thread that
+   created it, and only that thread may use it. */
+typedef struct _PAL_WAIT_SET *PAL_WAIT_SET;
+
+PALIMPORT
+PAL_WAIT_SET
+PALAPI
+PAL_CreateWaitSet(
+             VOID);
+
+PALIMPORT
+BOOL
+PALAPI
+PAL_DeleteWaitSet(
+             IN PAL_WAIT_SET hWaitSet);
+
+PALIMPORT
+BOOL
+PALAPI
+PAL_WaitSetAdd(
+             IN PAL_WAIT_SET hWaitSet,
+             IN HANDLE hObject,
+             IN PVOID pvContext);
+
+PALIMPORT
+BOOL
+PALAPI
+PAL_WaitSetRemove(
+             IN PAL_WAIT_SET hWaitSet,
+             IN PVOID pvContext);
+
+PALIMPORT
+DWORD
+PALAPI
+PAL_WaitSetWait(
+             IN PAL_WAIT_SET hWaitSet,
+             IN DWORD dwMilliseconds,
+             IN BOOL bAlertable,
+             OUT PVOID *ppvContexts,
+             IN DWORD nMaxContexts,
+             OUT LPDWORD lpnContexts);
+
+#endif // PLATFORM_UNIX
+
 PALIMPORT
 RHANDLE
 PALAPI
@@ -2858,6 +2932,115 @@ PALAPI
 SetUnhandledExceptionFilter(
                 IN LPTOP_LEVEL_EXCEPTION_FILTER lpTopLevelExceptionFilter);
 
+// The Interlocked functions are compiled inline with gcc, so that callers
+// don't pay a call into the PAL for a single locked instruction. x86 uses
+// the same instructions as the PAL's own implementation; other processors
+// use the gcc atomic builtins (gcc 4.1 and later), which are full barriers
+// except __sync_lock_test_and_set. The PAL still exports the out-of-line
+// versions (arch/*/interlock.*); define PAL_NO_INLINE_INTERLOCKED to call
+// those instead.
+#if !defined(PAL_NO_INLINE_INTERLOCKED) && defined(__GNUC__)
+#if defined(_X86_)
+#define PAL_INLINE_INTERLOCKED 1
+#elif __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1)
+#define PAL_INLINE_INTERLOCKED 1
+#define PAL_INTERLOCKED_BUILTINS 1
+#endif
+#endif // !PAL_NO_INLINE_INTERLOCKED && __GNUC__
+
+#if PAL_INLINE_INTERLOCKED
+
+__inline__ static
+LONG
+InterlockedIncrement(
+             IN OUT LONG volatile *lpAddend)
+{
+#if PAL_INTERLOCKED_BUILTINS
+    return __sync_add_and_fetch(lpAddend, 1);
+#else
+    LONG RetValue;
+
+    __asm__ __volatile__(
+             "lock; xaddl %0,(%1)"
+             : "=r" (RetValue)
+             : "r" (lpAddend), "0" (1)
+             : "memory"
+             );
+
+    return RetValue + 1;
+#endif
+}
+
+__inline__ static
+LONG
+InterlockedDecrement(
+             IN OUT LONG volatile *lpAddend)
+{
+#if PAL_INTERLOCKED_BUILTINS
+    return __sync_sub_and_fetch(lpAddend, 1);
+#else
+    LONG RetValue;
+
+    __asm__ __volatile__(
+             "lock; xaddl %0,(%1)"
+             : "=r" (RetValue)
+             : "r" (lpAddend), "0" (-1)
+             : "memory"
+             );
+
+    return RetValue - 1;
+#endif
+}
+
+__inline__ static
+LONG
+InterlockedExchange(
+            IN OUT LONG volatile *Target,
+            IN LONG Value)
+{
+#if PAL_INTERLOCKED_BUILTINS
+    // __sync_lock_test_and_set is only an acquire barrier
+    __sync_synchronize();
+    return __sync_lock_test_and_set(Target, Value);
+#else
+    LONG result;
+
+    __asm__ __volatile__(
+             "lock; xchgl %0,(%1)"
+             : "=r" (result)
+             : "r" (Target), "0" (Value)
+             : "memory"
+             );
+
+    return result;
+#endif
+}
+
+__inline__ static
+LONG
+InterlockedCompareExchange(
+               IN OUT LONG volatile *Destination,
+               IN LONG Exchange,
+               IN LONG Comperand)
+{
+#if PAL_INTERLOCKED_BUILTINS
+    return __sync_val_compare_and_swap(Destination, Comperand, Exchange);
+#else
+    LONG result;
+
+    __asm__ __volatile__(
+             "lock; cmpxchgl %2,(%1)"
+             : "=a" (result)
+             : "r" (Destination), "r" (Exchange), "0" (Comperand)
+             : "memory"
+             );
+
+    return result;
+#endif
+}
+
+#else // PAL_INLINE_INTERLOCKED
+
 PALIMPORT
 LONG
 PALAPI
@@ -2885,6 +3068,8 @@ InterlockedCompareExchange(
                IN LONG Exchange,
                IN LONG Comperand);
 
+#endif // PAL_INLINE_INTERLOCKED
+
 
 #define InterlockedExchangePointer(Target, Value) \
     ((PVOID)(UINT_PTR)InterlockedExchange((PLONG)(UINT_PTR)(Target), (LONG)(UINT_PTR)(Value)))
@@ -2894,7 +3079,35 @@ InterlockedCompareExchange(
 
 // ROTORTODO -- need to decide whether to support InterlockedExchangeAdd on all platforms
 
-#if defined _M_AMD64
+#if PAL_INLINE_INTERLOCKED
+
+__inline__ static
+VOID
+MemoryBarrier(
+    VOID)
+{
+#if PAL_INTERLOCKED_BUILTINS
+    __sync_synchronize();
+#else
+    LONG Barrier;
+
+    __asm__ __volatile__(
+        "xchg %%eax, %0"
+        :
+        : "m" (Barrier)
+        : "memory", "eax");
+#endif
+}
+
+#elif defined(__GNUC__)
+
+PALIMPORT
+VOID
+PALAPI
+MemoryBarrier(
+    VOID);
+
+#elif defined _M_AMD64
 #define MemoryBarrier __faststorefence
 #elif defined _M_IA64
 #define MemoryBarrier __mf
@@ -2907,12 +3120,29 @@ __forceinline void MemoryBarrier(void) {
 #error Unknown target architecture
 #endif
 
+#if PAL_INLINE_INTERLOCKED && defined(_X86_)
+
+__inline__ static
+VOID
+YieldProcessor(
+    VOID)
+{
+    __asm__ __volatile__ (
+        "rep\n"
+        "nop"
+    );
+}
+
+#else // PAL_INLINE_INTERLOCKED && _X86_
+
 PALIMPORT
 VOID
 PALAPI
 YieldProcessor(
     VOID);
 
+#endif // PAL_INLINE_INTERLOCKED && _X86_
+
 PALIMPORT
 BOOL
 PALAPI
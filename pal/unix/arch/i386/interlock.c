@@ -20,8 +20,14 @@ Abstract:
     Implementation of Interlocked functions for the Intel x86
     platform. These functions are processor dependent.
 
+    rotor_pal.h compiles the same code inline into its callers; these are
+    the exported versions.
+
 --*/
 
+/* get the prototypes instead of the inline versions */
+#define PAL_NO_INLINE_INTERLOCKED
+
 #include "pal/palinternal.h"
 #include "pal/dbgmsg.h"
 
@@ -28,6 +28,8 @@ Abstract:
 #include "pal/file.h"
 #include "pal/filetime.h"
 #include "pal/utils.h"
+#include "pal/socket2.h"
+#include "pal/thread.h"
 
 #include <time.h>
 #include <fcntl.h>
@@ -36,7 +38,9 @@ Abstract:
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/param.h>
+#include <sys/time.h>
 #include <errno.h>
+#include <pthread.h>
 
 typedef enum
 {
@@ -50,7 +54,40 @@ typedef enum
                                  FILE_FLAG_WRITE_THROUGH| \
                                  FILE_FLAG_NO_BUFFERING| \
                                  FILE_FLAG_RANDOM_ACCESS| \
-                                 FILE_FLAG_BACKUP_SEMANTICS)
+                                 FILE_FLAG_BACKUP_SEMANTICS| \
+                                 FILE_FLAG_OVERLAPPED)
+
+/* An overlapped ReadFile or WriteFile on a file opened with
+   FILE_FLAG_OVERLAPPED. It is done with pread/pwrite by one of the
+   threads below, so the file pointer isn't used or changed. */
+typedef struct _FILE_OVERLAPPED_REQUEST
+{
+    LIST_ENTRY Link;
+    HANDLE hFile;
+    file *file_data;           /* locked until the I/O is done */
+    BOOL bWrite;
+    LPVOID lpBuffer;
+    DWORD nNumberOfBytes;
+    UINT64 offset;
+    LPWSAOVERLAPPED lpOverlapped;
+    HANDLE CompletionPort;
+    ULONG_PTR CompletionKey;
+    pal_iocp_completion_packet *packet; /* NULL if nothing is posted */
+    BOOL bUpdateFilePointer;   /* the handle isn't overlapped */
+} FILE_OVERLAPPED_REQUEST;
+
+/* The pool grows when a request finds no idle thread, up to
+   FILE_MAX_IO_THREADS, and a thread exits after being idle for
+   FILE_IO_THREAD_IDLE_TIMEOUT milliseconds. */
+#define FILE_MAX_IO_THREADS          16
+#define FILE_IO_THREAD_IDLE_TIMEOUT  20000
+
+static pthread_mutex_t FILE_io_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t FILE_io_queue_not_empty = PTHREAD_COND_INITIALIZER;
+static LIST_ENTRY FILE_io_queue = { &FILE_io_queue, &FILE_io_queue };
+static int FILE_io_queue_length = 0;
+static int FILE_io_thread_count = 0;
+static int FILE_io_idle_thread_count = 0;
 
 
 SET_DEFAULT_DEBUG_CHANNEL(FILE);
@@ -81,6 +118,17 @@ static BOOL FILEUnlockFileRegion(file *pFileStruct,
 static void FILECleanUpLockedRgn(file *fileStructPtr);
 
 static SHMPTR FILEGetSHMFileLocks(char *filename);
+
+static BOOL FILEStartOverlappedIo(HANDLE hFile, file *file_data, BOOL bWrite,
+                                  LPVOID lpBuffer, DWORD nNumberOfBytes,
+                                  LPDWORD lpNumberOfBytesTransferred,
+                                  LPWSAOVERLAPPED lpOverlapped);
+static void FILEProcessOverlappedRequest(FILE_OVERLAPPED_REQUEST *request,
+                                         LPDWORD lpdwError,
+                                         LPDWORD lpdwTransferred);
+static BOOL FILEQueueOverlappedRequest(FILE_OVERLAPPED_REQUEST *request);
+static DWORD FILEIoThreadMain(LPVOID lpParameter);
+
 /* Static global. The init function must be called
 before any other functions and if it is not successful, 
 no other functions should be done. */
@@ -247,6 +295,11 @@ CreateFileA(
         goto done;
     }
 
+    /* Access to the security descriptor is governed by the owner's uid, not
+       by the handle; PAL_SetFileOwnerOnly and PAL_IsFileOwnerOnly work on
+       any handle. */
+    dwDesiredAccess &= ~(READ_CONTROL | WRITE_DAC);
+
     switch( dwDesiredAccess )
     {
     case 0:
@@ -342,7 +395,7 @@ CreateFileA(
         goto done;
     }
 
-    SHMLock();
+    SHMLockId(SLID_FILE_LOCKS);
     bIsSHMLockSet = TRUE; 
 
     /* check if this file has shared access */
@@ -639,6 +692,7 @@ CreateFileA(
     file_data->dwDesiredAccess = dwDesiredAccess;
     file_data->open_flags = open_flags;
     file_data->open_flags_deviceaccessonly = (dwDesiredAccess == 0);
+    file_data->overlapped = (dwFlagsAndAttributes & FILE_FLAG_OVERLAPPED) != 0;
 
 #ifdef O_DIRECT
     if(CREATE_ALWAYS == dwCreationDisposition)
@@ -710,7 +764,7 @@ done:
     }
     if(bIsSHMLockSet)
     {
-        SHMRelease();
+        SHMReleaseId(SLID_FILE_LOCKS);
     }
 
     if (dwLastError)
@@ -1650,7 +1704,11 @@ Function:
   WriteFileW
 
 Note:
-  lpOverlapped always NULL.
+  With lpOverlapped, the write is done at the offset it gives. On a file
+  opened with FILE_FLAG_OVERLAPPED, it is done by a PAL thread and the
+  function returns FALSE with ERROR_IO_PENDING; the completion is signaled
+  through hEvent and the completion port the file is bound to. Other files
+  are written synchronously.
 
 See MSDN doc.
 --*/
@@ -1681,13 +1739,7 @@ WriteFile(
         dwLastError = ERROR_INVALID_HANDLE;
         goto done;
     }
-    else if ( lpOverlapped )
-    {
-        ASSERT( "lpOverlapped is not NULL, as it should be.\n" );
-        dwLastError = ERROR_INVALID_PARAMETER;
-        goto done;
-    }
-    else if ( !lpNumberOfBytesWritten )
+    else if ( !lpNumberOfBytesWritten && !lpOverlapped )
     {
         ASSERT( "lpNumberOfBytesWritten is NULL\n" );
         dwLastError = ERROR_INVALID_PARAMETER;
@@ -1695,7 +1747,10 @@ WriteFile(
     }
 
     /* as per MSDN doc, this is the first thing done */
-    *lpNumberOfBytesWritten = 0;
+    if ( lpNumberOfBytesWritten )
+    {
+        *lpNumberOfBytesWritten = 0;
+    }
 
     file_data = FILEAcquireFileStruct(hFile);
     if ( !file_data )
@@ -1705,6 +1760,18 @@ WriteFile(
         goto done;
     }
 
+    if ( lpOverlapped )
+    {
+        /* FILEStartOverlappedIo releases the file structure and sets the
+           last error */
+        ret = FILEStartOverlappedIo(hFile, file_data, TRUE, (LPVOID)lpBuffer,
+                                    nNumberOfBytesToWrite,
+                                    lpNumberOfBytesWritten,
+                                    (LPWSAOVERLAPPED)lpOverlapped);
+        file_data = NULL;
+        goto done;
+    }
+
     /* we need to lock the region to be written to avoid locking a region using
        LockFile while writing on it */
     
@@ -1789,7 +1856,10 @@ Function:
   ReadFileW
 
 Note:
-  lpOverlapped always NULL.
+  With lpOverlapped, the read is done at the offset it gives. On a file
+  opened with FILE_FLAG_OVERLAPPED, it is done by a PAL thread and the
+  function returns FALSE with ERROR_IO_PENDING (see WriteFile). Other files
+  are read synchronously.
 
 See MSDN doc.
 --*/
@@ -1822,13 +1892,7 @@ ReadFile(
         dwLastError = ERROR_INVALID_HANDLE;
         goto done;
     }
-    else if ( lpOverlapped )
-    {
-        ASSERT( "lpOverlapped is not NULL, as it should be.\n" );
-        dwLastError = ERROR_INVALID_PARAMETER;
-        goto done;
-    }
-    else if ( !lpNumberOfBytesRead )
+    else if ( !lpNumberOfBytesRead && !lpOverlapped )
     {
         ERROR( "lpNumberOfBytesRead is NULL\n" );
         dwLastError = ERROR_INVALID_PARAMETER;
@@ -1842,7 +1906,10 @@ ReadFile(
     }
 
     /* as per MSDN doc, this is the first thing done */
-    *lpNumberOfBytesRead = 0;
+    if ( lpNumberOfBytesRead )
+    {
+        *lpNumberOfBytesRead = 0;
+    }
 
     file_data = FILEAcquireFileStruct(hFile);
     if ( !file_data )
@@ -1852,6 +1919,17 @@ ReadFile(
         goto done;
     }
 
+    if ( lpOverlapped )
+    {
+        /* FILEStartOverlappedIo releases the file structure and sets the
+           last error */
+        ret = FILEStartOverlappedIo(hFile, file_data, FALSE, lpBuffer,
+                                    nNumberOfBytesToRead, lpNumberOfBytesRead,
+                                    (LPWSAOVERLAPPED)lpOverlapped);
+        file_data = NULL;
+        goto done;
+    }
+
     /* we need to lock the region to be written to avoid locking a region using 
        LockFile while writing on it */
     if (file_data->unix_filename != NULL)                           
@@ -1936,6 +2014,89 @@ done:
 }
 
 
+/*++
+Function:
+  GetOverlappedResult
+
+See MSDN doc.
+
+Note:
+  Waiting needs the hEvent of the OVERLAPPED; the PAL can't wait on
+  the file handle itself.
+--*/
+BOOL
+PALAPI
+GetOverlappedResult(
+     IN HANDLE hFile,
+     IN LPOVERLAPPED lpOverlapped,
+     OUT LPDWORD lpNumberOfBytesTransferred,
+     IN BOOL bWait)
+{
+    LPWSAOVERLAPPED lpWSAOverlapped = (LPWSAOVERLAPPED)lpOverlapped;
+    BOOL ret = FALSE;
+    DWORD dwLastError = 0;
+
+    PERF_ENTRY(GetOverlappedResult);
+    ENTRY("GetOverlappedResult(hFile=%p, lpOverlapped=%p, "
+          "lpNumberOfBytesTransferred=%p, bWait=%d)\n",
+          hFile, lpOverlapped, lpNumberOfBytesTransferred, bWait);
+
+    if ( !lpWSAOverlapped || !lpNumberOfBytesTransferred )
+    {
+        ERROR( "lpOverlapped or lpNumberOfBytesTransferred is NULL\n" );
+        dwLastError = ERROR_INVALID_PARAMETER;
+        goto done;
+    }
+
+    if ( lpWSAOverlapped->Internal == ERROR_IO_PENDING )
+    {
+        if ( !bWait )
+        {
+            TRACE( "The operation is still in progress\n" );
+            dwLastError = ERROR_IO_INCOMPLETE;
+            goto done;
+        }
+
+        if ( lpWSAOverlapped->hEvent == NULL )
+        {
+            ERROR( "Can't wait for an operation without an event\n" );
+            dwLastError = ERROR_INVALID_PARAMETER;
+            goto done;
+        }
+
+        /* the low bit only tells not to post to the completion port */
+        if ( WaitForSingleObject(
+                 (HANDLE)((UINT_PTR)lpWSAOverlapped->hEvent & ~1),
+                 INFINITE) != WAIT_OBJECT_0 )
+        {
+            ERROR( "Waiting for the event failed\n" );
+            goto done;
+        }
+    }
+
+    *lpNumberOfBytesTransferred = lpWSAOverlapped->InternalHigh;
+
+    if ( lpWSAOverlapped->Internal != NO_ERROR )
+    {
+        dwLastError = lpWSAOverlapped->Internal;
+    }
+    else
+    {
+        ret = TRUE;
+    }
+
+done:
+    if (dwLastError)
+    {
+        SetLastError(dwLastError);
+    }
+
+    LOGEXIT("GetOverlappedResult returns BOOL %d\n", ret);
+    PERF_EXIT(GetOverlappedResult);
+    return ret;
+}
+
+
 /*++
 Function:
   GetStdHandle
@@ -2285,6 +2446,113 @@ done:
 }
 
 
+/*++
+Function:
+  PAL_SetFileOwnerOnly
+
+Takes away all access to the file from everybody but its owner. The file
+is created with the default mode, so call this before writing anything
+private into it.
+--*/
+BOOL
+PALAPI
+PAL_SetFileOwnerOnly(
+        IN HANDLE hFile)
+{
+    file *file_data;
+    DWORD dwLastError = 0;
+    BOOL bRet = FALSE;
+
+    PERF_ENTRY(PAL_SetFileOwnerOnly);
+    ENTRY("PAL_SetFileOwnerOnly(hFile=%p)\n", hFile);
+
+    file_data = FILEAcquireFileStruct(hFile);
+    if ( !file_data )
+    {
+        ERROR("Could not extract structure from handle %p\n", hFile);
+        dwLastError = ERROR_INVALID_HANDLE;
+        goto done;
+    }
+
+    if ( fchmod(file_data->unix_fd, S_IRUSR | S_IWUSR) != 0 )
+    {
+        ERROR("fchmod failed of file descriptor %d\n", file_data->unix_fd);
+        dwLastError = FILEGetLastErrorFromErrno();
+        goto done;
+    }
+
+    bRet = TRUE;
+
+done:
+    if (file_data)
+    {
+        FILEReleaseFileStruct(hFile,file_data);
+    }
+    if (dwLastError)
+    {
+        SetLastError(dwLastError);
+    }
+
+    LOGEXIT("PAL_SetFileOwnerOnly returns BOOL %d\n", bRet);
+    PERF_EXIT(PAL_SetFileOwnerOnly);
+    return bRet;
+}
+
+
+/*++
+Function:
+  PAL_IsFileOwnerOnly
+
+Returns TRUE if the file belongs to the current user and nobody else has
+any access to it, i.e. nobody else could have written what it contains.
+--*/
+BOOL
+PALAPI
+PAL_IsFileOwnerOnly(
+        IN HANDLE hFile)
+{
+    file *file_data;
+    struct stat stat_data;
+    DWORD dwLastError = 0;
+    BOOL bRet = FALSE;
+
+    PERF_ENTRY(PAL_IsFileOwnerOnly);
+    ENTRY("PAL_IsFileOwnerOnly(hFile=%p)\n", hFile);
+
+    file_data = FILEAcquireFileStruct(hFile);
+    if ( !file_data )
+    {
+        ERROR("Could not extract structure from handle %p\n", hFile);
+        dwLastError = ERROR_INVALID_HANDLE;
+        goto done;
+    }
+
+    if ( fstat(file_data->unix_fd, &stat_data) != 0 )
+    {
+        ERROR("fstat failed of file descriptor %d\n", file_data->unix_fd);
+        dwLastError = FILEGetLastErrorFromErrno();
+        goto done;
+    }
+
+    bRet = stat_data.st_uid == geteuid() &&
+           (stat_data.st_mode & (S_IRWXG | S_IRWXO)) == 0;
+
+done:
+    if (file_data)
+    {
+        FILEReleaseFileStruct(hFile,file_data);
+    }
+    if (dwLastError)
+    {
+        SetLastError(dwLastError);
+    }
+
+    LOGEXIT("PAL_IsFileOwnerOnly returns BOOL %d\n", bRet);
+    PERF_EXIT(PAL_IsFileOwnerOnly);
+    return bRet;
+}
+
+
 /*++
 Function:
   FlushFileBuffers
@@ -2725,6 +2993,440 @@ void FILEReleaseFileStruct( HANDLE handle, file *file_data )
 }
 
 
+/*++
+Function:
+  FILEBindIoCompletionPort
+
+Associate a file opened with FILE_FLAG_OVERLAPPED with a completion port.
+Returns FALSE, without setting the last error, if the handle isn't such a
+file, so the caller can try it as a socket.
+--*/
+BOOL FILEBindIoCompletionPort( HANDLE hFile, HANDLE CompletionPort,
+                               ULONG_PTR CompletionKey )
+{
+    file *file_data;
+    BOOL bRet = FALSE;
+
+    file_data = FILEAcquireFileStruct(hFile);
+    if ( file_data == NULL )
+    {
+        return FALSE;
+    }
+
+    if ( file_data->overlapped )
+    {
+        /* requests already queued keep the port they were started with */
+        file_data->CompletionKey = CompletionKey;
+        file_data->CompletionPort = CompletionPort;
+        bRet = TRUE;
+    }
+
+    FILEReleaseFileStruct(hFile, file_data);
+    return bRet;
+}
+
+
+/*++
+Function:
+  FILEPositionedIo
+
+Read or write at the given offset, without using the file pointer. A
+write is retried until all of it is done; a read returns what is there,
+and fails with ERROR_HANDLE_EOF at the end of the file.
+
+Returns NO_ERROR or the error of the operation.
+--*/
+static DWORD FILEPositionedIo(file *file_data, BOOL bWrite, LPVOID lpBuffer,
+                              DWORD nNumberOfBytes, UINT64 offset,
+                              LPDWORD lpdwTransferred)
+{
+    DWORD dwTransferred = 0;
+    ssize_t res;
+
+    while ( dwTransferred < nNumberOfBytes )
+    {
+        if ( bWrite )
+        {
+            res = pwrite( file_data->unix_fd, (char *)lpBuffer + dwTransferred,
+                          nNumberOfBytes - dwTransferred,
+                          (off_t)(offset + dwTransferred) );
+        }
+        else
+        {
+            res = pread( file_data->unix_fd, (char *)lpBuffer + dwTransferred,
+                         nNumberOfBytes - dwTransferred,
+                         (off_t)(offset + dwTransferred) );
+        }
+        TRACE("%s() returns %d\n", bWrite ? "pwrite" : "pread", (int)res);
+
+        if ( res < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+
+            *lpdwTransferred = dwTransferred;
+            if ( bWrite )
+            {
+                return FILEGetLastErrorFromErrno();
+            }
+            return (errno == EBADF) ? ERROR_ACCESS_DENIED : ERROR_READ_FAULT;
+        }
+
+        dwTransferred += res;
+
+        if ( !bWrite || res == 0 )
+        {
+            break;
+        }
+    }
+
+    *lpdwTransferred = dwTransferred;
+
+    if ( !bWrite && dwTransferred == 0 && nNumberOfBytes != 0 )
+    {
+        return ERROR_HANDLE_EOF;
+    }
+    if ( bWrite && dwTransferred < nNumberOfBytes )
+    {
+        return ERROR_WRITE_FAULT;
+    }
+    return NO_ERROR;
+}
+
+
+/*++
+Function:
+  FILEProcessOverlappedRequest
+
+Do the I/O of a request, release its file structure and complete it:
+InternalHigh and Internal of the OVERLAPPED get the byte count and the
+error, a packet is posted to the completion port if one was allocated,
+and hEvent is signaled.
+--*/
+static void FILEProcessOverlappedRequest(FILE_OVERLAPPED_REQUEST *request,
+                                         LPDWORD lpdwError,
+                                         LPDWORD lpdwTransferred)
+{
+    file *file_data = request->file_data;
+    LPWSAOVERLAPPED lpOverlapped = request->lpOverlapped;
+    UINT_PTR hEventData;
+    BOOL bLocked = FALSE;
+    DWORD dwTransferred = 0;
+    DWORD dwError;
+
+    /* we need to lock the region to avoid locking it with LockFile while
+       reading or writing it */
+    if ( file_data->unix_filename != NULL )
+    {
+        bLocked = FILELockFileRegion(file_data, request->offset,
+                                     request->nNumberOfBytes, RDWR_LOCK_RGN);
+        if ( bLocked == FALSE )
+        {
+            ERROR("Failed to lock file region !\n");
+            dwError = ERROR_LOCK_VIOLATION;
+            goto complete;
+        }
+    }
+
+    dwError = FILEPositionedIo(file_data, request->bWrite, request->lpBuffer,
+                               request->nNumberOfBytes, request->offset,
+                               &dwTransferred);
+
+    if ( request->bUpdateFilePointer &&
+         lseek(file_data->unix_fd, (off_t)(request->offset + dwTransferred),
+               SEEK_SET) == -1 )
+    {
+        WARN("lseek() failed; errno is %d (%s)\n", errno, strerror(errno));
+    }
+
+    if ( (bLocked == TRUE) &&
+         FILEUnlockFileRegion(file_data, request->offset,
+                              request->nNumberOfBytes, RDWR_LOCK_RGN) == FALSE )
+    {
+        WARN("Failed to unlock the locked region !\n");
+    }
+
+complete:
+    FILEReleaseFileStruct(request->hFile, file_data);
+
+    /* once Internal is set the OVERLAPPED may be reused, so read hEvent
+       first */
+    hEventData = (UINT_PTR)lpOverlapped->hEvent;
+
+    lpOverlapped->InternalHigh = dwTransferred;
+    InterlockedExchange((LONG *)&lpOverlapped->Internal, (LONG)dwError);
+
+    if ( request->packet != NULL )
+    {
+        SOCKPostQueuedCompletionStatus(request->CompletionPort, dwTransferred,
+                                       request->CompletionKey,
+                                       (LPOVERLAPPED)lpOverlapped, dwError,
+                                       request->packet);
+    }
+
+    if ( hEventData != 0 && SetEvent((HANDLE)(hEventData & ~1)) == FALSE )
+    {
+        ASSERT("Could not signal event!\n");
+    }
+
+    *lpdwError = dwError;
+    *lpdwTransferred = dwTransferred;
+}
+
+
+/*++
+Function:
+  FILEStartOverlappedIo
+
+Start a ReadFile or WriteFile given an OVERLAPPED. Takes over the file
+structure locked by the caller and sets the last error.
+
+On a file opened with FILE_FLAG_OVERLAPPED, the request is queued to the
+I/O threads and the function returns FALSE with ERROR_IO_PENDING. Other
+files are read or written right away at the offset of the OVERLAPPED,
+and their file pointer is moved after the data, as on Windows.
+
+A write fails with ERROR_INVALID_PARAMETER if the descriptor was opened
+with O_APPEND, as a standard handle redirected with >> is: pwrite would
+append the data there instead of writing it at the offset.
+--*/
+static BOOL FILEStartOverlappedIo(HANDLE hFile, file *file_data, BOOL bWrite,
+                                  LPVOID lpBuffer, DWORD nNumberOfBytes,
+                                  LPDWORD lpNumberOfBytesTransferred,
+                                  LPWSAOVERLAPPED lpOverlapped)
+{
+    FILE_OVERLAPPED_REQUEST sync_request;
+    FILE_OVERLAPPED_REQUEST *request = &sync_request;
+    UINT_PTR hEventData = (UINT_PTR)lpOverlapped->hEvent;
+    DWORD dwError = NO_ERROR;
+    DWORD dwTransferred = 0;
+
+    if ( hEventData != 0 && ResetEvent((HANDLE)(hEventData & ~1)) == FALSE )
+    {
+        ERROR("Could not reset the event of the OVERLAPPED\n");
+        FILEReleaseFileStruct(hFile, file_data);
+        return FALSE;
+    }
+
+    if ( bWrite )
+    {
+        int fd_flags = fcntl(file_data->unix_fd, F_GETFL);
+
+        if ( fd_flags != -1 && (fd_flags & O_APPEND) )
+        {
+            ERROR("file descriptor %d is in append mode, can't write at an "
+                  "explicit offset\n", file_data->unix_fd);
+            dwError = ERROR_INVALID_PARAMETER;
+            goto failed;
+        }
+    }
+
+    if ( file_data->overlapped )
+    {
+        request = (FILE_OVERLAPPED_REQUEST *)malloc(sizeof(FILE_OVERLAPPED_REQUEST));
+        if ( request == NULL )
+        {
+            ERROR("Couldn't allocate the overlapped I/O request\n");
+            dwError = ERROR_NOT_ENOUGH_MEMORY;
+            goto failed;
+        }
+    }
+
+    request->hFile = hFile;
+    request->file_data = file_data;
+    request->bWrite = bWrite;
+    request->lpBuffer = lpBuffer;
+    request->nNumberOfBytes = nNumberOfBytes;
+    request->offset = ((UINT64)lpOverlapped->OffsetHigh << 32) |
+                      lpOverlapped->Offset;
+    request->lpOverlapped = lpOverlapped;
+    request->CompletionPort = file_data->CompletionPort;
+    request->CompletionKey = file_data->CompletionKey;
+    request->packet = NULL;
+    request->bUpdateFilePointer = !file_data->overlapped;
+
+    lpOverlapped->InternalHigh = 0;
+    lpOverlapped->Internal = ERROR_IO_PENDING;
+
+    if ( !file_data->overlapped )
+    {
+        FILEProcessOverlappedRequest(request, &dwError, &dwTransferred);
+        if ( lpNumberOfBytesTransferred )
+        {
+            *lpNumberOfBytesTransferred = dwTransferred;
+        }
+        if ( dwError != NO_ERROR )
+        {
+            SetLastError(dwError);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    /* as with sockets, setting the low bit of hEvent keeps the completion
+       off the port */
+    if ( request->CompletionPort != NULL &&
+         (hEventData == 0 || (hEventData & 1) == 0) )
+    {
+        request->packet = (pal_iocp_completion_packet *)
+            malloc(sizeof(pal_iocp_completion_packet));
+        if ( request->packet == NULL )
+        {
+            ERROR("Couldn't allocate internal copy of I/O completion packet\n");
+            free(request);
+            dwError = ERROR_NOT_ENOUGH_MEMORY;
+            goto failed;
+        }
+    }
+
+    if ( !FILEQueueOverlappedRequest(request) )
+    {
+        free(request->packet);
+        free(request);
+        dwError = ERROR_NOT_ENOUGH_MEMORY;
+        goto failed;
+    }
+
+    SetLastError(ERROR_IO_PENDING);
+    return FALSE;
+
+failed:
+    lpOverlapped->Internal = dwError;
+    FILEReleaseFileStruct(hFile, file_data);
+    SetLastError(dwError);
+    return FALSE;
+}
+
+
+/*++
+Function:
+  FILEQueueOverlappedRequest
+
+Hand a request to the I/O threads, starting one if none is idle.
+Returns FALSE if there is no thread to do it.
+--*/
+static BOOL FILEQueueOverlappedRequest(FILE_OVERLAPPED_REQUEST *request)
+{
+    BOOL bStartThread = FALSE;
+    BOOL bRet = TRUE;
+    HANDLE hThread;
+    DWORD dwThreadId;
+
+    pthread_mutex_lock(&FILE_io_mutex);
+
+    InsertTailList(&FILE_io_queue, &request->Link);
+    FILE_io_queue_length++;
+
+    if ( FILE_io_queue_length <= FILE_io_idle_thread_count )
+    {
+        pthread_cond_signal(&FILE_io_queue_not_empty);
+    }
+    else if ( FILE_io_thread_count < FILE_MAX_IO_THREADS )
+    {
+        FILE_io_thread_count++;
+        bStartThread = TRUE;
+    }
+
+    pthread_mutex_unlock(&FILE_io_mutex);
+
+    if ( !bStartThread )
+    {
+        return TRUE;
+    }
+
+    hThread = CreateInternalThread(NULL, 0,
+                                   (LPTHREAD_START_ROUTINE)FILEIoThreadMain,
+                                   NULL, 0, &dwThreadId);
+    if ( hThread != NULL )
+    {
+        CloseHandle(hThread);
+        return TRUE;
+    }
+
+    ERROR("Couldn't create an overlapped I/O thread\n");
+
+    /* the threads already running will get to the request, unless there
+       are none */
+    pthread_mutex_lock(&FILE_io_mutex);
+    FILE_io_thread_count--;
+    if ( FILE_io_thread_count == 0 )
+    {
+        RemoveEntryList(&request->Link);
+        FILE_io_queue_length--;
+        bRet = FALSE;
+    }
+    pthread_mutex_unlock(&FILE_io_mutex);
+
+    return bRet;
+}
+
+
+/*++
+Function:
+  FILEIoThreadMain
+
+Thread procedure of the overlapped file I/O threads.
+--*/
+static DWORD FILEIoThreadMain(LPVOID lpParameter)
+{
+    FILE_OVERLAPPED_REQUEST *request;
+    LIST_ENTRY *pEntry;
+    struct timeval tv;
+    struct timespec deadline;
+    DWORD dwError;
+    DWORD dwTransferred;
+    int rtn;
+
+    pthread_mutex_lock(&FILE_io_mutex);
+
+    while (1)
+    {
+        while ( IsListEmpty(&FILE_io_queue) )
+        {
+            gettimeofday(&tv, NULL);
+            deadline.tv_sec = tv.tv_sec + FILE_IO_THREAD_IDLE_TIMEOUT / 1000;
+            deadline.tv_nsec = tv.tv_usec * 1000 +
+                               (FILE_IO_THREAD_IDLE_TIMEOUT % 1000) * 1000000;
+            if ( deadline.tv_nsec >= 1000000000 )
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+
+            FILE_io_idle_thread_count++;
+            rtn = pthread_cond_timedwait(&FILE_io_queue_not_empty,
+                                         &FILE_io_mutex, &deadline);
+            FILE_io_idle_thread_count--;
+
+            if ( rtn == ETIMEDOUT && IsListEmpty(&FILE_io_queue) )
+            {
+                FILE_io_thread_count--;
+                pthread_mutex_unlock(&FILE_io_mutex);
+
+                TRACE("Overlapped I/O thread terminating.\n");
+
+                /* don't call ExitThread, we don't want to call DllMain */
+                TerminateCurrentThread(0);
+            }
+        }
+
+        pEntry = RemoveHeadList(&FILE_io_queue);
+        FILE_io_queue_length--;
+        pthread_mutex_unlock(&FILE_io_mutex);
+
+        request = CONTAINING_RECORD(pEntry, FILE_OVERLAPPED_REQUEST, Link);
+        FILEProcessOverlappedRequest(request, &dwError, &dwTransferred);
+        free(request);
+
+        pthread_mutex_lock(&FILE_io_mutex);
+    }
+
+    return 0;
+}
+
+
 /*++
 Function:
   FILENewFileData
@@ -2754,6 +3456,9 @@ static file *FILENewFileData( void )
     data->open_flags_deviceaccessonly = FALSE;
     data->unix_fd = -1;
     data->inheritable = FALSE;
+    data->overlapped = FALSE;
+    data->CompletionPort = NULL;
+    data->CompletionKey = 0;
 
     return data;
 }
@@ -2891,7 +3596,7 @@ static int FILEDuplicateHandle( HANDLE handle, HOBJSTRUCT *handle_data)
         }
     }
 
-    SHMLock();
+    SHMLockId(SLID_FILE_LOCKS);
     SHM_Locked = TRUE;
 
     if (SHMPTR_TO_PTR_BOOL(fileLocks, file_data->shmFileLocks) == FALSE)
@@ -2911,7 +3616,7 @@ static int FILEDuplicateHandle( HANDLE handle, HOBJSTRUCT *handle_data)
         fileLocks->refCount++;
     }
 
-    SHMRelease();
+    SHMReleaseId(SLID_FILE_LOCKS);
     SHM_Locked = FALSE;
 
     if(!HMGRReplaceHandleData(handle, (HOBJSTRUCT *) data))
@@ -2925,7 +3630,7 @@ static int FILEDuplicateHandle( HANDLE handle, HOBJSTRUCT *handle_data)
 
 EXIT:
     if ( SHM_Locked == TRUE );
-       SHMRelease();
+       SHMReleaseId(SLID_FILE_LOCKS);
 
     if ( data != NULL )
     {
@@ -3542,7 +4247,7 @@ FILELockFileRegion(file *pFileStruct,
                      lockRgn, fakeLock = {0,0,0,0};
     SHMFILELOCKS *fileLocks;
 
-    SHMLock();
+    SHMLockId(SLID_FILE_LOCKS);
 
     /* make sure we don't have a pipe handle or std file handle */
     if (pFileStruct->unix_filename == NULL)        
@@ -3678,7 +4383,7 @@ FILELockFileRegion(file *pFileStruct,
     
     bRet = TRUE;
 EXIT:
-    SHMRelease();
+    SHMReleaseId(SLID_FILE_LOCKS);
     return bRet;
 }
 
@@ -3707,7 +4412,7 @@ FILEUnlockFileRegion(file *pFileStruct,
 
     BOOL bRet = FALSE;
 
-    SHMLock();
+    SHMLockId(SLID_FILE_LOCKS);
 
     /* make sure we don't have a pipe handle or std file handle */
     if (pFileStruct->unix_filename == NULL)        
@@ -3794,7 +4499,7 @@ FILEUnlockFileRegion(file *pFileStruct,
     }
     
 EXIT:    
-    SHMRelease();
+    SHMReleaseId(SLID_FILE_LOCKS);
     return bRet;
 }
 
@@ -3818,7 +4523,7 @@ FILEGetSHMFileLocks(char *filename)
     SHMFILELOCKS *filelocksPtr, *nextFilelocksPtr;
     char *unix_filename;
 
-    SHMLock();
+    SHMLockId(SLID_FILE_LOCKS);
 
     shmPtrRet = SHMGetInfo(SIID_FILE_LOCKS);
 
@@ -3907,7 +4612,7 @@ CLEANUP1:
     SHMfree(shmPtrRet);
     shmPtrRet = 0;
 EXIT:    
-    SHMRelease();
+    SHMReleaseId(SLID_FILE_LOCKS);
     return shmPtrRet;
 }
 
@@ -3943,7 +4648,7 @@ FILEAddNewLockedRgn(SHMFILELOCKS* fileLocks,
         return FALSE;
     }
 
-    SHMLock();
+    SHMLockId(SLID_FILE_LOCKS);
     
     /* Create a new entry for the new locked region */
     TRACE("Create a new entry for the new lock region (%I64u %I64u)\n", 
@@ -4023,7 +4728,7 @@ FILEAddNewLockedRgn(SHMFILELOCKS* fileLocks,
 CLEANUP:
     SHMfree(shmNewLockRgn);
 EXIT:    
-    SHMRelease();
+    SHMReleaseId(SLID_FILE_LOCKS);
     return bRet;
 }
 
@@ -4049,7 +4754,7 @@ FILECleanUpLockedRgn(file *fileStructPtr)
         return;
     }
 
-    SHMLock();
+    SHMLockId(SLID_FILE_LOCKS);
 
     if (SHMPTR_TO_PTR_BOOL(fileLocks, fileStructPtr->shmFileLocks) == FALSE)
     {
@@ -4157,7 +4862,7 @@ FILECleanUpLockedRgn(file *fileStructPtr)
         }
     }    
 EXIT:
-    SHMRelease();
+    SHMReleaseId(SLID_FILE_LOCKS);
     return;
 }
 
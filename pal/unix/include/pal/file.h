@@ -62,6 +62,9 @@ typedef struct _file
     char *unix_filename;
     SHMPTR shmFileLocks;
     BOOL inheritable;
+    BOOL overlapped;          /* opened with FILE_FLAG_OVERLAPPED */
+    HANDLE CompletionPort;    /* set by PAL_CreateIoCompletionPort */
+    ULONG_PTR CompletionKey;
 } file;
 
 typedef struct _find_handle
@@ -134,6 +137,17 @@ to FILEAcquireFileStruct.
 --*/
 void FILEReleaseFileStruct( HANDLE handle, file *file_data );
 
+/*++
+Function:
+  FILEBindIoCompletionPort
+
+Associate a file opened with FILE_FLAG_OVERLAPPED with a completion port;
+its overlapped reads and writes are then reported to the port. Returns
+FALSE, without setting the last error, if the handle isn't such a file.
+--*/
+BOOL FILEBindIoCompletionPort( HANDLE hFile, HANDLE CompletionPort,
+                               ULONG_PTR CompletionKey );
+
 /*++
 FILECanonicalizeRealPath
     Wraps realpath() to hide platform differences. See the man page for
@@ -63,6 +63,7 @@ Function :
 Parameters
     IN hMutex   mutex checked to see if it is signaled
     SHMPTR wait_state : shared memory pointer to waiting thread's wait state
+    int blockingPipe : pipe to write to when the object wakes the waiter up
 
 returns
     -1: an error occurred, SetLastError is called in this function.
@@ -72,15 +73,15 @@ returns
        holding it
 --*/
 
-INT MutexWaitOn( IN HANDLE hMutex, SHMPTR wait_state );
+INT MutexWaitOn( IN HANDLE hMutex, SHMPTR wait_state, int blockingPipe );
 
 /*++
 Function :
 
     MutexRemoveWaitingThread
 
-        Remove the CurrentThreadId from the list of waiting thread. This
-        function is called when the current thread stops waiting on a Mutex
+        Remove the waiter queued with wait_state from the list of waiting
+        thread. This function is called when the current thread stops waiting on a Mutex
         for a different reason than the Mutex was signaled. (e.g. a timeout,
         or the thread was waiting on multiple objects and another object was
         signaled)
@@ -88,6 +89,7 @@ Function :
 Parameters
     
         IN hMutex   mutex which the waiting thread list is updated
+        SHMPTR wait_state : wait state the waiter was queued with
 
 Returns
         -1: an error occurred
@@ -95,7 +97,7 @@ Returns
         1: if the thread was removed from the waiting list.
 --*/
 
-int MutexRemoveWaitingThread( IN HANDLE hMutex );
+int MutexRemoveWaitingThread( IN HANDLE hMutex, SHMPTR wait_state );
 
 typedef struct _MHO 
 {
@@ -28,6 +28,8 @@ shared memory, since those will not be valid for other processes. If you need
 to construct linked lists or other strctures that usually use pointers, use
 SHMPTR values instead of pointers. In addition, Lock/Release functions must be
 used when manipulating data in shared memory, to ensure inter-process synchronization.
+There is one lock for each part of shared memory (see SHM_LOCK_ID); SHMLock
+takes the one for the shared objects.
 
 Example :
 
@@ -92,6 +94,20 @@ typedef enum {
     SIID_LAST
 } SHM_INFO_ID;
 
+/*
+Locks on shared memory. Each one protects separate data, so that threads
+working on unrelated data don't wait for each other. A thread that needs more
+than one takes them in this order.
+ */
+typedef enum
+{
+    SLID_OBJECTS,       /* named objects, processes and remote handles */
+    SLID_FILE_LOCKS,    /* file lock regions (SIID_FILE_LOCKS) */
+    SLID_POOLS,         /* memory pools and segments; taken by SHMalloc/SHMfree */
+
+    SLID_LAST
+} SHM_LOCK_ID;
+
 typedef enum
 {
     SHM_NAMED_MAPPINGS,      /* structs with map name, file name & flags? */
@@ -127,10 +143,12 @@ validation (if segment is unknown, we have to call the function)
 
 #else /* !_DEBUG */
 
-extern int shm_numsegments;
+/* the table is read without any lock : the count is only incremented once 
+   the new segment's address is stored (see SHMPublishSegment) */
+extern volatile int shm_numsegments;
 
 /* array containing the base address of each segment */
-extern LPVOID shm_segment_bases[MAX_SEGMENTS];
+extern LPVOID volatile shm_segment_bases[MAX_SEGMENTS];
 
 #define SHMPTR_TO_PTR(shmptr)\
     ((LPVOID)((shmptr)?((((shmptr)>>24)<shm_numsegments)?\
@@ -207,7 +225,8 @@ void SHMfree(SHMPTR shmptr);
 /*++
 SHMLock
 
-Restrict shared memory access to the current thread of the current process
+Restrict access to the shared objects (SLID_OBJECTS) to the current thread of
+the current process
 
 (no parameters)
 
@@ -228,6 +247,33 @@ Return value :
 --*/
 int SHMRelease(void);
 
+/*++
+SHMLockId
+
+Restrict access to the part of shared memory protected by the given lock to the
+current thread of the current process
+
+Parameters :
+    SHM_LOCK_ID lock : lock to take
+
+Return value :
+    New lock count
+--*/
+int SHMLockId(SHM_LOCK_ID lock);
+
+/*++
+SHMReleaseId
+
+Release a lock on shared memory taken with SHMLockId.
+
+Parameters :
+    SHM_LOCK_ID lock : lock to release
+
+Return value :
+    New lock count
+--*/
+int SHMReleaseId(SHM_LOCK_ID lock);
+
 
 /*++
 Function :
@@ -242,7 +288,8 @@ Return value :
     Value of specified element
 
 Notes :
-    The SHM lock should be held while manipulating shared memory
+    The SHM lock protecting the element (see SHM_LOCK_ID) should be held
+    while manipulating shared memory
 --*/
 SHMPTR SHMGetInfo(SHM_INFO_ID element);
 
@@ -260,7 +307,8 @@ Return value :
     TRUE if successfull, FALSE otherwise.
 
 Notes :
-    The SHM lock should be held while manipulating shared memory
+    The SHM lock protecting the element (see SHM_LOCK_ID) should be held
+    while manipulating shared memory
 --*/
 BOOL SHMSetInfo(SHM_INFO_ID element, SHMPTR value);
 
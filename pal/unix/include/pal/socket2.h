@@ -106,6 +106,7 @@ typedef struct _pal_iocp_completion_packet
     DWORD dwNumberOfBytesTransferred;
     ULONG_PTR CompletionKey;
     LPOVERLAPPED lpOverlapped;
+    DWORD dwErrorCode; /* non zero makes GetQueuedCompletionStatus fail */
 } pal_iocp_completion_packet;
 
 typedef struct _ws2_op_sendto
@@ -440,6 +441,22 @@ SOCKAllocateCompletionPacket(
     LPWSAOVERLAPPED lpOverlapped,
     pal_iocp_completion_packet **lppIOCPCompletionPacket);
 
+/*++
+Function:
+  SOCKPostQueuedCompletionStatus
+
+  Queue a completion packet, allocated by the caller, to the global
+  completion port. Also used for the overlapped file I/O (file/file.c).
+--*/
+BOOL
+SOCKPostQueuedCompletionStatus(
+    HANDLE CompletionPort,
+    DWORD dwNumberOfBytesTransferred,
+    ULONG_PTR CompletionKey,
+    LPOVERLAPPED lpOverlapped,
+    DWORD dwErrorCode,
+    pal_iocp_completion_packet *lpIOCPCompletionPacket);
+
 /*++
 Function:
   SOCKIsValidSocket
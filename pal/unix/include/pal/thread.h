@@ -94,10 +94,40 @@ typedef enum
     TWS_WAITING,
     TWS_ALERTABLE,
     TWS_EARLYDEATH,
+    TWS_SETWAITING,     /* wait set registration, not woken up yet */
+    TWS_SETREADY,       /* wait set registration woken up by its object */
 
     TWS_NONE
 } THREAD_WAIT_STATE;
 
+/* Wait block of a thread (THREAD.waitAwakened). It lives in shared memory so
+   that objects in other processes can wake the thread up, and the waiting
+   lists only keep the address of its first member, the THREAD_WAIT_STATE. */
+typedef struct _THREAD_WAIT_BLOCK
+{
+    DWORD state;            /* THREAD_WAIT_STATE */
+    DWORD wakeupCode;       /* WAKEUPTHREAD_CODE; futex word, WUTC_NONE until
+                               the thread is woken up */
+    BOOL  bBlockWait;       /* TRUE while the thread sleeps on wakeupCode
+                               instead of its blocking pipe */
+#if HAVE_EVFILT_USER
+    int   waitKqueue;       /* kqueue the thread sleeps on, -1 until its 
+                               first wait; only valid in its own process */
+#endif  /* HAVE_EVFILT_USER */
+} THREAD_WAIT_BLOCK;
+
+/* blocking pipe value of a waiter that sleeps on the wakeupCode of its
+   THREAD_WAIT_BLOCK (see WakeUpThread) */
+#define WAIT_BLOCK_PIPE (-2)
+
+/* waiters sleep on their wait block with a futex, or with a kqueue user
+   event; without either, they sleep on their blocking pipe */
+#if HAVE_FUTEX || HAVE_EVFILT_USER
+#define HAVE_WAIT_BLOCK_WAKEUP 1
+#else   /* HAVE_FUTEX || HAVE_EVFILT_USER */
+#define HAVE_WAIT_BLOCK_WAKEUP 0
+#endif  /* HAVE_FUTEX || HAVE_EVFILT_USER */
+
 
 
 
@@ -427,34 +457,37 @@ Function:
 Parameters:
     IN hThread: handle of the thread to check for termination.
     SHMPTR wait_state : shared memory pointer to waiting thread's wait state
+    int blockingPipe : pipe to write to when the object wakes the waiter up,
+                       or WAIT_BLOCK_PIPE
 
 returns
     -1: an error occurred, SetLastError is called in this function.
     0: the thread has terminated.
     1: the thread is still running
 --*/
-int ThreadWaitOn(IN HANDLE hThread, SHMPTR wait_state);
+int ThreadWaitOn(IN HANDLE hThread, SHMPTR wait_state, int blockingPipe);
 
 
 /*++
 Function:
   ThreadRemoveWaitingThread
 
-  Remove the CurrentThreadId from the list of waiting thread. This
-  function is called when the current thread stops waiting on a Thread
+  Remove the waiter queued with wait_state from the list of waiting thread.
+  This function is called when the current thread stops waiting on a Thread
   for a different reason than the Thread having terminated. (e.g. a timeout,
   or the thread was waiting on multiple objects and another object was
   signaled)
 
 Parameters:
     IN hThread:   thread handle whose thread waiting list is to be modified
+    SHMPTR wait_state : wait state the waiter was queued with
 
 returns
     -1: an error occurred, SetLastError is called in this function.
     0: if the thread wasn't found in the list.
     1: if the thread was removed from the waiting list.
 --*/
-int ThreadRemoveWaitingThread(IN HANDLE hThread);
+int ThreadRemoveWaitingThread(IN HANDLE hThread, SHMPTR wait_state);
 
 /*++
 Function:
@@ -465,7 +498,10 @@ Function:
 Parameters:
     DWORD ThreadId    Thread to wake up
     DWORD ProcessId   Process of the thread to wake up
-    int   ThreadPipe  Blocking pipe associated with the thread to wake up.
+    int   ThreadPipe  Blocking pipe associated with the thread to wake up,
+                      or WAIT_BLOCK_PIPE
+    DWORD *pWaitState Wait state the thread waits with; with WAIT_BLOCK_PIPE,
+                      the state of a THREAD_WAIT_BLOCK
     WAKEUPTHREAD_CODE WakeUpCode Code to use when waking up the thread
 
 Return value:
@@ -475,8 +511,8 @@ Notes :
     -This function lives in pal/Unix/sync/, not in pal/Unix/thread/
 --*/
 VOID
-WakeUpThread( DWORD ThreadId, DWORD ProcessId,
-              int ThreadPipe, WAKEUPTHREAD_CODE WakeUpCode );
+WakeUpThread( DWORD ThreadId, DWORD ProcessId, int ThreadPipe,
+              DWORD *pWaitState, WAKEUPTHREAD_CODE WakeUpCode );
 
 /*++
 Function:
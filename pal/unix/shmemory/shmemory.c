@@ -146,6 +146,19 @@ the moment. Note that other platforms may not present the same difficulties
 (i.e. other pthread implementations may support inter-process mutexes), and may
 be able to use a simpler, more efficient approach.
 
+Update : where the kernel has futexes (Linux), the spinlock is also a futex.
+A process that finds it taken sleeps on it instead of yielding, and the owner
+wakes one sleeper when it lets go of it, so waiters no longer compete with the
+owner for the CPU. Where there is kqueue instead (FreeBSD, Mac OS X), kqueue
+can't wait on memory, so each spinlock gets a FIFO : a process that finds the
+spinlock taken sleeps in kevent() until the FIFO is readable, and the owner
+writes a byte to it when it lets go of a spinlock somebody sleeps on. Either
+sleep has a timeout so that the waiter still gets to check whether the owner
+is alive.
+Shared memory is also protected by several such spinlocks instead of one (see
+SHM_LOCK_ID in shmemory.h). Each protects separate data, so that file I/O, for
+example, doesn't wait for a thread creating a named event in another process.
+
 B] Reliability.
 It is important for the shared memory implementation to be as foolproof as
 possible. Since more than one process will be able to modify the shared data,
@@ -176,9 +189,16 @@ is still alive).
 #include <string.h>
 #include <sched.h>
 
-#if HAVE_YIELD_SYSCALL
+#if HAVE_YIELD_SYSCALL || HAVE_FUTEX
 #include <sys/syscall.h>
-#endif  /* HAVE_YIELD_SYSCALL */
+#endif  /* HAVE_YIELD_SYSCALL || HAVE_FUTEX */
+#if HAVE_FUTEX
+#include <time.h>
+#include <linux/futex.h>
+#elif HAVE_KQUEUE
+#include <time.h>
+#include <sys/event.h>
+#endif  /* HAVE_FUTEX */
         
 SET_DEFAULT_DEBUG_CHANNEL(SHMEM);
 
@@ -207,6 +227,12 @@ Low bytes are offset in the segment
 
 /*#define MAX_SEGMENTS 256*//*definition is now in shmemory.h*/
 
+/* layout of SHM_FIRST_HEADER : "SHM" followed by a version number, to be
+   bumped whenever the header changes. It's larger than any PID, so the first
+   segment of a PAL that kept its only spinlock where the version now is 
+   doesn't match either. */
+#define SHM_VERSION 0x53484D03
+
 /* Use MAP_NOSYNC to improve performance if it's available */
 #if defined(MAP_NOSYNC)
 #define MAPFLAGS MAP_NOSYNC|MAP_SHARED
@@ -214,6 +240,15 @@ Low bytes are offset in the segment
 #define MAPFLAGS MAP_SHARED
 #endif
 
+/* processes sleep on a taken spinlock with kqueue where there is no futex */
+#define SHM_KQUEUE_WAIT (!HAVE_FUTEX && HAVE_KQUEUE)
+
+#if HAVE_FUTEX || SHM_KQUEUE_WAIT
+/* longest time a process sleeps on a taken spinlock before it checks whether
+   the owner is still alive, in nanoseconds */
+#define SPINLOCK_SLEEP_TIMEOUT 10000000
+#endif  /* HAVE_FUTEX || SHM_KQUEUE_WAIT */
+
 
 /* Type definitions ***********************************************************/
 
@@ -279,16 +314,35 @@ typedef struct
     SHMPTR last_pool_blocks[SPS_LAST];
 } SHM_SEGMENT_HEADER;
 
+/*
+SHM_SPINLOCK
+Interprocess lock on one part of shared memory (see SHM_LOCK_ID)
+
+A process can only take the spinlock if owner is 0, and it takes the spinlock
+by placing its PID in it. (this allows a process to catch the special case
+where it tries to take a spinlock it already owns, and to find out that the
+owner died without releasing it)
+waiters is the number of threads (in all processes) sleeping on it, so that
+releasing a spinlock nobody waits for needs no system call. With futexes,
+owner is also the futex word.
+ */
+typedef struct
+{
+    pid_t owner;
+    LONG waiters;
+} SHM_SPINLOCK;
+
 /*
 SHM_FIRST_HEADER
 Global information about the shared memory system
 In addition to the standard SHM_SEGGMENT_HEADER, the first segment contains some
 information required to properly use the shared memory system.
 
-The spinlock is used to ensure that only one process accesses shared memory at
-the same time. A process can only take the spinlock if its contents is 0, and
-it takes the spinlock by placing its PID in it. (this allows a process to catch
-the special case where it tries to take a spinlock it already owns.
+The spinlocks are used to ensure that only one process accesses each part of
+shared memory at the same time (see SHM_LOCK_ID).
+
+version is SHM_VERSION. A process that finds another value in the first
+segment was built with another layout of this header and must not use it.
 
 The first_* members will contain the location of the first element in the
 various linked lists of shared information
@@ -296,40 +350,66 @@ various linked lists of shared information
 typedef struct
 {
     SHM_SEGMENT_HEADER header;
-    pid_t spinlock;
+    DWORD version;
+    SHM_SPINLOCK spinlocks[SLID_LAST];
     SHM_POOL_INFO pools[SPS_LAST]; /* information about each memory pool */
     SHMPTR shm_info[SIID_LAST]; /* basic blocks of shared information.*/
 }SHM_FIRST_HEADER;
 
 
-/* Static variables ***********************************************************/
+/*
+SHM_LOCK_STATE
+State of one SHM lock within the current process
 
-/* Critical section to ensure that only one thread at a time accesses shared
-memory. Rationale :
--Using a spinlock means that processes must busy-wait for the lock to be
+critsec ensures that only one thread at a time accesses the part of shared
+memory protected by the lock. Rationale :
+-Without futexes or kqueue, processes must busy-wait for the spinlock to be
  available. The critical section ensures taht only one thread will busy-wait,
  while the rest are put to sleep.
 -Since the spinlock only contains a PID, it isn't possible to make a difference
  between threads of the same process. This could be resolved by using 2
  spinlocks, but this would introduce more busy-wait.
-*/
-static CRITICAL_SECTION shm_critsec;
-                        
-/* number of segments the current process knows about */
-int shm_numsegments;
 
-/* array containing the base address of each segment */
-LPVOID shm_segment_bases[MAX_SEGMENTS];
+lock_count is the number of times the process currently holds the lock
+(SHMLockId calls without matching SHMReleaseId). Because we take the critical
+section while inside a SHMLockId/SHMReleaseId pair, this is actually the number
+of times it is held by a single thread.
+
+locking_thread is the thread ID of the thread holding the lock. used for
+debugging purposes : SHMGet/SetInfo will verify that the calling thread holds
+the lock
 
-/* number of locks the process currently holds (SHMLock calls without matching
-SHMRelease). Because we take the critical section while inside a
-SHMLock/SHMRelease pair, this is actually the number of locks held by a single
-thread. */
-static int lock_count;
+With SHM_KQUEUE_WAIT, wakeup_fifo is this process' descriptor for the FIFO of
+the spinlock, and wakeup_kqueue the kqueue that watches it. Both are -1 if
+they couldn't be opened; the process then yields instead of sleeping.
+ */
+typedef struct
+{
+    CRITICAL_SECTION critsec;
+    int lock_count;
+    DWORD locking_thread;
+#if SHM_KQUEUE_WAIT
+    int wakeup_fifo;
+    int wakeup_kqueue;
+#endif  /* SHM_KQUEUE_WAIT */
+} SHM_LOCK_STATE;
 
-/* thread ID of thread holding the SHM lock. used for debugging purposes : 
-   SHMGet/SetInfo will verify that the calling thread holds the lock */
-static DWORD locking_thread;
+
+/* Static variables ***********************************************************/
+
+static SHM_LOCK_STATE shm_locks[SLID_LAST];
+
+/* Segment table of the current process. It's only changed with SLID_POOLS 
+   held, but SHMPTR_TO_PTR reads it without any lock. A segment is published
+   by storing its base address, then, after a memory barrier, the new count 
+   (see SHMPublishSegment); a thread that sees the count finds the address. 
+   Entries don't change once they are published, until SHMCleanup. */
+
+/* number of segments the current process knows about */
+volatile int shm_numsegments;
+
+/* array containing the base address of each segment */
+LPVOID volatile shm_segment_bases[MAX_SEGMENTS];
 
 /* suffix template for mkstemp */
 static char segment_name_template[MAX_PATH];
@@ -349,6 +429,14 @@ static const char lockfile_shortname[] = ".rotor_pal_shmlockfile";
 /* size of a single segment : 256KB */
 static const int segment_size = 0x40000;
 
+/* lock that protects each SHM information element */
+static const SHM_LOCK_ID info_locks[SIID_LAST] =
+{
+    SLID_OBJECTS,       /* SIID_PROCESS_INFO */
+    SLID_OBJECTS,       /* SIID_NAMED_OBJECTS */
+    SLID_FILE_LOCKS     /* SIID_FILE_LOCKS */
+};
+
 #if defined(_DEBUG)
 /* environment variable, set to a non 0 value if we need to output waste 
    information to the file shm_waste_log (during process termination) */
@@ -363,8 +451,15 @@ static SHMPTR SHMLinkPool(SHMPTR first, int block_size, int num_blocks);
 static LPVOID SHMMapSegment(char *segment_name);
 static BOOL   SHMMapUnknownSegments(void);
 static BOOL   SHMAddSegment(void);
+static void   SHMPublishSegment(LPVOID segment_base);
 static BOOL   SHMInitSegmentFileSize(int fd);
 static int    SHMGetProcessList(int fd, pid_t **process_list, BOOL strip_me);
+static void   SHMWaitForSpinlock(SHM_LOCK_ID lock, SHM_SPINLOCK *spinlock,
+                                 pid_t owner, int spincount);
+#if SHM_KQUEUE_WAIT
+static void   SHMOpenWakeupFifo(SHM_LOCK_ID lock);
+static void   SHMCloseWakeupFifo(SHM_LOCK_ID lock);
+#endif  /* SHM_KQUEUE_WAIT */
 
 #if defined(_DEBUG)    
 
@@ -401,11 +496,20 @@ BOOL SHMInitialize(void)
     CHAR config_dir[MAX_PATH];
     CHAR first_segment_name[MAX_PATH];
     ssize_t sBytes;
+    SHM_LOCK_ID lock;
 
-    if (0 != SYNCInitializeCriticalSection(&shm_critsec))
+    for (lock = 0; lock < SLID_LAST; lock++)
     {
-        ERROR("Couldn't initialize SHM critical section\n");
-        return FALSE;
+        if (0 != SYNCInitializeCriticalSection(&shm_locks[lock].critsec))
+        {
+            ERROR("Couldn't initialize SHM critical section\n");
+            while (lock > 0)
+            {
+                lock--;
+                DeleteCriticalSection(&shm_locks[lock].critsec);
+            }
+            return FALSE;
+        }
     }
 
     init_waste();
@@ -583,7 +687,12 @@ BOOL SHMInitialize(void)
 
         header = (SHM_FIRST_HEADER *)shm_segment_bases[0];
 
-        header->spinlock = 0;
+        header->version = SHM_VERSION;
+        for (lock = 0; lock < SLID_LAST; lock++)
+        {
+            header->spinlocks[lock].owner = 0;
+            header->spinlocks[lock].waiters = 0;
+        }
         header->header.next_segment[0] = '\0'; /* no next segment */
 
         /* SHM information array starts with NULLs */
@@ -677,6 +786,24 @@ BOOL SHMInitialize(void)
             free(pal_processes);
             return FALSE;
         }
+
+        /* processes built with another layout of the first header share 
+           nothing with us, not even the spinlocks */
+        if(sb.st_size < sizeof(SHM_FIRST_HEADER) ||
+           SHM_VERSION != ((SHM_FIRST_HEADER *)shm_segment_bases[0])->version)
+        {
+            ERROR("First shared memory segment was created by an incompatible "
+                  "version of the PAL\n");
+            munmap(shm_segment_bases[0], sb.st_size);
+#ifdef O_EXLOCK
+            flock(fd_lock, LOCK_UN);
+#else   // O_EXLOCK
+            lockf(fd_lock, F_ULOCK, 0);
+#endif  // O_EXLOCK
+            close(fd_lock);
+            free(pal_processes);
+            return FALSE;
+        }
         TRACE("Successfully accessed first shared memory segment\n");
     }
     shm_numsegments = 1;
@@ -745,8 +872,14 @@ BOOL SHMInitialize(void)
 
     TRACE("Lock file released; ready to map all shared memory segments\n");
 
-    lock_count = 0;
-    locking_thread = 0;
+    for (lock = 0; lock < SLID_LAST; lock++)
+    {
+        shm_locks[lock].lock_count = 0;
+        shm_locks[lock].locking_thread = 0;
+#if SHM_KQUEUE_WAIT
+        SHMOpenWakeupFifo(lock);
+#endif  /* SHM_KQUEUE_WAIT */
+    }
 
     /* hook into all SHM segments */
     if(!SHMMapUnknownSegments())
@@ -773,24 +906,32 @@ void SHMCleanup(void)
     int n_pal_processes;
     pid_t *pal_processes;
     ssize_t sBytes;
+    SHM_LOCK_ID lock;
 
     TRACE("Starting shared memory cleanup\n");
 
-    SHMLock();
-    SHMRelease();
-
-    /* We should not be holding the spinlock at this point. If we are, release
-       the spinlock. by setting it to 0 */
     my_pid = gPID;
     header = (SHM_FIRST_HEADER *)shm_segment_bases[0];
 
-    if( my_pid==InterlockedCompareExchange((LONG *) &header->spinlock, 0, my_pid))
+    for (lock = 0; lock < SLID_LAST; lock++)
     {
-        WARN("SHMCleanup called while we still had the lock!\n");
-    }
+        SHMLockId(lock);
+        SHMReleaseId(lock);
+
+        /* We should not be holding the spinlock at this point. If we are,
+           release the spinlock. by setting it to 0 */
+        if( my_pid==InterlockedCompareExchange(
+                        (LONG *) &header->spinlocks[lock].owner, 0, my_pid))
+        {
+            WARN("SHMCleanup called while we still had lock %d!\n", lock);
+        }
 
-    /* Now for the interprocess stuff. */
-    DeleteCriticalSection(&shm_critsec);
+#if SHM_KQUEUE_WAIT
+        SHMCloseWakeupFifo(lock);
+#endif  /* SHM_KQUEUE_WAIT */
+
+        DeleteCriticalSection(&shm_locks[lock].critsec);
+    }
 
     TRACE("Segment unmapping complete; now unregistering this process\n");
 
@@ -947,6 +1088,20 @@ void SHMCleanup(void)
             WARN( "Unable to unlink the file! Reason=(%d)%s\n",
                   errno, strerror( errno ) );
         }
+
+#if SHM_KQUEUE_WAIT
+        for (lock = 0; lock < SLID_LAST; lock++)
+        {
+            char fifo_name[MAX_PATH];
+
+            sprintf(fifo_name, "%s_%d", lockfile_name, lock);
+            if ( -1 == unlink(fifo_name) && ENOENT != errno )
+            {
+                WARN( "Unable to unlink the FIFO %s! Reason=(%d)%s\n",
+                      fifo_name, errno, strerror( errno ) );
+            }
+        }
+#endif  /* SHM_KQUEUE_WAIT */
         
         /* try to remove the PAL's temp directory. this will fail if there are 
            still files in them; don't insist if that happens */
@@ -1020,7 +1175,7 @@ SHMPTR SHMalloc(size_t size)
 
     log_waste(sps, block_sizes[sps]-size);
 
-    SHMLock();
+    SHMLockId(SLID_POOLS);
     header = (SHM_FIRST_HEADER *)shm_segment_bases[0];
 
     /* If there are no free items of the specified size left, it's time to
@@ -1032,7 +1187,7 @@ SHMPTR SHMalloc(size_t size)
         if(!SHMAddSegment())
         {
             ERROR("Unable to allocate new shared memory segment!\n");
-            SHMRelease();
+            SHMReleaseId(SLID_POOLS);
             return 0;
         }
     }
@@ -1045,7 +1200,7 @@ SHMPTR SHMalloc(size_t size)
     {
         ASSERT("First free block in %d-byte pool (%08x) was invalid!\n",
               block_sizes[sps], first_free);
-        SHMRelease();
+        SHMReleaseId(SLID_POOLS);
         return 0;
     }
 
@@ -1074,7 +1229,7 @@ SHMPTR SHMalloc(size_t size)
         header->pools[sps].free_items = 0;
     }
 
-    SHMRelease();
+    SHMReleaseId(SLID_POOLS);
 
     TRACE("Allocation successful; %d blocks of %d bytes left. Returning %08x\n",
           header->pools[sps].free_items, block_sizes[sps], first_free);
@@ -1105,7 +1260,7 @@ void SHMfree(SHMPTR shmptr)
         WARN("can't SHMfree() a NULL SHMPTR!\n");
         return;
     }
-    SHMLock();
+    SHMLockId(SLID_POOLS);
 
     TRACE("Releasing SHMPTR 0x%08x\n", shmptr);
 
@@ -1114,7 +1269,7 @@ void SHMfree(SHMPTR shmptr)
     if(!shmptr_ptr)
     {
         ASSERT("Tried to free an invalid shared memory pointer 0x%08x\n", shmptr);
-        SHMRelease();
+        SHMReleaseId(SLID_POOLS);
         return;
     }
 
@@ -1140,7 +1295,7 @@ void SHMfree(SHMPTR shmptr)
     if(sps == SPS_LAST)
     {
         ASSERT("Shared memory pointer 0x%08x is out of bounds!\n", shmptr);
-        SHMRelease();
+        SHMReleaseId(SLID_POOLS);
         return;
     }
 
@@ -1156,7 +1311,7 @@ void SHMfree(SHMPTR shmptr)
     if( 0 != ( offset % block_sizes[sps] ) )
     {
         ASSERT("Shared memory pointer 0x%08x is misaligned!\n", shmptr);
-        SHMRelease();
+        SHMReleaseId(SLID_POOLS);
         return;
     }
 
@@ -1173,41 +1328,85 @@ void SHMfree(SHMPTR shmptr)
     TRACE("SHMPTR 0x%08x released; there are now %d blocks of %d bytes "
           "available\n", shmptr, first_header->pools[sps].free_items,
           block_sizes[sps]);
-    SHMRelease();
+    SHMReleaseId(SLID_POOLS);
 }
 
 /*++
 SHMLock
 
-Restrict shared memory access to the current thread of the current process
+Restrict access to the shared objects (SLID_OBJECTS) to the current thread of
+the current process
+
+(no parameters)
+
+Return value :
+    New lock count
+--*/
+int SHMLock(void)
+{
+    return SHMLockId(SLID_OBJECTS);
+}
+
+/*++
+SHMRelease
+
+Release a lock on shared memory taken with SHMLock.
 
 (no parameters)
 
+Return value :
+    New lock count
+
+--*/
+int SHMRelease(void)
+{
+    return SHMReleaseId(SLID_OBJECTS);
+}
+
+/*++
+SHMLockId
+
+Restrict access to the part of shared memory protected by the given lock to the
+current thread of the current process
+
+Parameters :
+    SHM_LOCK_ID lock : lock to take
+
 Return value :
     New lock count
 
 Notes :
-see comments at the declaration of shm_critsec for rationale of critical
+see comments at the declaration of SHM_LOCK_STATE for rationale of critical
 section usage
 --*/
-int SHMLock(void)
+int SHMLockId(SHM_LOCK_ID lock)
 {
+    SHM_LOCK_STATE *state;
     int spincount = 1;
 
+    if(lock < 0 || lock >= SLID_LAST)
+    {
+        ASSERT("Invalid SHM lock %d\n", lock);
+        return 0;
+    }
+    state = &shm_locks[lock];
+
     /* Hold the critical section until the lock is released */
-    SYNCEnterCriticalSection(&shm_critsec, TRUE);
+    SYNCEnterCriticalSection(&state->critsec, TRUE);
 
-    if(lock_count == 0)
+    if(state->lock_count == 0)
     {
         SHM_FIRST_HEADER *header;
+        SHM_SPINLOCK *spinlock;
         pid_t my_pid, tmp_pid;
 
-        TRACE("First-level SHM lock : taking spinlock\n");
+        TRACE("First-level SHM lock %d : taking spinlock\n", lock);
 
         header = (SHM_FIRST_HEADER *)shm_segment_bases[0];
+        spinlock = &header->spinlocks[lock];
         my_pid = gPID;
 
-        tmp_pid = InterlockedCompareExchange((LONG *) &header->spinlock, my_pid,0);
+        tmp_pid = InterlockedCompareExchange((LONG *) &spinlock->owner, my_pid,0);
         while(tmp_pid != 0)
         {
             /* Check if lock holder is alive. If it isn't, we can reset the
@@ -1221,106 +1420,120 @@ int SHMLock(void)
                 TRACE("SHM spinlock owner (%08x) is dead; releasing its lock\n",
                       tmp_pid);
 
-                InterlockedCompareExchange((LONG *) &header->spinlock, 0, tmp_pid);
+                InterlockedCompareExchange((LONG *) &spinlock->owner, 0, tmp_pid);
             }
             else
             {
-                /* another process is holding the lock... we want to yield and 
-                   give the holder a chance to release the lock
-                   The function sched_yield() only yields to a thread in the 
-                   current process; this doesn't help us much, anddoens't help 
-                   at all if there's only 1 thread. There doesn't seem to be 
-                   any clean way to force a yield to another process, but the 
-                   FreeBSD syscall "yield" does the job. We alternate between 
-                   both methods to give other threads of this process a chance 
-                   to run while we wait.
-                 */
-#if HAVE_YIELD_SYSCALL
-                if(spincount&1)
-                {
-#endif  /* HAVE_YIELD_SYSCALL */
-                    sched_yield();
-#if HAVE_YIELD_SYSCALL
-                }
-                else
-                {
-                    /* use the syscall first, since we know we'l need to yield 
-                       to another process eventually - the lock can't be held 
-                       by the current process, thanks to the critical section */
-                    syscall(SYS_yield, 0);
-                }
-#endif  /* HAVE_YIELD_SYSCALL */
+                SHMWaitForSpinlock(lock, spinlock, tmp_pid, spincount);
             }
-            tmp_pid = InterlockedCompareExchange((LONG *) &header->spinlock, my_pid,0);
+            tmp_pid = InterlockedCompareExchange((LONG *) &spinlock->owner, my_pid,0);
 
             spincount++;
         }
-        locking_thread = GetCurrentThreadId();
+        state->locking_thread = GetCurrentThreadId();
     }
-    lock_count++;
-    TRACE("SHM lock level is now %d\n", lock_count);
-    return lock_count;
+    state->lock_count++;
+    TRACE("SHM lock %d level is now %d\n", lock, state->lock_count);
+    return state->lock_count;
 }
 
 /*++
-SHMRelease
+SHMReleaseId
 
-Release a lock on shared memory taken with SHMLock.
+Release a lock on shared memory taken with SHMLockId.
 
-(no parameters)
+Parameters :
+    SHM_LOCK_ID lock : lock to release
 
 Return value :
     New lock count
 
 --*/
-int SHMRelease(void)
+int SHMReleaseId(SHM_LOCK_ID lock)
 {
+    SHM_LOCK_STATE *state;
+    int lock_count;
+
+    if(lock < 0 || lock >= SLID_LAST)
+    {
+        ASSERT("Invalid SHM lock %d\n", lock);
+        return 0;
+    }
+    state = &shm_locks[lock];
+
     /* prevent a thread from releasing another thread's lock */
-    SYNCEnterCriticalSection(&shm_critsec, TRUE);
+    SYNCEnterCriticalSection(&state->critsec, TRUE);
 
-    if(lock_count==0)
+    if(state->lock_count==0)
     {
-        ASSERT("SHMRelease called without matching SHMLock!\n");
-        SYNCLeaveCriticalSection(&shm_critsec, TRUE);
+        ASSERT("SHMReleaseId called without matching SHMLockId!\n");
+        SYNCLeaveCriticalSection(&state->critsec, TRUE);
         return 0;
     }
 
-    lock_count--;
+    state->lock_count--;
 
     /* If lock count is 0, this call matches the first Lock call; it's time to
        set the spinlock back to 0. */
-    if(lock_count == 0)
+    if(state->lock_count == 0)
     {
         SHM_FIRST_HEADER *header;
+        SHM_SPINLOCK *spinlock;
         pid_t my_pid, tmp_pid;
 
-        TRACE("Releasing first-level SHM lock : resetting spinlock\n");
+        TRACE("Releasing first-level SHM lock %d : resetting spinlock\n", lock);
 
         my_pid = gPID;
         header = (SHM_FIRST_HEADER *)shm_segment_bases[0];
+        spinlock = &header->spinlocks[lock];
 
         /* Make sure we don't touch the spinlock if we don't own it. We're
            supposed to own it if we get here, but just in case... */
-        tmp_pid = InterlockedCompareExchange((LONG *) &header->spinlock, 0, my_pid);
+        tmp_pid = InterlockedCompareExchange((LONG *) &spinlock->owner, 0, my_pid);
         if(tmp_pid !=my_pid)
         {
             ASSERT("Process 0x%08x tried to release spinlock owned by process "
                   "0x%08x!\n", my_pid, tmp_pid);
-            SYNCLeaveCriticalSection(&shm_critsec, TRUE);
+            SYNCLeaveCriticalSection(&state->critsec, TRUE);
             return 0;
         }
 
+#if HAVE_FUTEX || SHM_KQUEUE_WAIT
+        /* Waiters count themselves before they check the owner in the kernel,
+           and we check the count after clearing the owner, so either we see
+           them here or they see the spinlock free and don't sleep. */
+        if(0 != spinlock->waiters)
+        {
+#if HAVE_FUTEX
+            syscall(SYS_futex, &spinlock->owner, FUTEX_WAKE, 1, NULL, NULL, 0);
+#else   /* HAVE_FUTEX */
+            /* the byte stays in the FIFO until a waiter reads it, so a waiter
+               that hasn't reached kevent() yet still wakes up. If the FIFO is
+               full, waiters have plenty to wake up already. */
+            char wakeup = 0;
+
+            if(-1 != state->wakeup_fifo &&
+               -1 == write(state->wakeup_fifo, &wakeup, 1) && EAGAIN != errno)
+            {
+                WARN("Unable to wake up waiters of SHM lock %d! "
+                     "errno is %d (%s)\n", lock, errno, strerror(errno));
+            }
+#endif  /* HAVE_FUTEX */
+        }
+#endif  /* HAVE_FUTEX || SHM_KQUEUE_WAIT */
+
         /* indicate no thread (in this process) holds the SHM lock */
-        locking_thread = 0;
+        state->locking_thread = 0;
     }
 
-    TRACE("SHM lock level is now %d\n", lock_count);
+    lock_count = state->lock_count;
+    TRACE("SHM lock %d level is now %d\n", lock, lock_count);
 
-    /* This matches the SYNCEnterCriticalSection from SHMRelease */
-    SYNCLeaveCriticalSection(&shm_critsec, TRUE);
+    /* This matches the SYNCEnterCriticalSection from SHMReleaseId */
+    SYNCLeaveCriticalSection(&state->critsec, TRUE);
 
-    /* This matches the SYNCEnterCriticalSection from SHMLock */
-    SYNCLeaveCriticalSection(&shm_critsec, TRUE);
+    /* This matches the SYNCEnterCriticalSection from SHMLockId */
+    SYNCLeaveCriticalSection(&state->critsec, TRUE);
 
     return lock_count;
 }
@@ -1431,7 +1644,8 @@ Return value :
     Value of specified element
 
 Notes :
-    The SHM lock should be held while manipulating shared memory
+    The SHM lock protecting the element (see SHM_LOCK_ID) should be held
+    while manipulating shared memory
 --*/
 SHMPTR SHMGetInfo(SHM_INFO_ID element)
 {
@@ -1445,8 +1659,8 @@ SHMPTR SHMGetInfo(SHM_INFO_ID element)
     }
 
     /* verify that this thread holds the SHM lock. No race condition: if the 
-       current thread is here, it can't be in SHMLock or SHMUnlock */
-    if( GetCurrentThreadId() != locking_thread )
+       current thread is here, it can't be in SHMLockId or SHMReleaseId */
+    if( GetCurrentThreadId() != shm_locks[info_locks[element]].locking_thread )
     {
         ASSERT("SHMGetInfo called while thread does not hold the SHM lock!\n");
     }
@@ -1474,7 +1688,8 @@ Return value :
     TRUE if successfull, FALSE otherwise.
 
 Notes :
-    The SHM lock should be held while manipulating shared memory
+    The SHM lock protecting the element (see SHM_LOCK_ID) should be held
+    while manipulating shared memory
 --*/
 BOOL SHMSetInfo(SHM_INFO_ID element, SHMPTR value)
 {
@@ -1487,8 +1702,8 @@ BOOL SHMSetInfo(SHM_INFO_ID element, SHMPTR value)
     }
     
     /* verify that this thread holds the SHM lock. No race condition: if the 
-       current thread is here, it can't be in SHMLock or SHMUnlock */
-    if( GetCurrentThreadId() != locking_thread )
+       current thread is here, it can't be in SHMLockId or SHMReleaseId */
+    if( GetCurrentThreadId() != shm_locks[info_locks[element]].locking_thread )
     {
         ASSERT("SHMGetInfo called while thread does not hold the SHM lock!\n");
     }
@@ -1683,12 +1898,13 @@ Return value :
 static BOOL SHMMapUnknownSegments(void)
 {
     SHM_SEGMENT_HEADER *header;
+    LPVOID segment_base;
     int num_new = 0;
     BOOL retval = FALSE;
 
     TRACE("Mapping unknown segments into this process...\n");
 
-    SHMLock();
+    SHMLockId(SLID_POOLS);
 
     /* Get header of last known segment */
     header = (SHM_SEGMENT_HEADER *) shm_segment_bases[shm_numsegments-1];
@@ -1705,23 +1921,21 @@ static BOOL SHMMapUnknownSegments(void)
                   MAX_SEGMENTS);
             goto done;
         }
-        shm_segment_bases[shm_numsegments] =
-                    SHMMapSegment(header->next_segment);
-        if(!shm_segment_bases[shm_numsegments])
+        segment_base = SHMMapSegment(header->next_segment);
+        if(!segment_base)
         {
             ERROR("Failed to map next shared memory segment!\n");
             goto done;
         }
+        SHMPublishSegment(segment_base);
 
         /* Get header of new segment to see if there are others after it */
-        header = (SHM_SEGMENT_HEADER *)
-                        shm_segment_bases[shm_numsegments];
-        shm_numsegments++;
+        header = (SHM_SEGMENT_HEADER *)segment_base;
         num_new++;
     }
     retval = TRUE;
 done:
-    SHMRelease();
+    SHMReleaseId(SLID_POOLS);
     TRACE("Mapped %d new segments (total is now %d)\n",
           num_new, shm_numsegments);
 
@@ -1740,7 +1954,7 @@ Return value :
     TRUE on success, FALSE in case of error
 
 Notes :
-    This function assumes the SHM lock is held.
+    This function assumes the SHM pool lock (SLID_POOLS) is held.
 --*/
 static BOOL SHMAddSegment(void)
 {
@@ -1823,6 +2037,8 @@ static BOOL SHMAddSegment(void)
     TRACE("Mapped SHM segment #%d at %p; name is %s\n",
           shm_numsegments, segment_base, suffix_start);
 
+    /* the pools are linked through this entry below; the segment is only 
+       published (shm_numsegments) once they are ready */
     shm_segment_bases[shm_numsegments] = segment_base;
 
     /* Save name (well, suffix) of new segment in the header of the old last
@@ -1933,11 +2149,35 @@ static BOOL SHMAddSegment(void)
         /* Update first_shmptr to first byte after the new pool */
         first_shmptr+=num_new_items*block_sizes[sps];
     }
-    shm_numsegments++;
+    SHMPublishSegment(segment_base);
 
     return TRUE;
 }
 
+/*++
+SHMPublishSegment
+
+Add a mapped segment at the end of the segment table of this process
+
+Parameters :
+    LPVOID segment_base : address the segment is mapped at
+
+(no return value)
+
+Notes :
+    This function assumes the SHM pool lock (SLID_POOLS) is held.
+    SHMPTR_TO_PTR reads the table without the lock, so the address is stored
+    before the count that makes it visible, with a barrier in between.
+--*/
+static void SHMPublishSegment(LPVOID segment_base)
+{
+    int segment = shm_numsegments;
+
+    shm_segment_bases[segment] = segment_base;
+    MemoryBarrier();
+    shm_numsegments = segment + 1;
+}
+
 /*++
 SHMInitSegmentFileSize
 
@@ -2077,6 +2317,185 @@ static int SHMGetProcessList(int fd, pid_t **process_list, BOOL strip_me)
     return n_pal_processes;
 }
 
+/*++
+SHMWaitForSpinlock
+
+Wait for the owner of a SHM spinlock to release it
+
+Parameters :
+    SHM_LOCK_ID lock : lock the spinlock protects
+    SHM_SPINLOCK *spinlock : spinlock to wait for
+    pid_t owner : owner found in the spinlock by the last attempt to take it
+    int spincount : number of attempts so far
+
+(no return value)
+
+Notes :
+    This only gives the owner a chance to release the spinlock; the caller
+    must try to take it again, and must check now and then that the owner is
+    still alive.
+--*/
+static void SHMWaitForSpinlock(SHM_LOCK_ID lock, SHM_SPINLOCK *spinlock,
+                               pid_t owner, int spincount)
+{
+#if HAVE_FUTEX
+    struct timespec timeout;
+
+    /* Sleep until the owner releases the spinlock. The kernel returns right
+       away if the owner changed since we looked at it. The futex is not
+       private since the spinlock is shared between processes. */
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = SPINLOCK_SLEEP_TIMEOUT;
+
+    InterlockedIncrement(&spinlock->waiters);
+    syscall(SYS_futex, &spinlock->owner, FUTEX_WAIT, owner, &timeout, NULL, 0);
+    InterlockedDecrement(&spinlock->waiters);
+#elif SHM_KQUEUE_WAIT
+    SHM_LOCK_STATE *state = &shm_locks[lock];
+
+    if(-1 != state->wakeup_kqueue)
+    {
+        struct timespec timeout;
+        struct kevent event;
+        char wakeup;
+
+        /* Sleep until the owner writes to the FIFO of the spinlock. We count
+           ourselves before we look at the owner again, so if it releases the
+           spinlock after that, it sees us and writes the byte, which stays
+           in the FIFO until somebody reads it. */
+        timeout.tv_sec = 0;
+        timeout.tv_nsec = SPINLOCK_SLEEP_TIMEOUT;
+
+        InterlockedIncrement(&spinlock->waiters);
+        if(owner == spinlock->owner &&
+           1 == kevent(state->wakeup_kqueue, NULL, 0, &event, 1, &timeout))
+        {
+            /* another waiter may beat us to the byte; that's fine */
+            read(state->wakeup_fifo, &wakeup, 1);
+        }
+        InterlockedDecrement(&spinlock->waiters);
+        return;
+    }
+#endif  /* HAVE_FUTEX */
+
+#if !HAVE_FUTEX
+    /* another process is holding the lock... we want to yield and give the
+       holder a chance to release the lock
+       The function sched_yield() only yields to a thread in the current
+       process; this doesn't help us much, anddoens't help at all if there's
+       only 1 thread. There doesn't seem to be any clean way to force a yield
+       to another process, but the FreeBSD syscall "yield" does the job. We
+       alternate between both methods to give other threads of this process a
+       chance to run while we wait.
+     */
+#if HAVE_YIELD_SYSCALL
+    if(spincount&1)
+    {
+#endif  /* HAVE_YIELD_SYSCALL */
+        sched_yield();
+#if HAVE_YIELD_SYSCALL
+    }
+    else
+    {
+        /* use the syscall first, since we know we'l need to yield to another
+           process eventually - the lock can't be held by the current process,
+           thanks to the critical section */
+        syscall(SYS_yield, 0);
+    }
+#endif  /* HAVE_YIELD_SYSCALL */
+#endif  /* !HAVE_FUTEX */
+}
+
+#if SHM_KQUEUE_WAIT
+/*++
+SHMOpenWakeupFifo
+
+Open the FIFO processes sleep on when they find the spinlock of a SHM lock
+taken, and a kqueue to watch it
+
+Parameters :
+    SHM_LOCK_ID lock : lock whose FIFO to open
+
+(no return value)
+
+Notes :
+    The FIFO is shared by all processes and is removed by SHMCleanup along with
+    the lock file. If it can't be opened, wakeup_fifo and wakeup_kqueue are
+    left to -1, and SHMWaitForSpinlock yields instead of sleeping.
+--*/
+static void SHMOpenWakeupFifo(SHM_LOCK_ID lock)
+{
+    SHM_LOCK_STATE *state = &shm_locks[lock];
+    char fifo_name[MAX_PATH];
+    struct kevent event;
+
+    state->wakeup_fifo = -1;
+    state->wakeup_kqueue = -1;
+
+    sprintf(fifo_name, "%s_%d", lockfile_name, lock);
+    if(-1 == mkfifo(fifo_name, 0600) && EEXIST != errno)
+    {
+        WARN("Unable to create FIFO %s! errno is %d (%s)\n",
+             fifo_name, errno, strerror(errno));
+        return;
+    }
+
+    /* open for reading and writing, so that opening doesn't wait for the
+       other end and the FIFO never reports end-of-file */
+    state->wakeup_fifo = open(fifo_name, O_RDWR | O_NONBLOCK);
+    if(-1 == state->wakeup_fifo)
+    {
+        WARN("Unable to open FIFO %s! errno is %d (%s)\n",
+             fifo_name, errno, strerror(errno));
+        return;
+    }
+    fcntl(state->wakeup_fifo, F_SETFD, FD_CLOEXEC);
+
+    state->wakeup_kqueue = kqueue();
+    if(-1 == state->wakeup_kqueue)
+    {
+        WARN("kqueue() failed! errno is %d (%s)\n", errno, strerror(errno));
+        SHMCloseWakeupFifo(lock);
+        return;
+    }
+    fcntl(state->wakeup_kqueue, F_SETFD, FD_CLOEXEC);
+
+    EV_SET(&event, state->wakeup_fifo, EVFILT_READ, EV_ADD, 0, 0, NULL);
+    if(-1 == kevent(state->wakeup_kqueue, &event, 1, NULL, 0, NULL))
+    {
+        WARN("Unable to watch FIFO %s! errno is %d (%s)\n",
+             fifo_name, errno, strerror(errno));
+        SHMCloseWakeupFifo(lock);
+    }
+}
+
+/*++
+SHMCloseWakeupFifo
+
+Close this process' descriptors for the FIFO of a SHM lock
+
+Parameters :
+    SHM_LOCK_ID lock : lock whose FIFO to close
+
+(no return value)
+--*/
+static void SHMCloseWakeupFifo(SHM_LOCK_ID lock)
+{
+    SHM_LOCK_STATE *state = &shm_locks[lock];
+
+    if(-1 != state->wakeup_kqueue)
+    {
+        close(state->wakeup_kqueue);
+        state->wakeup_kqueue = -1;
+    }
+    if(-1 != state->wakeup_fifo)
+    {
+        close(state->wakeup_fifo);
+        state->wakeup_fifo = -1;
+    }
+}
+#endif  /* SHM_KQUEUE_WAIT */
+
 
 /*++
 SHMStrDup
@@ -40,6 +40,15 @@ Abstract:
     Operations are removed from the queue by the worker thread. If poll returns
     exceptional events (POLLHUP/POLLERR/POLLNVAL) then all pending asynchronous 
     operations are cancelled and the socket is restored to its synchronous mode.
+
+    Where epoll (HAVE_EPOLL) or kqueue (HAVE_KQUEUE) is available, the 
+    worker thread only serves the interthread pipe, and the sockets are 
+    watched by a few poller threads sharing one epoll set or kqueue. Sockets
+    are registered edge triggered and one shot: the poller that gets a 
+    socket processes it and SOCKRefreshPollfdEvents re-arms it, which makes
+    the kernel report it again if it is still ready (e.g. unread data was 
+    left when the recv queue ran empty). The pollfd array is still used to 
+    tell which sockets are asynchronous.
     
      
 Remarks:
@@ -71,6 +80,8 @@ Remarks:
 #include "pal/critsect.h"
 #include "pal/dbgmsg.h"
 #include "pal/socket2.h"
+#include "pal/thread.h"
+#include "pal/file.h"
 
 #include <sys/types.h>
 #if HAVE_POLL
@@ -79,6 +90,11 @@ Remarks:
 #include "pal/fakepoll.h"
 #include <sys/stat.h>
 #endif  // HAVE_POLL
+#if HAVE_EPOLL
+#include <sys/epoll.h>
+#elif HAVE_KQUEUE
+#include <sys/event.h>
+#endif  // HAVE_EPOLL
 #include <errno.h>
 #include <sys/uio.h>
 #include <unistd.h>
@@ -116,17 +132,37 @@ static ws2_sock *SOCKGetDataFromAsyncSocket( int fd );
 static ws2_op_list *SOCKGetQueueFromSocket(int fd, enum ws2_opcode which);
 static void SOCKRemoveSocketFromPollList( int fd );
 
+#if HAVE_EPOLL || HAVE_KQUEUE
+#define SOCK_HAVE_POLLER_THREADS 1
+#else   // HAVE_EPOLL || HAVE_KQUEUE
+#define SOCK_HAVE_POLLER_THREADS 0
+#endif  // HAVE_EPOLL || HAVE_KQUEUE
+
+#if SOCK_HAVE_POLLER_THREADS
+/* most threads waiting on the poller set, whatever the number of 
+   processors */
+#define SOCK_MAX_POLLER_THREADS 8
+/* most ready sockets taken from the kernel by one wait */
+#define SOCK_POLLER_MAX_EVENTS  64
+
+/* the epoll set or kqueue shared by the poller threads */
+static int SOCK_poller_set_fd = -1;
+/* written once to stop the poller threads; never read, so that it stays
+   ready for all of them */
+static int SOCK_poller_stop_pipe[2] = { -1, -1 };
+static HANDLE SOCK_poller_threads[SOCK_MAX_POLLER_THREADS];
+static int SOCK_poller_thread_count = 0;
+
+static BOOL SOCKStartPollerThreads( void );
+static void SOCKStopPollerThreads( void );
+static DWORD SOCKPollerThreadMain( PVOID pvUnused );
+static void SOCKProcessPollerEvents( int fd, short revents );
+static void SOCKSetPollerEvents( int fd, short poll_events );
+#endif  // SOCK_HAVE_POLLER_THREADS
+
 #define FILETIME_TO_ULONGLONG(f) \
     (((ULONGLONG)(f).dwHighDateTime << 32) | ((ULONGLONG)(f).dwLowDateTime))
 
-static
-BOOL SOCKPostQueuedCompletionStatus(
-    HANDLE CompletionPort,
-    DWORD dwNumberOfBytesTransferred,
-    ULONG_PTR CompletionKey,
-    LPOVERLAPPED lpOverlapped,
-    pal_iocp_completion_packet *lpIOCPCompletionPacket);
-
 
 
 static
@@ -621,6 +657,14 @@ DWORD SOCKWorkerThreadMain( PVOID phWorkerThreadInitCompleted )
 
     /* no more direct reference to the arrays below here */
 
+#if SOCK_HAVE_POLLER_THREADS
+    if (!SOCKStartPollerThreads())
+    {
+        ERROR("Unable to start the poller threads\n");
+        return FALSE;
+    }
+#endif  // SOCK_HAVE_POLLER_THREADS
+
     /* thread initialization completed. Notify WSAStartup. */
     if (!phWorkerThreadInitCompleted ||
         !SetEvent(* (HANDLE*) phWorkerThreadInitCompleted))
@@ -631,10 +675,15 @@ DWORD SOCKWorkerThreadMain( PVOID phWorkerThreadInitCompleted )
 
     while(1)
     {
+#if SOCK_HAVE_POLLER_THREADS
+        /* the sockets themselves are watched by the poller threads */
+        res = poll( SOCKGetPollfdFromAsyncSocket(SOCK_PIPE_READ), 1, INFTIM );
+#else   // SOCK_HAVE_POLLER_THREADS
         TRACE("polling %d file descriptors\n", SOCK_socket_list.max_fd + 1);
 
         res = poll( SOCKGetPollfdFromAsyncSocket(0),
                     SOCK_socket_list.max_fd + 1, INFTIM );
+#endif  // SOCK_HAVE_POLLER_THREADS
 
         if ( res == -1 )
         {
@@ -676,6 +725,7 @@ DWORD SOCKWorkerThreadMain( PVOID phWorkerThreadInitCompleted )
         }
         TRACE("poll() returned %d\n", res);
 
+#if !SOCK_HAVE_POLLER_THREADS
         for ( i = 0; i <= SOCK_socket_list.max_fd; ++i )
         {
 
@@ -765,6 +815,7 @@ DWORD SOCKWorkerThreadMain( PVOID phWorkerThreadInitCompleted )
     
             SOCKRefreshPollfdEvents(i);
         }
+#endif  // !SOCK_HAVE_POLLER_THREADS
 
         /* read data from the pipe if there is some */
         if ( SOCK_socket_list.pollfds[SOCK_PIPE_READ].revents & POLLIN )
@@ -775,6 +826,420 @@ DWORD SOCKWorkerThreadMain( PVOID phWorkerThreadInitCompleted )
 }
 
 
+#if SOCK_HAVE_POLLER_THREADS
+/*++
+Function:
+  SOCKStartPollerThreads
+
+Create the epoll set (or the kqueue) and start one poller thread per
+processor, up to SOCK_MAX_POLLER_THREADS. Called by the worker thread
+before it reports its initialization as completed.
+
+Return value:
+  TRUE in case of success, FALSE otherwise
+--*/
+static BOOL SOCKStartPollerThreads( void )
+{
+    SYSTEM_INFO SystemInfo;
+#if HAVE_EPOLL
+    struct epoll_event ev = { 0 };
+#else   // HAVE_EPOLL
+    struct kevent kev;
+#endif  // HAVE_EPOLL
+    DWORD thread_id;
+    int count;
+
+#if HAVE_EPOLL
+    SOCK_poller_set_fd = epoll_create(SOCK_table_size);
+#else   // HAVE_EPOLL
+    SOCK_poller_set_fd = kqueue();
+#endif  // HAVE_EPOLL
+    if ( SOCK_poller_set_fd == -1 )
+    {
+        ERROR("Unable to create the poller set, errno = %d (%s)\n",
+              errno, strerror(errno));
+        return FALSE;
+    }
+
+    if ( pipe(SOCK_poller_stop_pipe) != 0 )
+    {
+        ERROR("Could not create pipe to stop the poller threads\n");
+        goto error;
+    }
+
+    /* level triggered, so that every poller sees it */
+#if HAVE_EPOLL
+    ev.events = EPOLLIN;
+    ev.data.fd = SOCK_poller_stop_pipe[0];
+    if ( epoll_ctl(SOCK_poller_set_fd, EPOLL_CTL_ADD, 
+                   SOCK_poller_stop_pipe[0], &ev) != 0 )
+#else   // HAVE_EPOLL
+    EV_SET(&kev, SOCK_poller_stop_pipe[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+    if ( kevent(SOCK_poller_set_fd, &kev, 1, NULL, 0, NULL) != 0 )
+#endif  // HAVE_EPOLL
+    {
+        ERROR("Unable to add the stop pipe to the poller set, "
+              "errno = %d (%s)\n", errno, strerror(errno));
+        goto error;
+    }
+
+    GetSystemInfo(&SystemInfo);
+    count = SystemInfo.dwNumberOfProcessors;
+    if ( count < 1 )
+    {
+        count = 1;
+    }
+    if ( count > SOCK_MAX_POLLER_THREADS )
+    {
+        count = SOCK_MAX_POLLER_THREADS;
+    }
+
+    while ( SOCK_poller_thread_count < count )
+    {
+        HANDLE hThread;
+
+        hThread = CreateInternalThread( NULL, 0,
+                                        (LPTHREAD_START_ROUTINE)SOCKPollerThreadMain,
+                                        NULL, 0, &thread_id );
+        if ( hThread == NULL )
+        {
+            ERROR("Could not create poller thread\n");
+            goto error;
+        }
+
+        SOCK_poller_threads[SOCK_poller_thread_count++] = hThread;
+    }
+
+    TRACE("Started %d poller threads on poller set %d\n", 
+          SOCK_poller_thread_count, SOCK_poller_set_fd);
+    return TRUE;
+
+error:
+    SOCKStopPollerThreads();
+    return FALSE;
+}
+
+/*++
+Function:
+  SOCKStopPollerThreads
+
+Tell the poller threads to terminate, wait for them and release the poller
+set. Called by the worker thread when it is asked to terminate, so that
+no poller touches the socket list after WSACleanup.
+--*/
+static void SOCKStopPollerThreads( void )
+{
+    char stop = 0;
+    int i;
+
+    if ( SOCK_poller_thread_count > 0 )
+    {
+        if ( write(SOCK_poller_stop_pipe[1], &stop, 1) != 1 )
+        {
+            ASSERT("Unable to stop the poller threads, errno = %d (%s)\n",
+                   errno, strerror(errno));
+        }
+        else
+        {
+            for ( i = 0; i < SOCK_poller_thread_count; ++i )
+            {
+                if ( WaitForSingleObject(SOCK_poller_threads[i], INFINITE) 
+                     != WAIT_OBJECT_0 )
+                {
+                    ASSERT("Failed to wait on poller thread's handle (%p)\n",
+                           SOCK_poller_threads[i]);
+                }
+            }
+        }
+
+        for ( i = 0; i < SOCK_poller_thread_count; ++i )
+        {
+            if ( CloseHandle(SOCK_poller_threads[i]) == FALSE )
+            {
+                WARN("Unable to reclaim poller thread handle\n");
+            }
+        }
+        SOCK_poller_thread_count = 0;
+    }
+
+    for ( i = 0; i <= 1; ++i )
+    {
+        if ( SOCK_poller_stop_pipe[i] != -1 )
+        {
+            if ( close(SOCK_poller_stop_pipe[i]) != 0 )
+            {
+                WARN("Could not close file descriptor %d\n", 
+                     SOCK_poller_stop_pipe[i]);
+            }
+            SOCK_poller_stop_pipe[i] = -1;
+        }
+    }
+
+    if ( SOCK_poller_set_fd != -1 )
+    {
+        if ( close(SOCK_poller_set_fd) != 0 )
+        {
+            WARN("Could not close file descriptor %d\n", SOCK_poller_set_fd);
+        }
+        SOCK_poller_set_fd = -1;
+    }
+}
+
+/*++
+Function:
+  SOCKPollerThreadMain
+
+Entry point for the poller threads, which wait on the poller set and 
+complete the overlapped operations of the sockets it reports.
+--*/
+static DWORD SOCKPollerThreadMain( PVOID pvUnused )
+{
+#if HAVE_EPOLL
+    struct epoll_event events[SOCK_POLLER_MAX_EVENTS];
+#else   // HAVE_EPOLL
+    struct kevent events[SOCK_POLLER_MAX_EVENTS];
+#endif  // HAVE_EPOLL
+    short revents;
+    int res;
+    int fd;
+    int i;
+
+    while(1)
+    {
+#if HAVE_EPOLL
+        res = epoll_wait( SOCK_poller_set_fd, events, 
+                          SOCK_POLLER_MAX_EVENTS, -1 );
+#else   // HAVE_EPOLL
+        res = kevent( SOCK_poller_set_fd, NULL, 0, events,
+                      SOCK_POLLER_MAX_EVENTS, NULL );
+#endif  // HAVE_EPOLL
+
+        if ( res == -1 )
+        {
+            if(EINTR == errno)
+            {
+                TRACE("waiting on the poller set failed with EINTR; "
+                      "re-polling\n");
+                continue;
+            }
+            ASSERT("waiting on the poller set returned -1, "
+                   "errno = %d (%s)\n", errno, strerror(errno));
+            continue;
+        }
+        TRACE("poller set reported %d events\n", res);
+
+        for ( i = 0; i < res; ++i )
+        {
+            /* translate the event to what poll would have returned */
+            revents = 0;
+#if HAVE_EPOLL
+            fd = events[i].data.fd;
+            if ( events[i].events & EPOLLIN )
+            {
+                revents |= POLLIN;
+            }
+            if ( events[i].events & EPOLLOUT )
+            {
+                revents |= POLLOUT;
+            }
+            if ( events[i].events & EPOLLHUP )
+            {
+                revents |= POLLHUP;
+            }
+            if ( events[i].events & EPOLLERR )
+            {
+                revents |= POLLERR;
+            }
+#else   // HAVE_EPOLL
+            fd = (int)events[i].ident;
+            if ( (events[i].flags & EV_EOF) && events[i].fflags != 0 )
+            {
+                /* fflags holds the pending socket error */
+                revents = POLLERR;
+            }
+            else if ( events[i].filter == EVFILT_READ )
+            {
+                /* a plain EOF is left to recv, which then returns 0 */
+                revents = POLLIN;
+            }
+            else if ( events[i].filter == EVFILT_WRITE )
+            {
+                revents = POLLOUT;
+            }
+#endif  // HAVE_EPOLL
+
+            if ( fd == SOCK_poller_stop_pipe[0] )
+            {
+                TRACE("Poller thread terminating.\n");
+
+                /* don't call ExitThread, we don't want to call DllMain */
+                TerminateCurrentThread(0);
+            }
+
+            SOCKProcessPollerEvents( fd, revents );
+        }
+    }
+}
+
+/*++
+Function:
+  SOCKProcessPollerEvents
+
+Does for one socket reported by the poller set what the worker thread loop
+does for the sockets reported by poll.
+
+Parameters:
+  fd: the socket
+  revents: the POLLXXX events reported for it
+--*/
+static void SOCKProcessPollerEvents( int fd, short revents )
+{
+    ws2_sock *sock;
+
+    SYNCEnterCriticalSection(&SOCK_list_crit_section, TRUE);
+
+    /* the socket may have been removed since the poller set reported it */
+    if ( !SOCKAreAsyncOperationsEnabled(fd) )
+    {
+        TRACE("Socket %d is no longer asynchronous\n", fd);
+        SYNCLeaveCriticalSection(&SOCK_list_crit_section, TRUE);
+        return;
+    }
+
+    sock = SOCKGetDataFromAsyncSocket(fd);
+
+    if ( revents & (POLLHUP | POLLERR) )
+    {
+        /* the socket is disconnected, or an exceptional condition has
+           occurred on it; see SOCKWorkerThreadMain */
+        SOCKDeleteAsyncSocket(fd, FALSE);
+        SYNCLeaveCriticalSection(&SOCK_list_crit_section, TRUE);
+        return;
+    }
+
+    if ( (revents & POLLIN) && sock->eventselect &&
+         sock->eventselect->lNetworkEvents & FD_ACCEPT )
+    {
+        TRACE("Socket %d is ready to ACCEPT. Event Signalled.\n", fd);
+        if ( SetEvent(sock->eventselect->hEventObject) == FALSE )
+        {
+            ERROR("Could not signal event!\n");
+        }
+        /* disable accept events for now */
+        sock->eventselect->disabled_events |= FD_ACCEPT;
+    }
+
+    if ( (revents & POLLOUT) && sock->eventselect &&
+         sock->eventselect->lNetworkEvents & FD_CONNECT )
+    {
+        TRACE("Socket %d is ready to connect. Event Signalled.\n", fd);
+        if ( SetEvent(sock->eventselect->hEventObject) == FALSE )
+        {
+            ERROR("Could not signal event!\n");
+        }
+        /* disable connect events for now */
+        sock->eventselect->disabled_events |= FD_CONNECT;
+    }
+
+    SYNCLeaveCriticalSection(&SOCK_list_crit_section, TRUE);
+
+    /* unlike poll, epoll reports both directions at once; kqueue reports
+       each direction on its own */
+    if ( revents & POLLIN )
+    {
+        SOCKProcessOverlappedRecv(fd);
+    }
+    if ( revents & POLLOUT )
+    {
+        SOCKProcessOverlappedSend(fd);
+    }
+
+    /* re-arm the socket, unless it was closed meanwhile */
+    SYNCEnterCriticalSection(&SOCK_list_crit_section, TRUE);
+    if ( SOCKAreAsyncOperationsEnabled(fd) )
+    {
+        SOCKRefreshPollfdEvents(fd);
+    }
+    SYNCLeaveCriticalSection(&SOCK_list_crit_section, TRUE);
+}
+
+/*++
+Function:
+  SOCKSetPollerEvents
+
+Arm the socket in the poller set for the given poll events. Called by
+SOCKRefreshPollfdEvents, holding the SOCK_list_crit_section, each time the
+events of a socket are recomputed.
+
+Parameters:
+  fd: the socket
+  poll_events: the POLLIN/POLLOUT events that are wanted
+--*/
+static void SOCKSetPollerEvents( int fd, short poll_events )
+{
+#if HAVE_EPOLL
+    struct epoll_event ev = { 0 };
+#else   // HAVE_EPOLL
+    struct kevent kev;
+#endif  // HAVE_EPOLL
+
+    if ( SOCK_poller_set_fd == -1 )
+    {
+        return;
+    }
+
+#if HAVE_EPOLL
+    ev.events = EPOLLET | EPOLLONESHOT;
+    if ( poll_events & POLLIN )
+    {
+        ev.events |= EPOLLIN;
+    }
+    if ( poll_events & POLLOUT )
+    {
+        ev.events |= EPOLLOUT;
+    }
+    ev.data.fd = fd;
+
+    /* the socket isn't in the set the first time, nor after it was 
+       closed and its descriptor reused */
+    if ( epoll_ctl(SOCK_poller_set_fd, EPOLL_CTL_MOD, fd, &ev) != 0 )
+    {
+        if ( errno != ENOENT ||
+             epoll_ctl(SOCK_poller_set_fd, EPOLL_CTL_ADD, fd, &ev) != 0 )
+        {
+            ERROR("Unable to add socket %d to the epoll set, "
+                  "errno = %d (%s)\n", fd, errno, strerror(errno));
+        }
+    }
+#else   // HAVE_EPOLL
+    /* kqueue has a filter per direction. Each is added one shot, which 
+       also re-arms it if it already fired, and the kernel reports it 
+       again if the socket is still ready. A filter that isn't wanted 
+       any more is deleted; it may not be there, hence ENOENT. */
+    EV_SET(&kev, fd, EVFILT_READ, 
+           (poll_events & POLLIN) ? EV_ADD | EV_ONESHOT : EV_DELETE, 
+           0, 0, NULL);
+    if ( kevent(SOCK_poller_set_fd, &kev, 1, NULL, 0, NULL) != 0 &&
+         errno != ENOENT )
+    {
+        ERROR("Unable to set the read filter of socket %d, "
+              "errno = %d (%s)\n", fd, errno, strerror(errno));
+    }
+
+    EV_SET(&kev, fd, EVFILT_WRITE, 
+           (poll_events & POLLOUT) ? EV_ADD | EV_ONESHOT : EV_DELETE, 
+           0, 0, NULL);
+    if ( kevent(SOCK_poller_set_fd, &kev, 1, NULL, 0, NULL) != 0 &&
+         errno != ENOENT )
+    {
+        ERROR("Unable to set the write filter of socket %d, "
+              "errno = %d (%s)\n", fd, errno, strerror(errno));
+    }
+#endif  // HAVE_EPOLL
+}
+#endif  // SOCK_HAVE_POLLER_THREADS
+
+
 /*++
 Function:
   SOCKRefreshPollfdEvents
@@ -835,6 +1300,9 @@ static void SOCKRefreshPollfdEvents( int fd )
         SOCKAddAsyncSocket(fd);
         TRACE("new events on socket %d are 0x%hx\n", fd, new_events);
         SOCKGetPollfdFromAsyncSocket(fd)->events = new_events;
+#if SOCK_HAVE_POLLER_THREADS
+        SOCKSetPollerEvents(fd, new_events);
+#endif  // SOCK_HAVE_POLLER_THREADS
 
     }
     else
@@ -913,6 +1381,10 @@ static void SOCKProcessAsyncOperations()
         {
             TRACE("Got WS2_OP_STOPTHREAD; worker thread terminating.\n");
 
+#if SOCK_HAVE_POLLER_THREADS
+            SOCKStopPollerThreads();
+#endif  // SOCK_HAVE_POLLER_THREADS
+
             /* don't call ExitThread, we don't want to call DllMain */
             TerminateCurrentThread(0);
             break;
@@ -938,7 +1410,6 @@ Function:
 static void SOCKProcessOverlappedSend( int fd )
 {
     int    res;
-    fd_set write_set;
   
     ws2_sock *sock;
     ws2_op_list_node *curr;
@@ -948,14 +1419,14 @@ static void SOCKProcessOverlappedSend( int fd )
     ws2_op_sendto *op_sendto;
 
   
-    FD_ZERO(&write_set);
-    if (FD_SET_BOOL(fd, &write_set) == FALSE)
+    /* don't go through FD_SET here: sockets above FD_SETSIZE can be
+       asynchronous too */
+    sock = SOCKGetDataFromAsyncSocket(fd);
+    if (sock == NULL)
     {
         ERROR("Invalid socket value\n");
         return;
     }
-    
-    sock = SOCKGetDataFromAsyncSocket(fd);
 
     SYNCEnterCriticalSection(&SOCK_list_crit_section, TRUE);
     
@@ -1102,24 +1573,20 @@ static void SOCKProcessOverlappedRecv( int fd )
 {
     ws2_sock *sock ;
     int    res;
-    fd_set read_set;
 
     ws2_op_list_node *curr;
     ws2_op_list_node *next;
     ws2_op_list_node *cleanup;
     ws2_op_recvfrom  *op_recvfrom;
     
-    SYNCEnterCriticalSection(&SOCK_list_crit_section, TRUE);
-
-    FD_ZERO(&read_set);
-    if (FD_SET_BOOL(fd, &read_set) == FALSE)
+    sock = SOCKGetDataFromAsyncSocket(fd);
+    if (sock == NULL)
     {
         ERROR("Invalid socket value\n");
-        SYNCLeaveCriticalSection(&SOCK_list_crit_section, TRUE);
         return;
     }
 
-    sock = SOCKGetDataFromAsyncSocket(fd);
+    SYNCEnterCriticalSection(&SOCK_list_crit_section, TRUE);
 
     if ( !sock->recv_list.head )
     {
@@ -1358,6 +1825,40 @@ BOOL SOCKDeleteAsyncSocket( int fd, BOOL bThreadCleanup )
 static void 
 SOCKRemoveSocketFromPollList( int fd )
 {
+#if SOCK_HAVE_POLLER_THREADS
+    if ( SOCK_poller_set_fd != -1 && SOCKAreAsyncOperationsEnabled(fd) )
+    {
+        /* fails if the application already closed the socket, which
+           removed it from the poller set anyway */
+#if HAVE_EPOLL
+        struct epoll_event ev = { 0 };
+
+        if ( epoll_ctl(SOCK_poller_set_fd, EPOLL_CTL_DEL, fd, &ev) != 0 )
+        {
+            TRACE("epoll_ctl(EPOLL_CTL_DEL) failed for socket %d, "
+                  "errno = %d (%s)\n", fd, errno, strerror(errno));
+        }
+#else   // HAVE_EPOLL
+        struct kevent kev[2];
+
+        EV_SET(&kev[0], fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+        EV_SET(&kev[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+        /* one at a time: kevent stops at the first filter that isn't 
+           there */
+        if ( kevent(SOCK_poller_set_fd, &kev[0], 1, NULL, 0, NULL) != 0 )
+        {
+            TRACE("Deleting the read filter of socket %d failed, "
+                  "errno = %d (%s)\n", fd, errno, strerror(errno));
+        }
+        if ( kevent(SOCK_poller_set_fd, &kev[1], 1, NULL, 0, NULL) != 0 )
+        {
+            TRACE("Deleting the write filter of socket %d failed, "
+                  "errno = %d (%s)\n", fd, errno, strerror(errno));
+        }
+#endif  // HAVE_EPOLL
+    }
+#endif  // SOCK_HAVE_POLLER_THREADS
+
     /* find the new highest file descriptor */
     SOCK_socket_list.pollfds[fd].fd = -1;
     if (fd == SOCK_socket_list.max_fd)
@@ -1506,6 +2007,7 @@ SOCKProcessOverlappedCompletion(
                     lpOverlapped->InternalHigh,
                     sock->CompletionKey,
                     (LPOVERLAPPED)lpOverlapped,
+                    NO_ERROR,
                     lpIOCPCompletionPacket);
                 fPostCompletionPacket = TRUE;
             }
@@ -1556,17 +2058,20 @@ Function:
   it will do a pthread conditional variable broadcast to wake up the 
   threads that are waiting on the completion port.
 
+  A non zero dwErrorCode is the error of a failed I/O operation:
+  GetQueuedCompletionStatus returns FALSE for it, with lpOverlapped set.
+
 Return value:
   TRUE, if a new completion status is successfully added to the list;
   FALSE, otherwise.
 --*/
-static
 BOOL
 SOCKPostQueuedCompletionStatus(
     HANDLE CompletionPort,
     DWORD dwNumberOfBytesTransferred,
     ULONG_PTR CompletionKey,
     LPOVERLAPPED lpOverlapped,
+    DWORD dwErrorCode,
     pal_iocp_completion_packet *lpIOCPCompletionPacket)
 {
     BOOL Ret = FALSE;
@@ -1590,6 +2095,7 @@ SOCKPostQueuedCompletionStatus(
     pEntry->dwNumberOfBytesTransferred = dwNumberOfBytesTransferred;
     pEntry->lpOverlapped = lpOverlapped;
     pEntry->CompletionKey = CompletionKey;
+    pEntry->dwErrorCode = dwErrorCode;
 
     rtn = pthread_mutex_lock(&SOCK_iocp.completion_packet_list_mutex);
     if (rtn != 0)
@@ -1636,9 +2142,11 @@ This implementation deviates from MSDN documentation
 in the following three areas:
 1. Only one global IO completion port is supported since CLR's
 threadpool implementation uses only one IO completion port.
-2. Only socket IO is supported since the main purpose
-of IO completion port is to support overlapped IO for
-large number of concurrent socket connections.
+2. Only socket IO and files opened with FILE_FLAG_OVERLAPPED
+are supported. A file handle is checked first, so a socket
+whose descriptor has the same value as such a file handle
+can't be bound; the CLR only binds the handles it got from
+CreateFile and socket.
 3. NumberOfConcurrentThreads in CreateIoCompletionPort
 is not enforced because after a thread gets IO completion status
 it is no longer under the control of completion port.
@@ -1693,6 +2201,13 @@ PAL_CreateIoCompletionPort(
     {
         ws2_sock *sock = NULL;
 
+        if (FILEBindIoCompletionPort(FileHandle, ExistingCompletionPort,
+                                     CompletionKey))
+        {
+            Ret = ExistingCompletionPort;
+            goto CreateIoCompletionPortExit;
+        }
+
         if ( SOCKIsValidSocket((int)((INT_PTR)FileHandle)) == FALSE )
         {
             ERROR("Socket %d is not a valid socket\n", FileHandle);
@@ -1769,6 +2284,7 @@ PostQueuedCompletionStatus(
             dwNumberOfBytesTransferred,
             dwCompletionKey,
             lpOverlapped,
+            NO_ERROR,
             lpIOCPCompletionPacket);
 
 PostQueuedCompletionStatusExit:
@@ -1897,8 +2413,18 @@ GetQueuedCompletionStatus(
         *lpNumberOfBytesTransferred = pPacket->dwNumberOfBytesTransferred;
         *lpCompletionKey = pPacket->CompletionKey;
         *lpOverlapped = pPacket->lpOverlapped;
+
+        /* like Windows, a failed I/O operation dequeues its packet
+           but returns FALSE with the error of the operation */
+        if (pPacket->dwErrorCode != NO_ERROR)
+        {
+            SetLastError(pPacket->dwErrorCode);
+        }
+        else
+        {
+            Ret = TRUE;
+        }
         free(pPacket);
-        Ret = TRUE;
     }
 
 GetQueuedCompletionStatusMutexUnlock:
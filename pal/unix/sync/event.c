@@ -42,6 +42,13 @@ const int MAX_EVENT = MAX_PATH + 1;
 static int DupEventHandle( HANDLE handle, HOBJSTRUCT *handle_data);
 static int CloseEventHandle( HOBJSTRUCT *handle_data);
 static BOOL IsValidEventObject(Event *pEvent);
+static Event *AllocEvent(SHMPTR info, BOOL bManualReset, BOOL bInitialState);
+static void FreeEvent(Event *pEvent);
+static void LocalEventSet(Event *pEvent);
+static int LocalEventWaitOn(Event *pEvent, SHMPTR wait_state, 
+                            int blockingPipe);
+static int LocalEventRemoveWaitingThread(Event *pEvent, SHMPTR wait_state);
+static BOOL LocalEventMoveToShared(Event *pEvent);
 
 /*++
 Function:
@@ -123,8 +130,8 @@ CreateEventW(
 {
     HANDLE hEvent = NULL;
     Event *pEvent;
-    GLOBAL_EVENT_SYSTEM_OBJECT *pEventInfo;
-    SHMPTR newEvent;
+    GLOBAL_EVENT_SYSTEM_OBJECT *pEventInfo = NULL;
+    SHMPTR newEvent = (SHMPTR) NULL;
     DWORD OldLastError;
     BOOL need_unlock = FALSE;
     LPCWSTR lpObjectName = NULL;
@@ -181,8 +188,9 @@ CreateEventW(
         SetLastError(OldLastError);
     }
 
-    /* Allocate the event object */
-    pEvent = (Event *) malloc(sizeof(Event));
+    /* Allocate the event object. An unnamed event stays in this process
+       until it's passed to another one (see EventLocalToRemote) */
+    pEvent = AllocEvent((SHMPTR) NULL, bManualReset, bInitialState);
 
     if (pEvent == NULL)
     {
@@ -191,50 +199,41 @@ CreateEventW(
         goto CreateEventExit;
     }
 
-    /* Allocate the EventInfo in shared memory, so it can be accessible by
-       other processes */
-
-    newEvent = SHMalloc(sizeof(GLOBAL_EVENT_SYSTEM_OBJECT));
-
-    if (newEvent == (SHMPTR) NULL)
+    if (lpName)
     {
-        ERROR("Unable to allocate shared memory\n");
-        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
-        free( pEvent );
-        goto CreateEventExit;
-    }
+        /* Allocate the EventInfo in shared memory, so it can be accessible by
+           other processes */
 
-    pEvent->objHeader.type = HOBJ_EVENT;
-    pEvent->objHeader.close_handle = CloseEventHandle;
-    pEvent->objHeader.dup_handle = DupEventHandle;
+        newEvent = SHMalloc(sizeof(GLOBAL_EVENT_SYSTEM_OBJECT));
 
-    pEvent->refCount = 1;
-    pEvent->info = newEvent;
+        if (newEvent == (SHMPTR) NULL)
+        {
+            ERROR("Unable to allocate shared memory\n");
+            SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+            FreeEvent( pEvent );
+            goto CreateEventExit;
+        }
 
-    pEventInfo = (GLOBAL_EVENT_SYSTEM_OBJECT*) SHMPTR_TO_PTR(newEvent);
-    pEventInfo->refCount = 1;
-    pEventInfo->state = bInitialState;
-    pEventInfo->manualReset = bManualReset;
-    pEventInfo->waitingThreads = (SHMPTR) NULL;
-    pEventInfo->next = (SHMPTR) NULL;
+        pEvent->info = newEvent;
+
+        pEventInfo = (GLOBAL_EVENT_SYSTEM_OBJECT*) SHMPTR_TO_PTR(newEvent);
+        pEventInfo->refCount = 1;
+        pEventInfo->state = bInitialState;
+        pEventInfo->manualReset = bManualReset;
+        pEventInfo->waitingThreads = (SHMPTR) NULL;
+        pEventInfo->next = (SHMPTR) NULL;
     
-    pEventInfo->ShmHeader.ObjectType = SHM_NAMED_EVENTS;
-    pEventInfo->ShmHeader.ShmSelf = newEvent;
-    if (lpName)
-    {
+        pEventInfo->ShmHeader.ObjectType = SHM_NAMED_EVENTS;
+        pEventInfo->ShmHeader.ShmSelf = newEvent;
         if ((pEventInfo->ShmHeader.ShmObjectName = SHMWStrDup( lpObjectName )) == 0)
         {
             ERROR( "Unable to allocate shared memory!\n " );
             SetLastError(ERROR_INTERNAL_ERROR);
             SHMfree(newEvent);
-            free(pEvent);
+            FreeEvent(pEvent);
             goto CreateEventExit;
         }
     }
-    else
-    {
-        pEventInfo->ShmHeader.ShmObjectName = 0;
-    }
 
     hEvent = HMGRGetHandle((HOBJSTRUCT *) pEvent);
 
@@ -243,9 +242,9 @@ CreateEventW(
         if (lpName != NULL)
         {
             SHMfree(pEventInfo->ShmHeader.ShmObjectName);
+            SHMfree(newEvent);
         }
-        SHMfree(newEvent);
-        free(pEvent);
+        FreeEvent(pEvent);
         ERROR("Unable to get a free handle\n");
         SetLastError(ERROR_NOT_ENOUGH_MEMORY);
         goto CreateEventExit;
@@ -302,6 +301,19 @@ SetEvent(
         return FALSE;
     }                                           
 
+    SYNCEnterCriticalSection(&pEvent->critSection, TRUE);
+    if (0 == pEvent->info)
+    {
+        LocalEventSet(pEvent);
+        SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+        HMGRUnlockHandle(hEvent, &pEvent->objHeader);
+
+        LOGEXIT("SetEvent returns BOOL %d\n", bRet);
+        PERF_EXIT(SetEvent);
+        return bRet;
+    }
+    SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+
     SHMLock();
 
     pEventInfo = (GLOBAL_EVENT_SYSTEM_OBJECT*) SHMPTR_TO_PTR(pEvent->info);
@@ -368,6 +380,7 @@ SetEvent(
             WakeUpThread(pWaitingThread->threadId, 
                          pWaitingThread->processId,
                          pWaitingThread->blockingPipe,
+                         pAwakenState,
                          WUTC_SIGNALED );
 
             SHMfree(pTemp);
@@ -412,6 +425,23 @@ ResetEvent(
 
     pEvent = (Event *) HMGRLockHandle2(hEvent, HOBJ_EVENT);
 
+    if ( pEvent != NULL )
+    {
+        SYNCEnterCriticalSection(&pEvent->critSection, TRUE);
+        if (0 == pEvent->info)
+        {
+            pEvent->state = FALSE;
+            SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+            HMGRUnlockHandle(hEvent, &pEvent->objHeader);
+
+            TRACE("Event(%p) being reset.\n", hEvent);
+            LOGEXIT("ResetEvent returns BOOL %d\n", bRet);
+            PERF_EXIT(ResetEvent);
+            return bRet;
+        }
+        SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+    }
+
     SHMLock();
 
     if ( pEvent == NULL )
@@ -522,7 +552,7 @@ OpenEventW(
     else 
     {
         /* build a Event structure */
-        pEvent = (Event *) malloc(sizeof(Event));
+        pEvent = AllocEvent(shmpEventInfo, FALSE, FALSE);
 
         if (pEvent == NULL)
         {
@@ -531,12 +561,6 @@ OpenEventW(
             goto OpenEventWExit;
         }
 
-        pEvent->objHeader.type = HOBJ_EVENT;
-        pEvent->objHeader.close_handle = CloseEventHandle;
-        pEvent->objHeader.dup_handle = DupEventHandle;
-        pEvent->refCount = 1;
-        pEvent->info = shmpEventInfo;
-
         /* get a handle for the event */
         hEvent = HMGRGetHandle((HOBJSTRUCT *) pEvent);
 
@@ -544,7 +568,7 @@ OpenEventW(
         {
             ERROR("Unable to get a handle from the handle manager\n");
             hEvent = NULL;
-            free(pEvent);
+            FreeEvent(pEvent);
             SetLastError(ERROR_NOT_ENOUGH_MEMORY);
             goto OpenEventWExit;
         }
@@ -588,13 +612,14 @@ Function:
 Parameters:
     IN hEvent: handle of the event checked for the signaled state.
     SHMPTR wait_state : shared memory pointer to waiting thread's wait state
+    int blockingPipe : pipe to write to when the object wakes the waiter up
     
 returns
     WAITON_CODE value (see thread.h)
 --*/
 int
 EventWaitOn(
-    IN HANDLE hEvent, SHMPTR wait_state)
+    IN HANDLE hEvent, SHMPTR wait_state, int blockingPipe)
 {
     Event *pEvent;
     GLOBAL_EVENT_SYSTEM_OBJECT *pEventInfo;
@@ -604,16 +629,25 @@ EventWaitOn(
 
     pEvent = (Event *) HMGRLockHandle2(hEvent, HOBJ_EVENT);
 
-    SHMLock();
-
     if ( pEvent == NULL )
     {
         SetLastError(ERROR_INVALID_HANDLE);
         ERROR("Invalid event handle %p\n", hEvent);
-        SHMRelease();
         return WOC_ERROR;
     }
 
+    SYNCEnterCriticalSection(&pEvent->critSection, TRUE);
+    if (0 == pEvent->info)
+    {
+        ret = LocalEventWaitOn(pEvent, wait_state, blockingPipe);
+        SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+        HMGRUnlockHandle(hEvent,&pEvent->objHeader);
+        return ret;
+    }
+    SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+
+    SHMLock();
+
     pEventInfo = (GLOBAL_EVENT_SYSTEM_OBJECT*) SHMPTR_TO_PTR(pEvent->info);
 
     if (pEventInfo == NULL)
@@ -671,7 +705,7 @@ EventWaitOn(
 
             pWaitingThread->threadId = GetCurrentThreadId();
             pWaitingThread->processId = GetCurrentProcessId();
-            pWaitingThread->blockingPipe = THREADGetPipe();
+            pWaitingThread->blockingPipe = blockingPipe;
             pWaitingThread->ptr.shmNext = (SHMPTR) NULL;
             pWaitingThread->state.shmAwakened = wait_state;
 
@@ -735,18 +769,74 @@ EventWaitOn(
     return ret;
 }
 
+/*++
+Function:
+  EventIsManualReset
+
+  Tell whether an event is a manual-reset event (see event.h)
+--*/
+BOOL
+EventIsManualReset(
+    IN HANDLE hEvent)
+{
+    Event *pEvent;
+    GLOBAL_EVENT_SYSTEM_OBJECT *pEventInfo;
+    BOOL bManualReset = FALSE;
+
+    pEvent = (Event *) HMGRLockHandle2(hEvent, HOBJ_EVENT);
+
+    if ( (pEvent == NULL) || (!IsValidEventObject(pEvent)) )
+    {
+        ERROR("Invalid event handle %p\n", hEvent);
+        if (pEvent != NULL)
+        {
+            HMGRUnlockHandle(hEvent,&pEvent->objHeader);
+        }
+        return FALSE;
+    }
+
+    SYNCEnterCriticalSection(&pEvent->critSection, TRUE);
+    if (0 == pEvent->info)
+    {
+        bManualReset = pEvent->manualReset;
+        SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+        HMGRUnlockHandle(hEvent,&pEvent->objHeader);
+        return bManualReset;
+    }
+    SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+
+    SHMLock();
+
+    pEventInfo = (GLOBAL_EVENT_SYSTEM_OBJECT*) SHMPTR_TO_PTR(pEvent->info);
+
+    if (pEventInfo == NULL)
+    {
+        ASSERT("Invalid shared memory pointer\n");
+    }
+    else
+    {
+        bManualReset = pEventInfo->manualReset;
+    }
+
+    SHMRelease();
+    HMGRUnlockHandle(hEvent,&pEvent->objHeader);
+
+    return bManualReset;
+}
+
 /*++
 Function:
   EventRemoveWaitingThread
 
-  Remove the CurrentThreadId from the list of waiting thread. This
-  function is called when the current thread stops waiting on an Event
+  Remove the waiter queued with wait_state from the list of waiting thread.
+  This function is called when the current thread stops waiting on an Event
   for a different reason than the Event was signaled. (e.g. a timeout,
   or the thread was waiting on multiple objects and another object was
   signaled)
 
 Parameters:
     IN hEvent:   event handle of the modify thread waiting list.    
+    SHMPTR wait_state : wait state the waiter was queued with
 
 returns
     -1: an error occurred
@@ -755,7 +845,7 @@ returns
 --*/
 int
 EventRemoveWaitingThread(
-    IN HANDLE hEvent)
+    IN HANDLE hEvent, SHMPTR wait_state)
 {
     Event *pEvent;
     GLOBAL_EVENT_SYSTEM_OBJECT *pEventInfo;
@@ -764,19 +854,29 @@ EventRemoveWaitingThread(
     ThreadWaitingList *pNextWaitingThread;
     SHMPTR shmpWaitingThread;
     DWORD CurrentThreadId;
-    DWORD currentPID;
 
     pEvent = (Event *) HMGRLockHandle2(hEvent, HOBJ_EVENT);
 
-    SHMLock();
-
     if ( (pEvent == NULL) || (!IsValidEventObject(pEvent)) )
     {
         ASSERT("Invalid event handle %p\n", hEvent);
-        SHMRelease();
         return -1;
     }
 
+    CurrentThreadId = GetCurrentThreadId();
+
+    SYNCEnterCriticalSection(&pEvent->critSection, TRUE);
+    if (0 == pEvent->info)
+    {
+        ret = LocalEventRemoveWaitingThread(pEvent, wait_state);
+        SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+        HMGRUnlockHandle(hEvent,&pEvent->objHeader);
+        goto RemoveThreadTrace;
+    }
+    SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+
+    SHMLock();
+
     pEventInfo = (GLOBAL_EVENT_SYSTEM_OBJECT*) SHMPTR_TO_PTR(pEvent->info);
 
     if (pEventInfo == NULL)
@@ -787,8 +887,6 @@ EventRemoveWaitingThread(
         return -1;
     }
 
-    CurrentThreadId = GetCurrentThreadId();
-    currentPID = GetCurrentProcessId();
     shmpWaitingThread = pEventInfo->waitingThreads;
 
     if (shmpWaitingThread == (SHMPTR) NULL)
@@ -807,8 +905,7 @@ EventRemoveWaitingThread(
     }
 
     /* check if it is the first element in the list */
-    if (pWaitingThread->threadId == CurrentThreadId &&
-        pWaitingThread->processId == currentPID)
+    if (pWaitingThread->state.shmAwakened == wait_state)
     {
         pEventInfo->waitingThreads = pWaitingThread->ptr.shmNext;
         SHMfree(shmpWaitingThread);
@@ -829,8 +926,7 @@ EventRemoveWaitingThread(
                 break;
             }
 
-            if (pNextWaitingThread->threadId == CurrentThreadId &&
-                pNextWaitingThread->processId == currentPID)
+            if (pNextWaitingThread->state.shmAwakened == wait_state)
             {
                 /* found, so remove it */
                 SHMPTR pTemp;
@@ -849,6 +945,7 @@ RemoveThreadExit:
     SHMRelease();
     HMGRUnlockHandle(hEvent,&pEvent->objHeader);
 
+RemoveThreadTrace:
     if (ret == 0)
     {
         TRACE("ThreadId=%#x was not waiting on hEvent=%p\n",
@@ -880,15 +977,36 @@ CloseEventHandle(
     ThreadWaitingList *pWaitingThread;
     SHMPTR shmevent;
 
-    SHMLock();
-
     if (!IsValidEventObject(pEvent))
     {
-        SHMRelease();
         ASSERT("Invalid event handle\n");
         return -1;
     }
 
+    SYNCEnterCriticalSection(&pEvent->critSection, TRUE);
+    if (0 == pEvent->info)
+    {
+        pEvent->refCount--;
+        if (pEvent->refCount > 0)
+        {
+            SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+            TRACE("Removed reference to event object %p, refcount is still >0.\n",
+                  handle_data);
+            return 0; /* there's still other handles referencing this object */
+        }
+        pEvent->objHeader.type = HOBJ_INVALID;
+        SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+
+        FreeEvent(pEvent);
+
+        TRACE("Last reference to event object %p released; object destroyed.\n",
+              handle_data);
+        return 0;
+    }
+    SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+
+    SHMLock();
+
     shmevent = pEvent->info;
 
     pEventInfo = (GLOBAL_EVENT_SYSTEM_OBJECT*) SHMPTR_TO_PTR(shmevent);
@@ -908,7 +1026,7 @@ CloseEventHandle(
     if (pEvent->refCount == 0)
     {
         pEvent->objHeader.type = HOBJ_INVALID;
-        free(pEvent);
+        FreeEvent(pEvent);
     }
 
     if (pEventInfo->refCount > 0)
@@ -922,7 +1040,7 @@ CloseEventHandle(
     if (pEventInfo->ShmHeader.ShmObjectName != (SHMPTR) NULL)
     {
         /* Remove the named event from the global link list */
-        SHMRemoveNamedObject( pEvent->info );
+        SHMRemoveNamedObject( shmevent );
     }                                 
 
     /* free the thread waiting list */
@@ -969,15 +1087,23 @@ DupEventHandle(
     Event *pEvent = (Event *) handle_data;
     GLOBAL_EVENT_SYSTEM_OBJECT *pEventInfo;
 
-    SHMLock();
-
     if (!IsValidEventObject(pEvent))
     {
-        SHMRelease();
         ASSERT("Invalid event handle\n");
         return -1;
     }
 
+    SYNCEnterCriticalSection(&pEvent->critSection, TRUE);
+    if (0 == pEvent->info)
+    {
+        pEvent->refCount++;
+        SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+        return 0;
+    }
+    SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+
+    SHMLock();
+
     pEventInfo = (GLOBAL_EVENT_SYSTEM_OBJECT*) SHMPTR_TO_PTR(pEvent->info);
 
     if (pEventInfo == NULL)
@@ -1025,10 +1151,23 @@ BOOL EventLocalToRemote(HOBJSTRUCT* handle_data,
         return  FALSE;
     }
 
+    /* another process is going to use the event : move it to shared memory
+       if it's still local. The shared memory lock is taken before the 
+       event's critical section, since the caller already holds it */
+    SHMLock();
+    SYNCEnterCriticalSection(&pEvent->critSection, TRUE);
+    if (0 == pEvent->info && !LocalEventMoveToShared(pEvent))
+    {
+        SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+        SHMRelease();
+        ERROR("Unable to move the event to shared memory\n");
+        return FALSE;
+    }
+    SYNCLeaveCriticalSection(&pEvent->critSection, TRUE);
+
     remote_handle_data->ShmKernelObject =  pEvent->info;
     
     /* increment shared memory reference count */
-    SHMLock();
     pEventInfo = (GLOBAL_EVENT_SYSTEM_OBJECT*)
                  SHMPTR_TO_PTR( remote_handle_data->ShmKernelObject );
     if (pEventInfo == NULL)
@@ -1072,7 +1211,7 @@ HANDLE EventRemoteToLocal(HREMOTEOBJSTRUCT *remote_handle_data)
     }
 
     /* build a Event structure */
-    pEvent = (Event *) malloc(sizeof(Event));
+    pEvent = AllocEvent(shmpEventInfo, FALSE, FALSE);
     if (pEvent == NULL)
     {
         ERROR("Unable to allocate memory\n");
@@ -1080,18 +1219,12 @@ HANDLE EventRemoteToLocal(HREMOTEOBJSTRUCT *remote_handle_data)
         goto Exit;
     }
 
-    pEvent->objHeader.type = HOBJ_EVENT;
-    pEvent->objHeader.close_handle = CloseEventHandle;
-    pEvent->objHeader.dup_handle = DupEventHandle;
-    pEvent->refCount = 1;
-    pEvent->info = shmpEventInfo;
-
     /* get a handle for the event */
     hEvent = HMGRGetHandle((HOBJSTRUCT *) pEvent);
     if (hEvent == INVALID_HANDLE_VALUE)
     {
         ERROR("Unable to get a handle from the handle manager\n");
-        free(pEvent);
+        FreeEvent(pEvent);
         SetLastError(ERROR_NOT_ENOUGH_MEMORY);
         goto Exit;
     }        
@@ -1101,6 +1234,366 @@ Exit:
 }
 
 
+/*++
+Function:
+    AllocEvent
+
+Abstract:
+    Allocate and initialize an event object
+
+Parameters:
+    IN  info: shared memory EventInfo of the event, 0 for a local event
+    IN  bManualReset, bInitialState: see CreateEvent, for a local event
+
+Return:
+    the event object, NULL if there wasn't enough memory
+--*/
+static
+Event *
+AllocEvent(
+      SHMPTR info,
+      BOOL bManualReset,
+      BOOL bInitialState)
+{
+    Event *pEvent;
+
+    pEvent = (Event *) malloc(sizeof(Event));
+    if (pEvent == NULL)
+    {
+        return NULL;
+    }
+
+    pEvent->objHeader.type = HOBJ_EVENT;
+    pEvent->objHeader.close_handle = CloseEventHandle;
+    pEvent->objHeader.dup_handle = DupEventHandle;
+    pEvent->refCount = 1;
+    pEvent->info = info;
+    pEvent->state = bInitialState;
+    pEvent->manualReset = bManualReset;
+    pEvent->waitingThreads = NULL;
+
+    if (0 != SYNCInitializeCriticalSection(&pEvent->critSection))
+    {
+        ERROR("Unable to initialize critical section\n");
+        free(pEvent);
+        return NULL;
+    }
+
+    return pEvent;
+}
+
+/*++
+Function:
+    FreeEvent
+
+Abstract:
+    Free an event object allocated by AllocEvent, along with the waiting 
+    list of a local event. The shared memory EventInfo isn't touched.
+
+Parameters:
+    IN  pEvent: Event object
+--*/
+static
+void
+FreeEvent(
+      Event *pEvent)
+{
+    ThreadWaitingList *pWaitingThread;
+
+    while (NULL != pEvent->waitingThreads)
+    {
+        pWaitingThread = pEvent->waitingThreads;
+        pEvent->waitingThreads = pWaitingThread->ptr.Next;
+        free(pWaitingThread);
+    }
+
+    DeleteCriticalSection(&pEvent->critSection);
+    free(pEvent);
+}
+
+/*++
+Function:
+    LocalEventSet
+
+Abstract:
+    SetEvent for a local event. The caller holds the event's critical 
+    section.
+
+Parameters:
+    IN  pEvent: Event object
+--*/
+static
+void
+LocalEventSet(
+      Event *pEvent)
+{
+    ThreadWaitingList *pWaitingThread;
+    ThreadWaitingList *pPrevThread = NULL;
+    ThreadWaitingList *pTemp;
+    DWORD *pAwakenState;
+
+    if (pEvent->state)
+    {
+        return;
+    }
+
+    pEvent->state = TRUE;
+
+    /* wake up waiting threads */
+    pWaitingThread = pEvent->waitingThreads;
+    while (NULL != pWaitingThread)
+    {
+        /* check whether thread is already awake. this can happen if 
+           another object already woke up the thread, but the thread hasn't
+           yet had time to remove itself from all waiting lists. */
+        pAwakenState = SHMPTR_TO_PTR(pWaitingThread->state.shmAwakened);
+
+        if(!THREADInterlockedAwaken(pAwakenState, FALSE))
+        {
+            TRACE("thread is already awake, skipping it\n");
+            pPrevThread = pWaitingThread;
+            pWaitingThread = pWaitingThread->ptr.Next;
+            continue;
+        }
+
+        /* remove thread from waiting list */
+        pTemp = pWaitingThread;
+        pWaitingThread = pWaitingThread->ptr.Next;
+        if (NULL == pPrevThread)
+        {
+            pEvent->waitingThreads = pWaitingThread;
+        }
+        else
+        {
+            pPrevThread->ptr.Next = pWaitingThread;
+        }
+
+        TRACE("Waking up thread(%#x) Event has been set (%p)\n",
+              pTemp->threadId, pEvent);
+
+        WakeUpThread(pTemp->threadId, 
+                     pTemp->processId,
+                     pTemp->blockingPipe,
+                     pAwakenState,
+                     WUTC_SIGNALED );
+
+        free(pTemp);
+
+        /* if the event is auto-reset, we only want to wake up one thread, 
+           so break out.*/
+        if (pEvent->manualReset == FALSE)
+        {
+            pEvent->state = FALSE;
+            break;
+        }
+    }
+}
+
+/*++
+Function:
+    LocalEventWaitOn
+
+Abstract:
+    EventWaitOn for a local event. The caller holds the event's critical 
+    section.
+
+Parameters:
+    IN  pEvent: Event object
+    SHMPTR wait_state : shared memory pointer to waiting thread's wait state
+    int blockingPipe : pipe to write to when the object wakes the waiter up
+
+Return:
+    WAITON_CODE value (see thread.h)
+--*/
+static
+int
+LocalEventWaitOn(
+      Event *pEvent,
+      SHMPTR wait_state,
+      int blockingPipe)
+{
+    ThreadWaitingList *pWaitingThread;
+    ThreadWaitingList **ppLast;
+
+    if (pEvent->state)
+    {
+        /* try to flag the thread as awakened, don't add it to the list if it 
+           already was. (this happens if an object is signaled while WFMO is 
+           still calling WaitOn()) */
+        if(!THREADInterlockedAwaken(SHMPTR_TO_PTR(wait_state), FALSE))
+        {
+            TRACE("thread is already awake; not waiting on it\n");
+            return WOC_INTERUPTED;
+        }
+
+        TRACE("Event(%p) is signaled, not waiting\n", pEvent);
+
+        /* reset the event, if it's not a manual reset event */
+        if (pEvent->manualReset == FALSE)
+        {
+            pEvent->state = FALSE;
+        }
+        return WOC_SIGNALED;
+    }
+
+    /* add the current thread to the end of the list of waiting threads */
+    pWaitingThread = (ThreadWaitingList *) malloc(sizeof(ThreadWaitingList));
+    if (pWaitingThread == NULL)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        ERROR("Not enough memory to allocate a ThreadWaitingList\n");
+        return WOC_ERROR;
+    }
+
+    pWaitingThread->threadId = GetCurrentThreadId();
+    pWaitingThread->processId = GetCurrentProcessId();
+    pWaitingThread->blockingPipe = blockingPipe;
+    pWaitingThread->ptr.Next = NULL;
+    pWaitingThread->state.shmAwakened = wait_state;
+
+    for (ppLast = &pEvent->waitingThreads; NULL != *ppLast; 
+         ppLast = &(*ppLast)->ptr.Next)
+    {
+    }
+    *ppLast = pWaitingThread;
+
+    TRACE("Event(%p) is not signaled, current thread added to the waiting "
+          "list\n", pEvent);
+
+    return WOC_WAITING;
+}
+
+/*++
+Function:
+    LocalEventRemoveWaitingThread
+
+Abstract:
+    EventRemoveWaitingThread for a local event. The caller holds the event's
+    critical section.
+
+Parameters:
+    IN  pEvent: Event object
+    SHMPTR wait_state : wait state the waiter was queued with
+
+Return:
+    0: if the thread wasn't found in the list.
+    1: if the thread was removed from the waiting list.
+--*/
+static
+int
+LocalEventRemoveWaitingThread(
+      Event *pEvent,
+      SHMPTR wait_state)
+{
+    ThreadWaitingList **ppWaitingThread;
+    ThreadWaitingList *pWaitingThread;
+
+    for (ppWaitingThread = &pEvent->waitingThreads; NULL != *ppWaitingThread;
+         ppWaitingThread = &(*ppWaitingThread)->ptr.Next)
+    {
+        pWaitingThread = *ppWaitingThread;
+        if (pWaitingThread->state.shmAwakened == wait_state)
+        {
+            *ppWaitingThread = pWaitingThread->ptr.Next;
+            free(pWaitingThread);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*++
+Function:
+    LocalEventMoveToShared
+
+Abstract:
+    Move a local event to shared memory, so that other processes can use it.
+    The caller holds the shared memory lock and the event's critical 
+    section. On failure the event stays local.
+
+Parameters:
+    IN  pEvent: Event object
+
+Return:
+    TRUE if the event was moved, FALSE if there wasn't enough shared memory
+--*/
+static
+BOOL
+LocalEventMoveToShared(
+      Event *pEvent)
+{
+    SHMPTR shmEvent;
+    GLOBAL_EVENT_SYSTEM_OBJECT *pEventInfo;
+    SHMPTR shmWaitingThread;
+    SHMPTR *pshmLast;
+    ThreadWaitingList *pWaitingThread;
+    ThreadWaitingList *pSharedWaitingThread;
+
+    shmEvent = SHMalloc(sizeof(GLOBAL_EVENT_SYSTEM_OBJECT));
+    if (shmEvent == (SHMPTR) NULL)
+    {
+        ERROR("Unable to allocate shared memory\n");
+        return FALSE;
+    }
+
+    /* every handle of the process holds a reference on the shared object, 
+       as if the event had been created there */
+    pEventInfo = (GLOBAL_EVENT_SYSTEM_OBJECT*) SHMPTR_TO_PTR(shmEvent);
+    pEventInfo->refCount = pEvent->refCount;
+    pEventInfo->state = pEvent->state;
+    pEventInfo->manualReset = pEvent->manualReset;
+    pEventInfo->waitingThreads = (SHMPTR) NULL;
+    pEventInfo->next = (SHMPTR) NULL;
+    pEventInfo->ShmHeader.ObjectType = SHM_NAMED_EVENTS;
+    pEventInfo->ShmHeader.ShmSelf = shmEvent;
+    pEventInfo->ShmHeader.ShmObjectName = 0;
+
+    /* copy the waiting threads, in order */
+    pshmLast = &pEventInfo->waitingThreads;
+    for (pWaitingThread = pEvent->waitingThreads; NULL != pWaitingThread; 
+         pWaitingThread = pWaitingThread->ptr.Next)
+    {
+        shmWaitingThread = SHMalloc(sizeof(ThreadWaitingList));
+        if (shmWaitingThread == (SHMPTR) NULL)
+        {
+            ERROR("Not enough memory to allocate a ThreadWaitingList\n");
+
+            while (pEventInfo->waitingThreads)
+            {
+                shmWaitingThread = pEventInfo->waitingThreads;
+                pSharedWaitingThread = SHMPTR_TO_PTR(shmWaitingThread);
+                pEventInfo->waitingThreads = pSharedWaitingThread->ptr.shmNext;
+                SHMfree(shmWaitingThread);
+            }
+            SHMfree(shmEvent);
+            return FALSE;
+        }
+
+        pSharedWaitingThread = SHMPTR_TO_PTR(shmWaitingThread);
+        pSharedWaitingThread->threadId = pWaitingThread->threadId;
+        pSharedWaitingThread->processId = pWaitingThread->processId;
+        pSharedWaitingThread->blockingPipe = pWaitingThread->blockingPipe;
+        pSharedWaitingThread->ptr.shmNext = (SHMPTR) NULL;
+        pSharedWaitingThread->state.shmAwakened = 
+            pWaitingThread->state.shmAwakened;
+
+        *pshmLast = shmWaitingThread;
+        pshmLast = &pSharedWaitingThread->ptr.shmNext;
+    }
+
+    while (NULL != pEvent->waitingThreads)
+    {
+        pWaitingThread = pEvent->waitingThreads;
+        pEvent->waitingThreads = pWaitingThread->ptr.Next;
+        free(pWaitingThread);
+    }
+
+    pEvent->info = shmEvent;
+
+    TRACE("Event %p moved to shared memory\n", pEvent);
+    return TRUE;
+}
+
 /*++
 Function:
     isValidEventObject
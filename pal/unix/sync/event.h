@@ -28,13 +28,24 @@ Abstract:
 #include "pal/handle.h"
 #include "pal/thread.h"
 
+/* An unnamed event lives in the process until it's passed to another 
+   process (EventLocalToRemote); only then does it move to shared memory. 
+   Until then, critSection guards it and SetEvent, ResetEvent and the waits
+   don't take the shared memory lock. The move is one way. */
 typedef struct _Event
 {
     HOBJSTRUCT   objHeader;
 
-    SHMPTR       info;     /* shared mem pointer on EventInfo structure */
+    SHMPTR       info;     /* shared mem pointer on EventInfo structure, 
+                              0 while the event is local */
 
     INT          refCount;
+
+    CRITICAL_SECTION critSection;       /* guards info, and the members 
+                                           below while the event is local */
+    BOOL         state;
+    BOOL         manualReset;
+    ThreadWaitingList *waitingThreads;  /* ptr.Next, state.shmAwakened */
 } Event;
 
 /* Global Data.
@@ -68,33 +79,52 @@ Function:
 Parameters:
     IN hEvent: handle of the event checked for the signaled state.
     SHMPTR wait_state : shared memory pointer to waiting thread's wait state
+    int blockingPipe : pipe to write to when the object wakes the waiter up
     
 returns
 	-1: an error occurred, SetLastError is called in this function.
 	0: the event is not signaled.
     1: if the event is signaled.
 --*/
-int EventWaitOn(IN HANDLE hEvent, SHMPTR wait_state);
+int EventWaitOn(IN HANDLE hEvent, SHMPTR wait_state, int blockingPipe);
 
 /*++
 Function:
   EventRemoveWaitingThread
 
-  Remove the CurrentThreadId from the list of waiting thread. This
-  function is called when the current thread stop waiting on an Event
+  Remove the waiter queued with wait_state from the list of waiting thread.
+  This function is called when the current thread stop waiting on an Event
   for a different reason than the Event was signaled. (e.g. a timeout,
   or the thread was waiting on multiple objects and another object was
   signaled)
 
 Parameters:
     IN hEvent:   event handle of the modify thread waiting list.    
+    SHMPTR wait_state : wait state the waiter was queued with
 
 returns
 	-1: an error occurred, SetLastError is called in this function.
 	0: if the thread wasn't found in the list.
     1: if the thread was removed from the waiting list.
 --*/
-int EventRemoveWaitingThread(IN HANDLE hEvent);
+int EventRemoveWaitingThread(IN HANDLE hEvent, SHMPTR wait_state);
+
+/*++
+Function:
+  EventIsManualReset
+
+  Tell whether an event stays signaled when it wakes up a waiter. Used by 
+  the wait sets to hand back the signal of an auto-reset event that woke up
+  a registration which is then removed.
+
+Parameters:
+    IN hEvent: event handle
+
+returns
+    TRUE for a manual-reset event, FALSE for an auto-reset event or an 
+    invalid handle
+--*/
+BOOL EventIsManualReset(IN HANDLE hEvent);
 
 
 #endif //PAL_EVENT_H_
@@ -79,7 +79,7 @@ void MutexCleanup( void )
 /*++
 Function :
 
-    MutexAddThreadToList( pKernelObject );
+    MutexAddThreadToList( pKernelObject, wait_state, blockingPipe );
 
     Adds the current thread to the end of the thread list.
     
@@ -88,7 +88,7 @@ Function :
     Returns TRUE on success, FALSE on failure.
 --*/
 static BOOL MutexAddThreadToList( PGLOBAL_MUTEX_SYSTEM_OBJECT pKernelObject,
-                                  SHMPTR wait_state )
+                                  SHMPTR wait_state, int blockingPipe )
 {
     ThreadWaitingList * pNewThread = NULL;
     SHMPTR ShmThread = 0;
@@ -104,7 +104,7 @@ static BOOL MutexAddThreadToList( PGLOBAL_MUTEX_SYSTEM_OBJECT pKernelObject,
     if ( ShmThread != 0 )
     {
         pNewThread = (ThreadWaitingList*)SHMPTR_TO_PTR( ShmThread );
-        pNewThread->blockingPipe = THREADGetPipe();
+        pNewThread->blockingPipe = blockingPipe;
         pNewThread->processId = GetCurrentProcessId();
         pNewThread->threadId = GetCurrentThreadId();
         pNewThread->ptr.shmNext = 0;
@@ -163,12 +163,13 @@ Function :
 Parameters
     IN hMutex   mutex checked to see if it is signaled
     SHMPTR wait_state : shared memory pointer to waiting thread's wait state
+    int blockingPipe : pipe to write to when the object wakes the waiter up
 
 returns
     WAITON_CODE value
 --*/
 
-INT MutexWaitOn( IN HANDLE hMutex, SHMPTR wait_state )
+INT MutexWaitOn( IN HANDLE hMutex, SHMPTR wait_state, int blockingPipe )
 {
     PGLOBAL_MUTEX_SYSTEM_OBJECT pKernelObject = NULL;
     PMUTEX_HANDLE_OBJECT pHandleObject = NULL;
@@ -250,7 +251,7 @@ INT MutexWaitOn( IN HANDLE hMutex, SHMPTR wait_state )
         else
         {
             /* Add the thread to the waiting thread list. */
-            if ( MutexAddThreadToList( pKernelObject, wait_state ) )
+            if ( MutexAddThreadToList( pKernelObject, wait_state, blockingPipe ) )
             {
                 RetVal = 1;
             }
@@ -287,8 +288,8 @@ Function :
 
     MutexRemoveWaitingThread
 
-        Remove the CurrentThreadId from the list of waiting thread. This
-        function is called when the current thread stops waiting on a Mutex
+        Remove the waiter queued with wait_state from the list of waiting
+        thread. This function is called when the current thread stops waiting on a Mutex
         for a different reason than the Mutex was signaled. (e.g. a timeout,
         or the thread was waiting on multiple objects and another object was
         signaled)
@@ -296,6 +297,7 @@ Function :
 Parameters
     
         IN hMutex   mutex which the waiting thread list is updated
+        SHMPTR wait_state : wait state the waiter was queued with
 
 Returns
         -1: an error occurred
@@ -303,14 +305,13 @@ Returns
         1: if the thread was removed from the waiting list.
 --*/
 
-INT MutexRemoveWaitingThread( IN HANDLE hMutex )
+INT MutexRemoveWaitingThread( IN HANDLE hMutex, SHMPTR wait_state )
 {
     PMUTEX_HANDLE_OBJECT pMutexHandleObject = NULL;
     PGLOBAL_MUTEX_SYSTEM_OBJECT pKernelObject = NULL;
     
     ThreadWaitingList *pWaitingThread = NULL;
     DWORD CurrentThreadId = -1;
-    DWORD CurrentProcessId = -1;
     INT RetVal = -1;
 
     TRACE( "Entered.\n" );
@@ -342,7 +343,6 @@ INT MutexRemoveWaitingThread( IN HANDLE hMutex )
         (ThreadWaitingList*)SHMPTR_TO_PTR( pKernelObject->ShmWaitingForThreadList );
 
     CurrentThreadId = GetCurrentThreadId();
-    CurrentProcessId = GetCurrentProcessId();
     
     if ( pWaitingThread == NULL )
     {        
@@ -351,8 +351,7 @@ INT MutexRemoveWaitingThread( IN HANDLE hMutex )
     }
 
     /* Check if it is the first element in the list. */
-    if ( pWaitingThread->threadId == CurrentThreadId && 
-         pWaitingThread->processId == CurrentProcessId )
+    if ( pWaitingThread->state.shmAwakened == wait_state )
     {
         SHMPTR temp = pKernelObject->ShmWaitingForThreadList;
         pKernelObject->ShmWaitingForThreadList = pWaitingThread->ptr.shmNext;
@@ -372,8 +371,7 @@ INT MutexRemoveWaitingThread( IN HANDLE hMutex )
             pNextWaitingThread = 
                 (ThreadWaitingList*)SHMPTR_TO_PTR( pWaitingThread->ptr.shmNext );
 
-            if ( pNextWaitingThread->threadId == CurrentThreadId && 
-                 pNextWaitingThread->processId == CurrentProcessId ) 
+            if ( pNextWaitingThread->state.shmAwakened == wait_state )
             {
                 /* Found it so remove it */
                 SHMPTR shmTemp = 0;
@@ -1379,6 +1377,7 @@ MutexReleaseMutex( MUTEX_HANDLE_OBJECT *pMutex, WAKEUPTHREAD_CODE WakeUpCode,
                 WakeUpThread( pThreadWaitingList->threadId, 
                               pThreadWaitingList->processId,
                               pThreadWaitingList->blockingPipe,
+                              pAwakenState,
                               WakeUpCode );
                 SHMfree(shmWaitingThread);
             }
@@ -280,6 +280,7 @@ ReleaseSemaphore(
         WakeUpThread(pWaitingThread->threadId, 
                      pWaitingThread->processId,
                      pWaitingThread->blockingPipe,
+                     pWaitingThread->state.pAwakened,
                      WUTC_SIGNALED );
         pTempThread = pWaitingThread;
         pWaitingThread = pWaitingThread->ptr.Next;
@@ -319,13 +320,14 @@ Function:
 Parameters
     IN hSemaphore   semaphore checked to see if it is signaled
     SHMPTR wait_state : shared memory pointer to waiting thread's wait state
+    int blockingPipe : pipe to write to when the object wakes the waiter up
 
 returns
     WAITON_CODE value (see thread.h)
 --*/
 int
 SemaphoreWaitOn(
-    IN HANDLE hSemaphore, SHMPTR wait_state)
+    IN HANDLE hSemaphore, SHMPTR wait_state, int blockingPipe)
 {
     Semaphore *pSemaphore;
 	BOOL ret;
@@ -379,7 +381,7 @@ SemaphoreWaitOn(
 		{
             pWaitingThread->threadId = GetCurrentThreadId();
             pWaitingThread->processId = GetCurrentProcessId();
-            pWaitingThread->blockingPipe = THREADGetPipe();
+            pWaitingThread->blockingPipe = blockingPipe;
             pWaitingThread->ptr.Next = NULL;
             pWaitingThread->state.pAwakened = SHMPTR_TO_PTR(wait_state);
 
@@ -427,14 +429,15 @@ done:
 Function:
   SemaphoreRemoveWaitingThread
 
-  Remove the CurrentThreadId from the list of waiting thread. This
-  function is called when the current thread stop waiting on a Semaphore
+  Remove the waiter queued with wait_state from the list of waiting thread.
+  This function is called when the current thread stop waiting on a Semaphore
   for a different reason than the Semaphore was signaled. (e.g. a timeout,
   or the thread was waiting on multiple objects and another object was
   signaled)
 
 Parameters
     IN hSemaphore   semaphore which the waiting thread list is updated
+    SHMPTR wait_state : wait state the waiter was queued with
 
 returns
     -1: an error occurred
@@ -443,13 +446,14 @@ returns
 --*/
 int
 SemaphoreRemoveWaitingThread(
-	IN HANDLE hSemaphore)
+	IN HANDLE hSemaphore, SHMPTR wait_state)
 {
     Semaphore *pSemaphore;
 	int ret = 0;
 	ThreadWaitingList *pWaitingThread;
 	ThreadWaitingList *pNextWaitingThread;
     DWORD CurrentThreadId;
+    DWORD *pAwakenState = SHMPTR_TO_PTR(wait_state);
 
     pSemaphore = (Semaphore *) HMGRLockHandle2(hSemaphore, HOBJ_SEMAPHORE);
 
@@ -471,7 +475,7 @@ SemaphoreRemoveWaitingThread(
     }
 
     /* check if it is the first element in the list */
-    if (pWaitingThread->threadId == CurrentThreadId)
+    if (pWaitingThread->state.pAwakened == pAwakenState)
     {
         pSemaphore->waitingThreads = pWaitingThread->ptr.Next;
         free(pWaitingThread);
@@ -484,7 +488,7 @@ SemaphoreRemoveWaitingThread(
         {
             pNextWaitingThread = pWaitingThread->ptr.Next;
 
-            if (pNextWaitingThread->threadId == CurrentThreadId)
+            if (pNextWaitingThread->state.pAwakened == pAwakenState)
             {
                 /* found, so remove it */
                 ThreadWaitingList *pTemp;
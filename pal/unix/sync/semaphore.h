@@ -55,33 +55,35 @@ Function:
 Parameters
     IN hSemaphore   semaphore checked to see if it is signaled
     SHMPTR wait_state : shared memory pointer to waiting thread's wait state
+    int blockingPipe : pipe to write to when the object wakes the waiter up
 
 returns
     -1: an error occurred, SetLastError is called in this function.
     0: the semaphore is signaled.
     1: if the semaphore is not signaled.
 --*/
-int SemaphoreWaitOn(IN HANDLE hSemaphore, SHMPTR wait_state);
+int SemaphoreWaitOn(IN HANDLE hSemaphore, SHMPTR wait_state, int blockingPipe);
 
 /*++
 Function:
   SemaphoreRemoveWaitingThread
 
-  Remove the CurrentThreadId from the list of waiting thread. This
-  function is called when the current thread stop waiting on a Semaphore
+  Remove the waiter queued with wait_state from the list of waiting thread.
+  This function is called when the current thread stop waiting on a Semaphore
   for a different reason than the Semaphore was signaled. (e.g. a timeout,
   or the thread was waiting on multiple objects and another object was
   signaled)
 
 Parameters
     IN hSemaphore   semaphore which the waiting thread list is updated
+    SHMPTR wait_state : wait state the waiter was queued with
 
 returns
     -1: an error occurred
     0: if the thread wasn't found in the list.
     1: if the thread was removed from the waiting list.
 --*/
-int SemaphoreRemoveWaitingThread(IN HANDLE hSemaphore);
+int SemaphoreRemoveWaitingThread(IN HANDLE hSemaphore, SHMPTR wait_state);
 
 
 #endif //PAL_SEMAPHORE_H_
@@ -53,6 +53,14 @@ Revision History:
 #if HAVE_BROKEN_FIFO_SELECT
 #include <sys/stat.h>
 #endif  /* HAVE_BROKEN_FIFO_SELECT */
+#if HAVE_FUTEX
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#elif HAVE_EVFILT_USER
+#include <time.h>
+#include <sys/event.h>
+#endif  /* HAVE_FUTEX */
 
 SET_DEFAULT_DEBUG_CHANNEL(SYNC);
 
@@ -94,6 +102,79 @@ typedef struct _PROCESS_WAIT_ENTRY
     HANDLE Event;
 } PROCESS_WAIT_ENTRY, *PPROCESS_WAIT_ENTRY;
 
+/* wait state of a wait set registration. Like a thread's wait block it
+   lives in shared memory, and the waiting lists keep the address of its 
+   first member. The object that wakes the registration up moves the state
+   from TWS_SETWAITING to TWS_SETREADY and WakeUpThread pushes the block on 
+   the set's ready list, so the owner finds the signaled registrations 
+   without looking at the others.
+
+state : TWS_SETWAITING, then TWS_SETREADY once an object woke it up
+shmSelf : shared memory pointer to the block itself
+shmNextReady : next block of the ready list
+shmReadyList : the set's ready list (an SHMPTR to its first block)
+index : position of the registration in the set; only the owner thread uses 
+        it
+*/
+typedef struct _WAIT_SET_WAIT_BLOCK
+{
+    DWORD state;
+    SHMPTR shmSelf;
+    SHMPTR shmNextReady;
+    SHMPTR shmReadyList;
+    DWORD index;
+} WAIT_SET_WAIT_BLOCK;
+
+/* registration of an object in a wait set. The object's waiting list refers
+   to the entry through the entry's own wait state, so the objects of a set 
+   are woken up independently of each other and of the owner thread's own 
+   waits.
+
+hObject : the registered object
+hWaitObject : object in whose waiting list the entry is; hObject itself, or 
+              for a process, the event the WFMO worker thread sets when the 
+              process exits
+type : type of hWaitObject
+pvContext : value PAL_WaitSetWait returns when the object is signaled
+shmWaitState : wait state of the entry, a WAIT_SET_WAIT_BLOCK
+*/
+typedef struct _WAIT_SET_ENTRY
+{
+    HANDLE hObject;
+    HANDLE hWaitObject;
+    HOBJTYPE type;
+    PVOID pvContext;
+    SHMPTR shmWaitState;
+    WAIT_SET_WAIT_BLOCK *pWaitBlock;
+} WAIT_SET_ENTRY;
+
+/* the objects of a wait set write their wakeup codes into writePipe instead 
+   of the owner thread's blocking pipe, and push the woken up entries on the
+   ready list. The owner moves them to its pending list, oldest first, and 
+   PAL_WaitSetWait returns them from there.
+
+shmReadyList : shared memory SHMPTR, first block of the ready list (newest 
+               first); pushed to by any thread, emptied by the owner
+pReadyList : local pointer to the same
+shmPendingHead, shmPendingTail : blocks taken off the ready list and not 
+                                 returned yet; owner only
+*/
+struct _PAL_WAIT_SET
+{
+    DWORD dwOwnerThreadId;
+    int readPipe;
+    int writePipe;
+    WAIT_SET_ENTRY *pEntries;
+    DWORD nEntries;
+    DWORD nMaxEntries;
+    SHMPTR shmReadyList;
+    SHMPTR *pReadyList;
+    SHMPTR shmPendingHead;
+    SHMPTR shmPendingTail;
+};
+
+#define WAIT_SET_INITIAL_ENTRIES 16
+
 
 /****************** static functions ***************************/
 static
@@ -105,13 +186,25 @@ WFMO_WaitForMultipleObjectsEx(
              IN DWORD dwMilliseconds,
              IN BOOL bAlertable,
              IN BOOL bSleep);
-static WAITON_CODE WaitOn(HOBJTYPE type, HANDLE handle, SHMPTR wait_state);
+static WAITON_CODE WaitOn(HOBJTYPE type, HANDLE handle, SHMPTR wait_state,
+                          int blockingPipe);
 static int StopWaitingOnObjects(HOBJSTRUCT **hObjs, CONST HANDLE *pHandles, 
                                 int Count,
-                                HANDLE WaitProcessEvent);
-static BOOL StopWaiting(DWORD type, HANDLE handle);
+                                HANDLE WaitProcessEvent,
+                                SHMPTR wait_state);
+static BOOL StopWaiting(DWORD type, HANDLE handle, SHMPTR wait_state);
 static WAKEUPTHREAD_CODE ThreadWait(DWORD Milliseconds, BOOL bAlertable,
                                     DWORD *pWaitState);
+#if HAVE_FUTEX
+static int FutexWaitForWakeupCode(DWORD Milliseconds, 
+                                  THREAD_WAIT_BLOCK *pWaitBlock);
+#elif HAVE_EVFILT_USER
+static int KqueueGetWaitKqueue(THREAD_WAIT_BLOCK *pWaitBlock);
+static int KqueueWaitForWakeupCode(DWORD Milliseconds, 
+                                   THREAD_WAIT_BLOCK *pWaitBlock);
+static int KqueueWaitOnce(THREAD_WAIT_BLOCK *pWaitBlock, 
+                          const struct timespec *pTimeout);
+#endif  /* HAVE_FUTEX */
 static int PollBlockingPipe(DWORD Milliseconds, int blockingPipe, 
                             DWORD *pWaitState);
 static void WFMO_update_timeout(DWORD *old_time, DWORD *timeout);
@@ -119,6 +212,17 @@ static DWORD WFMO_WaitForAllObjects(int nCount, CONST HANDLE *lpHandles,
                                    HOBJSTRUCT **hObjs, DWORD dwMilliseconds);
 static DWORD WFMO_WaitForProcess(HANDLE hProcess, DWORD dwMilliseconds);
 static DWORD PALAPI WFMO_workerthread(LPVOID param);
+static BOOL WFMO_EnsureWorkerThread(void);
+static BOOL WaitSetCheckOwner(PAL_WAIT_SET hWaitSet);
+static void WaitSetReleaseEntry(PAL_WAIT_SET hWaitSet, WAIT_SET_ENTRY *pEntry,
+                                BOOL bReturnSignal);
+static void WaitSetDropEntry(PAL_WAIT_SET hWaitSet, DWORD index);
+static void WaitSetReturnSignal(WAIT_SET_ENTRY *pEntry);
+static void WaitSetPushReady(WAIT_SET_WAIT_BLOCK *pBlock);
+static void WaitSetTakeReady(PAL_WAIT_SET hWaitSet);
+static DWORD WaitSetCollect(PAL_WAIT_SET hWaitSet, PVOID *ppvContexts, 
+                            DWORD nMaxContexts);
+static void WaitSetDrainPipe(int fd);
 static DWORD WFMO_WaitForProcessEntry(PPROCESS_HANDLE_ENTRY pProcessEntry);
 static DWORD WFMO_WaitForProcessHandleLoop();
 static PPROCESS_HANDLE_ENTRY WFMO_FindProcessHandleEntry(HANDLE Process);
@@ -430,6 +534,7 @@ WFMO_WaitForMultipleObjectsEx(
         SHMPTR shmThreadWaitState;
         DWORD *pThreadWaitState;
         DWORD waitState;
+        int waitPipe;
         WAITON_CODE ret = 0;
 
         if ((hThread = PROCGetRealCurrentThread()) == INVALID_HANDLE_VALUE)
@@ -452,41 +557,10 @@ WFMO_WaitForMultipleObjectsEx(
 
             SYNCEnterCriticalSection(&wfmo_critical_section, TRUE);
             
-            if(NULL == worker_handle)
+            if(!WFMO_EnsureWorkerThread())
             {
-                /*first-time initialization : create worker thread and event */
-                DWORD tid;
-
-                TRACE("creating WFMO worker thread and related events\n");
-
-                /* reset flag used to stop worker thread */
-                keep_going = TRUE;
-
-                /* create worker thread's event, which we'll use to wake 
-                  it up when we want it to wait on a process */
-                start_worker_event = CreateEventW(NULL, FALSE, FALSE, NULL);
-                if(NULL == start_worker_event)
-                {
-                    ERROR("couldn't create event used to signal WFMO worker "
-                          "thread; error is %d\n", GetLastError());
-                    SetLastError(ERROR_NOT_ENOUGH_MEMORY);
-                    SYNCLeaveCriticalSection(&wfmo_critical_section, TRUE);
-                    goto WaitFMOExit;
-                }
-
-                /* create the worker thread itself */
-                worker_handle = CreateInternalThread(NULL, 0, &WFMO_workerthread,
-                                                     NULL, 0, &tid);
-                if(NULL == worker_handle)
-                {
-                    ERROR("couldn't create WFMO worker thread; error is %d\n",
-                          GetLastError());
-                    CloseHandle(start_worker_event);
-                    start_worker_event = NULL;
-                    SetLastError(ERROR_OUTOFMEMORY);
-                    SYNCLeaveCriticalSection(&wfmo_critical_section, TRUE);
-                    goto WaitFMOExit;
-                }
+                SYNCLeaveCriticalSection(&wfmo_critical_section, TRUE);
+                goto WaitFMOExit;
             }
 
             SYNCLeaveCriticalSection(&wfmo_critical_section, TRUE);
@@ -503,6 +577,33 @@ WFMO_WaitForMultipleObjectsEx(
         
         shmThreadWaitState = pThread->waitAwakened;
         pThreadWaitState = SHMPTR_TO_PTR(shmThreadWaitState);
+
+#if HAVE_FUTEX
+        /* the objects wake this thread up through the futex in its wait 
+           block. a code left over from an earlier wait (another object 
+           woke us up while we were leaving it) is stale by now */
+        ((THREAD_WAIT_BLOCK *)pThreadWaitState)->wakeupCode = WUTC_NONE;
+        ((THREAD_WAIT_BLOCK *)pThreadWaitState)->bBlockWait = TRUE;
+        waitPipe = WAIT_BLOCK_PIPE;
+#else   /* HAVE_FUTEX */
+#if HAVE_EVFILT_USER
+        /* the objects of this process wake this thread up through the user
+           event of its kqueue, those of other processes through its pipe, 
+           which the kqueue also watches. without a kqueue, the thread 
+           sleeps on its pipe alone */
+        if (-1 != KqueueGetWaitKqueue((THREAD_WAIT_BLOCK *)pThreadWaitState))
+        {
+            ((THREAD_WAIT_BLOCK *)pThreadWaitState)->wakeupCode = WUTC_NONE;
+            ((THREAD_WAIT_BLOCK *)pThreadWaitState)->bBlockWait = TRUE;
+            waitPipe = WAIT_BLOCK_PIPE;
+        }
+        else
+#endif  /* HAVE_EVFILT_USER */
+        {
+            waitPipe = THREADGetPipe();
+        }
+#endif  /* HAVE_FUTEX */
+
         waitState = bAlertable?TWS_ALERTABLE:TWS_WAITING;
         waitState = InterlockedCompareExchange(pThreadWaitState, waitState, 
                                                TWS_ACTIVE);
@@ -526,7 +627,7 @@ WFMO_WaitForMultipleObjectsEx(
                 event instead of the process; the worker thread will signal
                 WaitProcessEvent when the process is signalled */
             ret = WaitOn(HOBJ_EVENT, WaitProcessEvent, 
-                            shmThreadWaitState);
+                            shmThreadWaitState, waitPipe);
 
             if (WOC_WAITING != ret)
             {
@@ -550,7 +651,8 @@ WFMO_WaitForMultipleObjectsEx(
                         "process %#x\n", hHandles[i]);
                         SYNCLeaveCriticalSection(&wfmo_critical_section, TRUE);
                         retValue = WAIT_FAILED;
-                        StopWaitingOnObjects(hObjs, hHandles, i, WaitProcessEvent);
+                        StopWaitingOnObjects(hObjs, hHandles, i, WaitProcessEvent,
+                                             shmThreadWaitState);
                         goto WaitFMOExit;
                     }
                 }
@@ -571,14 +673,15 @@ WFMO_WaitForMultipleObjectsEx(
                 continue;
 
             ret = WaitOn(hObjs[i]->type, *(hHandles+i), 
-                            shmThreadWaitState);
+                            shmThreadWaitState, waitPipe);
 
             if (ret == WOC_ERROR)
             {
                 ERROR("WaitOn() reported an error for object %p\n",
                       *(hHandles+i));
                 /* an error occurred, SetLastError has already been called */
-                StopWaitingOnObjects(hObjs, hHandles, i, WaitProcessEvent);
+                StopWaitingOnObjects(hObjs, hHandles, i, WaitProcessEvent,
+                                     shmThreadWaitState);
                 goto WaitFMOExit;
             }
 
@@ -595,7 +698,8 @@ WFMO_WaitForMultipleObjectsEx(
                     retValue = WAIT_ABANDONED_0 + i;
                 }
 
-                StopWaitingOnObjects(hObjs, hHandles, i, WaitProcessEvent);
+                StopWaitingOnObjects(hObjs, hHandles, i, WaitProcessEvent,
+                                     shmThreadWaitState);
                 goto WaitFMOExit;
             }
             else if(WOC_INTERUPTED == ret)
@@ -628,7 +732,7 @@ WFMO_WaitForMultipleObjectsEx(
            remove it, then we call the callback
         */
         retValue = StopWaitingOnObjects(hObjs, hHandles, handles_locked,
-            WaitProcessEvent);
+            WaitProcessEvent, shmThreadWaitState);
 
         /* If we receive WUTC_APC_QUEUED as a wakeup code, that means 
            that QueueUserAPC() was called and APC(es) were queued on our 
@@ -717,56 +821,975 @@ WaitFMOExit:
     return retValue;
 }
 
-
+
+/*++
+Function:
+  Sleep
+
+See MSDN doc.
+--*/
+VOID
+PALAPI
+Sleep(
+      IN DWORD dwMilliseconds)
+{
+    PERF_ENTRY(Sleep);
+    ENTRY("Sleep(dwMilliseconds=%u)\n", dwMilliseconds);
+
+    WFMO_WaitForMultipleObjectsEx(0, NULL, FALSE, dwMilliseconds, FALSE, TRUE);
+
+    LOGEXIT("Sleep returns VOID\n");
+    PERF_EXIT(Sleep);
+}
+
+
+/*++
+Function:
+  SleepEx
+
+See MSDN doc.
+--*/
+DWORD
+PALAPI
+SleepEx(
+    IN DWORD dwMilliseconds,
+    IN BOOL bAlertable)
+{
+    DWORD ret;
+
+    PERF_ENTRY(SleepEx);
+    ENTRY("SleepEx(dwMilliseconds=%u, bAlertable=%d)\n", dwMilliseconds, bAlertable);
+
+    ret = WFMO_WaitForMultipleObjectsEx(0, NULL, FALSE, dwMilliseconds, bAlertable, TRUE);
+
+    if (ret == WAIT_TIMEOUT)
+    {
+        ret = 0;
+    }
+
+    LOGEXIT("SleepEx returns DWORD %u\n", ret);
+    PERF_EXIT(SleepEx);
+
+    return ret;
+}
+
+
+/*++
+Function:
+  PAL_CreateWaitSet
+
+  Create a wait set owned by the current thread.
+
+  WaitForMultipleObjects can wait on MAXIMUM_WAIT_OBJECTS objects at most, 
+  and it queues the thread in the waiting list of every object on each call.
+  A wait set keeps its objects registered between waits instead, and each 
+  object wakes up its registration through the set's own pipe, so one thread
+  can wait on any number of objects and a wait only costs a poll() on two 
+  descriptors and a look at the registrations that were signaled.
+
+Return value:
+    The new wait set, or NULL on failure (SetLastError is called)
+--*/
+PAL_WAIT_SET
+PALAPI
+PAL_CreateWaitSet(VOID)
+{
+    PAL_WAIT_SET hWaitSet = NULL;
+    int pipe_fds[2];
+
+    PERF_ENTRY(PAL_CreateWaitSet);
+    ENTRY("PAL_CreateWaitSet()\n");
+
+    hWaitSet = (PAL_WAIT_SET) malloc(sizeof(struct _PAL_WAIT_SET));
+    if (NULL == hWaitSet)
+    {
+        ERROR("Not enough memory to allocate a wait set\n");
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        goto done;
+    }
+
+    hWaitSet->pEntries = (WAIT_SET_ENTRY *) 
+        malloc(WAIT_SET_INITIAL_ENTRIES * sizeof(WAIT_SET_ENTRY));
+    if (NULL == hWaitSet->pEntries)
+    {
+        ERROR("Not enough memory to allocate the wait set entries\n");
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        free(hWaitSet);
+        hWaitSet = NULL;
+        goto done;
+    }
+
+    if (pipe(pipe_fds) != 0)
+    {
+        ERROR("pipe() failed! error is %d (%s)\n", errno, strerror(errno));
+        SetLastError(ERROR_TOO_MANY_OPEN_FILES);
+        free(hWaitSet->pEntries);
+        free(hWaitSet);
+        hWaitSet = NULL;
+        goto done;
+    }
+
+    /* the owner drains the pipe without blocking, and a full pipe mustn't 
+       block the threads signaling the objects (see WakeUpThread) */
+    if (fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK) == -1 ||
+        fcntl(pipe_fds[1], F_SETFL, O_NONBLOCK) == -1)
+    {
+        ERROR("Could not make the wait set pipe non-blocking\n");
+        SetLastError(ERROR_INTERNAL_ERROR);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        free(hWaitSet->pEntries);
+        free(hWaitSet);
+        hWaitSet = NULL;
+        goto done;
+    }
+
+    /* objects in other processes push on the ready list too */
+    hWaitSet->shmReadyList = SHMalloc(sizeof(SHMPTR));
+    if ((SHMPTR) NULL == hWaitSet->shmReadyList)
+    {
+        ERROR("Not enough memory to allocate the wait set ready list\n");
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        free(hWaitSet->pEntries);
+        free(hWaitSet);
+        hWaitSet = NULL;
+        goto done;
+    }
+    hWaitSet->pReadyList = SHMPTR_TO_PTR(hWaitSet->shmReadyList);
+    *hWaitSet->pReadyList = (SHMPTR) NULL;
+    hWaitSet->shmPendingHead = (SHMPTR) NULL;
+    hWaitSet->shmPendingTail = (SHMPTR) NULL;
+
+    hWaitSet->dwOwnerThreadId = GetCurrentThreadId();
+    hWaitSet->readPipe = pipe_fds[0];
+    hWaitSet->writePipe = pipe_fds[1];
+    hWaitSet->nEntries = 0;
+    hWaitSet->nMaxEntries = WAIT_SET_INITIAL_ENTRIES;
+
+done:
+    LOGEXIT("PAL_CreateWaitSet returns PAL_WAIT_SET %p\n", hWaitSet);
+    PERF_EXIT(PAL_CreateWaitSet);
+    return hWaitSet;
+}
+
+/*++
+Function:
+  PAL_DeleteWaitSet
+
+  Drop all the registrations of a wait set and delete it. The objects that 
+  were signaled but not returned by PAL_WaitSetWait yet get their signal 
+  back. Must be called by the owner thread.
+
+Parameters:
+    PAL_WAIT_SET hWaitSet : wait set to delete
+
+Return value:
+    TRUE on success, FALSE if hWaitSet is invalid (SetLastError is called)
+--*/
+BOOL
+PALAPI
+PAL_DeleteWaitSet(
+    IN PAL_WAIT_SET hWaitSet)
+{
+    BOOL bRet = FALSE;
+    DWORD i;
+
+    PERF_ENTRY(PAL_DeleteWaitSet);
+    ENTRY("PAL_DeleteWaitSet(hWaitSet=%p)\n", hWaitSet);
+
+    if (!WaitSetCheckOwner(hWaitSet))
+    {
+        goto done;
+    }
+
+    for (i = 0; i < hWaitSet->nEntries; i++)
+    {
+        WaitSetReleaseEntry(hWaitSet, &hWaitSet->pEntries[i], TRUE);
+    }
+
+    /* no object refers to the set's blocks anymore */
+    close(hWaitSet->readPipe);
+    close(hWaitSet->writePipe);
+    SHMfree(hWaitSet->shmReadyList);
+    free(hWaitSet->pEntries);
+    free(hWaitSet);
+    bRet = TRUE;
+
+done:
+    LOGEXIT("PAL_DeleteWaitSet returns BOOL %d\n", bRet);
+    PERF_EXIT(PAL_DeleteWaitSet);
+    return bRet;
+}
+
+/*++
+Function:
+  PAL_WaitSetAdd
+
+  Register an object in a wait set. If the object is already signaled, it is
+  acquired right away (the same way WaitForSingleObject would) and the next
+  PAL_WaitSetWait returns its context. Must be called by the owner thread.
+
+Parameters:
+    PAL_WAIT_SET hWaitSet : wait set to add the object to
+    HANDLE hObject : event, semaphore, mutex, thread or process to wait on
+    PVOID pvContext : value returned by PAL_WaitSetWait when hObject is 
+                      signaled; also identifies the registration for 
+                      PAL_WaitSetRemove
+
+Return value:
+    TRUE on success, FALSE on failure (SetLastError is called)
+--*/
+BOOL
+PALAPI
+PAL_WaitSetAdd(
+    IN PAL_WAIT_SET hWaitSet,
+    IN HANDLE hObject,
+    IN PVOID pvContext)
+{
+    BOOL bRet = FALSE;
+    HOBJSTRUCT *pObject;
+    WAIT_SET_ENTRY entry;
+    WAITON_CODE ret;
+
+    PERF_ENTRY(PAL_WaitSetAdd);
+    ENTRY("PAL_WaitSetAdd(hWaitSet=%p, hObject=%p, pvContext=%p)\n", 
+          hWaitSet, hObject, pvContext);
+
+    if (!WaitSetCheckOwner(hWaitSet))
+    {
+        goto done;
+    }
+
+    pObject = HMGRLockHandle(hObject);
+    if (NULL == pObject)
+    {
+        ERROR("Invalid handle %p\n", hObject);
+        SetLastError(ERROR_INVALID_HANDLE);
+        goto done;
+    }
+    entry.type = pObject->type;
+    HMGRUnlockHandle(hObject, pObject);
+
+    if ((entry.type != HOBJ_PROCESS) &&
+        (entry.type != HOBJ_EVENT) &&
+        (entry.type != HOBJ_SEMAPHORE) &&
+        (entry.type != HOBJ_MUTEX) &&
+        (entry.type != HOBJ_THREAD))
+    {
+        ERROR("Handle %p has invalid type %#x\n", hObject, entry.type);
+        SetLastError(ERROR_INVALID_HANDLE);
+        goto done;
+    }
+
+    if (hWaitSet->nEntries == hWaitSet->nMaxEntries)
+    {
+        WAIT_SET_ENTRY *pEntries;
+
+        pEntries = (WAIT_SET_ENTRY *) realloc(hWaitSet->pEntries, 
+            2 * hWaitSet->nMaxEntries * sizeof(WAIT_SET_ENTRY));
+        if (NULL == pEntries)
+        {
+            ERROR("Not enough memory to grow the wait set\n");
+            SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+            goto done;
+        }
+        hWaitSet->pEntries = pEntries;
+        hWaitSet->nMaxEntries *= 2;
+    }
+
+    entry.hObject = hObject;
+    entry.hWaitObject = hObject;
+    entry.pvContext = pvContext;
+    entry.shmWaitState = SHMalloc(sizeof(WAIT_SET_WAIT_BLOCK));
+    entry.pWaitBlock = SHMPTR_TO_PTR(entry.shmWaitState);
+    if (NULL == entry.pWaitBlock)
+    {
+        ERROR("Not enough memory to allocate a wait state\n");
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        goto done;
+    }
+    entry.pWaitBlock->state = TWS_SETWAITING;
+    entry.pWaitBlock->shmSelf = entry.shmWaitState;
+    entry.pWaitBlock->shmNextReady = (SHMPTR) NULL;
+    entry.pWaitBlock->shmReadyList = hWaitSet->shmReadyList;
+    entry.pWaitBlock->index = hWaitSet->nEntries;
+
+    if (HOBJ_PROCESS == entry.type)
+    {
+        BOOL bProcessHandleListEmpty;
+
+        /* processes don't use the pipe mechanism : let the WFMO worker thread
+           set an event when the process exits, and wait on the event */
+        entry.hWaitObject = CreateEventW(NULL, FALSE, FALSE, NULL);
+        if (NULL == entry.hWaitObject)
+        {
+            ERROR("couldn't create process wait event; error is %d\n",
+                  GetLastError());
+            SHMfree(entry.shmWaitState);
+            goto done;
+        }
+        entry.type = HOBJ_EVENT;
+
+        SYNCEnterCriticalSection(&wfmo_critical_section, TRUE);
+
+        bProcessHandleListEmpty = IsListEmpty(&process_handle_list);
+
+        if (!WFMO_EnsureWorkerThread() ||
+            NULL == WFMO_AddProcessWaitEntry(hObject, entry.hWaitObject))
+        {
+            ERROR("Cannot create process wait entry to wait on process %p\n",
+                  hObject);
+            SYNCLeaveCriticalSection(&wfmo_critical_section, TRUE);
+            CloseHandle(entry.hWaitObject);
+            SHMfree(entry.shmWaitState);
+            SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+            goto done;
+        }
+
+        if (bProcessHandleListEmpty)
+            SetEvent(start_worker_event);
+
+        SYNCLeaveCriticalSection(&wfmo_critical_section, TRUE);
+    }
+
+    /* if the object is signaled, WaitOn acquires it and flags the entry as 
+       awakened instead of queuing it; nothing wakes it up then, so it goes
+       on the ready list here */
+    ret = WaitOn(entry.type, entry.hWaitObject, entry.shmWaitState, 
+                 hWaitSet->writePipe);
+    if (WOC_ERROR == ret)
+    {
+        ERROR("WaitOn() reported an error for object %p\n", hObject);
+        if (entry.hWaitObject != entry.hObject)
+        {
+            SYNCEnterCriticalSection(&wfmo_critical_section, TRUE);
+            WFMO_DeleteProcessWaitEntry(entry.hObject, entry.hWaitObject);
+            SYNCLeaveCriticalSection(&wfmo_critical_section, TRUE);
+            CloseHandle(entry.hWaitObject);
+        }
+        SHMfree(entry.shmWaitState);
+        goto done;
+    }
+
+    hWaitSet->pEntries[hWaitSet->nEntries++] = entry;
+    if (WOC_SIGNALED == ret || WOC_ABANDONED == ret)
+    {
+        WaitSetPushReady(entry.pWaitBlock);
+    }
+    bRet = TRUE;
+
+done:
+    LOGEXIT("PAL_WaitSetAdd returns BOOL %d\n", bRet);
+    PERF_EXIT(PAL_WaitSetAdd);
+    return bRet;
+}
+
+/*++
+Function:
+  PAL_WaitSetRemove
+
+  Remove a registration from a wait set. If its object was signaled but 
+  PAL_WaitSetWait didn't return it yet, the wait set acquired the object on
+  the owner's behalf; the signal is handed back (the event is set again, the
+  semaphore or mutex released), so that it isn't lost. Must be called by the
+  owner thread.
+
+Parameters:
+    PAL_WAIT_SET hWaitSet : wait set to remove the registration from
+    PVOID pvContext : context the object was registered with
+
+Return value:
+    TRUE on success, FALSE if there's no such registration (this includes
+    registrations PAL_WaitSetWait already returned)
+--*/
+BOOL
+PALAPI
+PAL_WaitSetRemove(
+    IN PAL_WAIT_SET hWaitSet,
+    IN PVOID pvContext)
+{
+    BOOL bRet = FALSE;
+    DWORD i;
+
+    PERF_ENTRY(PAL_WaitSetRemove);
+    ENTRY("PAL_WaitSetRemove(hWaitSet=%p, pvContext=%p)\n", 
+          hWaitSet, pvContext);
+
+    if (!WaitSetCheckOwner(hWaitSet))
+    {
+        goto done;
+    }
+
+    for (i = 0; i < hWaitSet->nEntries; i++)
+    {
+        if (hWaitSet->pEntries[i].pvContext == pvContext)
+        {
+            WaitSetReleaseEntry(hWaitSet, &hWaitSet->pEntries[i], TRUE);
+            WaitSetDropEntry(hWaitSet, i);
+            bRet = TRUE;
+            break;
+        }
+    }
+
+    if (!bRet)
+    {
+        ERROR("no registration with context %p\n", pvContext);
+        SetLastError(ERROR_INVALID_PARAMETER);
+    }
+
+done:
+    LOGEXIT("PAL_WaitSetRemove returns BOOL %d\n", bRet);
+    PERF_EXIT(PAL_WaitSetRemove);
+    return bRet;
+}
+
+/*++
+Function:
+  PAL_WaitSetWait
+
+  Wait until at least one object of a wait set is signaled, the timeout
+  elapses or, for an alertable wait, an APC is queued to the owner thread.
+  The registrations of the signaled objects are removed from the set; the 
+  caller adds the objects again to keep waiting on them. Must be called by 
+  the owner thread.
+
+  Objects signaled from another process wake up the owner thread's blocking
+  pipe rather than the set's (WakeUpThread opens the pipe by thread id), so
+  the owner shouldn't block in WaitForMultipleObjects on other objects while
+  it has such objects registered.
+
+Parameters:
+    PAL_WAIT_SET hWaitSet : wait set to wait on
+    DWORD dwMilliseconds : timeout
+    BOOL bAlertable : TRUE to run queued APCs and return WAIT_IO_COMPLETION
+    PVOID *ppvContexts : receives the contexts of the signaled objects
+    DWORD nMaxContexts : size of ppvContexts; objects beyond that stay 
+                         registered and are returned by the next call
+    LPDWORD lpnContexts : receives the number of contexts returned
+
+Return value:
+    WAIT_OBJECT_0 if objects were signaled, WAIT_TIMEOUT, WAIT_IO_COMPLETION
+    or WAIT_FAILED (SetLastError is called)
+--*/
+DWORD
+PALAPI
+PAL_WaitSetWait(
+    IN PAL_WAIT_SET hWaitSet,
+    IN DWORD dwMilliseconds,
+    IN BOOL bAlertable,
+    OUT PVOID *ppvContexts,
+    IN DWORD nMaxContexts,
+    OUT LPDWORD lpnContexts)
+{
+    DWORD retValue = WAIT_FAILED;
+    HANDLE hThread;
+    THREAD *pThread;
+    DWORD *pThreadWaitState;
+    int threadPipe;
+    DWORD old_time;
+
+    PERF_ENTRY(PAL_WaitSetWait);
+    ENTRY("PAL_WaitSetWait(hWaitSet=%p, dwMilliseconds=%u, bAlertable=%d, "
+          "ppvContexts=%p, nMaxContexts=%u, lpnContexts=%p)\n", hWaitSet, 
+          dwMilliseconds, bAlertable, ppvContexts, nMaxContexts, lpnContexts);
+
+    if (!WaitSetCheckOwner(hWaitSet))
+    {
+        goto done;
+    }
+
+    if (NULL == ppvContexts || 0 == nMaxContexts || NULL == lpnContexts)
+    {
+        ERROR("invalid context buffer\n");
+        SetLastError(ERROR_INVALID_PARAMETER);
+        goto done;
+    }
+    *lpnContexts = 0;
+
+    if ((hThread = PROCGetRealCurrentThread()) == INVALID_HANDLE_VALUE)
+    {
+        ASSERT("Unable to get the real current thread handle\n");
+        goto done;
+    }
+
+    pThread = (THREAD *)HMGRLockHandle2(hThread, HOBJ_THREAD);
+    if (NULL == pThread)
+    {
+        ASSERT("Unable to lock thread handle %p!\n", hThread);
+        goto done;
+    }
+    pThreadWaitState = SHMPTR_TO_PTR(pThread->waitAwakened);
+    HMGRUnlockHandle(hThread, &pThread->objHeader);
+
+    /* QueueUserAPC has to write to the pipe we poll */
+    ((THREAD_WAIT_BLOCK *)pThreadWaitState)->bBlockWait = FALSE;
+
+    threadPipe = THREADGetPipe();
+    old_time = GetTickCount();
+
+    while (TRUE)
+    {
+        struct pollfd fds[2];
+        int poll_timeout;
+        int poll_retval;
+        int poll_errno;
+        DWORD waitState;
+
+        /* If we are alertable, then we need to execute any queued APC calls */
+        if (bAlertable)
+        {
+            int NumAPCCalled = THREADCallThreadAPCs();
+            if (NumAPCCalled == -1)
+            {
+                ERROR("Failed in calling APCs for the current thread\n");
+                break;
+            }
+            else if (NumAPCCalled > 0)
+            {
+                retValue = WAIT_IO_COMPLETION;
+                break;
+            }
+        }
+
+        *lpnContexts = WaitSetCollect(hWaitSet, ppvContexts, nMaxContexts);
+        if (*lpnContexts > 0)
+        {
+            retValue = WAIT_OBJECT_0;
+            break;
+        }
+
+        if (0 == dwMilliseconds)
+        {
+            retValue = WAIT_TIMEOUT;
+            break;
+        }
+
+        /* QueueUserAPC only wakes up alertable threads */
+        if (bAlertable)
+        {
+            waitState = InterlockedCompareExchange(pThreadWaitState, 
+                                                   TWS_ALERTABLE, TWS_ACTIVE);
+            if (TWS_EARLYDEATH == waitState)
+            {
+                WARN("thread is about to get suspended by TerminateProcess\n");
+            }
+            else if (TWS_ACTIVE != waitState)
+            {
+                ASSERT("unexpected thread wait state %d\n", waitState);
+            }
+        }
+
+        if (INFINITE == dwMilliseconds)
+        {
+            poll_timeout = INFTIM;
+        }
+        else if (INT_MAX < dwMilliseconds)
+        {
+            poll_timeout = INT_MAX;
+        }
+        else
+        {
+            poll_timeout = dwMilliseconds;
+        }
+
+        fds[0].fd = hWaitSet->readPipe;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = threadPipe;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        poll_retval = poll(fds, 2, poll_timeout);
+        poll_errno = errno;
+
+        if (-1 == poll_retval && EINTR != poll_errno)
+        {
+            ASSERT("poll() failed with %d (%s)\n", poll_errno, 
+                   strerror(poll_errno));
+        }
+
+        if (bAlertable)
+        {
+            waitState = InterlockedCompareExchange(pThreadWaitState, 
+                                                   TWS_ACTIVE, TWS_ALERTABLE);
+            if (TWS_ACTIVE == waitState)
+            {
+                /* QueueUserAPC woke us up; its wakeup code may not be in the 
+                   pipe yet, and must be read before the thread waits again */
+                fds[1].revents = 0;
+                while (poll(&fds[1], 1, INFTIM) == -1 && EINTR == errno)
+                {
+                }
+            }
+        }
+
+        /* the wakeup codes only tell that something happened; the wait 
+           states of the entries tell what */
+        WaitSetDrainPipe(hWaitSet->readPipe);
+        WaitSetDrainPipe(threadPipe);
+
+        if (-1 == poll_retval && EINTR != poll_errno)
+        {
+            SetLastError(ERROR_INTERNAL_ERROR);
+            break;
+        }
+
+        if (INFINITE != dwMilliseconds)
+        {
+            WFMO_update_timeout(&old_time, &dwMilliseconds);
+        }
+    }
+
+done:
+    LOGEXIT("PAL_WaitSetWait returns DWORD %u\n", retValue);
+    PERF_EXIT(PAL_WaitSetWait);
+    return retValue;
+}
+
+/*++
+Function:
+    WaitSetCheckOwner
+
+    Check that a wait set is valid and belongs to the current thread.
+
+Return value:
+    TRUE if the wait set may be used, FALSE otherwise (SetLastError is called)
+--*/
+static
+BOOL
+WaitSetCheckOwner(PAL_WAIT_SET hWaitSet)
+{
+    if (NULL == hWaitSet)
+    {
+        ERROR("hWaitSet is NULL\n");
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+    if (hWaitSet->dwOwnerThreadId != GetCurrentThreadId())
+    {
+        ASSERT("wait set %p belongs to thread %#x\n", hWaitSet, 
+               hWaitSet->dwOwnerThreadId);
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*++
+Function:
+    WaitSetReleaseEntry
+
+    Take a wait set entry off the waiting list of its object, and free the 
+    resources it holds. The entry stays in the set's array (see 
+    WaitSetDropEntry).
+
+Parameters:
+    PAL_WAIT_SET hWaitSet : wait set of the entry
+    WAIT_SET_ENTRY *pEntry : entry to release
+    BOOL bReturnSignal : TRUE if the entry may still be on the ready list; 
+                         if its object woke it up, the entry is taken off 
+                         the list and the signal handed back to the object
+--*/
+static
+void
+WaitSetReleaseEntry(PAL_WAIT_SET hWaitSet, WAIT_SET_ENTRY *pEntry, 
+                    BOOL bReturnSignal)
+{
+    if (pEntry->hWaitObject != pEntry->hObject)
+    {
+        SYNCEnterCriticalSection(&wfmo_critical_section, TRUE);
+        WFMO_DeleteProcessWaitEntry(pEntry->hObject, pEntry->hWaitObject);
+        SYNCLeaveCriticalSection(&wfmo_critical_section, TRUE);
+    }
+
+    /* the entry isn't in the list if the object already woke it up, and 
+       the handle may have been closed since it was added; either way 
+       there's nothing else to do. StopWaiting takes the lock the objects
+       wake their waiters under, so once it returns, an object that woke 
+       the entry up has pushed it on the ready list too, and the state 
+       doesn't change anymore */
+    StopWaiting(pEntry->type, pEntry->hWaitObject, pEntry->shmWaitState);
+
+    if (bReturnSignal && TWS_SETREADY == pEntry->pWaitBlock->state)
+    {
+        SHMPTR shmBlock = pEntry->shmWaitState;
+        SHMPTR shmPrev = (SHMPTR) NULL;
+        SHMPTR shmIter;
+        WAIT_SET_WAIT_BLOCK *pIter = NULL;
+
+        WaitSetTakeReady(hWaitSet);
+
+        for (shmIter = hWaitSet->shmPendingHead; 
+             (SHMPTR) NULL != shmIter && shmIter != shmBlock; 
+             shmIter = pIter->shmNextReady)
+        {
+            shmPrev = shmIter;
+            pIter = SHMPTR_TO_PTR(shmIter);
+        }
+
+        if ((SHMPTR) NULL == shmIter)
+        {
+            ASSERT("signaled entry %p of wait set %p isn't on the ready "
+                   "list\n", pEntry->hObject, hWaitSet);
+        }
+        else
+        {
+            if ((SHMPTR) NULL == shmPrev)
+            {
+                hWaitSet->shmPendingHead = pEntry->pWaitBlock->shmNextReady;
+            }
+            else
+            {
+                pIter->shmNextReady = pEntry->pWaitBlock->shmNextReady;
+            }
+            if (hWaitSet->shmPendingTail == shmBlock)
+            {
+                hWaitSet->shmPendingTail = shmPrev;
+            }
+        }
+
+        WaitSetReturnSignal(pEntry);
+    }
+
+    if (pEntry->hWaitObject != pEntry->hObject)
+    {
+        CloseHandle(pEntry->hWaitObject);
+    }
+    SHMfree(pEntry->shmWaitState);
+}
+
+/*++
+Function:
+    WaitSetDropEntry
+
+    Remove a released entry from the set's array, moving the last entry in 
+    its place.
+
+Parameters:
+    PAL_WAIT_SET hWaitSet : wait set of the entry
+    DWORD index : position of the entry
+--*/
+static
+void
+WaitSetDropEntry(PAL_WAIT_SET hWaitSet, DWORD index)
+{
+    WAIT_SET_ENTRY *pEntry = &hWaitSet->pEntries[index];
+
+    *pEntry = hWaitSet->pEntries[--hWaitSet->nEntries];
+    if (index < hWaitSet->nEntries)
+    {
+        pEntry->pWaitBlock->index = index;
+    }
+}
+
+/*++
+Function:
+    WaitSetReturnSignal
+
+    Give an object back the signal the wait set consumed when the object 
+    woke up one of its entries.
+
+    Auto-reset events, semaphores and mutexes were acquired on the owner's 
+    behalf; manual-reset events, threads and processes stay signaled, so 
+    there's nothing to give back. For a process, the entry waited on a 
+    private event that is about to be closed.
+
+Parameters:
+    WAIT_SET_ENTRY *pEntry : entry whose object woke it up
+--*/
+static
+void
+WaitSetReturnSignal(WAIT_SET_ENTRY *pEntry)
+{
+    BOOL bRet = TRUE;
+
+    if (pEntry->hWaitObject != pEntry->hObject)
+    {
+        return;
+    }
+
+    switch (pEntry->type)
+    {
+    case HOBJ_EVENT:
+        if (!EventIsManualReset(pEntry->hObject))
+        {
+            bRet = SetEvent(pEntry->hObject);
+        }
+        break;
+    case HOBJ_SEMAPHORE:
+        bRet = ReleaseSemaphore(pEntry->hObject, 1, NULL);
+        break;
+    case HOBJ_MUTEX:
+        bRet = ReleaseMutex(pEntry->hObject);
+        break;
+    default:
+        break;
+    }
+
+    if (!bRet)
+    {
+        /* the handle was closed since it was added */
+        WARN("couldn't hand the signal back to object %p (error %u)\n", 
+             pEntry->hObject, GetLastError());
+    }
+}
+
+/*++
+Function:
+    WaitSetPushReady
+
+    Push a woken up wait set entry on the ready list of its set. Called by 
+    WakeUpThread in the thread that signaled the object, which may belong to
+    another process, and by PAL_WaitSetAdd when the object was already 
+    signaled.
+
+Parameters:
+    WAIT_SET_WAIT_BLOCK *pBlock : wait state of the entry
+--*/
+static
+void
+WaitSetPushReady(WAIT_SET_WAIT_BLOCK *pBlock)
+{
+    SHMPTR *pReadyList = SHMPTR_TO_PTR(pBlock->shmReadyList);
+    SHMPTR shmHead;
+
+    if (NULL == pReadyList)
+    {
+        ASSERT("Invalid shared memory pointer\n");
+        return;
+    }
+
+    do
+    {
+        shmHead = *(volatile SHMPTR *)pReadyList;
+        pBlock->shmNextReady = shmHead;
+    }
+    while ((PVOID) shmHead != InterlockedCompareExchangePointer(
+                                  pReadyList, pBlock->shmSelf, shmHead));
+}
+
+/*++
+Function:
+    WaitSetTakeReady
+
+    Move the entries pushed on the ready list since the last call to the 
+    end of the pending list, oldest first.
+
+Parameters:
+    PAL_WAIT_SET hWaitSet : wait set
+--*/
+static
+void
+WaitSetTakeReady(PAL_WAIT_SET hWaitSet)
+{
+    SHMPTR shmIter;
+    SHMPTR shmFirst = (SHMPTR) NULL;
+    SHMPTR shmLast;
+
+    shmIter = (SHMPTR) InterlockedExchangePointer(hWaitSet->pReadyList, NULL);
+    shmLast = shmIter;
+
+    /* the ready list is newest first */
+    while ((SHMPTR) NULL != shmIter)
+    {
+        WAIT_SET_WAIT_BLOCK *pBlock = SHMPTR_TO_PTR(shmIter);
+        SHMPTR shmNext = pBlock->shmNextReady;
+
+        pBlock->shmNextReady = shmFirst;
+        shmFirst = shmIter;
+        shmIter = shmNext;
+    }
+
+    if ((SHMPTR) NULL == shmFirst)
+    {
+        return;
+    }
+
+    if ((SHMPTR) NULL == hWaitSet->shmPendingTail)
+    {
+        hWaitSet->shmPendingHead = shmFirst;
+    }
+    else
+    {
+        WAIT_SET_WAIT_BLOCK *pTail = SHMPTR_TO_PTR(hWaitSet->shmPendingTail);
+        pTail->shmNextReady = shmFirst;
+    }
+    hWaitSet->shmPendingTail = shmLast;
+}
+
 /*++
 Function:
-  Sleep
+    WaitSetCollect
 
-See MSDN doc.
+    Remove the entries woken up by their objects from a wait set, in the 
+    order they were woken up. Only the entries on the ready list are looked
+    at.
+
+Parameters:
+    PAL_WAIT_SET hWaitSet : wait set
+    PVOID *ppvContexts : receives the contexts of the removed entries
+    DWORD nMaxContexts : maximum number of entries to remove
+
+Return value:
+    Number of entries removed
 --*/
-VOID
-PALAPI
-Sleep(
-      IN DWORD dwMilliseconds)
+static
+DWORD
+WaitSetCollect(PAL_WAIT_SET hWaitSet, PVOID *ppvContexts, DWORD nMaxContexts)
 {
-    PERF_ENTRY(Sleep);
-    ENTRY("Sleep(dwMilliseconds=%u)\n", dwMilliseconds);
+    DWORD nContexts = 0;
 
-    WFMO_WaitForMultipleObjectsEx(0, NULL, FALSE, dwMilliseconds, FALSE, TRUE);
+    WaitSetTakeReady(hWaitSet);
 
-    LOGEXIT("Sleep returns VOID\n");
-    PERF_EXIT(Sleep);
-}
+    while ((SHMPTR) NULL != hWaitSet->shmPendingHead && 
+           nContexts < nMaxContexts)
+    {
+        WAIT_SET_WAIT_BLOCK *pBlock = SHMPTR_TO_PTR(hWaitSet->shmPendingHead);
+        DWORD index = pBlock->index;
+        WAIT_SET_ENTRY *pEntry = &hWaitSet->pEntries[index];
+
+        if (pEntry->pWaitBlock != pBlock)
+        {
+            ASSERT("ready list of wait set %p is corrupted\n", hWaitSet);
+        }
 
+        hWaitSet->shmPendingHead = pBlock->shmNextReady;
+        if ((SHMPTR) NULL == hWaitSet->shmPendingHead)
+        {
+            hWaitSet->shmPendingTail = (SHMPTR) NULL;
+        }
+
+        TRACE("object %p of wait set %p is signaled\n", pEntry->hObject, 
+              hWaitSet);
+        ppvContexts[nContexts++] = pEntry->pvContext;
+        WaitSetReleaseEntry(hWaitSet, pEntry, FALSE);
+        WaitSetDropEntry(hWaitSet, index);
+    }
+    return nContexts;
+}
 
 /*++
 Function:
-  SleepEx
+    WaitSetDrainPipe
 
-See MSDN doc.
+    Read all the wakeup codes in a non-blocking pipe.
+
+Parameters:
+    int fd : read end of the pipe
 --*/
-DWORD
-PALAPI
-SleepEx(
-    IN DWORD dwMilliseconds,
-    IN BOOL bAlertable)
+static
+void
+WaitSetDrainPipe(int fd)
 {
-    DWORD ret;
-
-    PERF_ENTRY(SleepEx);
-    ENTRY("SleepEx(dwMilliseconds=%u, bAlertable=%d)\n", dwMilliseconds, bAlertable);
-
-    ret = WFMO_WaitForMultipleObjectsEx(0, NULL, FALSE, dwMilliseconds, bAlertable, TRUE);
+    DWORD WakeupCodes[64];
+    int ret;
 
-    if (ret == WAIT_TIMEOUT)
+    do
     {
-        ret = 0;
+        ret = read(fd, WakeupCodes, sizeof(WakeupCodes));
     }
-
-    LOGEXIT("SleepEx returns DWORD %u\n", ret);
-    PERF_EXIT(SleepEx);
-
-    return ret;
+    while (ret > 0 || (-1 == ret && EINTR == errno));
 }
 
 /*++
@@ -782,6 +1805,7 @@ Parameters:
     DWORD type  : object type
     HANDLE handle : object handle
     SHMPTR wait_state : shared memory pointer to waiting thread's wait state
+    int blockingPipe : pipe the object writes to when it wakes the waiter up
 
 Return value:
     -1: an error occurred, SetLastError is called in this function.
@@ -794,7 +1818,8 @@ WAITON_CODE
 WaitOn(
        HOBJTYPE type,
        HANDLE handle,
-       SHMPTR wait_state)
+       SHMPTR wait_state,
+       int blockingPipe)
 {
     WAITON_CODE ret = WOC_ERROR;
 
@@ -806,16 +1831,16 @@ WaitOn(
         SetLastError(ERROR_INTERNAL_ERROR);
         break;
     case HOBJ_EVENT:
-        ret = EventWaitOn(handle, wait_state);
+        ret = EventWaitOn(handle, wait_state, blockingPipe);
         break;
     case HOBJ_SEMAPHORE:
-        ret = SemaphoreWaitOn(handle, wait_state);
+        ret = SemaphoreWaitOn(handle, wait_state, blockingPipe);
         break;
     case HOBJ_THREAD:
-        ret = ThreadWaitOn(handle, wait_state);
+        ret = ThreadWaitOn(handle, wait_state, blockingPipe);
         break;
     case HOBJ_MUTEX:
-        ret = MutexWaitOn(handle, wait_state);
+        ret = MutexWaitOn(handle, wait_state, blockingPipe);
         break;
     default:
         SetLastError(ERROR_INVALID_HANDLE);
@@ -841,6 +1866,7 @@ Parameters:
     int Count : number of objects
     HANDLE WaitProcessEvent: event that worker thread will signal
                              when process exits
+    SHMPTR wait_state : wait state the current thread waited with
 
 Return value:
     the position of the last object where the current thread was not
@@ -853,7 +1879,8 @@ StopWaitingOnObjects(
             HOBJSTRUCT **hObjs,
             CONST HANDLE *pHandles,
             int Count,
-            HANDLE WaitProcessEvent)
+            HANDLE WaitProcessEvent,
+            SHMPTR wait_state)
 {
     int i;
     int retValue = -1;
@@ -864,7 +1891,7 @@ StopWaitingOnObjects(
 
     if (NULL != WaitProcessEvent)
     {
-        StopWaiting(HOBJ_EVENT, WaitProcessEvent);
+        StopWaiting(HOBJ_EVENT, WaitProcessEvent, wait_state);
         SYNCEnterCriticalSection(&wfmo_critical_section, TRUE);
         for (i = 0; i < Count; i++)
         {
@@ -894,7 +1921,7 @@ StopWaitingOnObjects(
             /* even if StopWaiting returns an error(-1), we should try to 
                stop waiting on all the handles. It is possible the handle has
                been deleted while waiting for it */
-            if (0 == StopWaiting(hObjs[i]->type, pHandles[i]))
+            if (0 == StopWaiting(hObjs[i]->type, pHandles[i], wait_state))
             {
                 /* The race condition can occur when an object signals the
 
@@ -930,6 +1957,15 @@ StopWaitingOnObjects(
 
     }
 
+#if HAVE_WAIT_BLOCK_WAKEUP
+    if (((THREAD_WAIT_BLOCK *)SHMPTR_TO_PTR(wait_state))->bBlockWait)
+    {
+        /* the objects woke us up through the wait block. a code another 
+           process wrote to the thread pipe was read by the kqueue wait */
+        return retValue;
+    }
+#endif  /* HAVE_WAIT_BLOCK_WAKEUP */
+
     /* We have to make sure the thread pipe is empty.
        It is possible than more than one thread have 
        tried to wake up this thread */
@@ -994,12 +2030,13 @@ StopWaitingOnObjects(
 Function:
     StopWaiting
 
-    Remove the current thread from the waiting thread list of the
-    object passed in parameter (handle).
+    Remove the waiter queued with wait_state from the waiting thread list 
+    of the object passed in parameter (handle).
 
 Parameters:
     DWORD type  : object type
     HANDLE handle : object handle
+    SHMPTR wait_state : wait state the waiter was queued with
 
 Return value:
     -1: an error occurred
@@ -1010,7 +2047,8 @@ static
 int
 StopWaiting(
             DWORD type,
-            HANDLE handle)
+            HANDLE handle,
+            SHMPTR wait_state)
 {
     int ret = -1;
 
@@ -1021,16 +2059,16 @@ StopWaiting(
               "the pipe mechanism.\n");
         break;
     case HOBJ_EVENT:
-        ret = EventRemoveWaitingThread(handle);
+        ret = EventRemoveWaitingThread(handle, wait_state);
         break;
     case HOBJ_SEMAPHORE:
-        ret = SemaphoreRemoveWaitingThread(handle);
+        ret = SemaphoreRemoveWaitingThread(handle, wait_state);
         break;
     case HOBJ_THREAD:
-        ret = ThreadRemoveWaitingThread(handle);
+        ret = ThreadRemoveWaitingThread(handle, wait_state);
         break;
     case HOBJ_MUTEX:
-        ret = MutexRemoveWaitingThread(handle);
+        ret = MutexRemoveWaitingThread(handle, wait_state);
         break;
     default:
         ASSERT("Unsupported handle type\n");
@@ -1183,6 +2221,280 @@ int PollBlockingPipe(DWORD Milliseconds, int blockingPipe, DWORD *pWaitState)
     return poll_retval;
 }
 
+#if HAVE_FUTEX
+/*++
+Function:
+    FutexWaitForWakeupCode
+
+    Helper function for ThreadWait.  Sleeps on the wakeup code of the 
+    thread's wait block until WakeUpThread stores one.
+
+Parameters:
+    DWORD Milliseconds:  timeout value
+    THREAD_WAIT_BLOCK *pWaitBlock : thread's wait block
+
+Return value:
+     1 - a wakeup code was stored
+     0 - wait timed out
+    -1 - futex() had an error
+--*/
+static
+int FutexWaitForWakeupCode(DWORD Milliseconds, THREAD_WAIT_BLOCK *pWaitBlock)
+{
+    volatile DWORD *pWakeupCode = &pWaitBlock->wakeupCode;
+    struct timespec timeout;
+    DWORD old_time;
+    DWORD old_waitstate;
+    int futex_retval;
+
+    old_time = GetTickCount();
+
+    /* repeat until a code shows up or the timeout is used up. futex() also 
+       returns early when a signal interrupts it (EINTR) and when the code 
+       changed before it could go to sleep (EAGAIN) */
+    while(WUTC_NONE == *pWakeupCode && 0 != Milliseconds)
+    {
+        if(INFINITE != Milliseconds)
+        {
+            timeout.tv_sec = Milliseconds / 1000;
+            timeout.tv_nsec = (Milliseconds % 1000) * 1000000;
+        }
+
+        futex_retval = syscall(SYS_futex, pWakeupCode, FUTEX_WAIT, WUTC_NONE, 
+                               INFINITE == Milliseconds ? NULL : &timeout, 
+                               NULL, 0);
+        if(-1 == futex_retval)
+        {
+            if(ETIMEDOUT == errno)
+            {
+                break;
+            }
+            if(EINTR != errno && EAGAIN != errno)
+            {
+                ASSERT("futex() failed with %d (%s)\n", errno, strerror(errno));
+                return -1;
+            }
+        }
+
+        if(INFINITE != Milliseconds)
+        {
+            WFMO_update_timeout(&old_time, &Milliseconds);
+        }
+    }
+
+    if(WUTC_NONE != *pWakeupCode)
+    {
+        return 1;
+    }
+
+    /* timeout reached. set wait state back to 'active' */
+    old_waitstate = InterlockedCompareExchange(&pWaitBlock->state, TWS_ACTIVE, 
+                                               TWS_WAITING);
+    if(TWS_ALERTABLE == old_waitstate)
+    {
+        /* thread is alertable instead of just waiting. let's try again */
+        old_waitstate = InterlockedCompareExchange(&pWaitBlock->state, 
+                                                   TWS_ACTIVE, TWS_ALERTABLE);
+    }
+    if(TWS_ACTIVE != old_waitstate)
+    {
+        return 0;
+    }
+
+    /* oops, we were already 'active'; someone decided to wake us up sometime
+       between the timeout and here. Its code is on the way : wait for it and 
+       report a signal instead of a timeout */
+    while(WUTC_NONE == *pWakeupCode)
+    {
+        futex_retval = syscall(SYS_futex, pWakeupCode, FUTEX_WAIT, WUTC_NONE, 
+                               NULL, NULL, 0);
+        if(-1 == futex_retval && EINTR != errno && EAGAIN != errno)
+        {
+            ASSERT("futex() failed with %d (%s)\n", errno, strerror(errno));
+            return -1;
+        }
+    }
+    return 1;
+}
+#elif HAVE_EVFILT_USER
+/*++
+Function:
+    KqueueGetWaitKqueue
+
+    Returns the kqueue the current thread sleeps on, creating it on the 
+    thread's first wait. The kqueue watches a user event, triggered by 
+    WakeUpThread in this process, and the thread's blocking pipe, written 
+    by other processes.
+
+Parameters:
+    THREAD_WAIT_BLOCK *pWaitBlock : current thread's wait block
+
+Return value:
+    the kqueue, or -1 if it couldn't be created
+--*/
+static
+int KqueueGetWaitKqueue(THREAD_WAIT_BLOCK *pWaitBlock)
+{
+    struct kevent kev[2];
+    int kq;
+
+    if(-1 != pWaitBlock->waitKqueue)
+    {
+        return pWaitBlock->waitKqueue;
+    }
+
+    kq = kqueue();
+    if(-1 == kq)
+    {
+        ERROR("kqueue() failed with %d (%s)\n", errno, strerror(errno));
+        return -1;
+    }
+
+    EV_SET(&kev[0], 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, NULL);
+    EV_SET(&kev[1], THREADGetPipe(), EVFILT_READ, EV_ADD, 0, 0, NULL);
+    if(-1 == kevent(kq, kev, 2, NULL, 0, NULL))
+    {
+        ERROR("kevent() failed with %d (%s)\n", errno, strerror(errno));
+        close(kq);
+        return -1;
+    }
+
+    pWaitBlock->waitKqueue = kq;
+    return kq;
+}
+
+/*++
+Function:
+    KqueueWaitForWakeupCode
+
+    Helper function for ThreadWait.  Sleeps on the thread's kqueue until 
+    WakeUpThread stores a wakeup code in the thread's wait block, or 
+    another process writes one to the thread's pipe.
+
+Parameters:
+    DWORD Milliseconds:  timeout value
+    THREAD_WAIT_BLOCK *pWaitBlock : thread's wait block
+
+Return value:
+     1 - a wakeup code was stored
+     0 - wait timed out
+    -1 - kevent() or read() had an error
+--*/
+static
+int KqueueWaitForWakeupCode(DWORD Milliseconds, THREAD_WAIT_BLOCK *pWaitBlock)
+{
+    volatile DWORD *pWakeupCode = &pWaitBlock->wakeupCode;
+    struct timespec timeout;
+    DWORD old_time;
+    DWORD old_waitstate;
+
+    old_time = GetTickCount();
+
+    /* repeat until a code shows up or the timeout is used up. kevent() also
+       returns early when a signal interrupts it (EINTR), and for a trigger 
+       that came too late for an earlier wait */
+    while(WUTC_NONE == *pWakeupCode && 0 != Milliseconds)
+    {
+        if(INFINITE != Milliseconds)
+        {
+            timeout.tv_sec = Milliseconds / 1000;
+            timeout.tv_nsec = (Milliseconds % 1000) * 1000000;
+        }
+
+        if(-1 == KqueueWaitOnce(pWaitBlock, 
+                                INFINITE == Milliseconds ? NULL : &timeout))
+        {
+            return -1;
+        }
+
+        if(INFINITE != Milliseconds)
+        {
+            WFMO_update_timeout(&old_time, &Milliseconds);
+        }
+    }
+
+    if(WUTC_NONE != *pWakeupCode)
+    {
+        return 1;
+    }
+
+    /* timeout reached. set wait state back to 'active' */
+    old_waitstate = InterlockedCompareExchange(&pWaitBlock->state, TWS_ACTIVE, 
+                                               TWS_WAITING);
+    if(TWS_ALERTABLE == old_waitstate)
+    {
+        /* thread is alertable instead of just waiting. let's try again */
+        old_waitstate = InterlockedCompareExchange(&pWaitBlock->state, 
+                                                   TWS_ACTIVE, TWS_ALERTABLE);
+    }
+    if(TWS_ACTIVE != old_waitstate)
+    {
+        return 0;
+    }
+
+    /* oops, we were already 'active'; someone decided to wake us up sometime
+       between the timeout and here. Its code is on the way : wait for it and 
+       report a signal instead of a timeout */
+    while(WUTC_NONE == *pWakeupCode)
+    {
+        if(-1 == KqueueWaitOnce(pWaitBlock, NULL))
+        {
+            return -1;
+        }
+    }
+    return 1;
+}
+
+/*++
+Function:
+    KqueueWaitOnce
+
+    Helper function for KqueueWaitForWakeupCode.  Sleeps once on the 
+    thread's kqueue. A wakeup code another process wrote to the thread's 
+    pipe is moved to the wait block.
+
+Parameters:
+    THREAD_WAIT_BLOCK *pWaitBlock : thread's wait block
+    const struct timespec *pTimeout : timeout, NULL to wait forever
+
+Return value:
+     0 - kevent() returned, with or without a wakeup code
+    -1 - kevent() or read() had an error
+--*/
+static
+int KqueueWaitOnce(THREAD_WAIT_BLOCK *pWaitBlock, 
+                   const struct timespec *pTimeout)
+{
+    struct kevent kev;
+    DWORD WakeupCode;
+    int kevent_retval;
+
+    kevent_retval = kevent(pWaitBlock->waitKqueue, NULL, 0, &kev, 1, 
+                           pTimeout);
+    if(-1 == kevent_retval)
+    {
+        if(EINTR == errno)
+        {
+            return 0;
+        }
+        ASSERT("kevent() failed with %d (%s)\n", errno, strerror(errno));
+        return -1;
+    }
+
+    if(1 == kevent_retval && EVFILT_READ == kev.filter)
+    {
+        if(read(THREADGetPipe(), &WakeupCode, sizeof WakeupCode) != 
+           sizeof WakeupCode)
+        {
+            ASSERT("Unable to read the thread pipe (errno=%d)\n", errno);
+            return -1;
+        }
+        InterlockedExchange((LONG *)&pWaitBlock->wakeupCode, WakeupCode);
+    }
+    return 0;
+}
+#endif  /* HAVE_FUTEX */
+
 /*++
 Function:
     ThreadWait
@@ -1195,7 +2507,7 @@ Parameters:
 
 Return value:
     WAKEUPTHREAD_CODE - The wakeup code sent by WakeupThread over the pipe, 
-        
+        or stored in the wait block when the thread sleeps on it
 --*/
 static 
 WAKEUPTHREAD_CODE
@@ -1208,7 +2520,6 @@ ThreadWait( DWORD Milliseconds, BOOL bAlertable, DWORD *pWaitState )
     
 
     TRACE("Current Thread is blocking\n");
-    pipe = THREADGetPipe();
 
     /* Save current time, so that we can know how much time has elapsed 
        (only needs to be done once, gets updated in WFMO_update_timeout() ) */
@@ -1216,32 +2527,66 @@ ThreadWait( DWORD Milliseconds, BOOL bAlertable, DWORD *pWaitState )
         
     TRACE("Starting to wait, at time %u\n", old_time);
 
-    ret = PollBlockingPipe(Milliseconds, pipe, pWaitState);
-
-    if (ret == -1)
+#if HAVE_WAIT_BLOCK_WAKEUP
+    if (((THREAD_WAIT_BLOCK *)pWaitState)->bBlockWait)
     {
-        ASSERT("PollBlockingPipe() failed! errno is %d (%s)\n",
-              errno, strerror(errno));
-        return WUTC_NONE;
-    }
+#if HAVE_FUTEX
+        ret = FutexWaitForWakeupCode(Milliseconds, 
+                                     (THREAD_WAIT_BLOCK *)pWaitState);
+#else   /* HAVE_FUTEX */
+        ret = KqueueWaitForWakeupCode(Milliseconds, 
+                                      (THREAD_WAIT_BLOCK *)pWaitState);
+#endif  /* HAVE_FUTEX */
 
-    if (ret != 0)
-    {
-        TRACE("Read thread pipe\n");
-        /* there's at least one DWORD in the pipe, clear it */
-        if ( (ret = read(pipe,&WakeupCode,sizeof WakeupCode)) != sizeof WakeupCode )
+        if (ret == -1)
         {
-            ASSERT("Unable to clear the thread pipe [pipe=%d ret=%d errno=%d init_count=%d]\n", 
-                   pipe, ret, errno, init_count);
+            ASSERT("Waiting for the wakeup code failed!\n");
             return WUTC_NONE;
         }
 
-        if(WUTC_NONE>= WakeupCode || WUTC_LAST<= WakeupCode)
+        if (ret != 0)
+        {
+            WakeupCode = ((THREAD_WAIT_BLOCK *)pWaitState)->wakeupCode;
+
+            if(WUTC_NONE>= WakeupCode || WUTC_LAST<= WakeupCode)
+            {
+                ASSERT("got unknown wakeup code %d from the wait block!\n",
+                       WakeupCode);
+                return WUTC_NONE;
+            }
+        }
+    }
+    else
+#endif  /* HAVE_WAIT_BLOCK_WAKEUP */
+    {
+        pipe = THREADGetPipe();
+        ret = PollBlockingPipe(Milliseconds, pipe, pWaitState);
+
+        if (ret == -1)
         {
-            ASSERT("got unknown wakeup code %d from the pipe!\n",
-                   WakeupCode);
+            ASSERT("PollBlockingPipe() failed! errno is %d (%s)\n",
+                  errno, strerror(errno));
             return WUTC_NONE;
         }
+
+        if (ret != 0)
+        {
+            TRACE("Read thread pipe\n");
+            /* there's at least one DWORD in the pipe, clear it */
+            if ( (ret = read(pipe,&WakeupCode,sizeof WakeupCode)) != sizeof WakeupCode )
+            {
+                ASSERT("Unable to clear the thread pipe [pipe=%d ret=%d errno=%d init_count=%d]\n", 
+                       pipe, ret, errno, init_count);
+                return WUTC_NONE;
+            }
+
+            if(WUTC_NONE>= WakeupCode || WUTC_LAST<= WakeupCode)
+            {
+                ASSERT("got unknown wakeup code %d from the pipe!\n",
+                       WakeupCode);
+                return WUTC_NONE;
+            }
+        }
     }
     
     TRACE("Current Thread is unblocked\n");
@@ -1261,7 +2606,9 @@ Function:
 Parameters:
     DWORD ThreadId    Thread to wake up
     DWORD ProcessId   Process of the thread to wake up
-    int   ThreadPipe  Blocking pipe associated with the thread to wake up.
+    int   ThreadPipe  Blocking pipe associated with the thread to wake up,
+                      or WAIT_BLOCK_PIPE
+    DWORD *pWaitState Wait state the thread waits with
     WAKEUPTHREAD_CODE WakeUpCode Code to use when waking up the thread
 
 Return value:
@@ -1271,6 +2618,7 @@ VOID
 WakeUpThread( DWORD ThreadId,
               DWORD ProcessId,
               int   ThreadPipe,
+              DWORD *pWaitState,
               WAKEUPTHREAD_CODE WakeUpCode )
 {
     BOOL closePipe = FALSE;
@@ -1281,6 +2629,51 @@ WakeUpThread( DWORD ThreadId,
         return;
     }
 
+    /* a wait set registration goes on the set's ready list before the set's
+       owner is woken up, so the owner finds it */
+    if (TWS_SETREADY == *pWaitState)
+    {
+        WaitSetPushReady((WAIT_SET_WAIT_BLOCK *)pWaitState);
+    }
+
+#if HAVE_FUTEX
+    if (WAIT_BLOCK_PIPE == ThreadPipe)
+    {
+        /* the thread sleeps on the wakeup code of its wait block. the block 
+           is in shared memory, so this is the same for a thread of another 
+           process, and no pipe has to be opened */
+        THREAD_WAIT_BLOCK *pWaitBlock = (THREAD_WAIT_BLOCK *)pWaitState;
+
+        InterlockedExchange((LONG *)&pWaitBlock->wakeupCode, WakeUpCode);
+        if (-1 == syscall(SYS_futex, &pWaitBlock->wakeupCode, FUTEX_WAKE, 1, 
+                          NULL, NULL, 0))
+        {
+            ASSERT("Unable to wake up the thread (errno=%d)\n", errno);
+        }
+        return;
+    }
+#elif HAVE_EVFILT_USER
+    /* the thread sleeps on its kqueue, which only its own process can 
+       trigger. another process writes the code to the thread's pipe below,
+       which the kqueue also watches */
+    if (WAIT_BLOCK_PIPE == ThreadPipe && GetCurrentProcessId() == ProcessId)
+    {
+        THREAD_WAIT_BLOCK *pWaitBlock = (THREAD_WAIT_BLOCK *)pWaitState;
+        struct kevent kev;
+
+        InterlockedExchange((LONG *)&pWaitBlock->wakeupCode, WakeUpCode);
+        EV_SET(&kev, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, NULL);
+        /* the thread may have found the code, exited and closed its kqueue
+           already */
+        if (-1 == kevent(pWaitBlock->waitKqueue, &kev, 1, NULL, 0, NULL) &&
+            EBADF != errno)
+        {
+            ASSERT("Unable to wake up the thread (errno=%d)\n", errno);
+        }
+        return;
+    }
+#endif  /* HAVE_FUTEX */
+
     if (GetCurrentProcessId() != ProcessId)
     {
         /* need to open the pipe, the pipe fd received in parameter
@@ -1308,8 +2701,11 @@ WakeUpThread( DWORD ThreadId,
         closePipe = TRUE;
     }
 
-    /* unblock the thread */
-    if ( write(ThreadPipe,&WakeUpCode,sizeof WakeUpCode) != sizeof WakeUpCode )
+    /* unblock the thread. a full pipe means a wait set's pipe (see
+       PAL_CreateWaitSet) that already holds plenty of wakeup codes its owner
+       hasn't read yet, so one more isn't needed */
+    if ( write(ThreadPipe,&WakeUpCode,sizeof WakeUpCode) != sizeof WakeUpCode &&
+         EAGAIN != errno )
     {
         ASSERT("Unable to write in the pipe to wakeup the thread (errno=%d)\n",
               errno);
@@ -1764,6 +3160,59 @@ static DWORD PALAPI WFMO_workerthread(LPVOID param)
     return 0;
 }
 
+/*++
+Function:
+  WFMO_EnsureWorkerThread
+  
+  Create the WFMO worker thread and its event the first time a process 
+  handle is waited on together with other handles.
+  The calling thread must hold wfmo_critical_section before
+  calling this function.
+
+Return value:
+    TRUE if the worker thread exists, FALSE otherwise (SetLastError is called)
+--*/
+static BOOL WFMO_EnsureWorkerThread(void)
+{
+    DWORD tid;
+
+    if(NULL != worker_handle)
+    {
+        return TRUE;
+    }
+
+    TRACE("creating WFMO worker thread and related events\n");
+
+    /* reset flag used to stop worker thread */
+    keep_going = TRUE;
+
+    /* create worker thread's event, which we'll use to wake 
+      it up when we want it to wait on a process */
+    start_worker_event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if(NULL == start_worker_event)
+    {
+        ERROR("couldn't create event used to signal WFMO worker "
+              "thread; error is %d\n", GetLastError());
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    /* create the worker thread itself */
+    worker_handle = CreateInternalThread(NULL, 0, &WFMO_workerthread,
+                                         NULL, 0, &tid);
+    if(NULL == worker_handle)
+    {
+        ERROR("couldn't create WFMO worker thread; error is %d\n",
+              GetLastError());
+        CloseHandle(start_worker_event);
+        start_worker_event = NULL;
+        SetLastError(ERROR_OUTOFMEMORY);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /*++
 Function:
     WFMO_WaitForProcessEntry
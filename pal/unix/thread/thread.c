@@ -379,7 +379,7 @@ Function:
 static THREAD *THREADNewThreadObject(void)
 {
     THREAD *lpThreadObj;
-    BOOL *pAwakened;
+    THREAD_WAIT_BLOCK *pAwakened;
 
     lpThreadObj = AllocTHREAD();
 
@@ -409,7 +409,7 @@ static THREAD *THREADNewThreadObject(void)
         return NULL;
     }
 
-    lpThreadObj->waitAwakened = SHMalloc(sizeof(DWORD));
+    lpThreadObj->waitAwakened = SHMalloc(sizeof(THREAD_WAIT_BLOCK));
     pAwakened = SHMPTR_TO_PTR(lpThreadObj->waitAwakened);
     if(NULL == pAwakened)
     {
@@ -418,7 +418,12 @@ static THREAD *THREADNewThreadObject(void)
         FreeTHREAD(lpThreadObj);
         return NULL;
     }               
-    *pAwakened = TWS_ACTIVE;
+    pAwakened->state = TWS_ACTIVE;
+    pAwakened->wakeupCode = WUTC_NONE;
+    pAwakened->bBlockWait = FALSE;
+#if HAVE_EVFILT_USER
+    pAwakened->waitKqueue = -1;
+#endif  /* HAVE_EVFILT_USER */
 
     if (0 != SYNCInitializeCriticalSection(&(lpThreadObj->thread_crit_section)))
     {
@@ -1332,7 +1337,8 @@ TerminateCurrentThread(
                 pPrevThread->ptr.Next = pWaitingThread->ptr.Next;
             }
             WakeUpThread(pWaitingThread->threadId, pWaitingThread->processId, 
-                         pWaitingThread->blockingPipe, WUTC_SIGNALED);
+                         pWaitingThread->blockingPipe, 
+                         pWaitingThread->state.pAwakened, WUTC_SIGNALED);
 
             pTempThread = pWaitingThread;
             pWaitingThread = pWaitingThread->ptr.Next;
@@ -1488,8 +1494,13 @@ QueueUserAPC(
 
     if(THREADInterlockedAwaken(pThreadWaitState, TRUE))
     {
+        /* an alertable thread sleeps either on its wait block (WFMO) or on
+           its pipe (PAL_WaitSetWait); the flag can't change until it has
+           been woken up */
         WakeUpThread(lpThread->dwThreadId, GetCurrentProcessId(), 
-                     lpThread->blockingPipe, WUTC_APC_QUEUED);
+                     ((THREAD_WAIT_BLOCK *)pThreadWaitState)->bBlockWait ?
+                        WAIT_BLOCK_PIPE : lpThread->blockingPipe,
+                     pThreadWaitState, WUTC_APC_QUEUED);
     }
     SYNCLeaveCriticalSection (&(lpThread->thread_crit_section), TRUE);
  
@@ -1941,7 +1952,7 @@ THREADCreateInitialThread(
     void)
 {
     THREAD *lpThreadObj;
-    LPBOOL pAwakened;
+    THREAD_WAIT_BLOCK *pAwakened;
     
     /* Create the thread object */
     lpThreadObj = AllocTHREAD();
@@ -1968,7 +1979,7 @@ THREADCreateInitialThread(
         return NULL;
     }
 
-    lpThreadObj->waitAwakened = SHMalloc(sizeof(DWORD));
+    lpThreadObj->waitAwakened = SHMalloc(sizeof(THREAD_WAIT_BLOCK));
     pAwakened = SHMPTR_TO_PTR(lpThreadObj->waitAwakened);
     if(NULL == pAwakened)
     {
@@ -1976,7 +1987,12 @@ THREADCreateInitialThread(
         FreeTHREAD(lpThreadObj);
         return NULL;
     }
-    *pAwakened = TWS_ACTIVE;
+    pAwakened->state = TWS_ACTIVE;
+    pAwakened->wakeupCode = WUTC_NONE;
+    pAwakened->bBlockWait = FALSE;
+#if HAVE_EVFILT_USER
+    pAwakened->waitKqueue = -1;
+#endif  /* HAVE_EVFILT_USER */
 
 
     lpThreadObj->dwThreadId = (DWORD) pthread_self();
@@ -2089,13 +2105,14 @@ Function:
 Parameters
     IN hThread   thread checked to see if it is running
     SHMPTR wait_state : shared memory pointer to waiting thread's wait state
+    int blockingPipe : pipe to write to when the object wakes the waiter up
 
 returns
     WAITON_CODE value
 --*/
 int
 ThreadWaitOn(
-    IN HANDLE hThread, SHMPTR wait_state)
+    IN HANDLE hThread, SHMPTR wait_state, int blockingPipe)
 {
     THREAD *pThread;
     BOOL ret;
@@ -2147,7 +2164,7 @@ ThreadWaitOn(
             
     pWaitingThread->threadId = GetCurrentThreadId();
     pWaitingThread->processId = GetCurrentProcessId();
-    pWaitingThread->blockingPipe = THREADGetPipe();
+    pWaitingThread->blockingPipe = blockingPipe;
     pWaitingThread->state.pAwakened = SHMPTR_TO_PTR(wait_state);
 
     TRACE("ThreadId=%#x will wait on thread=%#x\n", 
@@ -2175,14 +2192,15 @@ done:
 Function:
   ThreadRemoveWaitingThread
 
-  Remove the CurrentThreadId from the list of waiting thread. This
-  function is called when the current thread stops waiting on a Thread
+  Remove the waiter queued with wait_state from the list of waiting thread.
+  This function is called when the current thread stops waiting on a Thread
   for a different reason than the Thread terminating. (e.g. a timeout,
   or the thread was waiting on multiple objects and another object was
   signaled)
 
 Parameters
     IN hThread   thread whose waiting thread list is to be updated
+    SHMPTR wait_state : wait state the waiter was queued with
 
 returns
     -1: an error occurred
@@ -2191,13 +2209,14 @@ returns
 --*/
 int
 ThreadRemoveWaitingThread(
-    IN HANDLE hThread)
+    IN HANDLE hThread, SHMPTR wait_state)
 {
     THREAD *pThread;
     int ret = 0;
     ThreadWaitingList *pWaitingThread;
     ThreadWaitingList *pNextWaitingThread;
     DWORD CurrentThreadId;
+    DWORD *pAwakenState = SHMPTR_TO_PTR(wait_state);
 
     pThread = (THREAD *) HMGRLockHandle2(hThread, HOBJ_THREAD);
 
@@ -2219,7 +2238,7 @@ ThreadRemoveWaitingThread(
     }
 
     /* check if it is the first element in the list */
-    if (pWaitingThread->threadId == CurrentThreadId)
+    if (pWaitingThread->state.pAwakened == pAwakenState)
     {
         pThread->waitingThreads = pWaitingThread->ptr.Next;
         free(pWaitingThread);
@@ -2232,7 +2251,7 @@ ThreadRemoveWaitingThread(
         {
             pNextWaitingThread = pWaitingThread->ptr.Next;
 
-            if (pNextWaitingThread->threadId == CurrentThreadId)
+            if (pNextWaitingThread->state.pAwakened == pAwakenState)
             {
                 /* found, so remove it */
                 pWaitingThread->ptr.Next = pNextWaitingThread->ptr.Next;
@@ -2501,6 +2520,15 @@ closeThreadHandle(
                 *pWaitState);
         }
 
+#if HAVE_EVFILT_USER
+        /* close the kqueue the thread slept on, if it ever waited */
+        pWaitState = SHMPTR_TO_PTR(pThread->waitAwakened);
+        if (-1 != ((THREAD_WAIT_BLOCK *)pWaitState)->waitKqueue)
+        {
+            close(((THREAD_WAIT_BLOCK *)pWaitState)->waitKqueue);
+        }
+#endif  /* HAVE_EVFILT_USER */
+
         SHMfree(pThread->waitAwakened);
 
         /* Release linked list of queued APC functions */
@@ -2781,7 +2809,8 @@ Function:
   THREADInterlockedAwaken
   
   try to flag a thread's wait state as active, but only if it isn't already 
-  active
+  active. The wait state of a wait set registration goes from TWS_SETWAITING
+  to TWS_SETREADY instead (see PAL_CreateWaitSet)
 
 Parameters :
     DWORD *state : pointer to wait state variable
@@ -2810,6 +2839,13 @@ BOOL THREADInterlockedAwaken(DWORD *pWaitState, BOOL alert_only)
         {
             return TRUE;
         }               
+
+        previous_state = InterlockedCompareExchange(pWaitState, TWS_SETREADY, 
+                                                    TWS_SETWAITING);
+        if(TWS_SETWAITING == previous_state)
+        {
+            return TRUE;
+        }
     }
     else
     {
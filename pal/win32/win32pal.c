@@ -655,6 +655,154 @@ LExit:
     return Ret;
 }
 
+// Returns the requested information about the process token, allocated
+// with malloc, or NULL
+static LPVOID GetProcessTokenInformation(TOKEN_INFORMATION_CLASS InfoClass)
+{
+    HANDLE hToken;
+    DWORD cbInfo = 0;
+    LPVOID pInfo = NULL;
+
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &hToken))
+        return NULL;
+
+    GetTokenInformation(hToken, InfoClass, NULL, 0, &cbInfo);
+    if (cbInfo != 0)
+    {
+        pInfo = malloc(cbInfo);
+        if (pInfo != NULL && !GetTokenInformation(hToken, InfoClass, pInfo, cbInfo, &cbInfo))
+        {
+            free(pInfo);
+            pInfo = NULL;
+        }
+    }
+
+    CloseHandle(hToken);
+    return pInfo;
+}
+
+PALIMPORT
+BOOL
+PALAPI
+PAL_SetFileOwnerOnly(
+        IN HANDLE hFile)
+{
+    BOOL Ret = FALSE;
+    PTOKEN_USER pUser;
+    PACL pAcl = NULL;
+    DWORD cbAcl;
+    DWORD dwError;
+
+    PERF_ENTRY(PAL_SetFileOwnerOnly);
+    LOGAPI("PAL_SetFileOwnerOnly(hFile=%p)\n", hFile);
+
+    pUser = (PTOKEN_USER)GetProcessTokenInformation(TokenUser);
+    if (pUser == NULL)
+        goto LExit;
+
+    // A protected DACL with the user as its only entry, so that nothing is
+    // inherited from the directory
+    cbAcl = sizeof(ACL) + sizeof(ACCESS_ALLOWED_ACE) - sizeof(DWORD) + GetLengthSid(pUser->User.Sid);
+    pAcl = (PACL)malloc(cbAcl);
+    if (pAcl == NULL)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        goto LExit;
+    }
+
+    if (!InitializeAcl(pAcl, cbAcl, ACL_REVISION) ||
+        !AddAccessAllowedAce(pAcl, ACL_REVISION, FILE_ALL_ACCESS, pUser->User.Sid))
+        goto LExit;
+
+    dwError = SetSecurityInfo(hFile, SE_FILE_OBJECT,
+                              DACL_SECURITY_INFORMATION | PROTECTED_DACL_SECURITY_INFORMATION,
+                              NULL, NULL, pAcl, NULL);
+    if (dwError != ERROR_SUCCESS)
+    {
+        SetLastError(dwError);
+        goto LExit;
+    }
+
+    Ret = TRUE;
+
+LExit:
+    free(pAcl);
+    free(pUser);
+    LOGAPI("PAL_SetFileOwnerOnly returns BOOL %d\n", Ret);
+    PERF_EXIT(PAL_SetFileOwnerOnly);
+    return Ret;
+}
+
+PALIMPORT
+BOOL
+PALAPI
+PAL_IsFileOwnerOnly(
+        IN HANDLE hFile)
+{
+    BOOL Ret = FALSE;
+    PTOKEN_USER pUser;
+    PTOKEN_OWNER pDefaultOwner;
+    PSECURITY_DESCRIPTOR pSD = NULL;
+    PSID pOwner;
+    PACL pDacl;
+    DWORD dwError;
+    DWORD i;
+
+    PERF_ENTRY(PAL_IsFileOwnerOnly);
+    LOGAPI("PAL_IsFileOwnerOnly(hFile=%p)\n", hFile);
+
+    pUser = (PTOKEN_USER)GetProcessTokenInformation(TokenUser);
+    pDefaultOwner = (PTOKEN_OWNER)GetProcessTokenInformation(TokenOwner);
+    if (pUser == NULL || pDefaultOwner == NULL)
+        goto LExit;
+
+    dwError = GetSecurityInfo(hFile, SE_FILE_OBJECT,
+                              OWNER_SECURITY_INFORMATION | DACL_SECURITY_INFORMATION,
+                              &pOwner, NULL, &pDacl, NULL, &pSD);
+    if (dwError != ERROR_SUCCESS)
+    {
+        SetLastError(dwError);
+        goto LExit;
+    }
+
+    // Files created by an administrator belong to the Administrators group
+    // rather than to the user. A NULL DACL grants everybody everything.
+    if ((!EqualSid(pOwner, pUser->User.Sid) && !EqualSid(pOwner, pDefaultOwner->Owner)) ||
+        pDacl == NULL)
+        goto LExit;
+
+    for (i = 0; i < pDacl->AceCount; i++)
+    {
+        ACE_HEADER *pAce;
+        PSID pSid;
+
+        if (!GetAce(pDacl, i, (LPVOID *)&pAce))
+            goto LExit;
+
+        // Deny entries only take access away
+        if (pAce->AceType != ACCESS_ALLOWED_ACE_TYPE)
+            continue;
+
+        // SYSTEM and the administrators can take ownership of any file anyway
+        pSid = (PSID)&((ACCESS_ALLOWED_ACE *)pAce)->SidStart;
+        if (!EqualSid(pSid, pUser->User.Sid) &&
+            !IsWellKnownSid(pSid, WinLocalSystemSid) &&
+            !IsWellKnownSid(pSid, WinBuiltinAdministratorsSid))
+            goto LExit;
+    }
+
+    Ret = TRUE;
+
+LExit:
+    if (pSD != NULL)
+        LocalFree(pSD);
+    free(pDefaultOwner);
+    free(pUser);
+    LOGAPI("PAL_IsFileOwnerOnly returns BOOL %d\n", Ret);
+    PERF_EXIT(PAL_IsFileOwnerOnly);
+    return Ret;
+}
+
 PALIMPORT
 PAL_POPTIMIZEDTLSGETTER 
 PALAPI
@@ -1156,7 +1304,7 @@ PAL_AreFileApisANSI(
     return Ret;
 }
 
-#define PAL_LEGAL_DESIRED_ACCESS (GENERIC_READ|GENERIC_WRITE)
+#define PAL_LEGAL_DESIRED_ACCESS (GENERIC_READ|GENERIC_WRITE|READ_CONTROL|WRITE_DAC)
 #define PAL_LEGAL_SHARE_MODE (FILE_SHARE_READ| \
                               FILE_SHARE_WRITE| \
                               FILE_SHARE_DELETE)
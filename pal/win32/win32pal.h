@@ -1297,6 +1297,7 @@ Abstract:
 #include <windows.h>
 #include <winnls.h>
 #include <wincrypt.h>
+#include <aclapi.h>
 #include <objbase.h>
 #include <stdio.h>
 #include <malloc.h>
@@ -0,0 +1,99 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Wait/signal benchmark. Two threads hand a token back and forth through a
+// pair of auto-reset events, so every round trip is two signals and two
+// waits that block. Then one thread sets and resets an event nobody waits
+// on, which is the cost of signaling alone:
+//
+//     clix eventpingpong.exe [round trips] [set/reset pairs]
+
+using System;
+using System.Threading;
+
+class EventPingPong {
+
+    AutoResetEvent ping = new AutoResetEvent(false);
+    AutoResetEvent pong = new AutoResetEvent(false);
+    int roundTrips;
+
+    void Ponger()
+    {
+        for (int i = 0; i < roundTrips; i++) {
+            ping.WaitOne();
+            pong.Set();
+        }
+    }
+
+    bool PingPong(int count)
+    {
+        roundTrips = count;
+        Thread ponger = new Thread(new ThreadStart(Ponger));
+        ponger.Start();
+
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < count; i++) {
+            ping.Set();
+            if (!pong.WaitOne(60 * 1000, false)) {
+                Console.WriteLine("Timed out after " + i.ToString() + " round trips");
+                return false;
+            }
+        }
+
+        ThreadBench.Report("Round trips", count, start);
+        ponger.Join();
+        return true;
+    }
+
+    static void SetReset(int count)
+    {
+        ManualResetEvent e = new ManualResetEvent(false);
+
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < count; i++) {
+            e.Set();
+            e.Reset();
+        }
+
+        ThreadBench.Report("Set/reset pairs", count, start);
+        e.Close();
+    }
+
+    public static int Main(String[] args)
+    {
+        int roundTrips = 100000;
+        if (args.Length > 0)
+            roundTrips = Int32.Parse(args[0]);
+
+        int pairs = 1000000;
+        if (args.Length > 1)
+            pairs = Int32.Parse(args[1]);
+
+        EventPingPong t = new EventPingPong();
+
+        // warm up the jit
+        if (!t.PingPong(100))
+            return 1;
+        SetReset(100);
+
+        if (!t.PingPong(roundTrips))
+            return 1;
+        SetReset(pairs);
+
+        return 0;
+    }
+}
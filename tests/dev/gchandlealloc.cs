@@ -0,0 +1,101 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// GC handle allocation benchmark. Every thread pins a buffer and frees the
+// handle over and over, the way interop and asynchronous I/O pin their
+// buffers, and the run is repeated with 1, 2, 4 and 8 threads:
+//
+//     clix gchandlealloc.exe [handles per thread]
+//
+// Set COMPlus_HandleTableMagazines=0 to get the numbers without the
+// per-thread handle caches. !GCHandles in SOS prints how often the
+// handle tables had to take their locks.
+
+using System;
+using System.Runtime.InteropServices;
+using System.Threading;
+
+class GCHandleAlloc {
+
+    int handlesPerThread;
+    int remaining;
+    ManualResetEvent start = new ManualResetEvent(false);
+    ManualResetEvent done = new ManualResetEvent(false);
+
+    void Worker()
+    {
+        byte[] buffer = new byte[64];
+
+        start.WaitOne();
+
+        for (int i = 0; i < handlesPerThread; i++) {
+            GCHandle h = GCHandle.Alloc(buffer, GCHandleType.Pinned);
+            h.Free();
+        }
+
+        if (Interlocked.Decrement(ref remaining) == 0)
+            done.Set();
+    }
+
+    bool Run(int threads, int count)
+    {
+        handlesPerThread = count;
+        remaining = threads;
+        start.Reset();
+        done.Reset();
+
+        for (int i = 0; i < threads; i++)
+            new Thread(new ThreadStart(Worker)).Start();
+
+        int begin = Environment.TickCount;
+        start.Set();
+
+        if (!done.WaitOne(10 * 60 * 1000, false)) {
+            Console.WriteLine("Timed out with " + threads.ToString() + " threads");
+            return false;
+        }
+
+        int end = Environment.TickCount;
+        double seconds = (double)Math.Max(end - begin, 1) / 1000.0;
+        int total = threads * count;
+
+        Console.WriteLine("Threads: " + threads.ToString().PadLeft(2) +
+                          "  Handles: " + total.ToString() +
+                          "  Time (sec): " + seconds.ToString() +
+                          "  Handles/sec: " + ((double)total / seconds).ToString());
+        return true;
+    }
+
+    public static int Main(String[] args)
+    {
+        int count = 1000000;
+        if (args.Length > 0)
+            count = Int32.Parse(args[0]);
+
+        GCHandleAlloc t = new GCHandleAlloc();
+
+        // warm up the jit
+        if (!t.Run(1, 100))
+            return 1;
+
+        int[] threads = { 1, 2, 4, 8 };
+        foreach (int n in threads) {
+            if (!t.Run(n, count))
+                return 1;
+        }
+
+        return 0;
+    }
+}
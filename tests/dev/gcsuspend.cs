@@ -0,0 +1,121 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// GC suspension benchmark. Threads spin in managed code, some in a loop and
+// some in recursive calls without loops, while the main thread collects
+// generation 0 over and over. Every collection has to stop the spinning
+// threads first, so the time per collection grows with the time to suspend:
+//
+//     clix gcsuspend.exe [spinning threads] [collections]
+//
+// Set COMPlus_GCPollSuspend=1 to suspend by polling instead of suspending
+// threads. !Threads in SOS prints the time-to-suspend histogram.
+
+using System;
+using System.Threading;
+
+class GCSuspend {
+
+    volatile bool stop;
+    int sink;
+
+    void Loop()
+    {
+        int n = 0;
+        while (!stop)
+            n++;
+        sink = n;
+    }
+
+    int Recurse(int depth)
+    {
+        if (depth == 0)
+            return 1;
+        return Recurse(depth - 1) + 1;
+    }
+
+    void Calls()
+    {
+        int n = 0;
+        while (!stop)
+            n += Recurse(100);
+        sink = n;
+    }
+
+    static void Report(string what, int count, int start, int slowest)
+    {
+        int end = Environment.TickCount;
+        double seconds = (double)Math.Max(end - start, 1) / 1000.0;
+
+        Console.WriteLine(what + ": " + count.ToString() +
+                          "  Time (sec): " + seconds.ToString() +
+                          "  Per sec: " + ((double)count / seconds).ToString() +
+                          "  Slowest (ms): " + slowest.ToString());
+    }
+
+    bool Run(int threads, int collections)
+    {
+        stop = false;
+        Thread[] spinners = new Thread[threads];
+        for (int i = 0; i < threads; i++) {
+            spinners[i] = new Thread((i % 2 == 0) ? new ThreadStart(Loop) : new ThreadStart(Calls));
+            spinners[i].Start();
+        }
+
+        int start = Environment.TickCount;
+        int slowest = 0;
+
+        for (int i = 0; i < collections; i++) {
+            int before = Environment.TickCount;
+            GC.Collect(0);
+            slowest = Math.Max(slowest, Environment.TickCount - before);
+        }
+
+        Report("Threads: " + threads.ToString().PadLeft(3) + "  Collections", collections, start, slowest);
+
+        stop = true;
+        for (int i = 0; i < threads; i++) {
+            if (!spinners[i].Join(60 * 1000)) {
+                Console.WriteLine("Spinning thread did not stop");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    public static int Main(String[] args)
+    {
+        int maxThreads = Environment.ProcessorCount * 2;
+        if (args.Length > 0)
+            maxThreads = Int32.Parse(args[0]);
+
+        int collections = 1000;
+        if (args.Length > 1)
+            collections = Int32.Parse(args[1]);
+
+        GCSuspend t = new GCSuspend();
+
+        // warm up the jit
+        if (!t.Run(2, 10))
+            return 1;
+
+        for (int n = 1; n <= maxThreads; n *= 2) {
+            if (!t.Run(n, collections))
+                return 1;
+        }
+
+        return 0;
+    }
+}
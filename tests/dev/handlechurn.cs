@@ -0,0 +1,163 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Handle allocation and free under contention. Each thread allocates strong,
+// weak and pinned handles in batches, checks them, frees some itself in a
+// shuffled order and passes the rest to whichever thread comes next, so
+// handles are freed on other threads than the one that allocated them.
+// Collections run in between, and short lived threads give back the
+// handles they cached when they exit:
+//
+//     clix handlechurn.exe [threads] [batches per thread]
+//
+// A handle must keep pointing at the object it was allocated for until it
+// is freed.
+
+using System;
+using System.Runtime.InteropServices;
+using System.Threading;
+
+class HandleChurn {
+
+    const int BatchSize = 40;
+
+    class Entry {
+        public GCHandle Handle;
+        public object Target;
+    }
+
+    static Entry[] passed = new Entry[0];
+    static object passedLock = new object();
+    static int batches;
+    static int failures;
+    static long allocated;
+    static long freed;
+
+    static void Fail(string what)
+    {
+        Interlocked.Increment(ref failures);
+        Console.WriteLine(what);
+    }
+
+    static Entry Alloc(int i)
+    {
+        Entry e = new Entry();
+        switch (i % 3) {
+        case 0:
+            e.Target = new object();
+            e.Handle = GCHandle.Alloc(e.Target, GCHandleType.Normal);
+            break;
+        case 1:
+            e.Target = new object();
+            e.Handle = GCHandle.Alloc(e.Target, GCHandleType.Weak);
+            break;
+        default:
+            e.Target = new byte[16];
+            e.Handle = GCHandle.Alloc(e.Target, GCHandleType.Pinned);
+            break;
+        }
+        Interlocked.Increment(ref allocated);
+        return e;
+    }
+
+    static void Check(Entry e)
+    {
+        if (!e.Handle.IsAllocated)
+            Fail("Handle was freed behind our back");
+        else if (!Object.ReferenceEquals(e.Handle.Target, e.Target))
+            Fail("Handle points at the wrong object");
+    }
+
+    static void Free(Entry e)
+    {
+        Check(e);
+        e.Handle.Free();
+        Interlocked.Increment(ref freed);
+    }
+
+    static void Churn()
+    {
+        Random random = new Random(Thread.CurrentThread.ManagedThreadId);
+        Entry[] batch = new Entry[BatchSize];
+
+        for (int b = 0; b < batches; b++) {
+            for (int i = 0; i < BatchSize; i++)
+                batch[i] = Alloc(i);
+
+            if (b % 16 == 0)
+                GC.Collect();
+
+            // shuffle
+            for (int i = BatchSize - 1; i > 0; i--) {
+                int j = random.Next(i + 1);
+                Entry t = batch[i];
+                batch[i] = batch[j];
+                batch[j] = t;
+            }
+
+            for (int i = 0; i < BatchSize; i++)
+                Check(batch[i]);
+
+            // trade the second half for what the last thread left us
+            Entry[] mine = new Entry[BatchSize / 2];
+            Array.Copy(batch, BatchSize / 2, mine, 0, BatchSize / 2);
+            Entry[] theirs;
+            lock (passedLock) {
+                theirs = passed;
+                passed = mine;
+            }
+
+            for (int i = 0; i < BatchSize / 2; i++)
+                Free(batch[i]);
+            for (int i = 0; i < theirs.Length; i++)
+                Free(theirs[i]);
+        }
+    }
+
+    static void ShortLived()
+    {
+        Entry[] batch = new Entry[BatchSize];
+        for (int i = 0; i < BatchSize; i++)
+            batch[i] = Alloc(i);
+        for (int i = 0; i < BatchSize; i++)
+            Free(batch[i]);
+    }
+
+    public static int Main(String[] args)
+    {
+        int threads = 4;
+        if (args.Length > 0)
+            threads = Int32.Parse(args[0]);
+
+        batches = 5000;
+        if (args.Length > 1)
+            batches = Int32.Parse(args[1]);
+
+        int start = ThreadBench.Run(threads, new ThreadStart(Churn));
+        ThreadBench.Report("Handles", allocated, start);
+
+        for (int i = 0; i < 50; i++)
+            ThreadBench.Run(threads, new ThreadStart(ShortLived));
+        GC.Collect();
+
+        for (int i = 0; i < passed.Length; i++)
+            Free(passed[i]);
+
+        if (freed != allocated)
+            Fail("Allocated " + allocated.ToString() + " handles but freed " + freed.ToString());
+
+        return failures == 0 ? 0 : 1;
+    }
+}
@@ -0,0 +1,90 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Ephemeral GC cost with many old handles. Fills the handle table with
+// strong handles to objects that have been promoted to the oldest
+// generation, then times gen0 collections. The run is repeated with
+// no handles, then ten times as many each time up to the maximum:
+//
+//     clix handlescan.exe [max handles] [collections per run]
+//
+// Gen0 collections should cost about the same however many old handles
+// there are. A checked runtime logs how many handle table segments each
+// scan passed over with COMPlus_LogEnable=1 COMPlus_LogFacility=0x1
+// COMPlus_LogLevel=6.
+
+using System;
+using System.Runtime.InteropServices;
+
+class HandleScan {
+
+    static bool Run(int handles, int collections)
+    {
+        GCHandle[] table = new GCHandle[handles];
+        for (int i = 0; i < handles; i++)
+            table[i] = GCHandle.Alloc(new Object());
+
+        // promote the targets (and age the handles) as far as they go
+        GC.Collect();
+        GC.Collect();
+
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < collections; i++) {
+            // a little young garbage so there is something to collect
+            for (int j = 0; j < 100; j++)
+                new Object();
+            GC.Collect(0);
+        }
+
+        int end = Environment.TickCount;
+        double seconds = (double)Math.Max(end - start, 1) / 1000.0;
+
+        Console.WriteLine("Handles: " + handles.ToString().PadLeft(8) +
+                          "  Collections: " + collections.ToString() +
+                          "  Time (sec): " + seconds.ToString() +
+                          "  Collections/sec: " + ((double)collections / seconds).ToString());
+
+        for (int i = 0; i < handles; i++)
+            table[i].Free();
+
+        return true;
+    }
+
+    public static int Main(String[] args)
+    {
+        int maxHandles = 1000000;
+        if (args.Length > 0)
+            maxHandles = Int32.Parse(args[0]);
+
+        int collections = 1000;
+        if (args.Length > 1)
+            collections = Int32.Parse(args[1]);
+
+        // warm up the jit
+        if (!Run(10, 10))
+            return 1;
+
+        if (!Run(0, collections))
+            return 1;
+
+        for (int n = 1000; n <= maxHandles; n *= 10) {
+            if (!Run(n, collections))
+                return 1;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,172 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Jit throughput harness. Pushes every method with a body in the given
+// assemblies (System.dll by default) through the jit and reports how fast
+// it went:
+//
+//     clix jitthroughput.exe [assembly.dll ...]
+//
+// Each assembly is compiled twice, each time in a new appdomain that
+// doesn't share code with the others, so every method counted is compiled
+// for the first time:
+//
+//   - jit:    the assembly is fully trusted and its IL isn't verified
+//   - verify: the appdomain policy only grants the assembly Execution, so
+//             the jit verifies its IL while compiling it. Assemblies that
+//             are fully trusted whatever the policy (e.g. from the GAC)
+//             aren't verified; pass a local copy to measure them.
+//
+// mscorlib is shared by all appdomains and mostly compiled already, so it
+// can't be measured this way.
+//
+// Set PERF_OUTPUT=1 to also get the runtime's own jit stats at shutdown
+// (native code size, time spent in EE callbacks and in each jit phase).
+
+using System;
+using System.Reflection;
+using System.Runtime.CompilerServices;
+using System.Security;
+using System.Security.Policy;
+
+class Compiler : MarshalByRefObject {
+
+    const BindingFlags AllDeclared = BindingFlags.DeclaredOnly |
+                                     BindingFlags.Public | BindingFlags.NonPublic |
+                                     BindingFlags.Static | BindingFlags.Instance;
+
+    int methods;
+    long ilBytes;
+    int failures;
+
+    void Prepare(MethodBase m)
+    {
+        // Open generic methods need an instantiation and methods without
+        // a body (abstract, pinvoke, runtime implemented) are never jitted
+        if (m.IsAbstract || m.ContainsGenericParameters)
+            return;
+
+        MethodBody body = m.GetMethodBody();
+        if (body == null)
+            return;
+
+        try {
+            RuntimeHelpers.PrepareMethod(m.MethodHandle);
+            methods++;
+            ilBytes += body.GetILAsByteArray().Length;
+        }
+        catch (Exception e) {
+            failures++;
+            Console.WriteLine("Failed to jit " + m.DeclaringType.FullName + "::" + m.Name + ": " + e.GetType().Name);
+        }
+    }
+
+    // Compiles every method of the assembly at path and returns how many
+    // were compiled
+    public int Run(String path, String phase)
+    {
+        Assembly a = Assembly.LoadFrom(path);
+
+        Type[] types;
+        try {
+            types = a.GetTypes();
+        }
+        catch (ReflectionTypeLoadException e) {
+            types = e.Types;
+        }
+
+        int start = Environment.TickCount;
+
+        foreach (Type t in types) {
+            if (t == null || t.ContainsGenericParameters)
+                continue;
+
+            foreach (MethodInfo m in t.GetMethods(AllDeclared))
+                Prepare(m);
+            foreach (ConstructorInfo c in t.GetConstructors(AllDeclared))
+                Prepare(c);
+        }
+
+        int end = Environment.TickCount;
+        double seconds = (double)Math.Max(end - start, 1) / 1000.0;
+
+        Console.WriteLine(a.GetName().Name + " (" + phase + ")");
+        Console.WriteLine("  Methods:            " + methods.ToString());
+        Console.WriteLine("  IL bytes:           " + ilBytes.ToString());
+        Console.WriteLine("  Failures:           " + failures.ToString());
+        Console.WriteLine("  Time (sec):         " + seconds.ToString());
+        Console.WriteLine("  Methods/sec:        " + ((double)methods / seconds).ToString());
+        Console.WriteLine("  IL KBytes/sec:      " + ((double)ilBytes / 1024.0 / seconds).ToString());
+
+        return methods;
+    }
+}
+
+class JitThroughput {
+
+    // Domain policy that grants the harness full trust and everything
+    // else Execution only
+    static PolicyLevel PartialTrustPolicy()
+    {
+        PolicyLevel level = PolicyLevel.CreateAppDomainLevel();
+
+        UnionCodeGroup root = new UnionCodeGroup(new AllMembershipCondition(),
+                                                 new PolicyStatement(level.GetNamedPermissionSet("Execution")));
+        root.AddChild(new UnionCodeGroup(new UrlMembershipCondition(typeof(Compiler).Assembly.CodeBase),
+                                         new PolicyStatement(level.GetNamedPermissionSet("FullTrust"))));
+        level.RootCodeGroup = root;
+        return level;
+    }
+
+    static int Run(String path, bool verify)
+    {
+        // Only mscorlib is shared in a single domain appdomain, so the
+        // assembly gets its own copy of the code
+        AppDomainSetup setup = new AppDomainSetup();
+        setup.ApplicationBase = AppDomain.CurrentDomain.BaseDirectory;
+        setup.LoaderOptimization = LoaderOptimization.SingleDomain;
+
+        AppDomain domain = AppDomain.CreateDomain(verify ? "verify" : "jit", null, setup);
+        try {
+            if (verify)
+                domain.SetAppDomainPolicy(PartialTrustPolicy());
+
+            Compiler c = (Compiler)domain.CreateInstanceAndUnwrap(typeof(Compiler).Assembly.FullName,
+                                                                 typeof(Compiler).FullName);
+            return c.Run(path, verify ? "verify" : "jit");
+        }
+        finally {
+            AppDomain.Unload(domain);
+        }
+    }
+
+    public static int Main(String[] args)
+    {
+        String[] paths = args;
+        if (paths.Length == 0)
+            paths = new String[] { typeof(Uri).Assembly.Location };
+
+        int total = 0;
+
+        foreach (String path in paths) {
+            total += Run(path, false);
+            total += Run(path, true);
+        }
+
+        // Every method was compiled for the first time, so anything less
+        // than one method means the harness itself is broken
+        return (total > 0) ? 0 : 1;
+    }
+}
@@ -0,0 +1,122 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Contended lock benchmark. Every thread takes the same lock over and over,
+// does a little work inside it and a little outside, and the run is repeated
+// with 1, 2, 4, 8 and 16 threads. Then the same with work inside the lock
+// that takes long enough that spinning for it doesn't pay off:
+//
+//     clix monitorcontention.exe [acquisitions per run]
+//
+// Run !syncblk in SOS while it runs to see how the lock was contended.
+
+using System;
+using System.Threading;
+
+class MonitorContention {
+
+    object theLock = new object();
+    int remaining;
+    int inside;
+    int outside;
+    int total;
+
+    void Worker()
+    {
+        int sum = 0;
+
+        for (;;) {
+            lock (theLock) {
+                if (remaining == 0)
+                    break;
+                remaining--;
+                total++;
+
+                for (int i = 0; i < inside; i++)
+                    sum += i;
+            }
+
+            for (int i = 0; i < outside; i++)
+                sum += i;
+        }
+
+        // keep the loops from being optimized away
+        if (sum == 42)
+            Console.WriteLine();
+    }
+
+    bool Run(string what, int threads, int count)
+    {
+        remaining = count;
+        total = 0;
+
+        Thread[] workers = new Thread[threads];
+        for (int i = 0; i < threads; i++)
+            workers[i] = new Thread(new ThreadStart(Worker));
+
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < threads; i++)
+            workers[i].Start();
+        for (int i = 0; i < threads; i++)
+            workers[i].Join();
+
+        int end = Environment.TickCount;
+        double seconds = (double)Math.Max(end - start, 1) / 1000.0;
+
+        Console.WriteLine(what + "  Threads: " + threads.ToString().PadLeft(2) +
+                          "  Acquisitions: " + count.ToString() +
+                          "  Time (sec): " + seconds.ToString() +
+                          "  Per sec: " + ((double)count / seconds).ToString());
+
+        if (total != count) {
+            Console.WriteLine("Took the lock " + total.ToString() + " times");
+            return false;
+        }
+        return true;
+    }
+
+    public static int Main(String[] args)
+    {
+        int count = 1000000;
+        if (args.Length > 0)
+            count = Int32.Parse(args[0]);
+
+        MonitorContention t = new MonitorContention();
+
+        // give the lock a sync block, and warm up the jit
+        t.theLock.GetHashCode();
+        if (!t.Run("Warm up", 2, 100))
+            return 1;
+
+        int[] threads = { 1, 2, 4, 8, 16 };
+
+        t.inside = 20;
+        t.outside = 100;
+        foreach (int n in threads) {
+            if (!t.Run("Short hold", n, count))
+                return 1;
+        }
+
+        t.inside = 100000;
+        t.outside = 1000;
+        foreach (int n in threads) {
+            if (!t.Run("Long hold ", n, count / 100))
+                return 1;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,73 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Uncontended lock benchmark. One thread takes and releases the same lock
+// over and over, first on an object with a thin lock, then on one that has a
+// sync block (its hash code was taken first). Then it increments a counter
+// with Interlocked, which is the cost of a single locked operation:
+//
+//     clix monitorenter.exe [iterations]
+
+using System;
+using System.Threading;
+
+class MonitorEnter {
+
+    static int counter;
+
+    static void EnterExit(string what, object o, int count)
+    {
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < count; i++) {
+            Monitor.Enter(o);
+            Monitor.Exit(o);
+        }
+
+        ThreadBench.Report(what, count, start);
+    }
+
+    static void Increment(int count)
+    {
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < count; i++)
+            Interlocked.Increment(ref counter);
+
+        ThreadBench.Report("Interlocked.Increment", count, start);
+    }
+
+    public static int Main(String[] args)
+    {
+        int iterations = 10000000;
+        if (args.Length > 0)
+            iterations = Int32.Parse(args[0]);
+
+        object thin = new object();
+        object inflated = new object();
+        inflated.GetHashCode();
+
+        // warm up the jit
+        EnterExit("Enter/Exit (thin lock)", thin, 100);
+        EnterExit("Enter/Exit (sync block)", inflated, 100);
+        Increment(100);
+
+        EnterExit("Enter/Exit (thin lock)", thin, iterations);
+        EnterExit("Enter/Exit (sync block)", inflated, iterations);
+        Increment(iterations);
+
+        return counter == iterations + 100 ? 0 : 1;
+    }
+}
@@ -0,0 +1,131 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Monitor barging and starvation. Threads take one lock as fast as they can
+// and hold it briefly, so the lock is usually taken back by a running thread
+// before a woken waiter gets to it. One more thread takes the lock only now
+// and then and measures how long each of its waits takes:
+//
+//     clix monitorfairness.exe [threads] [milliseconds]
+//
+// Only one thread may be inside the lock at a time, every thread has to get
+// the lock a reasonable number of times, and a waiter that keeps losing to
+// barging threads must get the lock handed to it long before the other threads stop.
+
+using System;
+using System.Threading;
+
+class MonitorFairness {
+
+    const int MaxWait = 2000;
+    const int MinAcquires = 10;
+
+    static object gate = new object();
+    static int inside;
+    static long counter;
+    static int duration;
+    static int failures;
+    static int next;
+    static long[] acquires;
+    static int slowestWait;
+    static long waits;
+
+    static void Fail(string what)
+    {
+        Interlocked.Increment(ref failures);
+        Console.WriteLine(what);
+    }
+
+    static void Spin(int count)
+    {
+        for (int i = 0; i < count; i++)
+            Thread.SpinWait(1);
+    }
+
+    static void Contend()
+    {
+        int me = Interlocked.Increment(ref next) - 1;
+        int end = Environment.TickCount + duration;
+        long mine = 0;
+
+        while (Environment.TickCount - end < 0) {
+            lock (gate) {
+                if (Interlocked.Increment(ref inside) != 1)
+                    Fail("Two threads inside the lock");
+                counter++;
+                Spin(20);
+                Interlocked.Decrement(ref inside);
+            }
+            mine++;
+        }
+
+        acquires[me] = mine;
+    }
+
+    static void Wait()
+    {
+        int end = Environment.TickCount + duration;
+
+        while (Environment.TickCount - end < 0) {
+            int start = Environment.TickCount;
+            lock (gate) {
+                int waited = Environment.TickCount - start;
+                if (waited > slowestWait)
+                    slowestWait = waited;
+                waits++;
+                counter++;
+            }
+            Thread.Sleep(10);
+        }
+    }
+
+    public static int Main(String[] args)
+    {
+        int threads = 4;
+        if (args.Length > 0)
+            threads = Int32.Parse(args[0]);
+
+        duration = 5000;
+        if (args.Length > 1)
+            duration = Math.Max(Int32.Parse(args[1]), 2 * MaxWait);
+
+        acquires = new long[threads];
+
+        Thread waiter = new Thread(new ThreadStart(Wait));
+        waiter.Start();
+
+        int start = ThreadBench.Run(threads, new ThreadStart(Contend));
+        waiter.Join();
+
+        long total = waits;
+        for (int i = 0; i < threads; i++) {
+            total += acquires[i];
+            if (acquires[i] < MinAcquires)
+                Fail("Thread " + i.ToString() + " only got the lock " +
+                     acquires[i].ToString() + " times");
+        }
+        ThreadBench.Report("Acquires", total, start);
+        Console.WriteLine("Waiter: " + waits.ToString() + " acquires, slowest took " +
+                          slowestWait.ToString() + " ms");
+
+        if (counter != total)
+            Fail("Counted " + counter.ToString() + " times under the lock, expected " +
+                 total.ToString());
+        if (waits == 0 || slowestWait > MaxWait)
+            Fail("Waiter starved");
+
+        return failures == 0 ? 0 : 1;
+    }
+}
@@ -0,0 +1,158 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+// Code range churn test. Code address lookups (stack walks, exception
+// dispatch) run on some threads while others keep creating appdomains,
+// jitting code into them and unloading them, which adds and deletes code
+// ranges all the time:
+//
+//     clix rangechurn.exe [domains per thread]
+//
+// Every stack walk must find all the frames it expects, and every
+// exception must be caught by the handler it was thrown to.
+
+using System;
+using System.Diagnostics;
+using System.Reflection;
+using System.Runtime.CompilerServices;
+using System.Threading;
+
+class Walker : MarshalByRefObject {
+
+    // Recurses depth times and returns the number of Recurse frames the
+    // stack walk found at the bottom
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    public static int Recurse(int depth)
+    {
+        if (depth > 0)
+            return Recurse(depth - 1);
+
+        int found = 0;
+        StackTrace trace = new StackTrace();
+        for (int i = 0; i < trace.FrameCount; i++) {
+            MethodBase m = trace.GetFrame(i).GetMethod();
+            if (m != null && m.Name == "Recurse")
+                found++;
+        }
+        return found;
+    }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    static void Throw(int depth)
+    {
+        if (depth > 0)
+            Throw(depth - 1);
+        throw new ApplicationException(depth.ToString());
+    }
+
+    // Walks the stack and throws through a few frames, returns false if
+    // anything went wrong
+    public bool Check(int depth)
+    {
+        if (Recurse(depth) != depth + 1)
+            return false;
+
+        try {
+            Throw(depth);
+        }
+        catch (ApplicationException e) {
+            return e.Message == "0";
+        }
+        return false;
+    }
+}
+
+class RangeChurn {
+
+    const int Depth = 8;
+
+    static int domains = 50;
+    static volatile bool done;
+    static volatile bool failed;
+
+    static void Fail(String what)
+    {
+        Console.WriteLine("FAILED: " + what);
+        failed = true;
+    }
+
+    // Each domain jits its own copy of Walker, so it adds code ranges when
+    // it is created and deletes them when it is unloaded
+    static void Churn()
+    {
+        try {
+            for (int i = 0; i < domains && !failed; i++) {
+                AppDomainSetup setup = new AppDomainSetup();
+                setup.ApplicationBase = AppDomain.CurrentDomain.BaseDirectory;
+                setup.LoaderOptimization = LoaderOptimization.SingleDomain;
+
+                AppDomain domain = AppDomain.CreateDomain("churn" + i.ToString(), null, setup);
+                Walker w = (Walker)domain.CreateInstanceAndUnwrap(typeof(Walker).Assembly.FullName,
+                                                                 typeof(Walker).FullName);
+                if (!w.Check(Depth))
+                    Fail("lookup in appdomain " + i.ToString());
+                AppDomain.Unload(domain);
+
+                if (i % 10 == 0)
+                    GC.Collect();
+            }
+        }
+        catch (Exception e) {
+            Fail(e.ToString());
+        }
+    }
+
+    static void Walk()
+    {
+        Walker w = new Walker();
+        int count = 0;
+
+        while (!done && !failed) {
+            if (!w.Check(Depth))
+                Fail("lookup in the default domain after " + count.ToString() + " walks");
+            count++;
+        }
+    }
+
+    public static int Main(String[] args)
+    {
+        if (args.Length > 0)
+            domains = Int32.Parse(args[0]);
+
+        Thread[] walkers = new Thread[Math.Max(Environment.ProcessorCount, 2)];
+        for (int i = 0; i < walkers.Length; i++) {
+            walkers[i] = new Thread(new ThreadStart(Walk));
+            walkers[i].Start();
+        }
+
+        Thread[] churners = new Thread[2];
+        for (int i = 0; i < churners.Length; i++) {
+            churners[i] = new Thread(new ThreadStart(Churn));
+            churners[i].Start();
+        }
+
+        for (int i = 0; i < churners.Length; i++)
+            churners[i].Join();
+
+        done = true;
+        for (int i = 0; i < walkers.Length; i++)
+            walkers[i].Join();
+
+        if (failed)
+            return 1;
+
+        Console.WriteLine("PASSED");
+        return 0;
+    }
+}
@@ -0,0 +1,86 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Read lock scaling in the loader. Each thread looks up a manifest resource
+// that doesn't exist, which takes the metadata read lock of the assembly,
+// and a few threads take it as often as they can. The run is repeated with
+// 1, 2, 4, ... threads:
+//
+//     clix rwlockread.exe [max threads] [lookups per thread]
+//
+// With no writers around, lookups per second should grow with the number of
+// threads up to the number of processors.
+
+using System;
+using System.Reflection;
+using System.Threading;
+
+class RWLockRead {
+
+    static Assembly assembly = typeof(RWLockRead).Assembly;
+    static int lookups;
+    static int found;
+
+    static void Lookup()
+    {
+        for (int i = 0; i < lookups; i++) {
+            if (assembly.GetManifestResourceInfo("NoSuchResource") != null)
+                found++;
+        }
+    }
+
+    static bool Run(int threads)
+    {
+        int start = ThreadBench.Run(threads, new ThreadStart(Lookup));
+        int end = Environment.TickCount;
+        double seconds = (double)Math.Max(end - start, 1) / 1000.0;
+        long total = (long)threads * lookups;
+
+        Console.WriteLine("Threads: " + threads.ToString().PadLeft(3) +
+                          "  Lookups: " + total.ToString() +
+                          "  Time (sec): " + seconds.ToString() +
+                          "  Lookups/sec: " + ((double)total / seconds).ToString());
+
+        if (found != 0) {
+            Console.WriteLine("Found a resource that shouldn't exist");
+            return false;
+        }
+        return true;
+    }
+
+    public static int Main(String[] args)
+    {
+        int maxThreads = 8;
+        if (args.Length > 0)
+            maxThreads = Int32.Parse(args[0]);
+
+        int perThread = 200000;
+        if (args.Length > 1)
+            perThread = Int32.Parse(args[1]);
+
+        // warm up the jit
+        lookups = 10;
+        if (!Run(1))
+            return 1;
+
+        lookups = perThread;
+        for (int n = 1; n <= maxThreads; n *= 2) {
+            if (!Run(n))
+                return 1;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,104 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Writer progress on the loader's read mostly locks. Reader threads look up
+// resources in the newest loaded copy of this assembly as fast as they can,
+// which takes its read locks over and over, while another thread keeps
+// loading new copies from bytes and using them, which creates image layouts
+// under the write lock:
+//
+//     clix rwlockwriter.exe [readers] [loads]
+//
+// Reader biased locks make writers wait for the readers to drain, but they
+// must still get in, so all of the loads have to finish within the timeout.
+
+using System;
+using System.IO;
+using System.Reflection;
+using System.Threading;
+
+class RWLockWriter {
+
+    const int Timeout = 120 * 1000;
+
+    static volatile Assembly latest = typeof(RWLockWriter).Assembly;
+    static volatile bool done;
+    static byte[] image;
+    static int loads;
+    static volatile int loaded;
+    static long lookups;
+
+    static void Read()
+    {
+        long count = 0;
+        while (!done) {
+            Assembly a = latest;
+            for (int i = 0; i < 100; i++) {
+                if (a.GetManifestResourceInfo("NoSuchResource") != null)
+                    Console.WriteLine("Found a resource that shouldn't exist");
+                a.GetName();
+            }
+            count += 100;
+        }
+        Interlocked.Add(ref lookups, count);
+    }
+
+    static void Write()
+    {
+        for (int i = 0; i < loads; i++) {
+            Assembly a = Assembly.Load(image);
+            if (a.GetType("RWLockWriter") == null)
+                Console.WriteLine("Loaded copy has no RWLockWriter type");
+            latest = a;
+            loaded++;
+        }
+    }
+
+    public static int Main(String[] args)
+    {
+        int readers = 4;
+        if (args.Length > 0)
+            readers = Int32.Parse(args[0]);
+
+        loads = 200;
+        if (args.Length > 1)
+            loads = Int32.Parse(args[1]);
+
+        image = File.ReadAllBytes(typeof(RWLockWriter).Assembly.Location);
+
+        Thread[] readerThreads = new Thread[readers];
+        for (int i = 0; i < readers; i++) {
+            readerThreads[i] = new Thread(new ThreadStart(Read));
+            readerThreads[i].Start();
+        }
+
+        int start = Environment.TickCount;
+        bool finished = ThreadBench.RunFor(1, new ThreadStart(Write), Timeout);
+        ThreadBench.Report("Loads", loaded, start);
+
+        done = true;
+        for (int i = 0; i < readers; i++)
+            readerThreads[i].Join();
+        Console.WriteLine("Lookups: " + lookups.ToString());
+
+        if (!finished) {
+            Console.WriteLine("Writer only got " + loaded.ToString() + " of " +
+                              loads.ToString() + " loads done in " +
+                              (Timeout / 1000).ToString() + " seconds");
+            return 1;
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,268 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Loopback connection scaling benchmark. Every connection runs small
+// request/echo round trips with the asynchronous socket methods, all at the
+// same time, and the run is repeated with 16 connections, then doubling up
+// to the maximum:
+//
+//     clix socketscale.exe [max connections] [round trips per connection]
+//
+// Each connection takes two descriptors, so raise the open file limit
+// (ulimit -n) before asking for more than a few hundred connections.
+
+using System;
+using System.Net;
+using System.Net.Sockets;
+using System.Threading;
+
+class SocketScale {
+
+    const int MessageSize = 64;
+
+    int remaining;
+    int failures;
+    ManualResetEvent done = new ManualResetEvent(false);
+
+    void Finished(bool failed)
+    {
+        if (failed)
+            Interlocked.Increment(ref failures);
+
+        if (Interlocked.Decrement(ref remaining) == 0)
+            done.Set();
+    }
+
+    // Server side: sends back whatever it receives until the client closes
+    class Echo {
+
+        Socket socket;
+        byte[] buffer = new byte[MessageSize];
+        AsyncCallback received;
+        AsyncCallback sent;
+
+        public Echo(Socket socket)
+        {
+            this.socket = socket;
+            received = new AsyncCallback(Received);
+            sent = new AsyncCallback(Sent);
+        }
+
+        public void Start()
+        {
+            try {
+                socket.BeginReceive(buffer, 0, buffer.Length, SocketFlags.None, received, null);
+            }
+            catch (SocketException) {
+            }
+            catch (ObjectDisposedException) {
+            }
+        }
+
+        void Received(IAsyncResult ar)
+        {
+            try {
+                int read = socket.EndReceive(ar);
+                if (read > 0)
+                    socket.BeginSend(buffer, 0, read, SocketFlags.None, sent, null);
+            }
+            catch (SocketException) {
+            }
+            catch (ObjectDisposedException) {
+            }
+        }
+
+        void Sent(IAsyncResult ar)
+        {
+            try {
+                socket.EndSend(ar);
+            }
+            catch (SocketException) {
+                return;
+            }
+            catch (ObjectDisposedException) {
+                return;
+            }
+            Start();
+        }
+    }
+
+    // Client side: sends a message and waits for all of it to come back,
+    // as many times as asked
+    class Pinger {
+
+        SocketScale owner;
+        Socket socket;
+        byte[] message = new byte[MessageSize];
+        byte[] reply = new byte[MessageSize];
+        int received;
+        int left;
+        AsyncCallback receivedCallback;
+        AsyncCallback sentCallback;
+
+        public Pinger(SocketScale owner, Socket socket)
+        {
+            this.owner = owner;
+            this.socket = socket;
+            receivedCallback = new AsyncCallback(Received);
+            sentCallback = new AsyncCallback(Sent);
+        }
+
+        public void Start(int roundTrips)
+        {
+            left = roundTrips;
+            Send();
+        }
+
+        void Send()
+        {
+            received = 0;
+            try {
+                socket.BeginSend(message, 0, MessageSize, SocketFlags.None, sentCallback, null);
+            }
+            catch (SocketException) {
+                owner.Finished(true);
+            }
+        }
+
+        void Sent(IAsyncResult ar)
+        {
+            try {
+                socket.EndSend(ar);
+                socket.BeginReceive(reply, 0, MessageSize, SocketFlags.None, receivedCallback, null);
+            }
+            catch (SocketException) {
+                owner.Finished(true);
+            }
+        }
+
+        void Received(IAsyncResult ar)
+        {
+            int read;
+            try {
+                read = socket.EndReceive(ar);
+                if (read == 0) {
+                    owner.Finished(true);
+                    return;
+                }
+
+                received += read;
+                if (received < MessageSize) {
+                    socket.BeginReceive(reply, received, MessageSize - received, SocketFlags.None, receivedCallback, null);
+                    return;
+                }
+            }
+            catch (SocketException) {
+                owner.Finished(true);
+                return;
+            }
+
+            if (--left > 0)
+                Send();
+            else
+                owner.Finished(false);
+        }
+    }
+
+    bool Run(int connections, int roundTrips)
+    {
+        Socket listener = new Socket(AddressFamily.InterNetwork, SocketType.Stream, ProtocolType.Tcp);
+        listener.Bind(new IPEndPoint(IPAddress.Loopback, 0));
+        listener.Listen(16);
+
+        Socket[] clients = new Socket[connections];
+        Socket[] servers = new Socket[connections];
+        Pinger[] pingers = new Pinger[connections];
+
+        bool ok = true;
+        try {
+            for (int i = 0; i < connections; i++) {
+                clients[i] = new Socket(AddressFamily.InterNetwork, SocketType.Stream, ProtocolType.Tcp);
+                clients[i].Connect(listener.LocalEndPoint);
+                servers[i] = listener.Accept();
+
+                // round trips of small messages are what Nagle delays
+                clients[i].SetSocketOption(SocketOptionLevel.Tcp, SocketOptionName.NoDelay, 1);
+                servers[i].SetSocketOption(SocketOptionLevel.Tcp, SocketOptionName.NoDelay, 1);
+
+                new Echo(servers[i]).Start();
+                pingers[i] = new Pinger(this, clients[i]);
+            }
+
+            remaining = connections;
+            failures = 0;
+            done.Reset();
+
+            int start = Environment.TickCount;
+
+            for (int i = 0; i < connections; i++)
+                pingers[i].Start(roundTrips);
+
+            if (!done.WaitOne(10 * 60 * 1000, false)) {
+                Console.WriteLine("Timed out with " + connections.ToString() + " connections");
+                ok = false;
+            }
+            else if (failures != 0) {
+                Console.WriteLine(failures.ToString() + " of " + connections.ToString() + " connections failed");
+                ok = false;
+            }
+            else {
+                int end = Environment.TickCount;
+                double seconds = (double)Math.Max(end - start, 1) / 1000.0;
+                int total = connections * roundTrips;
+
+                Console.WriteLine("Connections: " + connections.ToString().PadLeft(5) +
+                                  "  Round trips: " + total.ToString() +
+                                  "  Time (sec): " + seconds.ToString() +
+                                  "  Round trips/sec: " + ((double)total / seconds).ToString());
+            }
+        }
+        finally {
+            for (int i = 0; i < connections; i++) {
+                if (clients[i] != null)
+                    clients[i].Close();
+                if (servers[i] != null)
+                    servers[i].Close();
+            }
+            listener.Close();
+        }
+
+        return ok;
+    }
+
+    public static int Main(String[] args)
+    {
+        int maxConnections = 256;
+        if (args.Length > 0)
+            maxConnections = Int32.Parse(args[0]);
+
+        int roundTrips = 200;
+        if (args.Length > 1)
+            roundTrips = Int32.Parse(args[1]);
+
+        SocketScale t = new SocketScale();
+
+        // warm up the pool and the jit
+        if (!t.Run(4, 10))
+            return 1;
+
+        for (int n = 16; n <= maxConnections; n *= 2) {
+            if (!t.Run(n, roundTrips))
+                return 1;
+        }
+
+        return 0;
+    }
+}
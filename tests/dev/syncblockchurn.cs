@@ -0,0 +1,121 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Sync block allocation and free under contention. Worker threads take the
+// hash code of new objects and lock them, so they get sync blocks that are
+// freed again when the objects die, while another thread keeps collecting.
+// They also lock a few long lived objects that were given sync blocks up
+// front and count under the lock:
+//
+//     clix syncblockchurn.exe [threads] [objects per thread]
+//
+// Hash codes must not change and the counts must add up, which they don't
+// if a sync block is freed or handed out twice while an object still uses it.
+
+using System;
+using System.Threading;
+
+class SyncBlockChurn {
+
+    const int SharedObjects = 16;
+
+    static object[] shared = new object[SharedObjects];
+    static int[] sharedHash = new int[SharedObjects];
+    static int[] sharedCount = new int[SharedObjects];
+    static int objects;
+    static int failures;
+    static volatile bool done;
+
+    static void Fail(string what)
+    {
+        Interlocked.Increment(ref failures);
+        Console.WriteLine(what);
+    }
+
+    static void Churn()
+    {
+        object[] kept = new object[64];
+        int[] keptHash = new int[64];
+
+        for (int i = 0; i < objects; i++) {
+            // a short lived object
+            object o = new object();
+            int hash = o.GetHashCode();
+            lock (o) {
+                if (o.GetHashCode() != hash)
+                    Fail("Hash code of a locked object changed");
+            }
+
+            // one that lives through a few collections
+            int k = i % kept.Length;
+            if (kept[k] != null && kept[k].GetHashCode() != keptHash[k])
+                Fail("Hash code of a kept object changed");
+            kept[k] = o;
+            keptHash[k] = hash;
+
+            // and one of the shared ones
+            int s = i % SharedObjects;
+            lock (shared[s]) {
+                sharedCount[s]++;
+            }
+            if (shared[s].GetHashCode() != sharedHash[s])
+                Fail("Hash code of a shared object changed");
+        }
+    }
+
+    static void Collect()
+    {
+        while (!done) {
+            GC.Collect();
+            Thread.Sleep(1);
+        }
+    }
+
+    public static int Main(String[] args)
+    {
+        int threads = 4;
+        if (args.Length > 0)
+            threads = Int32.Parse(args[0]);
+
+        objects = 200000;
+        if (args.Length > 1)
+            objects = Int32.Parse(args[1]);
+
+        for (int i = 0; i < SharedObjects; i++) {
+            shared[i] = new object();
+            sharedHash[i] = shared[i].GetHashCode();
+            lock (shared[i]) {
+            }
+        }
+
+        Thread collector = new Thread(new ThreadStart(Collect));
+        collector.Start();
+
+        int start = ThreadBench.Run(threads, new ThreadStart(Churn));
+        ThreadBench.Report("Objects", (long)threads * objects, start);
+
+        done = true;
+        collector.Join();
+
+        long total = 0;
+        for (int i = 0; i < SharedObjects; i++)
+            total += sharedCount[i];
+        if (total != (long)threads * objects)
+            Fail("Counted " + total.ToString() + " times under the lock, expected " +
+                 ((long)threads * objects).ToString());
+
+        return failures == 0 ? 0 : 1;
+    }
+}
@@ -0,0 +1,80 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Sync block allocation under load. Each thread takes the hash code of a
+// new object and then locks it, which makes the runtime give the object a
+// sync block. The objects die right away, so the sync blocks are freed
+// again after every collection. The run is repeated with 1, 2, 4, ... threads:
+//
+//     clix syncblockinflate.exe [max threads] [objects per thread]
+//
+// The number of objects inflated per second should grow with the number of
+// threads up to the number of processors.
+
+using System;
+using System.Threading;
+
+class SyncBlockInflate {
+
+    static int objects;
+
+    static void Inflate()
+    {
+        for (int i = 0; i < objects; i++) {
+            Object o = new Object();
+            o.GetHashCode();
+            lock (o) {
+            }
+        }
+    }
+
+    static bool Run(int threads)
+    {
+        int start = ThreadBench.Run(threads, new ThreadStart(Inflate));
+        int end = Environment.TickCount;
+        double seconds = (double)Math.Max(end - start, 1) / 1000.0;
+        long total = (long)threads * objects;
+
+        Console.WriteLine("Threads: " + threads.ToString().PadLeft(3) +
+                          "  Objects: " + total.ToString() +
+                          "  Time (sec): " + seconds.ToString() +
+                          "  Objects/sec: " + ((double)total / seconds).ToString());
+        return true;
+    }
+
+    public static int Main(String[] args)
+    {
+        int maxThreads = 8;
+        if (args.Length > 0)
+            maxThreads = Int32.Parse(args[0]);
+
+        int perThread = 1000000;
+        if (args.Length > 1)
+            perThread = Int32.Parse(args[1]);
+
+        // warm up the jit
+        objects = 10;
+        if (!Run(1))
+            return 1;
+
+        objects = perThread;
+        for (int n = 1; n <= maxThreads; n *= 2) {
+            if (!Run(n))
+                return 1;
+        }
+
+        return 0;
+    }
+}
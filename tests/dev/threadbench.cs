@@ -0,0 +1,77 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Helpers shared by the threading tests in this directory. Compile them in
+// with the test:
+//
+//     csc /out:eventpingpong.exe eventpingpong.cs threadbench.cs
+
+using System;
+using System.Threading;
+
+class ThreadBench {
+
+    // Prints the count, the time since start and the rate per second.
+    public static void Report(string what, long count, int start)
+    {
+        int end = Environment.TickCount;
+        double seconds = (double)Math.Max(end - start, 1) / 1000.0;
+
+        Console.WriteLine(what + ": " + count.ToString() +
+                          "  Time (sec): " + seconds.ToString() +
+                          "  Per sec: " + ((double)count / seconds).ToString());
+    }
+
+    // Runs body on the given number of threads, waits for all of them and
+    // returns the tick count from just before the first one was started.
+    public static int Run(int threads, ThreadStart body)
+    {
+        Thread[] workers = new Thread[threads];
+        for (int i = 0; i < threads; i++)
+            workers[i] = new Thread(body);
+
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < threads; i++)
+            workers[i].Start();
+        for (int i = 0; i < threads; i++)
+            workers[i].Join();
+
+        return start;
+    }
+
+    // Like Run, but gives up waiting after timeout milliseconds in total.
+    // Returns false if some thread was still running then.
+    public static bool RunFor(int threads, ThreadStart body, int timeout)
+    {
+        Thread[] workers = new Thread[threads];
+        for (int i = 0; i < threads; i++) {
+            workers[i] = new Thread(body);
+            workers[i].IsBackground = true;
+        }
+
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < threads; i++)
+            workers[i].Start();
+        for (int i = 0; i < threads; i++) {
+            int left = Math.Max(timeout - (Environment.TickCount - start), 0);
+            if (!workers[i].Join(left))
+                return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,129 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Threadpool fan-out benchmark. Each root work item queues a tree of small
+// work items from inside the pool, which is what the per-worker queues are
+// for, and the run is repeated with 1, 4, 16 and 64 worker threads:
+//
+//     clix threadpoolsteal.exe [items per run]
+//
+// Set COMPlus_ThreadpoolWorkStealing=0 to get the numbers for the single
+// global queue.
+
+using System;
+using System.Threading;
+
+class ThreadpoolSteal {
+
+    const int Fanout = 4;
+
+    int remaining;
+    ManualResetEvent done = new ManualResetEvent(false);
+    WaitCallback callback;
+
+    ThreadpoolSteal()
+    {
+        callback = new WaitCallback(Work);
+    }
+
+    void Work(Object state)
+    {
+        int depth = (int)state;
+
+        if (depth > 0) {
+            for (int i = 0; i < Fanout; i++)
+                ThreadPool.QueueUserWorkItem(callback, depth - 1);
+        }
+
+        if (Interlocked.Decrement(ref remaining) == 0)
+            done.Set();
+    }
+
+    // Number of items in a tree of the given depth
+    static int TreeSize(int depth)
+    {
+        int size = 1;
+        int level = 1;
+        for (int i = 0; i < depth; i++) {
+            level *= Fanout;
+            size += level;
+        }
+        return size;
+    }
+
+    bool Run(int threads, int roots, int depth)
+    {
+        // Pin the number of workers. The minimum can't go above the maximum
+        // and the maximum can't go below the minimum, so order the calls.
+        int maxWorkers, maxPorts, minWorkers, minPorts;
+        ThreadPool.GetMaxThreads(out maxWorkers, out maxPorts);
+        ThreadPool.GetMinThreads(out minWorkers, out minPorts);
+        if (threads > maxWorkers) {
+            ThreadPool.SetMaxThreads(threads, maxPorts);
+            ThreadPool.SetMinThreads(threads, minPorts);
+        }
+        else {
+            ThreadPool.SetMinThreads(threads, minPorts);
+            ThreadPool.SetMaxThreads(threads, maxPorts);
+        }
+
+        remaining = roots * TreeSize(depth);
+        int items = remaining;
+        done.Reset();
+
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < roots; i++)
+            ThreadPool.QueueUserWorkItem(callback, depth);
+
+        if (!done.WaitOne(10 * 60 * 1000, false)) {
+            Console.WriteLine("Timed out with " + threads.ToString() + " threads");
+            return false;
+        }
+
+        int end = Environment.TickCount;
+        double seconds = (double)Math.Max(end - start, 1) / 1000.0;
+
+        Console.WriteLine("Threads: " + threads.ToString().PadLeft(3) +
+                          "  Items: " + items.ToString() +
+                          "  Time (sec): " + seconds.ToString() +
+                          "  Items/sec: " + ((double)items / seconds).ToString());
+        return true;
+    }
+
+    public static int Main(String[] args)
+    {
+        int items = 1000000;
+        if (args.Length > 0)
+            items = Int32.Parse(args[0]);
+
+        int depth = 6;
+        int roots = Math.Max(items / TreeSize(depth), 1);
+
+        ThreadpoolSteal t = new ThreadpoolSteal();
+
+        // warm up the pool and the jit
+        if (!t.Run(4, 1, 2))
+            return 1;
+
+        int[] threads = { 1, 4, 16, 64 };
+        foreach (int n in threads) {
+            if (!t.Run(n, roots, depth))
+                return 1;
+        }
+
+        return 0;
+    }
+}
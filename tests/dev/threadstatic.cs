@@ -0,0 +1,99 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Thread static access benchmark. One thread reads and writes [ThreadStatic]
+// fields of primitive, reference and struct type, and then an ordinary
+// static field for comparison:
+//
+//     clix threadstatic.exe [iterations]
+
+using System;
+using System.Threading;
+
+struct Pair {
+    public int First;
+    public int Second;
+}
+
+class ThreadStaticAccess {
+
+    [ThreadStatic] static int counter;
+    [ThreadStatic] static object buffer;
+    [ThreadStatic] static Pair pair;
+    static int shared;
+
+    static void Primitive(int count)
+    {
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < count; i++)
+            counter++;
+
+        ThreadBench.Report("Thread static int", count, start);
+    }
+
+    static void Reference(int count)
+    {
+        object o = new object();
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < count; i++) {
+            if (buffer == null)
+                buffer = o;
+        }
+
+        ThreadBench.Report("Thread static object", count, start);
+    }
+
+    static void Struct(int count)
+    {
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < count; i++)
+            pair.First++;
+
+        ThreadBench.Report("Thread static struct", count, start);
+    }
+
+    static void Shared(int count)
+    {
+        int start = Environment.TickCount;
+
+        for (int i = 0; i < count; i++)
+            shared++;
+
+        ThreadBench.Report("Static int", count, start);
+    }
+
+    public static int Main(String[] args)
+    {
+        int iterations = 10000000;
+        if (args.Length > 0)
+            iterations = Int32.Parse(args[0]);
+
+        // warm up the jit
+        Primitive(100);
+        Reference(100);
+        Struct(100);
+        Shared(100);
+
+        Primitive(iterations);
+        Reference(iterations);
+        Struct(iterations);
+        Shared(iterations);
+
+        return (counter == iterations + 100 && pair.First == iterations + 100) ? 0 : 1;
+    }
+}
@@ -0,0 +1,142 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+
+// Threadpool timers created after the timer thread has been idle. With no
+// timers the thread sleeps without a timeout and the timing wheel is not
+// advanced, so the next timer must be placed from the current time and not
+// from the tick the wheel last processed. The same is checked while a far
+// away timer keeps the wheel from being empty. Every timer must fire no
+// earlier than its due time and not much later.
+
+using System;
+using System.Threading;
+
+class TimerIdle {
+
+    // GetTickCount only moves every 10-16ms
+    const int Resolution = 20;
+    const int Late = 2000;
+
+    class Check {
+        public int due;
+        public int start;
+        public int fired;
+        public ManualResetEvent done = new ManualResetEvent(false);
+    }
+
+    static void Fire(Object state)
+    {
+        Check check = (Check)state;
+        check.fired = Environment.TickCount;
+        check.done.Set();
+    }
+
+    static bool RunTimers(string what, int idle)
+    {
+        // leave the timer thread nothing to do for a while
+        Thread.Sleep(idle);
+
+        int[] dues = { 0, 1, 50, 300, 1500 };
+        Check[] checks = new Check[dues.Length];
+        Timer[] timers = new Timer[dues.Length];
+
+        for (int i = 0; i < dues.Length; i++) {
+            checks[i] = new Check();
+            checks[i].due = dues[i];
+            checks[i].start = Environment.TickCount;
+            timers[i] = new Timer(new TimerCallback(Fire), checks[i], dues[i], Timeout.Infinite);
+        }
+
+        bool result = true;
+
+        for (int i = 0; i < dues.Length; i++) {
+            Check check = checks[i];
+            if (!check.done.WaitOne(check.due + Late + 60 * 1000, false)) {
+                Console.WriteLine(what + ": timer due in " + check.due.ToString() + "ms never fired");
+                result = false;
+                continue;
+            }
+
+            int elapsed = check.fired - check.start;
+            if (elapsed < check.due - Resolution || elapsed > check.due + Late) {
+                Console.WriteLine(what + ": timer due in " + check.due.ToString() +
+                                  "ms fired after " + elapsed.ToString() + "ms");
+                result = false;
+            }
+        }
+
+        for (int i = 0; i < dues.Length; i++)
+            timers[i].Dispose();
+
+        return result;
+    }
+
+    static int fires;
+
+    static void Count(Object state)
+    {
+        Interlocked.Increment(ref fires);
+    }
+
+    // A periodic timer started after an idle period keeps its period
+    static bool RunPeriodic(int idle)
+    {
+        Thread.Sleep(idle);
+
+        fires = 0;
+        Timer timer = new Timer(new TimerCallback(Count), null, 100, 100);
+        Thread.Sleep(1050);
+        timer.Dispose();
+
+        int n = fires;
+        if (n < 5 || n > 11) {
+            Console.WriteLine("Periodic timer fired " + n.ToString() + " times in 1050ms with a period of 100ms");
+            return false;
+        }
+        return true;
+    }
+
+    public static int Main(String[] args)
+    {
+        bool result = true;
+
+        // start the timer thread
+        Check first = new Check();
+        Timer warmup = new Timer(new TimerCallback(Fire), first, 0, Timeout.Infinite);
+        first.done.WaitOne();
+        warmup.Dispose();
+
+        // the wheel is empty while the thread is idle
+        int[] idles = { 300, 3000 };
+        foreach (int idle in idles) {
+            if (!RunTimers("Empty wheel, idle " + idle.ToString() + "ms", idle))
+                result = false;
+            if (!RunPeriodic(idle))
+                result = false;
+        }
+
+        // a timer far in the future keeps the wheel from being empty, so the
+        // thread only wakes up when it is cascaded
+        Timer far = new Timer(new TimerCallback(Count), null, 24 * 60 * 60 * 1000, Timeout.Infinite);
+        foreach (int idle in idles) {
+            if (!RunTimers("Far timer pending, idle " + idle.ToString() + "ms", idle))
+                result = false;
+        }
+        far.Dispose();
+
+        Console.WriteLine(result ? "Passed" : "Failed");
+        return result ? 0 : 1;
+    }
+}
@@ -0,0 +1,230 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+// Host for the verification cache test, driven by vercache.pl:
+//
+//     clix vercache.exe run <appdir> <method>
+//
+// runs App.Trivial and App.<method> from <appdir>\vercacheapp.dll in an
+// appdomain that only grants it Execution, so their IL has to be verified
+// unless the verification cache says it already was. Trivial binds
+// vercachebase.dll, which the cache entries are only trusted against once
+// it is bound. Exits with 0 if the method ran, 1 if it failed verification.
+//
+//     clix vercache.exe forge <cachedir> <keyfile> <appdir> <method> mac|nomac
+//
+// adds the token of App.<method> to the cache file in <cachedir>, with a
+// MAC computed from <keyfile> (mac) or keeping the old one (nomac).
+
+using System;
+using System.IO;
+using System.Reflection;
+using System.Security;
+using System.Security.Policy;
+
+class Runner : MarshalByRefObject {
+
+    public int Run(String method)
+    {
+        Type app = Assembly.Load("vercacheapp").GetType("App");
+        try {
+            if (method != "Trivial")
+                app.GetMethod("Trivial").Invoke(null, null);
+            app.GetMethod(method).Invoke(null, null);
+            Console.WriteLine("App." + method + " ran");
+            return 0;
+        }
+        catch (TargetInvocationException e) {
+            if (!(e.InnerException is VerificationException))
+                throw;
+            Console.WriteLine("App." + method + " failed verification");
+            return 1;
+        }
+    }
+}
+
+class VerificationCacheTest {
+
+    // Layout of the cache file, see VerificationCache::FileHeader. The
+    // header is followed by the dependency MVIDs, the tokens and the MAC.
+    const int DependencyCountOffset = 64;
+    const int TokenCountOffset = 68;
+    const int HeaderSize = 72;
+    const int GuidSize = 16;
+    const int HashSize = 20;
+    const int BlockSize = 64;
+
+    // Domain policy that grants the host full trust and everything else
+    // Execution only
+    static PolicyLevel PartialTrustPolicy()
+    {
+        PolicyLevel level = PolicyLevel.CreateAppDomainLevel();
+
+        UnionCodeGroup root = new UnionCodeGroup(new AllMembershipCondition(),
+                                                 new PolicyStatement(level.GetNamedPermissionSet("Execution")));
+        root.AddChild(new UnionCodeGroup(new UrlMembershipCondition(typeof(Runner).Assembly.CodeBase),
+                                         new PolicyStatement(level.GetNamedPermissionSet("FullTrust"))));
+        level.RootCodeGroup = root;
+        return level;
+    }
+
+    static int Run(String appDir, String method)
+    {
+        AppDomainSetup setup = new AppDomainSetup();
+        setup.ApplicationBase = appDir;
+
+        AppDomain domain = AppDomain.CreateDomain("vercache", null, setup);
+        domain.SetAppDomainPolicy(PartialTrustPolicy());
+
+        Runner r = (Runner)domain.CreateInstanceFromAndUnwrap(typeof(Runner).Assembly.Location,
+                                                             typeof(Runner).FullName);
+        return r.Run(method);
+    }
+
+    static uint Rol(uint x, int n)
+    {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    // The BCL has no SHA1, so the MAC is computed by hand
+    static byte[] Sha1(byte[] data)
+    {
+        uint[] h = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+        int length = ((data.Length + 8) / BlockSize + 1) * BlockSize;
+        byte[] message = new byte[length];
+        Array.Copy(data, message, data.Length);
+        message[data.Length] = 0x80;
+        ulong bits = (ulong)data.Length * 8;
+        for (int i = 0; i < 8; i++)
+            message[length - 1 - i] = (byte)(bits >> (8 * i));
+
+        uint[] w = new uint[80];
+        for (int block = 0; block < length; block += BlockSize) {
+            for (int i = 0; i < 16; i++) {
+                int p = block + 4 * i;
+                w[i] = ((uint)message[p] << 24) | ((uint)message[p + 1] << 16) |
+                       ((uint)message[p + 2] << 8) | (uint)message[p + 3];
+            }
+            for (int i = 16; i < 80; i++)
+                w[i] = Rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+            uint a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; i++) {
+                uint f, k;
+                if (i < 20) {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                } else if (i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                } else if (i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                } else {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                uint t = Rol(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = Rol(b, 30);
+                b = a;
+                a = t;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+
+        byte[] hash = new byte[HashSize];
+        for (int i = 0; i < HashSize; i++)
+            hash[i] = (byte)(h[i / 4] >> (24 - 8 * (i % 4)));
+        return hash;
+    }
+
+    static byte[] HashWithKey(byte[] key, byte pad, byte[] data, int count)
+    {
+        byte[] buffer = new byte[BlockSize + count];
+        for (int i = 0; i < BlockSize; i++)
+            buffer[i] = (byte)(pad ^ (i < key.Length ? key[i] : 0));
+        Array.Copy(data, 0, buffer, BlockSize, count);
+        return Sha1(buffer);
+    }
+
+    static byte[] Hmac(byte[] key, byte[] data, int count)
+    {
+        byte[] inner = HashWithKey(key, 0x36, data, count);
+        return HashWithKey(key, 0x5C, inner, inner.Length);
+    }
+
+    static int Forge(String cacheDir, String keyFile, String appDir, String method, bool mac)
+    {
+        String[] files = Directory.GetFiles(cacheDir, "*.ver");
+        if (files.Length != 1) {
+            Console.WriteLine("Expected one cache file in " + cacheDir + ", found " + files.Length.ToString());
+            return 2;
+        }
+
+        byte[] old = File.ReadAllBytes(files[0]);
+        int tokenOffset = HeaderSize + GuidSize * BitConverter.ToInt32(old, DependencyCountOffset);
+        int count = BitConverter.ToInt32(old, TokenCountOffset);
+        if (old.Length != tokenOffset + 4 * count + HashSize) {
+            Console.WriteLine("Malformed cache file " + files[0]);
+            return 2;
+        }
+
+        Assembly app = Assembly.ReflectionOnlyLoadFrom(Path.Combine(appDir, "vercacheapp.dll"));
+        int token = app.GetType("App").GetMethod(method).MetadataToken;
+
+        // The tokens must stay sorted and unique
+        int[] tokens = new int[count + 1];
+        for (int i = 0; i < count; i++)
+            tokens[i] = BitConverter.ToInt32(old, tokenOffset + 4 * i);
+        if (Array.IndexOf(tokens, token, 0, count) < 0)
+            tokens[count++] = token;
+        Array.Sort(tokens, 0, count);
+
+        byte[] forged = new byte[tokenOffset + 4 * count + HashSize];
+        Array.Copy(old, forged, tokenOffset);
+        Array.Copy(BitConverter.GetBytes(count), 0, forged, TokenCountOffset, 4);
+        for (int i = 0; i < count; i++)
+            Array.Copy(BitConverter.GetBytes(tokens[i]), 0, forged, tokenOffset + 4 * i, 4);
+
+        if (mac) {
+            byte[] digest = Hmac(File.ReadAllBytes(keyFile), forged, forged.Length - HashSize);
+            Array.Copy(digest, 0, forged, forged.Length - HashSize, HashSize);
+        } else {
+            Array.Copy(old, old.Length - HashSize, forged, forged.Length - HashSize, HashSize);
+        }
+
+        File.WriteAllBytes(files[0], forged);
+        Console.WriteLine("Added App." + method + " to " + files[0] + (mac ? " with" : " without") + " a valid MAC");
+        return 0;
+    }
+
+    public static int Main(String[] args)
+    {
+        if (args.Length == 3 && args[0] == "run")
+            return Run(args[1], args[2]);
+        if (args.Length == 6 && args[0] == "forge")
+            return Forge(args[1], args[2], args[3], args[4], args[5] == "mac");
+
+        Console.WriteLine("Usage: vercache run <appdir> <method>");
+        Console.WriteLine("       vercache forge <cachedir> <keyfile> <appdir> <method> mac|nomac");
+        return 2;
+    }
+}
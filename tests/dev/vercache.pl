@@ -0,0 +1,111 @@
+# ==++==
+# 
+#   
+#    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+#   
+#    The use and distribution terms for this software are contained in the file
+#    named license.txt, which can be found in the root of this distribution.
+#    By using this software in any fashion, you are agreeing to be bound by the
+#    terms of this license.
+#   
+#    You must not remove this notice, or any other, from this software.
+#   
+# 
+# ==--==
+#
+# vercache.pl
+#
+# Custom driver for the verification cache test:
+#     Builds two versions of vercachebase.dll and one vercacheapp.dll used
+#     with both, then checks that the cache
+#       - misses when a referenced assembly changes
+#       - ignores a file that was changed without the MAC key
+#       - is trusted when the MAC is valid
+#       - ignores a file that other users can write
+
+use File::Basename;
+use File::Copy;
+use File::Path;
+
+my @host = @ARGV;
+my $out = dirname($host[$#host]) . "/vercache";
+my $v1 = "$out/v1";
+my $v2 = "$out/v2";
+my $key = "$out/vercache.key";
+
+sub Build {
+    my ($args) = @_;
+    return system("csc /nologo /debug /target:library $args") >> 8;
+}
+
+sub Host {
+    my @args = @_;
+    my $retval = system(@host, @args) >> 8;
+    print "vercache @args -> $retval\n";
+    return $retval;
+}
+
+sub Check {
+    my ($what, $ok) = @_;
+    if (!$ok) {
+        print "FAILED: $what\n";
+        exit(1);
+    }
+}
+
+sub CacheFiles {
+    my ($dir) = @_;
+    my @files = glob("$dir/*.ver");
+    return scalar(@files);
+}
+
+sub CacheDir {
+    my ($name) = @_;
+    my $dir = "$out/$name";
+    rmtree($dir);
+    mkpath($dir);
+    $ENV{COMPlus_VerificationCacheDir} = $dir;
+    return $dir;
+}
+
+rmtree($out);
+mkpath([$v1, $v2]);
+
+Check("build", !Build("/define:V1 /out:$v1/vercachebase.dll vercache/vercachebase.cs") &&
+               !Build("/out:$v2/vercachebase.dll vercache/vercachebase.cs") &&
+               !Build("/r:$v1/vercachebase.dll /out:$v1/vercacheapp.dll vercache/vercacheapp.cs"));
+
+# The cache is keyed on the image, so both directories need the same one
+copy("$v1/vercacheapp.dll", "$v2/vercacheapp.dll") or die "copy failed: $!";
+
+$ENV{COMPlus_VerificationCacheKeyFile} = $key;
+
+# Convert is verified and cached against v1, but must not be trusted
+# once vercachebase.dll no longer has Derived derive from Base
+my $dir = CacheDir("dependency");
+Check("Convert verifies against v1", Host("run", $v1, "Convert") == 0);
+Check("Convert is cached", CacheFiles($dir) == 1);
+Check("Convert is verified again against v2", Host("run", $v2, "Convert") == 1);
+
+# A valid cache for v2 that only lists Trivial, with Convert added by
+# someone who doesn't have the key
+$dir = CacheDir("tampered");
+Check("Trivial verifies against v2", Host("run", $v2, "Trivial") == 0);
+Check("Trivial is cached", CacheFiles($dir) == 1);
+Check("forged without the key", Host("forge", $dir, $key, $v2, "Convert", "nomac") == 0);
+Check("tampered cache is ignored", Host("run", $v2, "Convert") == 1);
+
+# The same entry with a valid MAC is a hit, so Convert now runs without
+# being verified
+Check("forged with the key", Host("forge", $dir, $key, $v2, "Convert", "mac") == 0);
+Check("cache hit skips verification", Host("run", $v2, "Convert") == 0);
+
+# The MAC is only worth something if nobody else could have written the
+# file. Windows ACLs can't be set from here.
+if ($^O ne "MSWin32") {
+    chmod(0666, glob("$dir/*.ver"));
+    Check("cache writable by others is ignored", Host("run", $v2, "Convert") == 1);
+}
+
+print "PASSED\n";
+exit(0);
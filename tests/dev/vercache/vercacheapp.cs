@@ -0,0 +1,33 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+// The partially trusted code whose verification results get cached.
+// It is built once and the same image is run against both versions
+// of vercachebase.dll.
+
+public class App {
+
+    // Verifiable only if Derived derives from Base
+    public static object Convert()
+    {
+        Base b = new Derived();
+        return b;
+    }
+
+    // Verifiable against either version
+    public static object Trivial()
+    {
+        return new Base();
+    }
+}
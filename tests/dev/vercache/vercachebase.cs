@@ -0,0 +1,28 @@
+// ==++==
+//
+//
+//    Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+//
+//    The use and distribution terms for this software are contained in the file
+//    named license.txt, which can be found in the root of this distribution.
+//    By using this software in any fashion, you are agreeing to be bound by the
+//    terms of this license.
+//
+//    You must not remove this notice, or any other, from this software.
+//
+//
+// ==--==
+// The assembly the cached methods depend on. The version built with V1
+// defined has Derived derive from Base; the other one doesn't, so code
+// that uses a Derived as a Base only verifies against the first.
+
+public class Base {
+}
+
+#if V1
+public class Derived : Base {
+}
+#else
+public class Derived {
+}
+#endif
@@ -0,0 +1,181 @@
+/*=====================================================================
+**
+** Source:  GetOverlappedResult.c (test 1)
+**
+** Purpose: Tests the PAL implementation of the GetOverlappedResult
+**          function. Opens a file with FILE_FLAG_OVERLAPPED, writes to
+**          it and reads it back at given offsets with overlapped
+**          WriteFile and ReadFile, and waits for the results. A read
+**          past the end of the file must fail with ERROR_HANDLE_EOF.
+**
+** 
+**  Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+** 
+**  The use and distribution terms for this software are contained in the file
+**  named license.txt, which can be found in the root of this distribution.
+**  By using this software in any fashion, you are agreeing to be bound by the
+**  terms of this license.
+** 
+**  You must not remove this notice, or any other, from this software.
+** 
+**
+**===================================================================*/
+#include <palsuite.h>
+
+char testFile[]   = "testfile.tmp";
+char testString[] = "people stop and stare";
+
+HANDLE hFile  = INVALID_HANDLE_VALUE;
+HANDLE hEvent = NULL;
+
+void CleanUpAndFail(const char *message, DWORD dwError)
+{
+    if (hFile != INVALID_HANDLE_VALUE && !CloseHandle(hFile))
+    {
+        Trace("ERROR:%u: Unable to close handle 0x%lx.\n",
+              GetLastError(),
+              hFile);
+    }
+    if (hEvent != NULL && !CloseHandle(hEvent))
+    {
+        Trace("ERROR:%u: Unable to close handle 0x%lx.\n",
+              GetLastError(),
+              hEvent);
+    }
+    Fail("ERROR:%u: %s\n", dwError, message);
+}
+
+/* Starts an overlapped read or write at the given offset and waits for
+ * it. Returns the result of GetOverlappedResult; the last error is the
+ * error of the operation.
+ */
+BOOL OverlappedIo(BOOL bWrite, LPVOID lpBuffer, DWORD nBytes, DWORD dwOffset,
+                  DWORD *pdwTransferred)
+{
+    WSAOVERLAPPED overlapped;
+    BOOL bRc;
+
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = dwOffset;
+    overlapped.hEvent = hEvent;
+
+    if (bWrite)
+    {
+        bRc = WriteFile(hFile, lpBuffer, nBytes, NULL, &overlapped);
+    }
+    else
+    {
+        bRc = ReadFile(hFile, lpBuffer, nBytes, NULL, &overlapped);
+    }
+
+    if (!bRc && GetLastError() != ERROR_IO_PENDING)
+    {
+        CleanUpAndFail(bWrite ? "Overlapped WriteFile failed." :
+                                "Overlapped ReadFile failed.",
+                       GetLastError());
+    }
+
+    return GetOverlappedResult(hFile, &overlapped, pdwTransferred, TRUE);
+}
+
+int __cdecl main(int argc, char *argv[])
+{
+    char  szBuffer[256];
+    DWORD dwBytes = 0;
+
+    /* Initialize the PAL.
+     */
+    if (0 != PAL_Initialize(argc,argv))
+    {
+        return FAIL;
+    }
+
+    hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (hEvent == NULL)
+    {
+        Fail("ERROR:%u: Unable to create an event.\n", GetLastError());
+    }
+
+    hFile = CreateFile(testFile, 
+                       GENERIC_WRITE|GENERIC_READ,
+                       FILE_SHARE_WRITE|FILE_SHARE_READ,
+                       NULL,
+                       CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL|FILE_FLAG_OVERLAPPED,
+                       NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        CleanUpAndFail("Unable to create the file.", GetLastError());
+    }
+
+    /* Write the string at offset 4, leaving a hole at the start.
+     */
+    if (!OverlappedIo(TRUE, testString, strlen(testString), 4, &dwBytes))
+    {
+        CleanUpAndFail("The overlapped write failed.", GetLastError());
+    }
+    if (dwBytes != strlen(testString))
+    {
+        CleanUpAndFail("The overlapped write didn't write all the data.",
+                       dwBytes);
+    }
+
+    /* Read back the second word.
+     */
+    memset(szBuffer, 0, sizeof(szBuffer));
+    if (!OverlappedIo(FALSE, szBuffer, 4, 4 + 7, &dwBytes))
+    {
+        CleanUpAndFail("The overlapped read failed.", GetLastError());
+    }
+    if (dwBytes != 4 || memcmp(szBuffer, "stop", 4) != 0)
+    {
+        CleanUpAndFail("The overlapped read returned the wrong data.",
+                       dwBytes);
+    }
+
+    /* Asking for more than there is returns what is there.
+     */
+    memset(szBuffer, 0, sizeof(szBuffer));
+    if (!OverlappedIo(FALSE, szBuffer, sizeof(szBuffer), 4, &dwBytes))
+    {
+        CleanUpAndFail("The overlapped read failed.", GetLastError());
+    }
+    if (dwBytes != strlen(testString) ||
+        memcmp(szBuffer, testString, strlen(testString)) != 0)
+    {
+        CleanUpAndFail("The overlapped read returned the wrong data.",
+                       dwBytes);
+    }
+
+    /* Reading past the end of the file fails with ERROR_HANDLE_EOF.
+     */
+    if (OverlappedIo(FALSE, szBuffer, sizeof(szBuffer), 4096, &dwBytes))
+    {
+        CleanUpAndFail("The read past the end of the file succeeded.",
+                       dwBytes);
+    }
+    if (GetLastError() != ERROR_HANDLE_EOF)
+    {
+        CleanUpAndFail("The read past the end of the file didn't fail "
+                       "with ERROR_HANDLE_EOF.", GetLastError());
+    }
+
+    if (!CloseHandle(hFile))
+    {
+        hFile = INVALID_HANDLE_VALUE;
+        CleanUpAndFail("Unable to close the file.", GetLastError());
+    }
+    hFile = INVALID_HANDLE_VALUE;
+
+    if (!DeleteFileA(testFile))
+    {
+        CleanUpAndFail("Unable to delete the file.", GetLastError());
+    }
+
+    CloseHandle(hEvent);
+
+    /* Terminate the PAL.
+     */
+    PAL_Terminate();
+    return PASS;
+}
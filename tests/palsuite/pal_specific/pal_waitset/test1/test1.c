@@ -0,0 +1,221 @@
+/*=============================================================
+**
+** Source: test1.c
+**
+** Purpose: Positive test for the PAL wait set APIs.
+**          Register more events than WaitForMultipleObjects can take
+**          in a wait set, signal some of them from another thread and 
+**          make sure PAL_WaitSetWait returns exactly those, acquires
+**          them, and drops their registrations. Also check timeouts,
+**          objects that are signaled when they are added, removed 
+**          registrations and alertable waits.
+**
+** 
+**  Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+** 
+**  The use and distribution terms for this software are contained in the file
+**  named license.txt, which can be found in the root of this distribution.
+**  By using this software in any fashion, you are agreeing to be bound by the
+**  terms of this license.
+** 
+**  You must not remove this notice, or any other, from this software.
+** 
+**
+**============================================================*/
+#include <palsuite.h>
+
+/* more than MAXIMUM_WAIT_OBJECTS */
+#define NUM_EVENTS      200
+
+#define FIRST_SIGNALED  7
+#define SECOND_SIGNALED 150
+#define REMOVED         42
+
+HANDLE hEvents[NUM_EVENTS];
+BOOL bAPCCalled = FALSE;
+
+DWORD PALAPI SignalThread(LPVOID lpParam)
+{
+    /* give the main thread time to block */
+    Sleep(200);
+
+    if (!SetEvent(hEvents[REMOVED]) ||
+        !SetEvent(hEvents[FIRST_SIGNALED]) ||
+        !SetEvent(hEvents[SECOND_SIGNALED]))
+    {
+        Trace("SetEvent failed (%u)\n", GetLastError());
+        return 1;
+    }
+    return 0;
+}
+
+VOID PALAPI APCFunc(ULONG_PTR dwParam)
+{
+    bAPCCalled = TRUE;
+}
+
+int __cdecl main(int argc, char *argv[])
+{
+    PAL_WAIT_SET hWaitSet;
+    PVOID contexts[NUM_EVENTS];
+    DWORD nContexts = 0;
+    DWORD dwRet;
+    DWORD i;
+    HANDLE hThread;
+    DWORD dwThreadId;
+    BOOL bFirst = FALSE;
+    BOOL bSecond = FALSE;
+
+    if (0 != PAL_Initialize(argc, argv))
+    {
+        return FAIL;
+    }
+
+    hWaitSet = PAL_CreateWaitSet();
+    if (NULL == hWaitSet)
+    {
+        Fail("PAL_CreateWaitSet failed (%u)\n", GetLastError());
+    }
+
+    for (i = 0; i < NUM_EVENTS; i++)
+    {
+        /* auto-reset, not signaled */
+        hEvents[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (NULL == hEvents[i])
+        {
+            Fail("CreateEvent failed (%u)\n", GetLastError());
+        }
+        if (!PAL_WaitSetAdd(hWaitSet, hEvents[i], (PVOID)(SIZE_T)(i + 1)))
+        {
+            Fail("PAL_WaitSetAdd failed for event %u (%u)\n", i, GetLastError());
+        }
+    }
+
+    /* nothing is signaled yet */
+    dwRet = PAL_WaitSetWait(hWaitSet, 0, FALSE, contexts, NUM_EVENTS, &nContexts);
+    if (WAIT_TIMEOUT != dwRet || 0 != nContexts)
+    {
+        Fail("PAL_WaitSetWait returned %u with %u contexts, expected "
+             "WAIT_TIMEOUT\n", dwRet, nContexts);
+    }
+
+    dwRet = PAL_WaitSetWait(hWaitSet, 100, FALSE, contexts, NUM_EVENTS, &nContexts);
+    if (WAIT_TIMEOUT != dwRet)
+    {
+        Fail("PAL_WaitSetWait returned %u, expected WAIT_TIMEOUT\n", dwRet);
+    }
+
+    /* a removed registration is never returned */
+    if (!PAL_WaitSetRemove(hWaitSet, (PVOID)(SIZE_T)(REMOVED + 1)))
+    {
+        Fail("PAL_WaitSetRemove failed (%u)\n", GetLastError());
+    }
+    if (PAL_WaitSetRemove(hWaitSet, (PVOID)(SIZE_T)(REMOVED + 1)))
+    {
+        Fail("PAL_WaitSetRemove succeeded for a registration that was "
+             "already removed\n");
+    }
+
+    hThread = CreateThread(NULL, 0, SignalThread, NULL, 0, &dwThreadId);
+    if (NULL == hThread)
+    {
+        Fail("CreateThread failed (%u)\n", GetLastError());
+    }
+
+    while (!bFirst || !bSecond)
+    {
+        dwRet = PAL_WaitSetWait(hWaitSet, 5000, FALSE, contexts, NUM_EVENTS, 
+                                &nContexts);
+        if (WAIT_OBJECT_0 != dwRet)
+        {
+            Fail("PAL_WaitSetWait returned %u, expected WAIT_OBJECT_0\n", dwRet);
+        }
+
+        for (i = 0; i < nContexts; i++)
+        {
+            if ((PVOID)(SIZE_T)(FIRST_SIGNALED + 1) == contexts[i] && !bFirst)
+            {
+                bFirst = TRUE;
+            }
+            else if ((PVOID)(SIZE_T)(SECOND_SIGNALED + 1) == contexts[i] && !bSecond)
+            {
+                bSecond = TRUE;
+            }
+            else
+            {
+                Fail("PAL_WaitSetWait returned unexpected context %p\n", 
+                     contexts[i]);
+            }
+        }
+    }
+
+    if (WAIT_OBJECT_0 != WaitForSingleObject(hThread, 5000))
+    {
+        Fail("signaling thread didn't terminate\n");
+    }
+    CloseHandle(hThread);
+
+    /* the wait acquired the auto-reset events, while the removed one is 
+       still signaled */
+    if (WAIT_TIMEOUT != WaitForSingleObject(hEvents[FIRST_SIGNALED], 0) ||
+        WAIT_TIMEOUT != WaitForSingleObject(hEvents[SECOND_SIGNALED], 0))
+    {
+        Fail("PAL_WaitSetWait didn't reset the signaled events\n");
+    }
+    if (WAIT_OBJECT_0 != WaitForSingleObject(hEvents[REMOVED], 0))
+    {
+        Fail("removed registration consumed the event\n");
+    }
+
+    /* returned registrations are dropped */
+    if (PAL_WaitSetRemove(hWaitSet, (PVOID)(SIZE_T)(FIRST_SIGNALED + 1)))
+    {
+        Fail("registration of a returned object is still in the set\n");
+    }
+
+    /* an object signaled when it is added is returned right away */
+    if (!SetEvent(hEvents[FIRST_SIGNALED]) ||
+        !PAL_WaitSetAdd(hWaitSet, hEvents[FIRST_SIGNALED], 
+                        (PVOID)(SIZE_T)(FIRST_SIGNALED + 1)))
+    {
+        Fail("couldn't add a signaled event (%u)\n", GetLastError());
+    }
+    dwRet = PAL_WaitSetWait(hWaitSet, 0, FALSE, contexts, NUM_EVENTS, &nContexts);
+    if (WAIT_OBJECT_0 != dwRet || 1 != nContexts ||
+        (PVOID)(SIZE_T)(FIRST_SIGNALED + 1) != contexts[0])
+    {
+        Fail("PAL_WaitSetWait returned %u with %u contexts, expected the "
+             "event signaled before it was added\n", dwRet, nContexts);
+    }
+
+    /* alertable waits run queued APCs */
+    if (0 == QueueUserAPC(APCFunc, GetCurrentThread(), 0))
+    {
+        Fail("QueueUserAPC failed (%u)\n", GetLastError());
+    }
+    dwRet = PAL_WaitSetWait(hWaitSet, 5000, TRUE, contexts, NUM_EVENTS, &nContexts);
+    if (WAIT_IO_COMPLETION != dwRet || !bAPCCalled)
+    {
+        Fail("PAL_WaitSetWait returned %u, expected WAIT_IO_COMPLETION\n", dwRet);
+    }
+
+    if (!PAL_DeleteWaitSet(hWaitSet))
+    {
+        Fail("PAL_DeleteWaitSet failed (%u)\n", GetLastError());
+    }
+
+    /* the registrations are gone with the set */
+    if (!SetEvent(hEvents[0]) || 
+        WAIT_OBJECT_0 != WaitForSingleObject(hEvents[0], 0))
+    {
+        Fail("deleted wait set still waits on its events\n");
+    }
+
+    for (i = 0; i < NUM_EVENTS; i++)
+    {
+        CloseHandle(hEvents[i]);
+    }
+
+    PAL_Terminate();
+    return PASS;
+}
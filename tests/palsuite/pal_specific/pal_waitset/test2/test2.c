@@ -0,0 +1,238 @@
+/*=============================================================
+**
+** Source: test2.c
+**
+** Purpose: Positive test for the PAL wait set APIs.
+**          An object that is signaled while it is registered in a 
+**          wait set is acquired on the owner's behalf. Make sure that
+**          removing the registration, or deleting the set, before 
+**          PAL_WaitSetWait returned it hands the signal back to
+**          auto-reset events, semaphores and mutexes, and leaves
+**          manual-reset events alone. Also check that signaled 
+**          registrations are returned in the order they were signaled.
+**
+** 
+**  Copyright (c) 2006 Microsoft Corporation.  All rights reserved.
+** 
+**  The use and distribution terms for this software are contained in the file
+**  named license.txt, which can be found in the root of this distribution.
+**  By using this software in any fashion, you are agreeing to be bound by the
+**  terms of this license.
+** 
+**  You must not remove this notice, or any other, from this software.
+** 
+**
+**============================================================*/
+#include <palsuite.h>
+
+#define NUM_ORDERED 8
+
+HANDLE hMutex;
+
+DWORD PALAPI TryMutexThread(LPVOID lpParam)
+{
+    DWORD dwRet = WaitForSingleObject(hMutex, 0);
+
+    if (WAIT_OBJECT_0 == dwRet)
+    {
+        ReleaseMutex(hMutex);
+    }
+    return dwRet;
+}
+
+/* returns the result of WaitForSingleObject(hMutex, 0) on another thread */
+DWORD TryMutexFromAnotherThread()
+{
+    HANDLE hThread;
+    DWORD dwThreadId;
+    DWORD dwExitCode;
+
+    hThread = CreateThread(NULL, 0, TryMutexThread, NULL, 0, &dwThreadId);
+    if (NULL == hThread)
+    {
+        Fail("CreateThread failed (%u)\n", GetLastError());
+    }
+    if (WAIT_OBJECT_0 != WaitForSingleObject(hThread, 5000) ||
+        !GetExitCodeThread(hThread, &dwExitCode))
+    {
+        Fail("mutex thread didn't terminate\n");
+    }
+    CloseHandle(hThread);
+    return dwExitCode;
+}
+
+int __cdecl main(int argc, char *argv[])
+{
+    PAL_WAIT_SET hWaitSet;
+    HANDLE hAutoEvent;
+    HANDLE hManualEvent;
+    HANDLE hSemaphore;
+    HANDLE hOrdered[NUM_ORDERED];
+    PVOID contexts[NUM_ORDERED];
+    DWORD nContexts = 0;
+    DWORD dwRet;
+    DWORD i;
+
+    if (0 != PAL_Initialize(argc, argv))
+    {
+        return FAIL;
+    }
+
+    hWaitSet = PAL_CreateWaitSet();
+    if (NULL == hWaitSet)
+    {
+        Fail("PAL_CreateWaitSet failed (%u)\n", GetLastError());
+    }
+
+    hAutoEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    hManualEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    hSemaphore = CreateSemaphore(NULL, 1, 5, NULL);
+    hMutex = CreateMutex(NULL, FALSE, NULL);
+    if (NULL == hAutoEvent || NULL == hManualEvent || 
+        NULL == hSemaphore || NULL == hMutex)
+    {
+        Fail("couldn't create the objects (%u)\n", GetLastError());
+    }
+
+    /* an auto-reset event signaled while it is registered */
+    if (!PAL_WaitSetAdd(hWaitSet, hAutoEvent, (PVOID)1) || 
+        !SetEvent(hAutoEvent))
+    {
+        Fail("couldn't register and signal the event (%u)\n", GetLastError());
+    }
+    if (WAIT_TIMEOUT != WaitForSingleObject(hAutoEvent, 0))
+    {
+        Fail("the wait set didn't acquire the auto-reset event\n");
+    }
+    if (!PAL_WaitSetRemove(hWaitSet, (PVOID)1))
+    {
+        Fail("PAL_WaitSetRemove failed (%u)\n", GetLastError());
+    }
+    if (WAIT_OBJECT_0 != WaitForSingleObject(hAutoEvent, 0))
+    {
+        Fail("removing the registration lost the auto-reset event's "
+             "signal\n");
+    }
+
+    /* an auto-reset event signaled when it is added */
+    if (!SetEvent(hAutoEvent) || 
+        !PAL_WaitSetAdd(hWaitSet, hAutoEvent, (PVOID)1) ||
+        !PAL_WaitSetRemove(hWaitSet, (PVOID)1))
+    {
+        Fail("couldn't add and remove a signaled event (%u)\n", 
+             GetLastError());
+    }
+    if (WAIT_OBJECT_0 != WaitForSingleObject(hAutoEvent, 0))
+    {
+        Fail("removing the registration lost the signal of an event that "
+             "was signaled when it was added\n");
+    }
+
+    /* a manual-reset event stays signaled, and isn't set again after it 
+       was reset */
+    if (!PAL_WaitSetAdd(hWaitSet, hManualEvent, (PVOID)2) || 
+        !SetEvent(hManualEvent) || !ResetEvent(hManualEvent) ||
+        !PAL_WaitSetRemove(hWaitSet, (PVOID)2))
+    {
+        Fail("couldn't register and signal the manual-reset event (%u)\n", 
+             GetLastError());
+    }
+    if (WAIT_TIMEOUT != WaitForSingleObject(hManualEvent, 0))
+    {
+        Fail("removing the registration set a manual-reset event that was "
+             "reset\n");
+    }
+
+    /* a semaphore gets its count back */
+    if (!PAL_WaitSetAdd(hWaitSet, hSemaphore, (PVOID)3) ||
+        !PAL_WaitSetRemove(hWaitSet, (PVOID)3))
+    {
+        Fail("couldn't add and remove the semaphore (%u)\n", GetLastError());
+    }
+    if (WAIT_OBJECT_0 != WaitForSingleObject(hSemaphore, 0) ||
+        WAIT_TIMEOUT != WaitForSingleObject(hSemaphore, 0))
+    {
+        Fail("removing the registration didn't give the semaphore its "
+             "count back\n");
+    }
+
+    /* a mutex is released */
+    if (!PAL_WaitSetAdd(hWaitSet, hMutex, (PVOID)4))
+    {
+        Fail("couldn't add the mutex (%u)\n", GetLastError());
+    }
+    if (WAIT_TIMEOUT != TryMutexFromAnotherThread())
+    {
+        Fail("the wait set didn't acquire the mutex\n");
+    }
+    if (!PAL_WaitSetRemove(hWaitSet, (PVOID)4))
+    {
+        Fail("PAL_WaitSetRemove failed (%u)\n", GetLastError());
+    }
+    if (WAIT_OBJECT_0 != TryMutexFromAnotherThread())
+    {
+        Fail("removing the registration didn't release the mutex\n");
+    }
+
+    /* signaled registrations are returned oldest first, and the ones that
+       don't fit in the buffer are returned by the next call */
+    for (i = 0; i < NUM_ORDERED; i++)
+    {
+        hOrdered[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (NULL == hOrdered[i] ||
+            !PAL_WaitSetAdd(hWaitSet, hOrdered[i], (PVOID)(SIZE_T)(i + 10)))
+        {
+            Fail("couldn't register event %u (%u)\n", i, GetLastError());
+        }
+    }
+    for (i = NUM_ORDERED; i > 0; i--)
+    {
+        if (!SetEvent(hOrdered[i - 1]))
+        {
+            Fail("SetEvent failed (%u)\n", GetLastError());
+        }
+    }
+    for (i = 0; i < NUM_ORDERED; i += 2)
+    {
+        dwRet = PAL_WaitSetWait(hWaitSet, 0, FALSE, contexts, 2, &nContexts);
+        if (WAIT_OBJECT_0 != dwRet || 2 != nContexts ||
+            (PVOID)(SIZE_T)(NUM_ORDERED - i - 1 + 10) != contexts[0] ||
+            (PVOID)(SIZE_T)(NUM_ORDERED - i - 2 + 10) != contexts[1])
+        {
+            Fail("PAL_WaitSetWait returned %u with %u contexts, expected "
+                 "events %u and %u\n", dwRet, nContexts, 
+                 NUM_ORDERED - i - 1, NUM_ORDERED - i - 2);
+        }
+    }
+
+    /* deleting the set hands back the signals it holds */
+    if (!PAL_WaitSetAdd(hWaitSet, hOrdered[0], (PVOID)10) ||
+        !PAL_WaitSetAdd(hWaitSet, hSemaphore, (PVOID)3) ||
+        !SetEvent(hOrdered[0]) ||
+        !ReleaseSemaphore(hSemaphore, 1, NULL))
+    {
+        Fail("couldn't register and signal the objects (%u)\n", 
+             GetLastError());
+    }
+    if (!PAL_DeleteWaitSet(hWaitSet))
+    {
+        Fail("PAL_DeleteWaitSet failed (%u)\n", GetLastError());
+    }
+    if (WAIT_OBJECT_0 != WaitForSingleObject(hOrdered[0], 0) ||
+        WAIT_OBJECT_0 != WaitForSingleObject(hSemaphore, 0))
+    {
+        Fail("deleting the wait set lost the signals it held\n");
+    }
+
+    for (i = 0; i < NUM_ORDERED; i++)
+    {
+        CloseHandle(hOrdered[i]);
+    }
+    CloseHandle(hAutoEvent);
+    CloseHandle(hManualEvent);
+    CloseHandle(hSemaphore);
+    CloseHandle(hMutex);
+
+    PAL_Terminate();
+    return PASS;
+}